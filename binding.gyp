@@ -10,18 +10,24 @@
         'deps/v8-convert'
       ],
       "sources": [ "src/binding.cc"
+      , "src/cache.cc"
       , "src/common.cc"
       , "src/error.cc"
       , "src/message.cc"
       , "src/object.cc"
+      , "src/odb.cc"
       , "src/oid.cc"
+      , "src/oid_array.cc"
+      , "src/pool.cc"
       , "src/reference.cc"
       , "src/repository.cc"
+      , "src/revwalk.cc"
       ],
 
       "libraries": [
         "<(module_root_dir)/deps/libgit2/build/libgit2.a",
-        "-lssl"
+        "-lssl",
+        "-lpthread"
       ],
 
       # Enable exceptions, required by V8U (see TooTallNate/node-gyp#17)
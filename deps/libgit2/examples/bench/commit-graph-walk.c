@@ -0,0 +1,150 @@
+/*
+ * Compare history walks with and without a commit-graph: a time sorted
+ * walk of every branch, the first 50 commits of a topological walk of
+ * them (as `git log --topo-order -n 50`), and the ahead/behind count of
+ * the first two branches (which also finds their merge base). The
+ * commit-graph is written for the second run and removed again at the
+ * end.
+ *
+ * usage: commit-graph-walk <repository> [<runs>]
+ */
+#include <git2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+struct branches {
+	git_repository *repo;
+	git_oid ids[2];
+	int count;
+};
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void check(int error, const char *what)
+{
+	if (error < 0) {
+		const git_error *e = giterr_last();
+		fprintf(stderr, "%s: %s\n", what, e ? e->message : "failed");
+		exit(1);
+	}
+}
+
+static int branch_cb(const char *name, git_branch_t type, void *payload)
+{
+	struct branches *b = payload;
+	char ref[1024];
+
+	(void)type;
+	if (b->count == 2)
+		return 0;
+
+	snprintf(ref, sizeof(ref), "refs/heads/%s", name);
+	check(git_reference_name_to_id(&b->ids[b->count++], b->repo, ref), "resolving a branch");
+	return 0;
+}
+
+/* milliseconds per walk of up to `limit` commits (0 for all); `count` gets how many */
+static double walk(git_repository *repo, unsigned int sorting, size_t limit,
+	int runs, size_t *count)
+{
+	double start = now();
+	int i;
+
+	for (i = 0; i < runs; ++i) {
+		git_revwalk *walk;
+		git_oid id;
+
+		check(git_revwalk_new(&walk, repo), "creating a walk");
+		git_revwalk_sorting(walk, sorting);
+		check(git_revwalk_push_glob(walk, "heads"), "pushing the branches");
+
+		*count = 0;
+		while ((!limit || *count < limit) && git_revwalk_next(&id, walk) == 0)
+			(*count)++;
+
+		git_revwalk_free(walk);
+	}
+
+	return (now() - start) * 1e3 / runs;
+}
+
+static double ahead_behind(git_repository *repo, const struct branches *b, int runs)
+{
+	double start = now();
+	size_t ahead, behind;
+	int i;
+
+	for (i = 0; i < runs; ++i)
+		check(git_graph_ahead_behind(&ahead, &behind, repo, &b->ids[0], &b->ids[1]),
+			"counting ahead/behind");
+
+	return (now() - start) * 1e3 / runs;
+}
+
+static void run(const char *label, git_repository *repo, const struct branches *b, int runs)
+{
+	size_t count = 0, topo_count = 0;
+	double w = walk(repo, GIT_SORT_TIME, 0, runs, &count);
+	double topo = walk(repo, GIT_SORT_TOPOLOGICAL, 50, runs, &topo_count);
+
+	printf("%-15s walk (%u commits): %9.2f ms   topo, first %u: %9.2f ms   ahead/behind: %9.2f ms\n",
+		label, (unsigned int)count, w, (unsigned int)topo_count, topo,
+		b->count == 2 ? ahead_behind(repo, b, runs) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	struct branches b = { NULL, {{{0}}}, 0 };
+	git_repository *repo;
+	git_commit_graph_writer *writer;
+	git_revwalk *all;
+	char graph_path[4096];
+	int runs = 5;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: commit-graph-walk <repository> [<runs>]\n");
+		return 1;
+	}
+	if (argc > 2 && (runs = atoi(argv[2])) < 1) {
+		fprintf(stderr, "runs must be positive\n");
+		return 1;
+	}
+
+	git_threads_init();
+	check(git_repository_open(&repo, argv[1]), "opening the repository");
+	b.repo = repo;
+
+	snprintf(graph_path, sizeof(graph_path), "%s/objects/info/commit-graph",
+		git_repository_path(repo));
+	if (access(graph_path, F_OK) == 0) {
+		fprintf(stderr, "%s already exists; not touching it\n", graph_path);
+		return 1;
+	}
+
+	check(git_branch_foreach(repo, GIT_BRANCH_LOCAL, branch_cb, &b), "listing branches");
+
+	run("odb:", repo, &b, runs);
+
+	check(git_commit_graph_writer_new(&writer, repo), "creating the writer");
+	check(git_revwalk_new(&all, repo), "creating a walk");
+	check(git_revwalk_push_glob(all, "heads"), "pushing the branches");
+	check(git_commit_graph_writer_add_revwalk(writer, all), "adding the commits");
+	check(git_commit_graph_writer_commit(writer), "writing the commit-graph");
+	git_revwalk_free(all);
+	git_commit_graph_writer_free(writer);
+
+	run("commit-graph:", repo, &b, runs);
+
+	unlink(graph_path);
+	git_repository_free(repo);
+	git_threads_shutdown();
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Compare ways of getting the parents and the date out of commits, the
+ * way a history walk without a commit-graph does: decoding each parent
+ * with git_oid_fromstr and finding the committer time from the end of
+ * the line (as revwalk used to), and git_commit_header_scan. The
+ * commits reachable from all branches are read into memory first, so
+ * only the parsing is timed.
+ *
+ * This is built with the scanner's source, which the library doesn't
+ * export.
+ *
+ * usage: commit-parse <repository> [<runs>]
+ */
+#include <git2.h>
+#include "commit_header.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+struct commits {
+	char *data;
+	size_t *offsets; /* one more than there are commits */
+	size_t count, alloc, data_len, data_alloc;
+};
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void check(int error, const char *what)
+{
+	if (error < 0) {
+		const git_error *e = giterr_last();
+		fprintf(stderr, "%s: %s\n", what, e ? e->message : "failed");
+		exit(1);
+	}
+}
+
+static void add_commit(struct commits *c, const void *data, size_t len)
+{
+	if (c->count + 2 > c->alloc) {
+		c->alloc = c->alloc ? c->alloc * 2 : 1024;
+		c->offsets = realloc(c->offsets, c->alloc * sizeof(size_t));
+	}
+	while (c->data_len + len > c->data_alloc) {
+		c->data_alloc = c->data_alloc ? c->data_alloc * 2 : 1024 * 1024;
+		c->data = realloc(c->data, c->data_alloc);
+	}
+	if (!c->offsets || !c->data) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	memcpy(c->data + c->data_len, data, len);
+	c->offsets[c->count++] = c->data_len;
+	c->data_len += len;
+	c->offsets[c->count] = c->data_len;
+}
+
+static void load(struct commits *c, git_repository *repo)
+{
+	git_revwalk *walk;
+	git_odb *odb;
+	git_oid id;
+	int error;
+
+	check(git_repository_odb(&odb, repo), "opening the odb");
+	check(git_revwalk_new(&walk, repo), "creating a walk");
+	check(git_revwalk_push_glob(walk, "heads"), "pushing the branches");
+
+	while ((error = git_revwalk_next(&id, walk)) == 0) {
+		git_odb_object *obj;
+
+		check(git_odb_read(&obj, odb, &id), "reading a commit");
+		add_commit(c, git_odb_object_data(obj), git_odb_object_size(obj));
+		git_odb_object_free(obj);
+	}
+	if (error != GIT_ITEROVER)
+		check(error, "walking");
+
+	git_revwalk_free(walk);
+	git_odb_free(odb);
+}
+
+/* the parents with git_oid_fromstr, then back from the end of the committer line */
+static int parse_fromstr(git_oid *acc, long long *time, const char *buffer, size_t len)
+{
+	const size_t parent_len = strlen("parent ") + GIT_OID_HEXSZ + 1;
+	const char *buffer_end = buffer + len, *committer_start;
+	size_t i;
+
+	buffer += strlen("tree ") + GIT_OID_HEXSZ + 1;
+
+	while (buffer + parent_len < buffer_end && memcmp(buffer, "parent ", strlen("parent ")) == 0) {
+		git_oid oid;
+
+		if (git_oid_fromstr(&oid, buffer + strlen("parent ")) < 0)
+			return -1;
+		for (i = 0; i < GIT_OID_RAWSZ; ++i)
+			acc->id[i] ^= oid.id[i];
+
+		buffer += parent_len;
+	}
+
+	if ((committer_start = buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
+		return -1;
+	buffer++;
+	if ((buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
+		return -1;
+
+	while (buffer > committer_start && git__isspace(*buffer))
+		buffer--;
+	while (buffer > committer_start && git__isdigit(*buffer))
+		buffer--;
+	if ((buffer > committer_start) && (*buffer == '+' || *buffer == '-')) {
+		buffer--;
+		while (buffer > committer_start && git__isspace(*buffer))
+			buffer--;
+		while (buffer > committer_start && git__isdigit(*buffer))
+			buffer--;
+	}
+	if (buffer == committer_start)
+		return -1;
+
+	*time += strtol(buffer + 1, NULL, 10);
+	return 0;
+}
+
+static int parse_scan(git_oid *acc, long long *time, const char *buffer, size_t len)
+{
+	git_commit_header header;
+	size_t n, i;
+
+	if (git_commit_header_scan(&header, buffer, len) < 0 || !header.committer)
+		return -1;
+
+	for (n = 0; n < header.parent_count; ++n) {
+		git_oid oid;
+
+		if (git_commit_header_parent(&oid, &header, n) < 0)
+			return -1;
+		for (i = 0; i < GIT_OID_RAWSZ; ++i)
+			acc->id[i] ^= oid.id[i];
+	}
+
+	*time += header.committer_time;
+	return 0;
+}
+
+typedef int (*parse_fn)(git_oid *, long long *, const char *, size_t);
+
+static git_oid expected_acc;
+static long long expected_time;
+static int have_expected;
+
+static void run(const char *name, parse_fn fn, const struct commits *c, int runs)
+{
+	double start, elapsed;
+	git_oid acc;
+	long long time = 0;
+	size_t n;
+	int r;
+
+	memset(&acc, 0, sizeof(acc));
+	start = now();
+	for (r = 0; r < runs; ++r) {
+		for (n = 0; n < c->count; ++n) {
+			if (fn(&acc, &time, c->data + c->offsets[n], c->offsets[n + 1] - c->offsets[n]) < 0) {
+				fprintf(stderr, "%s: commit %d doesn't parse\n", name, (int)n);
+				exit(1);
+			}
+		}
+	}
+	elapsed = (now() - start) / runs;
+
+	/* the first one run is the reference */
+	if (!have_expected) {
+		expected_acc = acc;
+		expected_time = time;
+		have_expected = 1;
+	} else if (memcmp(&expected_acc, &acc, sizeof(acc)) || expected_time != time) {
+		fprintf(stderr, "%s gives different parents or dates\n", name);
+		exit(1);
+	}
+
+	printf("%-10s %8.2f ms %10.0f commits/s (%d commits)\n", name,
+		elapsed * 1000, c->count / elapsed, (int)c->count);
+}
+
+int main(int argc, char **argv)
+{
+	git_repository *repo;
+	struct commits c;
+	int runs;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <repository> [<runs>]\n", argv[0]);
+		return 1;
+	}
+	runs = argc > 2 ? atoi(argv[2]) : 5;
+	if (runs < 1)
+		runs = 1;
+
+	memset(&c, 0, sizeof(c));
+	check(git_repository_open(&repo, argv[1]), "opening the repository");
+	load(&c, repo);
+
+	run("fromstr", parse_fromstr, &c, runs);
+	run("scan", parse_scan, &c, runs);
+
+	free(c.data);
+	free(c.offsets);
+	git_repository_free(repo);
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Compare object lookups in a repository's packs with and without a
+ * multi-pack-index. Lookups go straight to the pack backend, so that
+ * neither the object cache nor the refresh the ODB does after a miss
+ * is measured, and are made for objects that exist and for random ids
+ * that don't. The multi-pack-index is written for the second run and
+ * removed again at the end.
+ *
+ * usage: midx-lookup <objects-dir> [<lookups>]
+ */
+#include <git2.h>
+#include <git2/odb_backend.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/time.h>
+
+struct oid_list {
+	git_oid *ids;
+	size_t count, alloc;
+};
+
+static int collect_cb(const git_oid *id, void *payload)
+{
+	struct oid_list *list = payload;
+
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : 1024;
+		git_oid *ids = realloc(list->ids, alloc * sizeof(git_oid));
+		if (!ids)
+			return -1;
+		list->ids = ids;
+		list->alloc = alloc;
+	}
+
+	git_oid_cpy(&list->ids[list->count++], id);
+	return 0;
+}
+
+static int count_packs(const char *objects_dir)
+{
+	char path[4096];
+	struct dirent *de;
+	DIR *dir;
+	int count = 0;
+
+	snprintf(path, sizeof(path), "%s/pack", objects_dir);
+	if ((dir = opendir(path)) == NULL)
+		return 0;
+
+	while ((de = readdir(dir)) != NULL) {
+		size_t len = strlen(de->d_name);
+		if (len > 4 && !strcmp(de->d_name + len - 4, ".idx"))
+			count++;
+	}
+
+	closedir(dir);
+	return count;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* nanoseconds per lookup; exits if an answer is wrong */
+static double lookup(git_odb_backend *b, const struct oid_list *oids, int lookups, int expected)
+{
+	unsigned int seed = 1;
+	double start = now();
+	int i;
+
+	for (i = 0; i < lookups; ++i) {
+		seed = seed * 1103515245 + 12345;
+		if (b->exists(b, &oids->ids[(seed >> 8) % oids->count]) != expected) {
+			fprintf(stderr, "lookup gave the wrong answer\n");
+			exit(1);
+		}
+	}
+
+	return (now() - start) * 1e9 / lookups;
+}
+
+static void run(const char *label, const char *objects_dir,
+	const struct oid_list *present, const struct oid_list *missing, int lookups)
+{
+	git_odb_backend *b;
+
+	if (git_odb_backend_pack(&b, objects_dir) < 0) {
+		fprintf(stderr, "could not open the packs in %s\n", objects_dir);
+		exit(1);
+	}
+
+	printf("%-18s present: %8.0f ns/lookup   missing: %8.0f ns/lookup\n", label,
+		lookup(b, present, lookups, 1), lookup(b, missing, lookups, 0));
+
+	b->free(b);
+}
+
+int main(int argc, char **argv)
+{
+	git_odb *odb;
+	struct oid_list present = { NULL, 0, 0 }, missing = { NULL, 0, 0 };
+	char midx_path[4096];
+	int lookups = 1000000, npacks = 0;
+	size_t i;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: midx-lookup <objects-dir> [<lookups>]\n");
+		return 1;
+	}
+	if (argc > 2 && (lookups = atoi(argv[2])) < 1) {
+		fprintf(stderr, "lookups must be positive\n");
+		return 1;
+	}
+
+	snprintf(midx_path, sizeof(midx_path), "%s/pack/multi-pack-index", argv[1]);
+	if (access(midx_path, F_OK) == 0) {
+		fprintf(stderr, "%s already exists; not touching it\n", midx_path);
+		return 1;
+	}
+
+	git_threads_init();
+
+	if (git_odb_open(&odb, argv[1]) < 0 ||
+		git_odb_foreach(odb, collect_cb, &present) < 0 || present.count == 0) {
+		fprintf(stderr, "could not list the objects in %s\n", argv[1]);
+		return 1;
+	}
+
+	/* random ids; lookup() complains should one of them exist */
+	srand(42);
+	for (i = 0; i < present.count; ++i) {
+		git_oid id;
+		size_t j;
+
+		for (j = 0; j < GIT_OID_RAWSZ; ++j)
+			id.id[j] = (unsigned char)rand();
+		if (collect_cb(&id, &missing) < 0)
+			return 1;
+	}
+
+	npacks = count_packs(argv[1]);
+
+	printf("%d lookups over %d objects in %d packs\n", lookups, (int)present.count, npacks);
+
+	run("per-pack search:", argv[1], &present, &missing, lookups);
+
+	if (git_odb_write_multi_pack_index(odb) < 0) {
+		fprintf(stderr, "could not write the multi-pack-index: %s\n", giterr_last()->message);
+		return 1;
+	}
+
+	run("multi-pack-index:", argv[1], &present, &missing, lookups);
+
+	unlink(midx_path);
+	git_odb_free(odb);
+	free(present.ids);
+	free(missing.ids);
+	git_threads_shutdown();
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Read random objects from a repository's packs on several threads at
+ * once and report the throughput for one thread and for all of them.
+ * Each thread opens the repository on its own and the object cache is
+ * turned off, so every read goes to the pack windows.
+ *
+ * usage: pack-read <repo-dir> [<threads> [<reads-per-thread>]]
+ */
+#include <git2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+struct oid_list {
+	git_oid *ids;
+	size_t count, alloc;
+};
+
+struct reader {
+	const char *path;
+	const struct oid_list *oids;
+	unsigned int seed;
+	int reads;
+	int failed;
+};
+
+static int collect_cb(const git_oid *id, void *payload)
+{
+	struct oid_list *list = payload;
+
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : 1024;
+		git_oid *ids = realloc(list->ids, alloc * sizeof(git_oid));
+		if (!ids)
+			return -1;
+		list->ids = ids;
+		list->alloc = alloc;
+	}
+
+	git_oid_cpy(&list->ids[list->count++], id);
+	return 0;
+}
+
+static void *read_random(void *payload)
+{
+	struct reader *r = payload;
+	git_repository *repo;
+	git_odb *odb;
+	int i;
+
+	if (git_repository_open(&repo, r->path) < 0 ||
+		git_repository_odb(&odb, repo) < 0) {
+		r->failed = 1;
+		return NULL;
+	}
+
+	for (i = 0; i < r->reads; ++i) {
+		git_odb_object *obj;
+
+		r->seed = r->seed * 1103515245 + 12345;
+		if (git_odb_read(&obj, odb, &r->oids->ids[(r->seed >> 8) % r->oids->count]) < 0) {
+			r->failed = 1;
+			break;
+		}
+		git_odb_object_free(obj);
+	}
+
+	git_odb_free(odb);
+	git_repository_free(repo);
+	return NULL;
+}
+
+static double run(const char *path, const struct oid_list *oids, int nthreads, int reads)
+{
+	pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+	struct reader *readers = calloc(nthreads, sizeof(struct reader));
+	struct timeval start, end;
+	int i, failed = 0;
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nthreads; ++i) {
+		readers[i].path = path;
+		readers[i].oids = oids;
+		readers[i].seed = i + 1;
+		readers[i].reads = reads;
+		pthread_create(&threads[i], NULL, read_random, &readers[i]);
+	}
+
+	for (i = 0; i < nthreads; ++i) {
+		pthread_join(threads[i], NULL);
+		failed |= readers[i].failed;
+	}
+
+	gettimeofday(&end, NULL);
+
+	free(threads);
+	free(readers);
+
+	if (failed) {
+		fprintf(stderr, "reading objects failed\n");
+		exit(1);
+	}
+
+	return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	git_repository *repo;
+	git_odb *odb;
+	struct oid_list oids = { NULL, 0, 0 };
+	int nthreads = 8, reads = 100000, t;
+	double base = 0;
+
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "usage: pack-read <repo-dir> [<threads> [<reads-per-thread>]]\n");
+		return 1;
+	}
+	if (argc > 2)
+		nthreads = atoi(argv[2]);
+	if (argc > 3)
+		reads = atoi(argv[3]);
+	if (nthreads < 1 || reads < 1) {
+		fprintf(stderr, "threads and reads must be positive\n");
+		return 1;
+	}
+
+	git_threads_init();
+
+	for (t = GIT_OBJ_COMMIT; t <= GIT_OBJ_TAG; ++t)
+		git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, (git_otype)t, (size_t)0);
+
+	if (git_repository_open(&repo, argv[1]) < 0 ||
+		git_repository_odb(&odb, repo) < 0 ||
+		git_odb_foreach(odb, collect_cb, &oids) < 0 || oids.count == 0) {
+		fprintf(stderr, "could not list the objects in %s\n", argv[1]);
+		return 1;
+	}
+	git_odb_free(odb);
+	git_repository_free(repo);
+
+	printf("%d reads per thread over %d objects\n", reads, (int)oids.count);
+
+	/* 1, 2, 4, ... and finally the requested number of threads */
+	for (t = 1; ; t = (t * 2 < nthreads) ? t * 2 : nthreads) {
+		double secs = run(argv[1], &oids, t, reads);
+		double rate = (t * (double)reads) / secs;
+
+		if (t == 1)
+			base = rate;
+
+		printf("%2d thread(s): %10.0f reads/s  (%.2fx)\n", t, rate, rate / base);
+
+		if (t == nthreads)
+			break;
+	}
+
+	free(oids.ids);
+	git_threads_shutdown();
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Compare two ways of finding the history of a path: walking every
+ * commit and looking the path up in it and in its first parent with
+ * git_tree_entry_bypath, and a walk limited with git_revwalk_set_paths,
+ * which compares trees level by level and skips identical subtrees.
+ * The first also lists commits a merge brought in whose change the
+ * merge didn't keep, so the counts may differ.
+ *
+ * usage: path-walk <repository> <path> [<runs>]
+ */
+#include <git2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void check(int error, const char *what)
+{
+	if (error < 0) {
+		const git_error *e = giterr_last();
+		fprintf(stderr, "%s: %s\n", what, e ? e->message : "failed");
+		exit(1);
+	}
+}
+
+/* 0 and a zero id when the path isn't there */
+static void entry_of(git_oid *out, unsigned int *mode, git_commit *commit, const char *path)
+{
+	git_tree *tree;
+	git_tree_entry *entry;
+
+	memset(out, 0, sizeof(*out));
+	*mode = 0;
+
+	check(git_commit_tree(&tree, commit), "reading a tree");
+	if (git_tree_entry_bypath(&entry, tree, path) == 0) {
+		git_oid_cpy(out, git_tree_entry_id(entry));
+		*mode = git_tree_entry_filemode(entry);
+		git_tree_entry_free(entry);
+	}
+	git_tree_free(tree);
+}
+
+static size_t walk_bypath(git_repository *repo, const char *path)
+{
+	git_revwalk *walk;
+	git_oid id;
+	size_t count = 0;
+
+	check(git_revwalk_new(&walk, repo), "creating a walk");
+	git_revwalk_sorting(walk, GIT_SORT_TIME);
+	check(git_revwalk_push_head(walk), "pushing HEAD");
+
+	while (git_revwalk_next(&id, walk) == 0) {
+		git_commit *commit, *parent;
+		git_oid mine, theirs;
+		unsigned int my_mode, their_mode = 0;
+
+		check(git_commit_lookup(&commit, repo, &id), "reading a commit");
+		entry_of(&mine, &my_mode, commit, path);
+
+		memset(&theirs, 0, sizeof(theirs));
+		if (git_commit_parentcount(commit) > 0) {
+			check(git_commit_parent(&parent, commit, 0), "reading a parent");
+			entry_of(&theirs, &their_mode, parent, path);
+			git_commit_free(parent);
+		}
+
+		if (my_mode != their_mode || git_oid_cmp(&mine, &theirs))
+			count++;
+
+		git_commit_free(commit);
+	}
+
+	git_revwalk_free(walk);
+	return count;
+}
+
+static size_t walk_limited(git_repository *repo, const char *path)
+{
+	git_revwalk *walk;
+	git_strarray paths;
+	git_oid id;
+	size_t count = 0;
+
+	paths.strings = (char **)&path;
+	paths.count = 1;
+
+	check(git_revwalk_new(&walk, repo), "creating a walk");
+	git_revwalk_sorting(walk, GIT_SORT_TIME);
+	check(git_revwalk_set_paths(walk, &paths), "setting the path");
+	check(git_revwalk_push_head(walk), "pushing HEAD");
+
+	while (git_revwalk_next(&id, walk) == 0)
+		count++;
+
+	git_revwalk_free(walk);
+	return count;
+}
+
+static void run(const char *name, size_t (*fn)(git_repository *, const char *),
+	git_repository *repo, const char *path, int runs)
+{
+	double start = now();
+	size_t count = 0;
+	int i;
+
+	for (i = 0; i < runs; ++i)
+		count = fn(repo, path);
+
+	printf("%-10s %10.2f ms %8d commits\n", name,
+		(now() - start) * 1000 / runs, (int)count);
+}
+
+int main(int argc, char **argv)
+{
+	git_repository *repo;
+	int runs;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <repository> <path> [<runs>]\n", argv[0]);
+		return 1;
+	}
+	runs = argc > 3 ? atoi(argv[3]) : 3;
+	if (runs < 1)
+		runs = 1;
+
+	git_threads_init();
+	check(git_repository_open(&repo, argv[1]), "opening the repository");
+
+	run("bypath", walk_bypath, repo, argv[2], runs);
+	run("limited", walk_limited, repo, argv[2], runs);
+
+	git_repository_free(repo);
+	git_threads_shutdown();
+	return 0;
+}
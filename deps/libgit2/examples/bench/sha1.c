@@ -0,0 +1,197 @@
+/*
+ * Compare the SHA-1 implementations: the builtin one, the ones using
+ * the SHA extensions and SSSE3 (where the CPU has them) and OpenSSL's.
+ * Each hashes a large buffer in 64k updates, the way the indexer and
+ * the pack writer do, and many small objects, the way loose objects
+ * and trees are hashed; those are hashed in batches too, the way
+ * git_hash_vec_many takes them, with and without the AVX2 lanes.
+ *
+ * This is built from the hash sources themselves, as the library only
+ * has the one it was configured with, and doesn't link to the library.
+ *
+ * usage: sha1 [<megabytes> [<small-object-size>]]
+ */
+#include "common.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef GIT_BENCH_OPENSSL
+# include <openssl/evp.h>
+# if OPENSSL_VERSION_NUMBER < 0x10100000L
+#  define EVP_MD_CTX_new EVP_MD_CTX_create
+#  define EVP_MD_CTX_free EVP_MD_CTX_destroy
+# endif
+#endif
+
+#define UPDATE_SIZE (64 * 1024)
+#define BATCH_SIZE 64
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void hash_builtin(git_oid *out, const unsigned char *data, size_t len, size_t update)
+{
+	git_hash_ctx ctx;
+	size_t pos;
+
+	git_hash_init(&ctx);
+	for (pos = 0; pos < len; pos += update)
+		git_hash_update(&ctx, data + pos, len - pos < update ? len - pos : update);
+	git_hash_final(out, &ctx);
+}
+
+#ifdef GIT_BENCH_OPENSSL
+/* one context for all the runs, so small objects don't time malloc */
+static EVP_MD_CTX *evp_ctx;
+
+static void hash_openssl(git_oid *out, const unsigned char *data, size_t len, size_t update)
+{
+	size_t pos;
+
+	EVP_DigestInit_ex(evp_ctx, EVP_sha1(), NULL);
+	for (pos = 0; pos < len; pos += update)
+		EVP_DigestUpdate(evp_ctx, data + pos, len - pos < update ? len - pos : update);
+	EVP_DigestFinal_ex(evp_ctx, out->id, NULL);
+}
+#endif
+
+typedef void (*hash_fn)(git_oid *, const unsigned char *, size_t, size_t);
+
+static const unsigned char *data;
+static size_t data_len, small_len;
+static git_oid expected_bulk, expected_small;
+static int have_expected;
+
+static void run(const char *name, hash_fn fn)
+{
+	git_oid id, acc;
+	double start, bulk, small;
+	size_t pos, count = 0, i;
+
+	start = now();
+	fn(&id, data, data_len, UPDATE_SIZE);
+	bulk = now() - start;
+
+	/* the small objects' ids are folded into one to check them */
+	memset(&acc, 0, sizeof(acc));
+	start = now();
+	for (pos = 0; pos + small_len <= data_len; pos += small_len, ++count) {
+		git_oid one;
+		fn(&one, data + pos, small_len, small_len);
+		for (i = 0; i < GIT_OID_RAWSZ; ++i)
+			acc.id[i] ^= one.id[i];
+	}
+	small = now() - start;
+
+	/* the first one run is the reference */
+	if (!have_expected) {
+		expected_bulk = id;
+		expected_small = acc;
+		have_expected = 1;
+	} else if (memcmp(&expected_bulk, &id, sizeof(id)) ||
+		memcmp(&expected_small, &acc, sizeof(acc))) {
+		fprintf(stderr, "%s gives a different hash\n", name);
+		exit(1);
+	}
+
+	printf("%-10s %8.1f MB/s %10.0f objects/s (%d bytes)\n", name,
+		data_len / bulk / (1024 * 1024), count / small, (int)small_len);
+}
+
+static void run_batched(const char *name)
+{
+	git_buf_vec vec[BATCH_SIZE];
+	git_oid ids[BATCH_SIZE], acc;
+	double start, small;
+	size_t pos = 0, count = 0, n, i, j;
+
+	memset(&acc, 0, sizeof(acc));
+	start = now();
+	while (pos + small_len <= data_len) {
+		for (n = 0; n < BATCH_SIZE && pos + small_len <= data_len; ++n, pos += small_len) {
+			vec[n].data = (void *)(data + pos);
+			vec[n].len = small_len;
+		}
+
+		git_hash_vec_many(ids, vec, 1, n);
+		for (i = 0; i < n; ++i)
+			for (j = 0; j < GIT_OID_RAWSZ; ++j)
+				acc.id[j] ^= ids[i].id[j];
+		count += n;
+	}
+	small = now() - start;
+
+	if (memcmp(&expected_small, &acc, sizeof(acc))) {
+		fprintf(stderr, "%s gives a different hash\n", name);
+		exit(1);
+	}
+
+	printf("%-10s %13s %10.0f objects/s (%d bytes, %d at a time)\n", name,
+		"-", count / small, (int)small_len, BATCH_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+	size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 256, i;
+	unsigned char *buf;
+	unsigned int seed = 1;
+
+	small_len = argc > 2 ? (size_t)atoi(argv[2]) : 200;
+	data_len = megabytes * 1024 * 1024;
+
+	if (!data_len || !small_len || (buf = malloc(data_len)) == NULL) {
+		fprintf(stderr, "usage: %s [<megabytes> [<small-object-size>]]\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < data_len; ++i) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (unsigned char)(seed >> 16);
+	}
+	data = buf;
+
+#ifdef X86_SHA1
+	{
+		const git_hash_x86_impl *impl;
+
+		for (impl = git_hash_x86__impls; impl->name; ++impl) {
+			if (git_hash_x86__use(impl->name) < 0) {
+				printf("%-10s not supported by this CPU\n", impl->name);
+				continue;
+			}
+			run(impl->name, hash_builtin);
+		}
+
+		git_hash_x86__use(NULL);
+		run_batched("batched");
+
+		if (git_hash_x86__use_lanes(1) < 0)
+			printf("%-10s not supported by this CPU\n", "avx2x8");
+		else
+			run_batched("avx2x8");
+	}
+#else
+	run("builtin", hash_builtin);
+#endif
+
+#ifdef GIT_BENCH_OPENSSL
+	if ((evp_ctx = EVP_MD_CTX_new()) == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	run("openssl", hash_openssl);
+	EVP_MD_CTX_free(evp_ctx);
+#endif
+
+	free(buf);
+	return 0;
+}
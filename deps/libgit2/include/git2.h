@@ -24,6 +24,7 @@
 #include "git2/revwalk.h"
 #include "git2/merge.h"
 #include "git2/graph.h"
+#include "git2/commit_graph.h"
 #include "git2/refs.h"
 #include "git2/reflog.h"
 #include "git2/revparse.h"
@@ -183,6 +183,27 @@ GIT_EXTERN(int) git_blob_create_fromchunks(
  */
 GIT_EXTERN(int) git_blob_create_frombuffer(git_oid *oid, git_repository *repo, const void *buffer, size_t len);
 
+/**
+ * Write several in-memory buffers to the ODB as blobs
+ *
+ * The buffers are hashed together, which is quicker than one by one
+ * where the CPU can hash several of them side by side, and only the
+ * blobs the ODB doesn't have yet are written.
+ *
+ * @param out array of `n` oids, returning the oids of the blobs
+ * @param repo repository where the blobs will be written
+ * @param buffers array of `n` buffers to be written as blobs
+ * @param lens array of the `n` buffers' lengths
+ * @param n number of buffers
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_blob_create_frombuffers(
+	git_oid *out,
+	git_repository *repo,
+	const void *const *buffers,
+	const size_t *lens,
+	size_t n);
+
 /**
  * Determine if the blob content is most certainly binary or not.
  *
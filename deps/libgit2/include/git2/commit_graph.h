@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_git_commit_graph_h__
+#define INCLUDE_git_commit_graph_h__
+
+#include "common.h"
+#include "types.h"
+#include "oid.h"
+
+/**
+ * @file git2/commit_graph.h
+ * @brief Git commit-graph routines
+ * @defgroup git_commit_graph Git commit-graph routines
+ * @ingroup Git
+ * @{
+ *
+ * A commit-graph file ("objects/info/commit-graph") lists the parents,
+ * commit time and generation number of a set of commits. When one is
+ * present, revision walks, merge bases and ahead/behind counts read
+ * the commits it covers from it instead of from the object database.
+ */
+GIT_BEGIN_DECL
+
+/**
+ * Start building a commit-graph for a repository
+ *
+ * @param out The new writer
+ * @param repo The repository
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_commit_graph_writer_new(
+	git_commit_graph_writer **out, git_repository *repo);
+
+/**
+ * Add a commit to the graph
+ *
+ * Its ancestors are added as well when the graph is written, as the
+ * parents of every commit in the graph must be in it too.
+ *
+ * @param w The writer
+ * @param commit_id The id of the commit
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_commit_graph_writer_add(
+	git_commit_graph_writer *w, const git_oid *commit_id);
+
+/**
+ * Add every commit a revision walk yields to the graph
+ *
+ * To cover every branch, for instance, push the "heads" glob onto the
+ * walk with `git_revwalk_push_glob`.
+ *
+ * @param w The writer
+ * @param walk The revision walk; it is run until it is over
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_commit_graph_writer_add_revwalk(
+	git_commit_graph_writer *w, git_revwalk *walk);
+
+/**
+ * Write the commit-graph of the repository, replacing the current one
+ *
+ * @param w The writer
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_commit_graph_writer_commit(git_commit_graph_writer *w);
+
+/**
+ * Free a commit-graph writer
+ *
+ * @param w The writer
+ */
+GIT_EXTERN(void) git_commit_graph_writer_free(git_commit_graph_writer *w);
+
+/** @} */
+GIT_END_DECL
+#endif
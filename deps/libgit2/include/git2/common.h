@@ -128,7 +128,13 @@ enum {
 	GIT_OPT_GET_MWINDOW_SIZE,
 	GIT_OPT_SET_MWINDOW_SIZE,
 	GIT_OPT_GET_MWINDOW_MAPPED_LIMIT,
-	GIT_OPT_SET_MWINDOW_MAPPED_LIMIT
+	GIT_OPT_SET_MWINDOW_MAPPED_LIMIT,
+	GIT_OPT_GET_CACHE_LIMIT,
+	GIT_OPT_SET_CACHE_LIMIT,
+	GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT,
+	GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT,
+	GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT,
+	GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT
 };
 
 /**
@@ -136,15 +142,43 @@ enum {
  *
  * Available options:
  *
- *	opts(GIT_OPT_MWINDOW_SIZE, size_t):
+ *	opts(GIT_OPT_GET_MWINDOW_SIZE, size_t *):
+ *		get the maximum mmap window size
+ *
+ *	opts(GIT_OPT_SET_MWINDOW_SIZE, size_t):
  *		set the maximum mmap window size
  *
- *	opts(GIT_OPT_MWINDOW_MAPPED_LIMIT, size_t):
+ *	opts(GIT_OPT_GET_MWINDOW_MAPPED_LIMIT, size_t *):
+ *		get the maximum memory that will be mapped in total by the library
+ *
+ *	opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, size_t):
  *		set the maximum amount of memory that can be mapped at any time
  *		by the library
  *
+ *	opts(GIT_OPT_GET_CACHE_LIMIT, git_otype, size_t *):
+ *		get the number of bytes each object cache may spend on objects
+ *		of the given type (0 for types that aren't cached)
+ *
+ *	opts(GIT_OPT_SET_CACHE_LIMIT, git_otype, size_t):
+ *		set the number of bytes each object cache may spend on objects
+ *		of the given type; objects bigger than a fraction of the budget
+ *		are never cached, and a budget of 0 disables caching of the type
+ *
+ *	opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, size_t *):
+ *		get the maximum amount of memory the cache of delta bases may use
+ *
+ *	opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, size_t):
+ *		set the maximum amount of memory the process-wide cache of
+ *		delta bases, shared by all pack files, may use
+ *
+ *	opts(GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT, size_t *):
+ *		get the size of the largest delta base that will be cached
+ *
+ *	opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, size_t):
+ *		set the size of the largest delta base that will be cached
+ *
  *	@param option Option key
- *	@param ... value to set the option
+ *	@param ... value to set the option, or where to put the value queried
  */
 GIT_EXTERN(void) git_libgit2_opts(int option, ...);
 
@@ -191,6 +191,23 @@ GIT_EXTERN(int) git_odb_read_header(size_t *len_out, git_otype *type_out, git_od
  */
 GIT_EXTERN(int) git_odb_exists(git_odb *db, const git_oid *id);
 
+/**
+ * Determine which of many objects can be found in the database.
+ *
+ * This gives the same answers as calling `git_odb_exists` on every
+ * id, but the ids are sorted once and each pack index is then read
+ * in a single pass, which is much faster for large batches.
+ *
+ * @param out bitmap of `(count + 7) / 8` bytes; bit `i % 8` of
+ * byte `i / 8` is set if `ids[i]` was found, and cleared otherwise
+ * @param db database to be searched for the objects
+ * @param ids the ids of the objects to search for
+ * @param count number of ids
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_odb_exists_many(
+	unsigned char *out, git_odb *db, const git_oid *ids, size_t count);
+
 /**
  * Refresh the object database to load newly added files.
  *
@@ -206,6 +223,12 @@ GIT_EXTERN(int) git_odb_exists(git_odb *db, const git_oid *id);
  * when a lookup fails, to see if the looked up object exists
  * on disk but hasn't been loaded yet.
  *
+ * Objects that were still not found after such a refresh are
+ * remembered, and looking them up again does not refresh the ODB
+ * until they are written through it or this function is called.
+ * Loose objects are always found; only objects in packs written
+ * by another application need this call to show up.
+ *
  * @param db database to refresh
  * @return 0 on success, error code otherwise
  */
@@ -301,6 +324,40 @@ GIT_EXTERN(int) git_odb_open_wstream(git_odb_stream **out, git_odb *db, size_t s
  */
 GIT_EXTERN(int) git_odb_open_rstream(git_odb_stream **out, git_odb *db, const git_oid *oid);
 
+/**
+ * Open a stream to read an object from the ODB, with its size and type
+ *
+ * Packed objects are inflated (and their deltas applied) as they are
+ * read, so reading a large blob doesn't take as much memory as the
+ * blob. Objects of backends that can't stream are read whole when the
+ * stream is opened.
+ *
+ * The returned stream will be of type `GIT_STREAM_RDONLY` and
+ * will have the following methods:
+ *
+ *		- stream->read: read up to `n` bytes from the stream; returns
+ *		  how many were read, 0 at the end of the object, or an error
+ *		- stream->free: free the stream
+ *
+ * The stream must always be free'd or will leak memory.
+ *
+ * @see git_odb_stream
+ *
+ * @param out pointer where to store the stream
+ * @param len pointer where to store the size of the object
+ * @param type pointer where to store the type of the object
+ * @param db object database where the stream will read from
+ * @param oid oid of the object the stream will read from
+ * @return 0 if the stream was created; GIT_ENOTFOUND if the object
+ *	isn't in the database; another error code otherwise
+ */
+GIT_EXTERN(int) git_odb_open_rstream_ext(
+	git_odb_stream **out,
+	size_t *len,
+	git_otype *type,
+	git_odb *db,
+	const git_oid *oid);
+
 /**
  * Open a stream for writing a pack file to the ODB.
  *
@@ -325,6 +382,21 @@ GIT_EXTERN(int) git_odb_write_pack(
 	git_transfer_progress_callback progress_cb,
 	void *progress_payload);
 
+/**
+ * Write a multi-pack-index for the packs in the ODB.
+ *
+ * The multi-pack-index lists the objects of all the packs in a
+ * single sorted table, so that looking an object up takes one
+ * search instead of one per pack. The file uses the same format
+ * as git's `multi-pack-index`, and is used automatically when
+ * the ODB is opened or refreshed; packs added after it was
+ * written are still searched one by one.
+ *
+ * @param db object database whose packs should be indexed
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_odb_write_multi_pack_index(git_odb *db);
+
 /**
  * Determine the object-ID (sha1 hash) of a data buffer
  *
@@ -406,6 +478,24 @@ GIT_EXTERN(size_t) git_odb_object_size(git_odb_object *object);
  */
 GIT_EXTERN(git_otype) git_odb_object_type(git_odb_object *object);
 
+/**
+ * Read the counters of the database's raw object cache
+ *
+ * @param out Pointer to the stats structure to fill
+ * @param db database handle
+ */
+GIT_EXTERN(void) git_odb_cache_stats(git_cache_stats *out, git_odb *db);
+
+/**
+ * Read the counters of the delta base cache
+ *
+ * The cache is shared by all the pack files opened by the process, and
+ * its size is bounded by `GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT`.
+ *
+ * @param out Pointer to the stats structure to fill
+ */
+GIT_EXTERN(void) git_odb_delta_base_cache_stats(git_cache_stats *out);
+
 /** @} */
 GIT_END_DECL
 #endif
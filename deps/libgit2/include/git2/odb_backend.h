@@ -103,6 +103,36 @@ struct git_odb_backend {
 			void *progress_payload);
 
 	void (* free)(struct git_odb_backend *);
+
+	/* Callbacks added since are kept below, so that backends
+	 * built against an older layout still line up.
+	 */
+
+	/* Index all the packs of the backend in a single
+	 * multi-pack-index, so lookups don't have to search
+	 * every pack in turn.
+	 */
+	int (* writemidx)(struct git_odb_backend *);
+
+	/* Check many objects at once. The ids are sorted; set
+	 * bit `i % 8` of byte `i / 8` of the bitmap for each one
+	 * that exists, and leave the bits already set alone.
+	 */
+	int (* exists_many)(
+			struct git_odb_backend *,
+			unsigned char *,
+			const git_oid *,
+			size_t);
+
+	/* Like `readstream`, and also gives the size and type
+	 * of the object.
+	 */
+	int (* readstream_ext)(
+			struct git_odb_stream **,
+			size_t *,
+			git_otype *,
+			struct git_odb_backend *,
+			const git_oid *);
 };
 
 #define GIT_ODB_BACKEND_VERSION 1
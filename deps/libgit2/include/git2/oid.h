@@ -59,6 +59,20 @@ GIT_EXTERN(int) git_oid_fromstr(git_oid *out, const char *str);
  */
 GIT_EXTERN(int) git_oid_fromstrn(git_oid *out, const char *str, size_t length);
 
+/**
+ * Parse many hex formatted object ids at once.
+ *
+ * The ids are read from `str` back to back, with no separators:
+ * 40 hex characters each. This is much faster than calling
+ * `git_oid_fromstr()` in a loop on large batches.
+ *
+ * @param out array of `count` oids the result is written into.
+ * @param str input hex string, `count * 40` characters long.
+ * @param count number of oids to parse.
+ * @return 0 or an error code if any of the characters isn't hex
+ */
+GIT_EXTERN(int) git_oid_fromstr_many(git_oid *out, const char *str, size_t count);
+
 /**
  * Copy an already raw oid into a git_oid structure.
  *
@@ -79,6 +93,18 @@ GIT_EXTERN(void) git_oid_fromraw(git_oid *out, const unsigned char *raw);
  */
 GIT_EXTERN(void) git_oid_fmt(char *out, const git_oid *id);
 
+/**
+ * Format many git_oids into hex at once.
+ *
+ * The ids are written back to back, with no separators: 40 hex
+ * characters each. No '\\0' terminator is added.
+ *
+ * @param out output hex string, at least `count * 40` bytes long.
+ * @param ids array of `count` oids to format.
+ * @param count number of oids to format.
+ */
+GIT_EXTERN(void) git_oid_fmt_many(char *out, const git_oid *ids, size_t count);
+
 /**
  * Format a git_oid into a loose-object path string.
  *
@@ -68,6 +68,22 @@ GIT_EXTERN(int) git_packbuilder_insert(git_packbuilder *pb, const git_oid *id, c
  */
 GIT_EXTERN(int) git_packbuilder_insert_tree(git_packbuilder *pb, const git_oid *id);
 
+/**
+ * Insert the commits of a revision walk and the objects they reference
+ *
+ * When one of the repository's packs has a reachability bitmap index,
+ * and it covers the walk, the objects are found with it: everything
+ * reachable from the pushed commits and not from the hidden ones. The
+ * walk isn't run in that case. Otherwise it's run until it is over and
+ * each commit it yields is inserted along with its whole tree.
+ *
+ * @param pb The packbuilder
+ * @param walk The revision walk, which mustn't have been started
+ *
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_packbuilder_insert_walk(git_packbuilder *pb, git_revwalk *walk);
+
 /**
  * Write the new pack and the corresponding index to path
  *
@@ -105,6 +121,27 @@ GIT_EXTERN(uint32_t) git_packbuilder_object_count(git_packbuilder *pb);
  */
 GIT_EXTERN(uint32_t) git_packbuilder_written(git_packbuilder *pb);
 
+/**
+ * Write a reachability bitmap index for one of the repository's packs
+ *
+ * The pack is the one holding the first commit the walk yields, and it
+ * must hold every object the walk's commits reach; this is the case
+ * for a pack built with `git_packbuilder_insert_walk` from the same
+ * walk. The commits the walk was started from get a bitmap, and so
+ * does every hundredth commit on the way. Fetches and pushes can then
+ * work out the objects they need from the bitmaps without walking
+ * every tree.
+ *
+ * The file is written next to the pack with a ".bitmap" extension, in
+ * the format git uses.
+ *
+ * @param repo The repository
+ * @param walk The revision walk; it is run until it is over
+ *
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_pack_bitmap_write(git_repository *repo, git_revwalk *walk);
+
 /**
  * Free the packbuilder and all associated data
  *
@@ -54,6 +54,32 @@ GIT_EXTERN(int) git_reference_lookup(git_reference **out, git_repository *repo,
 GIT_EXTERN(int) git_reference_name_to_id(
 	git_oid *out, git_repository *repo, const char *name);
 
+/**
+ * Lookup many reference names and resolve them to OIDs at once.
+ *
+ * This gives the same results as calling `git_reference_name_to_id()`
+ * for every name, but the packed-refs file is only loaded (or checked
+ * for changes) once for the whole batch.
+ *
+ * A name that can't be resolved doesn't stop the batch: its error code
+ * is stored in `errors` and its entry in `out` is zeroed.
+ *
+ * @param out Array of `count` oids to be filled in
+ * @param errors Array of `count` ints, set to 0 for every resolved name,
+ * or to the error code for that name (ENOTFOUND, EINVALIDSPEC...)
+ * @param repo The repository in which to look up the references
+ * @param names Array of `count` long names for the references
+ * @param count Number of names to resolve
+ * @return 0 on success, or an error code if the packed refs couldn't
+ * be loaded
+ */
+GIT_EXTERN(int) git_reference_name_to_id_many(
+	git_oid *out,
+	int *errors,
+	git_repository *repo,
+	const char **names,
+	size_t count);
+
 /**
  * Create a new symbolic reference.
  *
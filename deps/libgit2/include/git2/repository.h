@@ -642,6 +642,20 @@ typedef enum {
  */
 GIT_EXTERN(int) git_repository_state(git_repository *repo);
 
+/**
+ * Read the counters of the repository's parsed object cache
+ *
+ * Parsed objects looked up through `git_object_lookup` and friends are
+ * kept in a per-repository cache whose size is bounded by the per-type
+ * byte budgets set with `GIT_OPT_SET_CACHE_LIMIT`.
+ *
+ * @param out Pointer to the stats structure to fill
+ * @param repo Repository pointer
+ */
+GIT_EXTERN(void) git_repository_cache_stats(
+	git_cache_stats *out,
+	git_repository *repo);
+
 /** @} */
 GIT_END_DECL
 #endif
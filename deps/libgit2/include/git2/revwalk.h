@@ -10,6 +10,7 @@
 #include "common.h"
 #include "types.h"
 #include "oid.h"
+#include "strarray.h"
 
 /**
  * @file git2/revwalk.h
@@ -216,6 +217,29 @@ GIT_EXTERN(int) git_revwalk_next(git_oid *out, git_revwalk *walk);
  */
 GIT_EXTERN(void) git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode);
 
+/**
+ * Only show the commits which change one of the given paths, the way
+ * `git log -- <paths>` does.
+ *
+ * The history is simplified as git does it by default: a commit which
+ * has the paths as one of its parents has them is left out, and only
+ * that parent is followed (the first one, if there are several), so
+ * the side branches of a merge which kept one side's version aren't
+ * walked. A root commit is shown if it has any of the paths.
+ *
+ * Paths are relative to the root of the tree and name a file or a
+ * directory (with or without a trailing slash); they're taken
+ * literally, without any glob matching. A NULL or empty list, or an
+ * empty path, removes the limit.
+ *
+ * Changing the paths resets the walker.
+ *
+ * @param walk the walker being used for the traversal.
+ * @param paths the paths to limit the walk to
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_revwalk_set_paths(git_revwalk *walk, const git_strarray *paths);
+
 /**
  * Free a revision walker previously allocated.
  *
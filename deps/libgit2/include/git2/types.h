@@ -143,6 +143,19 @@ typedef struct git_note git_note;
 /** Representation of a git packbuilder */
 typedef struct git_packbuilder git_packbuilder;
 
+/** Representation of a commit-graph being built */
+typedef struct git_commit_graph_writer git_commit_graph_writer;
+
+/** Counters describing the state of an object cache */
+typedef struct git_cache_stats {
+	size_t hits; /** lookups served from the cache */
+	size_t misses; /** lookups that had to go to the backends */
+	size_t stores; /** objects inserted into the cache */
+	size_t evictions; /** objects pushed out of the cache */
+	size_t entries; /** objects currently cached */
+	size_t bytes; /** bytes currently accounted to cached objects */
+} git_cache_stats;
+
 /** Time in a signature */
 typedef struct git_time {
 	git_time_t time; /** time in seconds from epoch */
@@ -62,6 +62,38 @@ int git_blob_create_frombuffer(git_oid *oid, git_repository *repo, const void *b
 	return error;
 }
 
+int git_blob_create_frombuffers(
+	git_oid *out,
+	git_repository *repo,
+	const void *const *buffers,
+	const size_t *lens,
+	size_t n)
+{
+	int error;
+	git_odb *odb;
+	git_rawobj *objs;
+	size_t i;
+
+	assert(out && repo && (n == 0 || (buffers && lens)));
+
+	if ((error = git_repository_odb__weakptr(&odb, repo)) < 0)
+		return error;
+
+	objs = git__calloc(n ? n : 1, sizeof(git_rawobj));
+	GITERR_CHECK_ALLOC(objs);
+
+	for (i = 0; i < n; ++i) {
+		objs[i].data = (void *)buffers[i];
+		objs[i].len = lens[i];
+		objs[i].type = GIT_OBJ_BLOB;
+	}
+
+	error = git_odb__write_many(out, odb, objs, n);
+
+	git__free(objs);
+	return error;
+}
+
 static int write_file_stream(
 	git_oid *oid, git_odb *odb, const char *path, git_off_t file_size)
 {
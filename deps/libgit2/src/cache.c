@@ -11,61 +11,300 @@
 #include "thread-utils.h"
 #include "util.h"
 #include "cache.h"
+#include "global.h"
 #include "git2/oid.h"
 
+/*
+ * The cache is split into sets of GIT_CACHE_WAYS slots each; an object
+ * can only live in the set picked by its oid, and the least recently
+ * used slot of the set is replaced on a conflict. Sets are striped over
+ * GIT_CACHE_SHARDS shards, each with its own lock and its own share of
+ * the per-type byte budgets. When a shard goes over the budget of a type,
+ * the oldest of a few sampled objects of that type is evicted.
+ *
+ * Lookups are lock-free; see the comment on git_cache_shard for how
+ * evicted objects are kept alive for readers that may still see them.
+ */
+
+#define GIT_CACHE_SAMPLES 5
+
+size_t git_cache__budget[GIT_CACHE_TYPES] = {
+	0,                /* other */
+	(8 * 1024 * 1024), /* GIT_OBJ_COMMIT */
+	(8 * 1024 * 1024), /* GIT_OBJ_TREE */
+	(4 * 1024 * 1024), /* GIT_OBJ_BLOB */
+	(1 * 1024 * 1024)  /* GIT_OBJ_TAG */
+};
+
+GIT_INLINE(int) cache_type(git_otype type)
+{
+	return (type > 0 && type < GIT_CACHE_TYPES) ? (int)type : 0;
+}
+
+GIT_INLINE(size_t) cache_set(git_cache *cache, const git_oid *oid)
+{
+	uint32_t hash;
+	memcpy(&hash, oid->id, sizeof(hash));
+	return hash & cache->set_mask;
+}
+
+GIT_INLINE(size_t) shard_slots(git_cache *cache)
+{
+	return ((cache->set_mask + 1) / GIT_CACHE_SHARDS) * GIT_CACHE_WAYS;
+}
+
+/* Map the n-th slot owned by a shard to its index in the slot table */
+GIT_INLINE(size_t) shard_slot(size_t shard, size_t n)
+{
+	size_t set = shard + (n / GIT_CACHE_WAYS) * GIT_CACHE_SHARDS;
+	return set * GIT_CACHE_WAYS + (n % GIT_CACHE_WAYS);
+}
+
+GIT_INLINE(uint32_t) slot_age(git_cache *cache, git_cache_shard *shard, size_t slot)
+{
+	return shard->clock - cache->stamps[slot];
+}
+
+/*
+ * Epochs count up to a multiple of 3 and wrap, so that `epoch % 3`
+ * always takes turns, even across the wrap.
+ */
+#define CACHE_EPOCH_WRAP (3 << 28)
+
+GIT_INLINE(int) epoch_next(int epoch)
+{
+	return (epoch + 1) % CACHE_EPOCH_WRAP;
+}
+
+/* How many epochs `epoch` is behind `now` */
+GIT_INLINE(int) epoch_age(int now, int epoch)
+{
+	return (now - epoch + CACHE_EPOCH_WRAP) % CACHE_EPOCH_WRAP;
+}
+
+static git_atomic cache_stripes_given;
+
+/* The stripe of the calling thread */
+static git_cache_stripe *cache_stripe(git_cache *cache)
+{
+	git_global_st *global = GIT_GLOBAL;
+
+	if (global == NULL)
+		return &cache->stripes[0];
+
+	if (!global->cache_stripe)
+		global->cache_stripe = git_atomic_inc(&cache_stripes_given);
+
+	return &cache->stripes[(unsigned int)global->cache_stripe % GIT_CACHE_STRIPES];
+}
+
+/* Move to the next epoch, if nobody is still reading in the previous one */
+static int cache_advance(git_cache *cache)
+{
+	int epoch = cache->epoch.val, i;
+	ssize_t reading = 0;
+
+	git_memory_barrier();
+
+	for (i = 0; i < GIT_CACHE_STRIPES; ++i)
+		reading += cache->stripes[i].readers[(epoch + 2) % 3].val;
+
+	if (reading)
+		return 0;
+
+	git_atomic_compare_and_swap(&cache->epoch, epoch, epoch_next(epoch));
+	return 1;
+}
+
+static void release_list(git_cache *cache, git_cache_shard *shard, int list)
+{
+	size_t i;
+	git_cached_obj *node;
+
+	git_vector_foreach(&shard->retired[list], i, node) {
+		shard->retired_used[cache_type(node->type)] -= node->size;
+		git_cached_obj_decref(node, cache->free_obj);
+	}
+
+	git_vector_clear(&shard->retired[list]);
+}
+
+/* Drop the cache's references to the retired objects no reader can see */
+static void release_retired(git_cache *cache, git_cache_shard *shard)
+{
+	int list, now;
+
+	/* when nobody's reading, this moves two epochs on, and whatever
+	 * was just evicted can go right away */
+	if (cache_advance(cache))
+		cache_advance(cache);
+
+	now = cache->epoch.val;
+
+	for (list = 0; list < 3; ++list) {
+		if (shard->retired[list].length > 0 &&
+			epoch_age(now, shard->retired_epoch[list]) >= 2)
+			release_list(cache, shard, list);
+	}
+}
+
+static size_t retired_count(git_cache_shard *shard)
+{
+	return shard->retired[0].length + shard->retired[1].length +
+		shard->retired[2].length;
+}
+
+static int evict_slot(git_cache *cache, git_cache_shard *shard, size_t slot)
+{
+	git_cached_obj *node = git___swap((void * volatile *)&cache->slots[slot], NULL);
+	int type = cache_type(node->type);
+	int epoch = cache->epoch.val, list = epoch % 3;
+
+	/* the list may still hold objects from three epochs back: they
+	 * have to go first, so that the list only holds one epoch */
+	if (shard->retired[list].length > 0 && shard->retired_epoch[list] != epoch)
+		release_list(cache, shard, list);
+
+	/* readers that loaded the slot before the swap may still be looking
+	 * at the object; if it cannot be parked, it stays cached */
+	if (git_vector_insert(&shard->retired[list], node) < 0) {
+		giterr_clear();
+		git___swap((void * volatile *)&cache->slots[slot], node);
+		return -1;
+	}
+
+	shard->retired_epoch[list] = epoch;
+	shard->retired_used[type] += node->size;
+
+	shard->used[type] -= node->size;
+	shard->entries--;
+	shard->evictions++;
+	return 0;
+}
+
+static int evict_sampled(git_cache *cache, size_t s, int type)
+{
+	git_cache_shard *shard = &cache->shards[s];
+	size_t total = shard_slots(cache), scanned, seen = 0;
+	size_t slot, best = 0;
+	int found = 0;
+
+	for (scanned = 0; scanned < total && seen < GIT_CACHE_SAMPLES; ++scanned) {
+		git_cached_obj *node;
+
+		slot = shard_slot(s, shard->hand);
+		shard->hand = (shard->hand + 1) % total;
+
+		node = cache->slots[slot];
+		if (node == NULL || cache_type(node->type) != type)
+			continue;
+
+		seen++;
+		if (!found || slot_age(cache, shard, slot) > slot_age(cache, shard, best)) {
+			best = slot;
+			found = 1;
+		}
+	}
+
+	if (!found)
+		return -1;
+
+	return evict_slot(cache, shard, best);
+}
+
 int git_cache_init(git_cache *cache, size_t size, git_cached_obj_freeptr free_ptr)
 {
-	if (size < 8)
-		size = 8;
-	size = git__size_t_powerof2(size);
+	size_t i, j, sets = size / GIT_CACHE_WAYS;
 
-	cache->size_mask = size - 1;
-	cache->lru_count = 0;
+	if (sets < GIT_CACHE_SHARDS)
+		sets = GIT_CACHE_SHARDS;
+	sets = git__size_t_powerof2(sets);
+
+	memset(cache, 0x0, sizeof(git_cache));
+
+	cache->set_mask = sets - 1;
 	cache->free_obj = free_ptr;
 
-	git_mutex_init(&cache->lock);
+	cache->slots = git__calloc(sets * GIT_CACHE_WAYS, sizeof(git_cached_obj *));
+	GITERR_CHECK_ALLOC(cache->slots);
+
+	cache->stamps = git__calloc(sets * GIT_CACHE_WAYS, sizeof(uint32_t));
+	if (cache->stamps == NULL) {
+		git__free((void *)cache->slots);
+		cache->slots = NULL;
+		return -1;
+	}
 
-	cache->nodes = git__malloc(size * sizeof(git_cached_obj *));
-	GITERR_CHECK_ALLOC(cache->nodes);
+	for (i = 0; i < GIT_CACHE_SHARDS; ++i) {
+		git_mutex_init(&cache->shards[i].lock);
+		for (j = 0; j < 3; ++j)
+			git_vector_init(&cache->shards[i].retired[j], 0, NULL);
+	}
 
-	memset(cache->nodes, 0x0, size * sizeof(git_cached_obj *));
 	return 0;
 }
 
 void git_cache_free(git_cache *cache)
 {
-	size_t i;
+	size_t i, j;
+
+	if (cache->slots == NULL)
+		return;
+
+	for (i = 0; i < (cache->set_mask + 1) * GIT_CACHE_WAYS; ++i) {
+		if (cache->slots[i] != NULL)
+			git_cached_obj_decref(cache->slots[i], cache->free_obj);
+	}
 
-	for (i = 0; i < (cache->size_mask + 1); ++i) {
-		if (cache->nodes[i] != NULL)
-			git_cached_obj_decref(cache->nodes[i], cache->free_obj);
+	/* nobody can be reading any more */
+	for (i = 0; i < GIT_CACHE_SHARDS; ++i) {
+		for (j = 0; j < 3; ++j) {
+			release_list(cache, &cache->shards[i], (int)j);
+			git_vector_free(&cache->shards[i].retired[j]);
+		}
+		git_mutex_free(&cache->shards[i].lock);
 	}
 
-	git_mutex_free(&cache->lock);
-	git__free(cache->nodes);
+	git__free((void *)cache->slots);
+	git__free((void *)cache->stamps);
+	cache->slots = NULL;
+	cache->stamps = NULL;
 }
 
 void *git_cache_get(git_cache *cache, const git_oid *oid)
 {
-	uint32_t hash;
-	git_cached_obj *node = NULL, *result = NULL;
+	size_t set = cache_set(cache, oid), i;
+	git_cache_shard *shard = &cache->shards[set % GIT_CACHE_SHARDS];
+	git_cache_stripe *stripe = cache_stripe(cache);
+	git_cached_obj *result = NULL;
+	int epoch;
 
-	memcpy(&hash, oid->id, sizeof(hash));
-
-	if (git_mutex_lock(&cache->lock)) {
-		giterr_set(GITERR_THREAD, "unable to lock cache mutex");
-		return NULL;
+	/* no lock: the cache's reference on anything we can load from a
+	 * slot is only dropped two epochs after it's evicted, and the epoch
+	 * can't get that far while we're counted in. If it moved on before
+	 * we were, count again, so we're counted in the epoch we read in. */
+	for (;;) {
+		epoch = cache->epoch.val;
+		git_atomic_inc(&stripe->readers[epoch % 3]);
+		if (cache->epoch.val == epoch)
+			break;
+		git_atomic_dec(&stripe->readers[epoch % 3]);
 	}
 
-	{
-		node = cache->nodes[hash & cache->size_mask];
+	for (i = set * GIT_CACHE_WAYS; i < (set + 1) * GIT_CACHE_WAYS; ++i) {
+		git_cached_obj *node = cache->slots[i];
 
 		if (node != NULL && git_oid_cmp(&node->oid, oid) == 0) {
 			git_cached_obj_incref(node);
+			cache->stamps[i] = shard->clock;
 			result = node;
+			break;
 		}
 	}
-	git_mutex_unlock(&cache->lock);
+
+	git_atomic_dec(&stripe->readers[epoch % 3]);
+
+	git_atomic_ssize_add(result ? &stripe->hits : &stripe->misses, 1);
 
 	return result;
 }
@@ -73,38 +312,106 @@ void *git_cache_get(git_cache *cache, const git_oid *oid)
 void *git_cache_try_store(git_cache *cache, void *_entry)
 {
 	git_cached_obj *entry = _entry;
-	uint32_t hash;
+	size_t set = cache_set(cache, &entry->oid), s = set % GIT_CACHE_SHARDS;
+	git_cache_shard *shard = &cache->shards[s];
+	int type = cache_type(entry->type);
+	size_t budget = git_cache__budget[type] / GIT_CACHE_SHARDS;
+	size_t i, victim = set * GIT_CACHE_WAYS;
 
-	memcpy(&hash, &entry->oid, sizeof(uint32_t));
-
-	if (git_mutex_lock(&cache->lock)) {
+	if (git_mutex_lock(&shard->lock)) {
 		giterr_set(GITERR_THREAD, "unable to lock cache mutex");
 		return NULL;
 	}
 
-	{
-		git_cached_obj *node = cache->nodes[hash & cache->size_mask];
+	/* increase the refcount on this object, because
+	 * we are returning it to the user */
+	git_cached_obj_incref(entry);
 
-		/* increase the refcount on this object, because
-		 * the cache now owns it */
-		git_cached_obj_incref(entry);
+	for (i = set * GIT_CACHE_WAYS; i < (set + 1) * GIT_CACHE_WAYS; ++i) {
+		git_cached_obj *node = cache->slots[i];
 
 		if (node == NULL) {
-			cache->nodes[hash & cache->size_mask] = entry;
-		} else if (git_oid_cmp(&node->oid, &entry->oid) == 0) {
+			if (cache->slots[victim] != NULL)
+				victim = i;
+			continue;
+		}
+
+		if (git_oid_cmp(&node->oid, &entry->oid) == 0) {
 			git_cached_obj_decref(entry, cache->free_obj);
-			entry = node;
-		} else {
-			git_cached_obj_decref(node, cache->free_obj);
-			cache->nodes[hash & cache->size_mask] = entry;
+			git_cached_obj_incref(node);
+			cache->stamps[i] = ++shard->clock;
+
+			git_mutex_unlock(&shard->lock);
+			return node;
 		}
 
-		/* increase the refcount again, because we are
-		 * returning it to the user */
-		git_cached_obj_incref(entry);
+		if (cache->slots[victim] != NULL &&
+			slot_age(cache, shard, i) > slot_age(cache, shard, victim))
+			victim = i;
+	}
+
+	/* objects that would take a big bite out of the budget
+	 * are handed back to the user without being cached */
+	if (budget == 0 || entry->size > budget / 4) {
+		git_mutex_unlock(&shard->lock);
+		return entry;
+	}
+
+	/* parked objects still hold their memory, so they count against
+	 * the budget too. Should readers keep enough of them around to make
+	 * twice the budget, or too many of them, nothing more is cached
+	 * until they're gone; writers never wait for readers. */
+	release_retired(cache, shard);
 
+	if (shard->used[type] + shard->retired_used[type] + entry->size > 2 * budget ||
+		retired_count(shard) >= GIT_CACHE_MAX_RETIRED ||
+		(cache->slots[victim] != NULL && evict_slot(cache, shard, victim) < 0)) {
+		git_mutex_unlock(&shard->lock);
+		return entry;
 	}
-	git_mutex_unlock(&cache->lock);
+
+	/* the cache now owns a reference too */
+	git_cached_obj_incref(entry);
+
+	cache->stamps[victim] = ++shard->clock;
+	git___swap((void * volatile *)&cache->slots[victim], entry);
+	shard->used[type] += entry->size;
+	shard->entries++;
+	shard->stores++;
+
+	while (shard->used[type] > budget && evict_sampled(cache, s, type) == 0)
+		/* nothing */;
+
+	release_retired(cache, shard);
+
+	git_mutex_unlock(&shard->lock);
 
 	return entry;
 }
+
+void git_cache_read_stats(git_cache_stats *out, git_cache *cache)
+{
+	size_t i, t;
+
+	memset(out, 0x0, sizeof(git_cache_stats));
+
+	for (i = 0; i < GIT_CACHE_STRIPES; ++i) {
+		out->hits += (size_t)cache->stripes[i].hits.val;
+		out->misses += (size_t)cache->stripes[i].misses.val;
+	}
+
+	for (i = 0; i < GIT_CACHE_SHARDS; ++i) {
+		git_cache_shard *shard = &cache->shards[i];
+
+		if (git_mutex_lock(&shard->lock))
+			continue;
+
+		out->stores += shard->stores;
+		out->evictions += shard->evictions;
+		out->entries += shard->entries;
+		for (t = 0; t < GIT_CACHE_TYPES; ++t)
+			out->bytes += shard->used[t] + shard->retired_used[t];
+
+		git_mutex_unlock(&shard->lock);
+	}
+}
@@ -12,23 +12,81 @@
 #include "git2/odb.h"
 
 #include "thread-utils.h"
+#include "vector.h"
 
-#define GIT_DEFAULT_CACHE_SIZE 128
+/* Number of slots in a cache; entries are also bounded by the byte budgets */
+#define GIT_DEFAULT_CACHE_SIZE 4096
+
+/* Associativity of each set, and number of independently locked shards */
+#define GIT_CACHE_WAYS 8
+#define GIT_CACHE_SHARDS 16
+
+/* Evicted objects a shard may keep parked before it stops caching */
+#define GIT_CACHE_MAX_RETIRED 64
+
+/* Size of a CPU cache line, for keeping hot fields apart */
+#define GIT_CACHE_LINE 64
+
+/* Number of reader counters; each thread sticks to one of them */
+#define GIT_CACHE_STRIPES 16
+
+/* Budgets are tracked for GIT_OBJ_COMMIT..GIT_OBJ_TAG; slot 0 is "other" */
+#define GIT_CACHE_TYPES (GIT_OBJ_TAG + 1)
+
+extern size_t git_cache__budget[GIT_CACHE_TYPES];
 
 typedef void (*git_cached_obj_freeptr)(void *);
 
 typedef struct {
 	git_oid oid;
 	git_atomic refcount;
+	git_otype type;
+	size_t size;
 } git_cached_obj;
 
+/*
+ * Readers never take a lock, nor wait: they count themselves in as
+ * readers of the cache's current epoch and scan the slots directly.
+ * Writers hold the shard's `lock`, publish slots with an atomic swap,
+ * and park evicted objects in the `retired` list of the epoch they were
+ * evicted in. The epoch only moves on once nobody is reading in the one
+ * before it, so a list can be released two epochs after its own: every
+ * reader that might have seen its objects is gone by then. Writers just
+ * check whether that's the case; they never wait for readers.
+ */
 typedef struct {
-	git_cached_obj **nodes;
 	git_mutex lock;
+	volatile uint32_t clock;
+	size_t hand;
+	size_t used[GIT_CACHE_TYPES];
+	size_t retired_used[GIT_CACHE_TYPES];
+	size_t entries, stores, evictions;
+	git_vector retired[3];
+	int retired_epoch[3];
 
-	unsigned int lru_count;
-	size_t size_mask;
+	/* keep the hot fields of neighbouring shards on separate cache lines */
+	char pad[GIT_CACHE_LINE];
+} git_cache_shard;
+
+/*
+ * What lookups write to. A thread always uses the same stripe, so with
+ * no more threads than stripes none of these lines is shared.
+ */
+typedef struct {
+	git_atomic_ssize hits, misses;
+	git_atomic readers[3]; /* lookups in progress, by epoch % 3 */
+	char pad[GIT_CACHE_LINE - 2 * sizeof(git_atomic_ssize) - 3 * sizeof(git_atomic)];
+} git_cache_stripe;
+
+typedef struct {
+	git_cached_obj * volatile *slots;
+	volatile uint32_t *stamps;
+
+	size_t set_mask;
 	git_cached_obj_freeptr free_obj;
+	git_atomic epoch;
+	git_cache_stripe stripes[GIT_CACHE_STRIPES];
+	git_cache_shard shards[GIT_CACHE_SHARDS];
 } git_cache;
 
 int git_cache_init(git_cache *cache, size_t size, git_cached_obj_freeptr free_ptr);
@@ -37,6 +95,8 @@ void git_cache_free(git_cache *cache);
 void *git_cache_try_store(git_cache *cache, void *entry);
 void *git_cache_get(git_cache *cache, const git_oid *oid);
 
+void git_cache_read_stats(git_cache_stats *out, git_cache *cache);
+
 GIT_INLINE(void) git_cached_obj_incref(void *_obj)
 {
 	git_cached_obj *obj = _obj;
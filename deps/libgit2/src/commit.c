@@ -15,25 +15,13 @@
 #include "commit.h"
 #include "signature.h"
 #include "message.h"
+#include "commit_header.h"
 
 #include <stdarg.h>
 
-static void clear_parents(git_commit *commit)
-{
-	unsigned int i;
-
-	for (i = 0; i < commit->parent_ids.length; ++i) {
-		git_oid *parent = git_vector_get(&commit->parent_ids, i);
-		git__free(parent);
-	}
-
-	git_vector_clear(&commit->parent_ids);
-}
-
 void git_commit__free(git_commit *commit)
 {
-	clear_parents(commit);
-	git_vector_free(&commit->parent_ids);
+	git__free(commit->parent_ids);
 
 	git_signature_free(commit->author);
 	git_signature_free(commit->committer);
@@ -133,30 +121,34 @@ on_error:
 
 int git_commit__parse_buffer(git_commit *commit, const void *data, size_t len)
 {
-	const char *buffer = data;
 	const char *buffer_end = (const char *)data + len;
-	git_oid parent_id;
-
-	if (git_vector_init(&commit->parent_ids, 4, NULL) < 0)
-		return -1;
+	const char *buffer;
+	git_commit_header header;
+	size_t i;
 
-	if (git_oid__parse(&commit->tree_id, &buffer, buffer_end, "tree ") < 0)
+	if (git_commit_header_scan(&header, data, len) < 0 ||
+		git_commit_header_tree(&commit->tree_id, &header) < 0)
 		goto bad_buffer;
 
 	/*
 	 * TODO: commit grafts!
 	 */
 
-	while (git_oid__parse(&parent_id, &buffer, buffer_end, "parent ") == 0) {
-		git_oid *new_id = git__malloc(sizeof(git_oid));
-		GITERR_CHECK_ALLOC(new_id);
+	if (header.parent_count > 0) {
+		commit->parent_ids = git__malloc(header.parent_count * sizeof(git_oid));
+		GITERR_CHECK_ALLOC(commit->parent_ids);
 
-		git_oid_cpy(new_id, &parent_id);
+		for (i = 0; i < header.parent_count; ++i)
+			if (git_commit_header_parent(&commit->parent_ids[i], &header, i) < 0)
+				goto bad_buffer;
 
-		if (git_vector_insert(&commit->parent_ids, new_id) < 0)
-			return -1;
+		commit->parent_count = header.parent_count;
 	}
 
+	/* the scan found where the signatures are, but they're only checked here */
+	if ((buffer = header.author) == NULL)
+		buffer = header.parents + header.parent_count * GIT_COMMIT_HEADER_PARENT_LEN;
+
 	commit->author = git__malloc(sizeof(git_signature));
 	GITERR_CHECK_ALLOC(commit->author);
 
@@ -170,25 +162,14 @@ int git_commit__parse_buffer(git_commit *commit, const void *data, size_t len)
 	if (git_signature__parse(commit->committer, &buffer, buffer_end, "committer ", '\n') < 0)
 		return -1;
 
-	/* Parse add'l header entries until blank line found */
-	while (buffer < buffer_end && *buffer != '\n') {
-		const char *eoln = buffer;
-		while (eoln < buffer_end && *eoln != '\n')
-			++eoln;
-
-		if (git__prefixcmp(buffer, "encoding ") == 0) {
-			buffer += strlen("encoding ");
-
-			commit->message_encoding = git__strndup(buffer, eoln - buffer);
-			GITERR_CHECK_ALLOC(commit->message_encoding);
-		}
-
-		if (eoln < buffer_end && *eoln == '\n')
-			++eoln;
-
-		buffer = eoln;
+	if (header.encoding) {
+		commit->message_encoding = git__strndup(
+			(const char *)data + header.encoding, header.encoding_len);
+		GITERR_CHECK_ALLOC(commit->message_encoding);
 	}
 
+	buffer = (const char *)data + header.header_len;
+
 	/* skip blank lines */
 	while (buffer < buffer_end - 1 && *buffer == '\n')
 		buffer++;
@@ -225,7 +206,7 @@ GIT_COMMIT_GETTER(const char *, message, commit->message)
 GIT_COMMIT_GETTER(const char *, message_encoding, commit->message_encoding)
 GIT_COMMIT_GETTER(git_time_t, time, commit->committer->when.time)
 GIT_COMMIT_GETTER(int, time_offset, commit->committer->when.offset)
-GIT_COMMIT_GETTER(unsigned int, parentcount, (unsigned int)commit->parent_ids.length)
+GIT_COMMIT_GETTER(unsigned int, parentcount, (unsigned int)commit->parent_count)
 GIT_COMMIT_GETTER(const git_oid *, tree_id, &commit->tree_id);
 
 int git_commit_tree(git_tree **tree_out, const git_commit *commit)
@@ -238,7 +219,7 @@ const git_oid *git_commit_parent_id(git_commit *commit, unsigned int n)
 {
 	assert(commit);
 
-	return git_vector_get(&commit->parent_ids, n);
+	return n < commit->parent_count ? &commit->parent_ids[n] : NULL;
 }
 
 int git_commit_parent(git_commit **parent, git_commit *commit, unsigned int n)
@@ -17,7 +17,8 @@
 struct git_commit {
 	git_object object;
 
-	git_vector parent_ids;
+	git_oid *parent_ids;
+	size_t parent_count;
 	git_oid tree_id;
 
 	git_signature *author;
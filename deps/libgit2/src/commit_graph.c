@@ -0,0 +1,708 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+#include "commit_graph.h"
+#include "repository.h"
+#include "odb.h"
+#include "fileops.h"
+#include "filebuf.h"
+#include "oidmap.h"
+#include "pack.h"
+#include "pool.h"
+#include "vector.h"
+#include "sha1_lookup.h"
+#include "git2/commit.h"
+#include "git2/revwalk.h"
+
+GIT__USE_OIDMAP;
+
+/*
+ * File layout (all integers in network order):
+ *
+ *	header:	"CGPH", version (1), oid version (1), number of chunks,
+ *		number of base graphs (0)
+ *	chunk table: (id, 64-bit offset) for each chunk, then a zero id
+ *		with the offset of the end of the last chunk
+ *	OIDF:	256 entry fanout table
+ *	OIDL:	the sorted commit ids
+ *	CDAT:	for each commit, its tree id, the positions of its first
+ *		two parents, then the generation number (30 bits) and the
+ *		commit time (34 bits). A missing parent is 0x70000000; when
+ *		the high bit of the second one is set, the rest of it indexes
+ *		into EDGE, where the second and further parents are listed
+ *	EDGE:	parent positions; the last parent of a commit has the high
+ *		bit set
+ *	trailer: SHA-1 of everything above
+ */
+
+#define COMMIT_GRAPH_SIGNATURE 0x43475048 /* "CGPH" */
+#define COMMIT_GRAPH_VERSION 1
+#define COMMIT_GRAPH_OID_VERSION 1 /* SHA-1 */
+#define COMMIT_GRAPH_HEADER_SIZE 8
+#define COMMIT_GRAPH_CHUNK_TABLE_ENTRY 12
+#define COMMIT_GRAPH_DATA_WIDTH (GIT_OID_RAWSZ + 16)
+
+#define COMMIT_GRAPH_CHUNK_OIDF 0x4f494446
+#define COMMIT_GRAPH_CHUNK_OIDL 0x4f49444c
+#define COMMIT_GRAPH_CHUNK_CDAT 0x43444154
+#define COMMIT_GRAPH_CHUNK_EDGE 0x45444745
+
+#define COMMIT_GRAPH_PARENT_NONE 0x70000000
+#define COMMIT_GRAPH_EXTRA_EDGES 0x80000000
+#define COMMIT_GRAPH_LAST_EDGE 0x80000000
+#define COMMIT_GRAPH_EDGE_MASK 0x7fffffff
+
+struct commit_graph_chunk {
+	size_t offset, length;
+};
+
+static int commit_graph_error(const char *message)
+{
+	giterr_set(GITERR_ODB, "Invalid commit-graph file - %s", message);
+	return -1;
+}
+
+GIT_INLINE(uint32_t) get_be32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+GIT_INLINE(uint64_t) get_be64(const unsigned char *p)
+{
+	return ((uint64_t)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+static int commit_graph_parse_oid_fanout(
+	git_commit_graph_file *file,
+	const unsigned char *data,
+	struct commit_graph_chunk *chunk)
+{
+	uint32_t i, nr = 0;
+
+	if (chunk->length != 256 * 4)
+		return commit_graph_error("OID fanout chunk has wrong length");
+
+	file->oid_fanout = (const uint32_t *)(data + chunk->offset);
+
+	for (i = 0; i < 256; ++i) {
+		uint32_t n = ntohl(file->oid_fanout[i]);
+		if (n < nr)
+			return commit_graph_error("index is non-monotonic");
+		nr = n;
+	}
+
+	file->num_commits = nr;
+	return 0;
+}
+
+static int commit_graph_parse(
+	git_commit_graph_file *file, const unsigned char *data, size_t size)
+{
+	struct commit_graph_chunk oidf = {0}, oidl = {0}, cdat = {0}, edge = {0};
+	struct commit_graph_chunk *chunk = NULL;
+	const unsigned char *entry;
+	size_t chunks, last_offset, i;
+
+	if (size < COMMIT_GRAPH_HEADER_SIZE + COMMIT_GRAPH_CHUNK_TABLE_ENTRY + GIT_OID_RAWSZ)
+		return commit_graph_error("file is too short");
+
+	if (get_be32(data) != COMMIT_GRAPH_SIGNATURE ||
+		data[4] != COMMIT_GRAPH_VERSION || data[5] != COMMIT_GRAPH_OID_VERSION)
+		return commit_graph_error("unsupported signature or version");
+
+	/* split commit-graphs are not supported */
+	if (data[7] != 0)
+		return commit_graph_error("unsupported base graphs");
+
+	chunks = data[6];
+
+	if (size < COMMIT_GRAPH_HEADER_SIZE +
+		(chunks + 1) * COMMIT_GRAPH_CHUNK_TABLE_ENTRY + GIT_OID_RAWSZ)
+		return commit_graph_error("wrong chunk table size");
+
+	last_offset = COMMIT_GRAPH_HEADER_SIZE + (chunks + 1) * COMMIT_GRAPH_CHUNK_TABLE_ENTRY;
+	entry = data + COMMIT_GRAPH_HEADER_SIZE;
+
+	for (i = 0; i <= chunks; ++i, entry += COMMIT_GRAPH_CHUNK_TABLE_ENTRY) {
+		uint64_t offset = get_be64(entry + 4);
+
+		if (offset < last_offset || offset > size - GIT_OID_RAWSZ)
+			return commit_graph_error("chunks are not ordered or out of bounds");
+
+		if (chunk)
+			chunk->length = (size_t)offset - chunk->offset;
+
+		if (i == chunks)
+			break;
+
+		switch (get_be32(entry)) {
+		case COMMIT_GRAPH_CHUNK_OIDF: chunk = &oidf; break;
+		case COMMIT_GRAPH_CHUNK_OIDL: chunk = &oidl; break;
+		case COMMIT_GRAPH_CHUNK_CDAT: chunk = &cdat; break;
+		case COMMIT_GRAPH_CHUNK_EDGE: chunk = &edge; break;
+		default: chunk = NULL; break; /* unknown chunks are skipped */
+		}
+
+		if (chunk)
+			chunk->offset = (size_t)offset;
+		last_offset = (size_t)offset;
+	}
+
+	if (!oidf.offset || !oidl.offset || !cdat.offset)
+		return commit_graph_error("missing required chunks");
+
+	if (commit_graph_parse_oid_fanout(file, data, &oidf) < 0)
+		return -1;
+
+	if (oidl.length != (size_t)file->num_commits * GIT_OID_RAWSZ)
+		return commit_graph_error("OID lookup chunk has wrong length");
+	if (cdat.length != (size_t)file->num_commits * COMMIT_GRAPH_DATA_WIDTH)
+		return commit_graph_error("commit data chunk has wrong length");
+	if (edge.length % 4 != 0)
+		return commit_graph_error("extra edge list chunk has wrong length");
+
+	file->oid_lookup = (const git_oid *)(data + oidl.offset);
+	file->commit_data = data + cdat.offset;
+	file->extra_edge_list = edge.offset ? data + edge.offset : NULL;
+	file->num_extra_edge_list = edge.length / 4;
+
+	git_oid_fromraw(&file->checksum, data + size - GIT_OID_RAWSZ);
+	return 0;
+}
+
+int git_commit_graph_open(git_commit_graph_file **file_out, const char *path)
+{
+	git_commit_graph_file *file;
+	git_file fd;
+	struct stat st;
+	int error;
+
+	*file_out = NULL;
+
+	if ((fd = git_futils_open_ro(path)) < 0)
+		return fd;
+
+	if (p_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+		!git__is_sizet(st.st_size)) {
+		p_close(fd);
+		giterr_set(GITERR_OS, "Failed to check commit-graph");
+		return -1;
+	}
+
+	file = git__calloc(1, sizeof(git_commit_graph_file));
+	if (file == NULL) {
+		p_close(fd);
+		return -1;
+	}
+
+	error = git_futils_mmap_ro(&file->graph_map, fd, 0, (size_t)st.st_size);
+	p_close(fd);
+
+	if (error < 0) {
+		git__free(file);
+		return error;
+	}
+
+	GIT_REFCOUNT_INC(file);
+
+	if (commit_graph_parse(file, file->graph_map.data, file->graph_map.len) < 0) {
+		git_commit_graph_free(file);
+		return -1;
+	}
+
+	*file_out = file;
+	return 0;
+}
+
+static void commit_graph_file_free(git_commit_graph_file *file)
+{
+	git_futils_mmap_free(&file->graph_map);
+	git__free(file);
+}
+
+void git_commit_graph_free(git_commit_graph_file *file)
+{
+	if (file == NULL)
+		return;
+
+	GIT_REFCOUNT_DEC(file, commit_graph_file_free);
+}
+
+int git_commit_graph_find(
+	uint32_t *pos,
+	const git_commit_graph_file *file,
+	const git_oid *id)
+{
+	unsigned hi, lo;
+	int found;
+
+	hi = ntohl(file->oid_fanout[(int)id->id[0]]);
+	lo = ((id->id[0] == 0x0) ? 0 : ntohl(file->oid_fanout[(int)id->id[0] - 1]));
+
+	found = sha1_entry_pos(file->oid_lookup, GIT_OID_RAWSZ, 0,
+		lo, hi, file->num_commits, id->id);
+
+	if (found < 0)
+		return GIT_ENOTFOUND;
+
+	*pos = (uint32_t)found;
+	return 0;
+}
+
+int git_commit_graph_entry_get(
+	git_commit_graph_entry *e,
+	const git_commit_graph_file *file,
+	uint32_t pos)
+{
+	const unsigned char *data;
+	uint32_t word;
+
+	if (pos >= file->num_commits)
+		return commit_graph_error("commit position out of range");
+
+	data = file->commit_data + (size_t)pos * COMMIT_GRAPH_DATA_WIDTH;
+
+	git_oid_fromraw(&e->tree_oid, data);
+	e->parent1 = get_be32(data + GIT_OID_RAWSZ);
+	e->parent2 = get_be32(data + GIT_OID_RAWSZ + 4);
+
+	word = get_be32(data + GIT_OID_RAWSZ + 8);
+	e->generation = word >> 2;
+	e->commit_time = (git_time_t)(((uint64_t)(word & 0x3) << 32) |
+		get_be32(data + GIT_OID_RAWSZ + 12));
+
+	if (e->parent1 == COMMIT_GRAPH_PARENT_NONE)
+		e->parent_count = 0;
+	else if (e->parent2 == COMMIT_GRAPH_PARENT_NONE)
+		e->parent_count = 1;
+	else if (!(e->parent2 & COMMIT_GRAPH_EXTRA_EDGES))
+		e->parent_count = 2;
+	else {
+		size_t edge = e->parent2 & COMMIT_GRAPH_EDGE_MASK;
+
+		e->parent_count = 1;
+		do {
+			if (edge >= file->num_extra_edge_list)
+				return commit_graph_error("extra edge out of range");
+			e->parent_count++;
+		} while (!(get_be32(file->extra_edge_list + 4 * edge++) & COMMIT_GRAPH_LAST_EDGE));
+	}
+
+	return 0;
+}
+
+int git_commit_graph_entry_parent(
+	uint32_t *parent_pos,
+	const git_commit_graph_file *file,
+	const git_commit_graph_entry *e,
+	size_t n)
+{
+	uint32_t pos;
+
+	if (n >= e->parent_count)
+		return commit_graph_error("parent index out of range");
+
+	if (n == 0)
+		pos = e->parent1;
+	else if (!(e->parent2 & COMMIT_GRAPH_EXTRA_EDGES))
+		pos = e->parent2;
+	else
+		/* entry_get made sure the whole list is in range */
+		pos = get_be32(file->extra_edge_list +
+			4 * ((e->parent2 & COMMIT_GRAPH_EDGE_MASK) + n - 1)) & COMMIT_GRAPH_EDGE_MASK;
+
+	if (pos >= file->num_commits)
+		return commit_graph_error("parent position out of range");
+
+	*parent_pos = pos;
+	return 0;
+}
+
+/*
+ * Writing
+ */
+
+struct commit_graph_write_entry {
+	git_oid oid;
+	git_oid tree_oid;
+	git_time_t commit_time;
+	uint32_t generation;
+	uint32_t pos;
+	size_t parent_count;
+	struct commit_graph_write_entry **parents;
+};
+
+struct git_commit_graph_writer {
+	git_repository *repo;
+
+	git_oidmap *map;
+	git_vector entries;
+	git_pool pool;
+
+	/* entries before this one have their parents filled in */
+	size_t parsed;
+};
+
+int git_commit_graph_writer_new(git_commit_graph_writer **out, git_repository *repo)
+{
+	git_commit_graph_writer *w;
+
+	assert(out && repo);
+
+	w = git__calloc(1, sizeof(git_commit_graph_writer));
+	GITERR_CHECK_ALLOC(w);
+
+	w->repo = repo;
+	w->map = git_oidmap_alloc();
+
+	if (w->map == NULL ||
+		git_vector_init(&w->entries, 1024, NULL) < 0 ||
+		git_pool_init(&w->pool, 1, 0) < 0) {
+		git_commit_graph_writer_free(w);
+		return -1;
+	}
+
+	*out = w;
+	return 0;
+}
+
+static struct commit_graph_write_entry *commit_graph_writer_entry(
+	git_commit_graph_writer *w, const git_oid *id)
+{
+	struct commit_graph_write_entry *entry;
+	khiter_t pos;
+	int ret;
+
+	pos = kh_get(oid, w->map, id);
+	if (pos != kh_end(w->map))
+		return kh_value(w->map, pos);
+
+	entry = git_pool_mallocz(&w->pool, sizeof(struct commit_graph_write_entry));
+	if (entry == NULL || git_vector_insert(&w->entries, entry) < 0)
+		return NULL;
+
+	git_oid_cpy(&entry->oid, id);
+
+	pos = kh_put(oid, w->map, &entry->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return NULL;
+	}
+	kh_value(w->map, pos) = entry;
+
+	return entry;
+}
+
+int git_commit_graph_writer_add(git_commit_graph_writer *w, const git_oid *commit_id)
+{
+	assert(w && commit_id);
+
+	return commit_graph_writer_entry(w, commit_id) ? 0 : -1;
+}
+
+int git_commit_graph_writer_add_revwalk(git_commit_graph_writer *w, git_revwalk *walk)
+{
+	git_oid id;
+	int error;
+
+	assert(w && walk);
+
+	while ((error = git_revwalk_next(&id, walk)) == 0) {
+		if (commit_graph_writer_entry(w, &id) == NULL)
+			return -1;
+	}
+
+	return error == GIT_ITEROVER ? 0 : error;
+}
+
+/* Read the commits added so far, adding their parents as they're found */
+static int commit_graph_writer_fill(git_commit_graph_writer *w)
+{
+	for (; w->parsed < w->entries.length; ++w->parsed) {
+		struct commit_graph_write_entry *entry = w->entries.contents[w->parsed];
+		git_commit *commit;
+		unsigned int i;
+
+		if (git_commit_lookup(&commit, w->repo, &entry->oid) < 0)
+			return -1;
+
+		git_oid_cpy(&entry->tree_oid, git_commit_tree_id(commit));
+		entry->commit_time = git_commit_time(commit);
+		entry->parent_count = git_commit_parentcount(commit);
+
+		if (entry->parent_count) {
+			entry->parents = git_pool_malloc(&w->pool,
+				(uint32_t)(entry->parent_count * sizeof(struct commit_graph_write_entry *)));
+			if (entry->parents == NULL) {
+				git_commit_free(commit);
+				return -1;
+			}
+		}
+
+		for (i = 0; i < entry->parent_count; ++i) {
+			/* may grow the vector, so `entry` is used, not the slot */
+			entry->parents[i] = commit_graph_writer_entry(w, git_commit_parent_id(commit, i));
+			if (entry->parents[i] == NULL) {
+				git_commit_free(commit);
+				return -1;
+			}
+		}
+
+		git_commit_free(commit);
+	}
+
+	return 0;
+}
+
+static int commit_graph_write_entry_cmp(const void *a_, const void *b_)
+{
+	const struct commit_graph_write_entry *a = a_, *b = b_;
+	return git_oid_cmp(&a->oid, &b->oid);
+}
+
+/* generation = 1 + the largest generation among the parents */
+static int commit_graph_writer_generations(git_commit_graph_writer *w)
+{
+	git_vector stack = GIT_VECTOR_INIT;
+	struct commit_graph_write_entry *entry;
+	size_t i, j;
+
+	git_vector_foreach(&w->entries, i, entry) {
+		if (entry->generation)
+			continue;
+
+		if (git_vector_insert(&stack, entry) < 0)
+			goto on_error;
+
+		while (stack.length) {
+			struct commit_graph_write_entry *top = git_vector_last(&stack);
+			uint32_t generation = 0;
+			bool ready = true;
+
+			if (top->generation) {
+				git_vector_pop(&stack);
+				continue;
+			}
+
+			for (j = 0; j < top->parent_count; ++j) {
+				uint32_t parent = top->parents[j]->generation;
+
+				if (!parent) {
+					ready = false;
+					if (git_vector_insert(&stack, top->parents[j]) < 0)
+						goto on_error;
+				} else if (parent > generation)
+					generation = parent;
+			}
+
+			if (!ready)
+				continue;
+
+			top->generation = generation < GIT_COMMIT_GRAPH_GENERATION_MAX ?
+				generation + 1 : GIT_COMMIT_GRAPH_GENERATION_MAX;
+			git_vector_pop(&stack);
+		}
+	}
+
+	git_vector_free(&stack);
+	return 0;
+
+on_error:
+	git_vector_free(&stack);
+	return -1;
+}
+
+GIT_INLINE(void) put_be32(unsigned char *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static int write_be32(git_filebuf *f, uint32_t v)
+{
+	unsigned char buf[4];
+	put_be32(buf, v);
+	return git_filebuf_write(f, buf, sizeof(buf));
+}
+
+static int write_chunk_header(git_filebuf *f, uint32_t id, uint64_t offset)
+{
+	unsigned char buf[COMMIT_GRAPH_CHUNK_TABLE_ENTRY];
+
+	put_be32(buf, id);
+	put_be32(buf + 4, (uint32_t)(offset >> 32));
+	put_be32(buf + 8, (uint32_t)offset);
+
+	return git_filebuf_write(f, buf, sizeof(buf));
+}
+
+static int commit_graph_write_file(const char *path, git_vector *entries)
+{
+	git_filebuf f = GIT_FILEBUF_INIT;
+	struct commit_graph_write_entry *entry;
+	unsigned char header[COMMIT_GRAPH_HEADER_SIZE];
+	size_t i, j, num_edges = 0, fanout_pos = 0;
+	uint64_t offset;
+	git_oid checksum;
+	int error = 0;
+
+	git_vector_foreach(entries, i, entry) {
+		if (entry->parent_count > 2)
+			num_edges += entry->parent_count - 1;
+	}
+
+	put_be32(header, COMMIT_GRAPH_SIGNATURE);
+	header[4] = COMMIT_GRAPH_VERSION;
+	header[5] = COMMIT_GRAPH_OID_VERSION;
+	header[6] = num_edges ? 4 : 3;
+	header[7] = 0;
+
+	if ((error = git_futils_mkpath2file(path, GIT_OBJECT_DIR_MODE)) < 0 ||
+		(error = git_filebuf_open(&f, path, GIT_FILEBUF_HASH_CONTENTS)) < 0)
+		return error;
+
+	error = git_filebuf_write(&f, header, sizeof(header));
+
+	/* chunk table */
+	offset = COMMIT_GRAPH_HEADER_SIZE + (header[6] + 1) * COMMIT_GRAPH_CHUNK_TABLE_ENTRY;
+	if (!error)
+		error = write_chunk_header(&f, COMMIT_GRAPH_CHUNK_OIDF, offset);
+	offset += 256 * 4;
+	if (!error)
+		error = write_chunk_header(&f, COMMIT_GRAPH_CHUNK_OIDL, offset);
+	offset += entries->length * GIT_OID_RAWSZ;
+	if (!error)
+		error = write_chunk_header(&f, COMMIT_GRAPH_CHUNK_CDAT, offset);
+	offset += entries->length * COMMIT_GRAPH_DATA_WIDTH;
+	if (!error && num_edges) {
+		error = write_chunk_header(&f, COMMIT_GRAPH_CHUNK_EDGE, offset);
+		offset += num_edges * 4;
+	}
+	if (!error)
+		error = write_chunk_header(&f, 0, offset);
+
+	/* OIDF */
+	for (i = 0; !error && i < 256; ++i) {
+		while (fanout_pos < entries->length &&
+			((struct commit_graph_write_entry *)entries->contents[fanout_pos])->oid.id[0] <= i)
+			fanout_pos++;
+		error = write_be32(&f, (uint32_t)fanout_pos);
+	}
+
+	/* OIDL */
+	git_vector_foreach(entries, i, entry) {
+		if (error)
+			break;
+		error = git_filebuf_write(&f, entry->oid.id, GIT_OID_RAWSZ);
+	}
+
+	/* CDAT */
+	num_edges = 0;
+	git_vector_foreach(entries, i, entry) {
+		unsigned char data[COMMIT_GRAPH_DATA_WIDTH];
+		uint64_t commit_time = (uint64_t)entry->commit_time;
+		uint32_t parent1 = COMMIT_GRAPH_PARENT_NONE, parent2 = COMMIT_GRAPH_PARENT_NONE;
+
+		if (error)
+			break;
+
+		if (entry->parent_count > 0)
+			parent1 = entry->parents[0]->pos;
+		if (entry->parent_count > 2) {
+			parent2 = COMMIT_GRAPH_EXTRA_EDGES | (uint32_t)num_edges;
+			num_edges += entry->parent_count - 1;
+		} else if (entry->parent_count > 1)
+			parent2 = entry->parents[1]->pos;
+
+		memcpy(data, entry->tree_oid.id, GIT_OID_RAWSZ);
+		put_be32(data + GIT_OID_RAWSZ, parent1);
+		put_be32(data + GIT_OID_RAWSZ + 4, parent2);
+		put_be32(data + GIT_OID_RAWSZ + 8,
+			(entry->generation << 2) | (uint32_t)((commit_time >> 32) & 0x3));
+		put_be32(data + GIT_OID_RAWSZ + 12, (uint32_t)commit_time);
+
+		error = git_filebuf_write(&f, data, sizeof(data));
+	}
+
+	/* EDGE */
+	git_vector_foreach(entries, i, entry) {
+		if (error || entry->parent_count <= 2)
+			continue;
+
+		for (j = 1; !error && j < entry->parent_count; ++j) {
+			uint32_t pos = entry->parents[j]->pos;
+
+			if (j == entry->parent_count - 1)
+				pos |= COMMIT_GRAPH_LAST_EDGE;
+			error = write_be32(&f, pos);
+		}
+	}
+
+	if (!error && (error = git_filebuf_hash(&checksum, &f)) == 0 &&
+		(error = git_filebuf_write(&f, checksum.id, GIT_OID_RAWSZ)) == 0)
+		error = git_filebuf_commit(&f, GIT_PACK_FILE_MODE);
+
+	if (error < 0)
+		git_filebuf_cleanup(&f);
+
+	return error;
+}
+
+int git_commit_graph_writer_commit(git_commit_graph_writer *w)
+{
+	git_vector sorted = GIT_VECTOR_INIT;
+	struct commit_graph_write_entry *entry;
+	git_buf path = GIT_BUF_INIT;
+	size_t i;
+	int error;
+
+	assert(w);
+
+	if ((error = commit_graph_writer_fill(w)) < 0 ||
+		(error = commit_graph_writer_generations(w)) < 0)
+		return error;
+
+	if ((error = git_vector_dup(&sorted, &w->entries, commit_graph_write_entry_cmp)) < 0)
+		return error;
+
+	git_vector_sort(&sorted);
+
+	if (sorted.length > COMMIT_GRAPH_PARENT_NONE) {
+		giterr_set(GITERR_INVALID, "Too many commits for a commit-graph");
+		error = -1;
+		goto cleanup;
+	}
+
+	git_vector_foreach(&sorted, i, entry)
+		entry->pos = (uint32_t)i;
+
+	if ((error = git_buf_joinpath(&path, w->repo->path_repository, GIT_OBJECTS_DIR)) < 0 ||
+		(error = git_buf_joinpath(&path, path.ptr, GIT_COMMIT_GRAPH_FILE)) < 0)
+		goto cleanup;
+
+	if ((error = commit_graph_write_file(path.ptr, &sorted)) == 0)
+		git_repository__commit_graph_changed(w->repo);
+
+cleanup:
+	git_buf_free(&path);
+	git_vector_free(&sorted);
+	return error;
+}
+
+void git_commit_graph_writer_free(git_commit_graph_writer *w)
+{
+	if (w == NULL)
+		return;
+
+	git_oidmap_free(w->map);
+	git_vector_free(&w->entries);
+	git_pool_clear(&w->pool);
+	git__free(w);
+}
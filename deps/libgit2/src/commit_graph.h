@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_commit_graph_h__
+#define INCLUDE_commit_graph_h__
+
+#include "common.h"
+#include "map.h"
+#include "git2/oid.h"
+#include "git2/commit_graph.h"
+
+#define GIT_COMMIT_GRAPH_FILE "info/commit-graph"
+
+/* generation numbers are 30 bits wide; deeper commits all get this */
+#define GIT_COMMIT_GRAPH_GENERATION_MAX 0x3FFFFFFF
+
+/*
+ * A commit-graph stores, for a set of commits closed under "parent of",
+ * the parents, commit time and generation number of each one, so a
+ * history can be walked without inflating and parsing commit objects.
+ * The file lives in "objects/info" and uses git's format (version 1,
+ * SHA-1); parents are referred to by their position in the file.
+ */
+typedef struct git_commit_graph_file {
+	git_refcount rc;
+	git_map graph_map;
+
+	const uint32_t *oid_fanout;
+	uint32_t num_commits;
+	const git_oid *oid_lookup;
+	const unsigned char *commit_data;
+	const unsigned char *extra_edge_list;
+	size_t num_extra_edge_list;
+
+	git_oid checksum;
+} git_commit_graph_file;
+
+typedef struct git_commit_graph_entry {
+	git_oid tree_oid;
+	git_time_t commit_time;
+	uint32_t generation;
+	size_t parent_count;
+
+	/* raw parent words; see git_commit_graph_entry_parent */
+	uint32_t parent1, parent2;
+} git_commit_graph_entry;
+
+int git_commit_graph_open(git_commit_graph_file **file_out, const char *path);
+
+/* Drops a reference; the file is unmapped once the last one is gone */
+void git_commit_graph_free(git_commit_graph_file *file);
+
+/*
+ * Find the position of a commit. Returns GIT_ENOTFOUND, without setting
+ * an error, when the commit isn't in the graph.
+ */
+int git_commit_graph_find(
+	uint32_t *pos,
+	const git_commit_graph_file *file,
+	const git_oid *id);
+
+int git_commit_graph_entry_get(
+	git_commit_graph_entry *e,
+	const git_commit_graph_file *file,
+	uint32_t pos);
+
+/* The position of the `n`th parent of `e` */
+int git_commit_graph_entry_parent(
+	uint32_t *parent_pos,
+	const git_commit_graph_file *file,
+	const git_commit_graph_entry *e,
+	size_t n);
+
+#endif
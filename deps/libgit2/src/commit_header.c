@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "commit_header.h"
+
+#define TREE_LEN (5 + GIT_OID_HEXSZ + 1)
+
+/*
+ * The timestamp follows the e-mail at the end of a signature line, as
+ * in "Name <email> 1234567890 +0100"; it's 0 if there isn't one.
+ */
+static git_time_t signature_time(const char *line, const char *eol)
+{
+	const char *p = git__memrchr(line, '>', eol - line);
+	git_time_t time = 0;
+	int digits = 0;
+
+	if (p == NULL)
+		return 0;
+
+	for (++p; p < eol && *p == ' '; ++p)
+		;
+
+	/* as many as fit; later than that isn't a date anyway */
+	for (; p < eol && git__isdigit(*p) && digits < 18; ++p, ++digits)
+		time = time * 10 + (*p - '0');
+
+	return time;
+}
+
+/* The end of the line starting at `p`, or NULL if it doesn't end */
+GIT_INLINE(const char *) line_end(const char *p, const char *end)
+{
+	return memchr(p, '\n', end - p);
+}
+
+int git_commit_header_scan(git_commit_header *out, const char *data, size_t len)
+{
+	const char *p = data, *end = data + len, *eol;
+
+	memset(out, 0, sizeof(*out));
+
+	if (len < TREE_LEN || memcmp(p, "tree ", 5) != 0 || p[TREE_LEN - 1] != '\n')
+		return -1;
+
+	out->tree = p + 5;
+	p += TREE_LEN;
+
+	/* parent lines are fixed size, no need to look for their ends */
+	out->parents = p;
+	while (end - p >= GIT_COMMIT_HEADER_PARENT_LEN &&
+		memcmp(p, "parent ", 7) == 0 &&
+		p[GIT_COMMIT_HEADER_PARENT_LEN - 1] == '\n') {
+		out->parent_count++;
+		p += GIT_COMMIT_HEADER_PARENT_LEN;
+	}
+
+	/* a "parent " line which isn't whole */
+	if (end - p >= 7 && memcmp(p, "parent ", 7) == 0)
+		return -1;
+
+	if (end - p >= 7 && memcmp(p, "author ", 7) == 0) {
+		if ((eol = line_end(p, end)) == NULL)
+			return -1;
+
+		out->author = p;
+		out->author_time = signature_time(p, eol);
+		p = eol + 1;
+	}
+
+	if (end - p >= 10 && memcmp(p, "committer ", 10) == 0) {
+		if ((eol = line_end(p, end)) == NULL)
+			return -1;
+
+		out->committer = p;
+		out->committer_time = signature_time(p, eol);
+		p = eol + 1;
+	}
+
+	/* the rest of the header, up to a blank line */
+	while (p < end && *p != '\n') {
+		if ((eol = line_end(p, end)) == NULL)
+			eol = end;
+
+		if (eol - p >= 9 && memcmp(p, "encoding ", 9) == 0) {
+			out->encoding = (p + 9) - data;
+			out->encoding_len = eol - (p + 9);
+		}
+
+		p = eol < end ? eol + 1 : end;
+	}
+
+	out->header_len = p - data;
+	return 0;
+}
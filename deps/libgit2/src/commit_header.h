@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_commit_header_h__
+#define INCLUDE_commit_header_h__
+
+#include "common.h"
+#include "git2/oid.h"
+
+/* "parent " + hex id + '\n'; the parent lines of a commit are all this long */
+#define GIT_COMMIT_HEADER_PARENT_LEN (7 + GIT_OID_HEXSZ + 1)
+
+/*
+ * What one pass over a commit's header finds, as pointers into the
+ * buffer that was scanned; nothing is copied or allocated, and the
+ * ids are only decoded when asked for.
+ */
+typedef struct {
+	/* the tree's hex id */
+	const char *tree;
+
+	/* `parent_count` lines of GIT_COMMIT_HEADER_PARENT_LEN bytes each */
+	const char *parents;
+	size_t parent_count;
+
+	/* the "author " and "committer " lines, or NULL when missing */
+	const char *author;
+	const char *committer;
+
+	/* the timestamps at the end of those lines, 0 when there's none */
+	git_time_t author_time;
+	git_time_t committer_time;
+
+	/* where the value of the "encoding" header is; 0 when there's none */
+	size_t encoding, encoding_len;
+
+	/* up to the blank line ending the header, or all of it */
+	size_t header_len;
+} git_commit_header;
+
+/*
+ * Scan the header of the commit in `data`. Returns -1 when it doesn't
+ * start with a tree and parent lines, without setting an error; the
+ * other lines aren't checked beyond what's needed to find them.
+ */
+extern int git_commit_header_scan(
+	git_commit_header *out, const char *data, size_t len);
+
+/* Decode the tree id; 40 hex digits are known to be there */
+GIT_INLINE(int) git_commit_header_tree(git_oid *out, const git_commit_header *h)
+{
+	return git_oid_fromstr_many(out, h->tree, 1);
+}
+
+/* Decode the id of parent `n` */
+GIT_INLINE(int) git_commit_header_parent(
+	git_oid *out, const git_commit_header *h, size_t n)
+{
+	return git_oid_fromstr_many(out,
+		h->parents + n * GIT_COMMIT_HEADER_PARENT_LEN + strlen("parent "), 1);
+}
+
+#endif
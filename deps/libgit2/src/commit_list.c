@@ -8,178 +8,374 @@
 #include "commit_list.h"
 #include "common.h"
 #include "revwalk.h"
-#include "pool.h"
 #include "odb.h"
+#include "commit_header.h"
 
-int git_commit_list_time_cmp(void *a, void *b)
+#define COMMIT_TABLE_INITIAL 64
+
+/* the ids are already uniformly distributed */
+GIT_INLINE(size_t) commit_slot(const git_oid *oid, size_t mask)
+{
+	uint32_t h;
+	memcpy(&h, oid->id, sizeof(h));
+	return h & mask;
+}
+
+int git_commit_table_init(git_commit_table *table)
 {
-	git_commit_list_node *commit_a = (git_commit_list_node *)a;
-	git_commit_list_node *commit_b = (git_commit_list_node *)b;
+	memset(table, 0, sizeof(*table));
+	return 0;
+}
 
-	return (commit_a->time < commit_b->time);
+void git_commit_table_free(git_commit_table *table)
+{
+	git__free(table->oids);
+	git__free(table->trees);
+	git__free(table->times);
+	git__free(table->flags);
+	git__free(table->generations);
+	git__free(table->graph_pos);
+	git__free(table->in_degree);
+	git__free(table->parents_start);
+	git__free(table->parent_count);
+	git__free(table->parents);
+	git__free(table->slots);
+	memset(table, 0, sizeof(*table));
 }
 
-git_commit_list *git_commit_list_insert(git_commit_list_node *item, git_commit_list **list_p)
+/* A grown array is still valid if a later one fails to grow */
+#define GROW_FIELD(t, field, n) do { \
+	void *p = git__realloc((t)->field, (n) * sizeof(*(t)->field)); \
+	if (p == NULL) \
+		goto on_error; \
+	(t)->field = p; } while (0)
+
+/*
+ * Everything is allocated before `alloc`, the mask or the slots change,
+ * so a failure leaves the table as it was.
+ */
+static int commit_table_grow(git_commit_table *t)
 {
-	git_commit_list *new_list = git__malloc(sizeof(git_commit_list));
-	if (new_list != NULL) {
-		new_list->item = item;
-		new_list->next = *list_p;
+	size_t alloc = t->alloc ? t->alloc * 2 : COMMIT_TABLE_INITIAL;
+	size_t mask = alloc * 2 - 1, i;
+	uint32_t *slots;
+
+	/* at most half full, and rebuilt from the ids when it grows */
+	slots = git__calloc(alloc * 2, sizeof(uint32_t));
+	GITERR_CHECK_ALLOC(slots);
+
+	GROW_FIELD(t, oids, alloc);
+	GROW_FIELD(t, trees, alloc);
+	GROW_FIELD(t, times, alloc);
+	GROW_FIELD(t, flags, alloc);
+	GROW_FIELD(t, generations, alloc);
+	GROW_FIELD(t, graph_pos, alloc);
+	GROW_FIELD(t, in_degree, alloc);
+	GROW_FIELD(t, parents_start, alloc);
+	GROW_FIELD(t, parent_count, alloc);
+
+	for (i = 0; i < t->length; ++i) {
+		size_t slot = commit_slot(&t->oids[i], mask);
+
+		while (slots[slot])
+			slot = (slot + 1) & mask;
+		slots[slot] = (uint32_t)i + 1;
 	}
-	*list_p = new_list;
-	return new_list;
+
+	git__free(t->slots);
+	t->slots = slots;
+	t->slots_mask = mask;
+	t->alloc = alloc;
+
+	return 0;
+
+on_error:
+	git__free(slots);
+	return -1;
 }
 
-git_commit_list *git_commit_list_insert_by_date(git_commit_list_node *item, git_commit_list **list_p)
+int git_commit_table_lookup(
+	git_commit_idx *out, git_commit_table *t, const git_oid *oid)
 {
-	git_commit_list **pp = list_p;
-	git_commit_list *p;
+	git_commit_idx idx;
+	size_t slot = 0;
+
+	if (t->slots) {
+		for (slot = commit_slot(oid, t->slots_mask); t->slots[slot];
+			slot = (slot + 1) & t->slots_mask) {
+			idx = t->slots[slot] - 1;
+			if (git_oid_equal(&t->oids[idx], oid)) {
+				*out = idx;
+				return 0;
+			}
+		}
+	}
 
-	while ((p = *pp) != NULL) {
-		if (git_commit_list_time_cmp(p->item, item) < 0)
-			break;
+	if (t->length == t->alloc) {
+		if (t->length >= GIT_COMMIT_IDX_NONE - 1) {
+			giterr_set(GITERR_INVALID, "Too many commits in the walk");
+			return -1;
+		}
 
-		pp = &p->next;
+		if (commit_table_grow(t) < 0)
+			return -1;
+
+		/* the slot moved with the table */
+		for (slot = commit_slot(oid, t->slots_mask); t->slots[slot];
+			slot = (slot + 1) & t->slots_mask)
+			;
 	}
 
-	return git_commit_list_insert(item, pp);
+	idx = (git_commit_idx)t->length++;
+	git_oid_cpy(&t->oids[idx], oid);
+	t->times[idx] = 0;
+	t->flags[idx] = 0;
+	t->generations[idx] = 0;
+	t->graph_pos[idx] = 0;
+	t->in_degree[idx] = 0;
+	t->parents_start[idx] = 0;
+	t->parent_count[idx] = 0;
+	t->slots[slot] = idx + 1;
+
+	*out = idx;
+	return 0;
 }
 
-git_commit_list_node *git_commit_list_alloc_node(git_revwalk *walk)
+/* Make room for `n` more parents, returning where they start */
+static int commit_table_alloc_parents(uint32_t *out, git_commit_table *t, size_t n)
 {
-	return (git_commit_list_node *)git_pool_malloc(&walk->commit_pool, COMMIT_ALLOC);
+	if (t->parents_length + n > t->parents_alloc) {
+		size_t alloc = t->parents_alloc ? t->parents_alloc * 2 : COMMIT_TABLE_INITIAL;
+
+		while (alloc < t->parents_length + n)
+			alloc *= 2;
+
+		if (alloc > UINT32_MAX) {
+			giterr_set(GITERR_INVALID, "Too many commits in the walk");
+			return -1;
+		}
+
+		GROW_FIELD(t, parents, alloc);
+		t->parents_alloc = alloc;
+	}
+
+	*out = (uint32_t)t->parents_length;
+	t->parents_length += n;
+	return 0;
+
+on_error:
+	return -1;
 }
 
-static int commit_error(git_commit_list_node *commit, const char *msg)
+int git_commit_stack_push(git_commit_stack *stack, git_commit_idx idx)
 {
-	char commit_oid[GIT_OID_HEXSZ + 1];
-	git_oid_fmt(commit_oid, &commit->oid);
-	commit_oid[GIT_OID_HEXSZ] = '\0';
+	if (stack->length == stack->alloc) {
+		size_t alloc = stack->alloc ? stack->alloc * 2 : 16;
+		git_commit_idx *ids = git__realloc(stack->ids, alloc * sizeof(git_commit_idx));
+		GITERR_CHECK_ALLOC(ids);
 
-	giterr_set(GITERR_ODB, "Failed to parse commit %s - %s", commit_oid, msg);
+		stack->ids = ids;
+		stack->alloc = alloc;
+	}
 
-	return -1;
+	stack->ids[stack->length++] = idx;
+	return 0;
 }
 
-static git_commit_list_node **alloc_parents(
-	git_revwalk *walk, git_commit_list_node *commit, size_t n_parents)
+void git_commit_stack_free(git_commit_stack *stack)
 {
-	if (n_parents <= PARENTS_PER_COMMIT)
-		return (git_commit_list_node **)((char *)commit + sizeof(git_commit_list_node));
+	git__free(stack->ids);
+	stack->ids = NULL;
+	stack->length = stack->alloc = 0;
+}
+
+/* The same heap as git_pqueue, so commits that tie come out in the same order */
+#define left(i)	((i) << 1)
+#define parent(i) ((i) >> 1)
+
+int git_commit_queue_init(
+	git_commit_queue *q, const git_commit_table *table, git_commit_queue_cmp cmp)
+{
+	q->table = table;
+	q->cmp = cmp;
+	q->alloc = 16;
+	q->size = 1;
+
+	q->d = git__malloc(q->alloc * sizeof(git_commit_idx));
+	GITERR_CHECK_ALLOC(q->d);
 
-	return (git_commit_list_node **)git_pool_malloc(
-		&walk->commit_pool, (uint32_t)(n_parents * sizeof(git_commit_list_node *)));
+	return 0;
 }
 
+void git_commit_queue_free(git_commit_queue *q)
+{
+	git__free(q->d);
+	q->d = NULL;
+}
 
-void git_commit_list_free(git_commit_list **list_p)
+int git_commit_queue_insert(git_commit_queue *q, git_commit_idx idx)
 {
-	git_commit_list *list = *list_p;
+	size_t i, p;
 
-	if (list == NULL)
-		return;
+	if (q->size == q->alloc) {
+		git_commit_idx *d = git__realloc(q->d, q->alloc * 2 * sizeof(git_commit_idx));
+		GITERR_CHECK_ALLOC(d);
 
-	while (list) {
-		git_commit_list *temp = list;
-		list = temp->next;
-		git__free(temp);
+		q->d = d;
+		q->alloc *= 2;
 	}
 
-	*list_p = NULL;
+	for (i = q->size++, p = parent(i);
+		i > 1 && q->cmp(q->table, q->d[p], idx); i = p, p = parent(i))
+		q->d[i] = q->d[p];
+
+	q->d[i] = idx;
+	return 0;
 }
 
-git_commit_list_node *git_commit_list_pop(git_commit_list **stack)
+git_commit_idx git_commit_queue_pop(git_commit_queue *q)
 {
-	git_commit_list *top = *stack;
-	git_commit_list_node *item = top ? top->item : NULL;
+	git_commit_idx head, moving;
+	size_t i = 1, child;
+
+	if (q->size == 1)
+		return GIT_COMMIT_IDX_NONE;
 
-	if (top) {
-		*stack = top->next;
-		git__free(top);
+	head = q->d[1];
+	moving = q->d[--q->size];
+
+	while ((child = left(i)) < q->size) {
+		if (child + 1 < q->size && q->cmp(q->table, q->d[child], q->d[child + 1]))
+			child++;
+
+		if (!q->cmp(q->table, moving, q->d[child]))
+			break;
+
+		q->d[i] = q->d[child];
+		i = child;
 	}
-	return item;
+
+	q->d[i] = moving;
+	return head;
+}
+
+int git_commit_list_time_cmp(
+	const git_commit_table *table, git_commit_idx a, git_commit_idx b)
+{
+	return (table->times[a] < table->times[b]);
 }
 
-static int commit_quick_parse(git_revwalk *walk, git_commit_list_node *commit, git_rawobj *raw)
+int git_commit_list_generation_cmp(
+	const git_commit_table *table, git_commit_idx a, git_commit_idx b)
 {
-	const size_t parent_len = strlen("parent ") + GIT_OID_HEXSZ + 1;
-	unsigned char *buffer = raw->data;
-	unsigned char *buffer_end = buffer + raw->len;
-	unsigned char *parents_start, *committer_start;
-	int i, parents = 0;
-	int commit_time;
+	if (table->generations[a] != table->generations[b])
+		return (table->generations[a] < table->generations[b]);
 
-	buffer += strlen("tree ") + GIT_OID_HEXSZ + 1;
+	return (table->times[a] < table->times[b]);
+}
 
-	parents_start = buffer;
-	while (buffer + parent_len < buffer_end && memcmp(buffer, "parent ", strlen("parent ")) == 0) {
-		parents++;
-		buffer += parent_len;
-	}
+static int commit_error(git_revwalk *walk, git_commit_idx commit, const char *msg)
+{
+	char commit_oid[GIT_OID_HEXSZ + 1];
+	git_oid_fmt(commit_oid, &walk->commits.oids[commit]);
+	commit_oid[GIT_OID_HEXSZ] = '\0';
 
-	commit->parents = alloc_parents(walk, commit, parents);
-	GITERR_CHECK_ALLOC(commit->parents);
+	giterr_set(GITERR_ODB, "Failed to parse commit %s - %s", commit_oid, msg);
 
-	buffer = parents_start;
-	for (i = 0; i < parents; ++i) {
-		git_oid oid;
+	return -1;
+}
 
-		if (git_oid_fromstr(&oid, (char *)buffer + strlen("parent ")) < 0)
-			return -1;
+static int commit_quick_parse(git_revwalk *walk, git_commit_idx commit, git_rawobj *raw)
+{
+	git_commit_table *t = &walk->commits;
+	git_commit_header header;
+	uint32_t start;
+	size_t i;
 
-		commit->parents[i] = git_revwalk__commit_lookup(walk, &oid);
-		if (commit->parents[i] == NULL)
-			return -1;
+	if (git_commit_header_scan(&header, raw->data, raw->len) < 0 ||
+		git_commit_header_tree(&t->trees[commit], &header) < 0)
+		return commit_error(walk, commit, "object is corrupted");
+
+	if (header.committer == NULL)
+		return commit_error(walk, commit, "cannot parse commit time");
+
+	if (commit_table_alloc_parents(&start, t, header.parent_count) < 0)
+		return -1;
+
+	for (i = 0; i < header.parent_count; ++i) {
+		git_oid oid;
 
-		buffer += parent_len;
+		if (git_commit_header_parent(&oid, &header, i) < 0 ||
+			git_commit_table_lookup(&t->parents[start + i], t, &oid) < 0)
+			return -1;
 	}
 
-	commit->out_degree = (unsigned short)parents;
+	t->parents_start[commit] = start;
+	t->parent_count[commit] = (uint16_t)header.parent_count;
+	t->times[commit] = header.committer_time;
+	t->flags[commit] |= COMMIT_PARSED;
+	return 0;
+}
+
+/* Returns GIT_ENOTFOUND when the commit-graph doesn't have the commit */
+static int commit_graph_parse(git_revwalk *walk, git_commit_idx commit)
+{
+	git_commit_table *t = &walk->commits;
+	git_commit_graph_entry e;
+	uint32_t pos, start;
+	size_t i;
 
-	if ((committer_start = buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
-		return commit_error(commit, "object is corrupted");
+	if (!(t->flags[commit] & COMMIT_IN_GRAPH)) {
+		if (git_commit_graph_find(&pos, walk->graph, &t->oids[commit]) < 0)
+			return GIT_ENOTFOUND;
 
-	buffer++;
+		t->flags[commit] |= COMMIT_IN_GRAPH;
+		t->graph_pos[commit] = pos;
+	}
 
-	if ((buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
-		return commit_error(commit, "object is corrupted");
+	if (git_commit_graph_entry_get(&e, walk->graph, t->graph_pos[commit]) < 0)
+		return -1;
 
-	/* Skip trailing spaces */
-	while (buffer > committer_start && git__isspace(*buffer))
-		buffer--;
+	if (commit_table_alloc_parents(&start, t, e.parent_count) < 0)
+		return -1;
 
-	/* Seek for the begining of the pack of digits */
-	while (buffer > committer_start && git__isdigit(*buffer))
-		buffer--;
+	for (i = 0; i < e.parent_count; ++i) {
+		git_commit_idx parent;
 
-	/* Skip potential timezone offset */
-	if ((buffer > committer_start) && (*buffer == '+' || *buffer == '-')) {
-		buffer--;
+		if (git_commit_graph_entry_parent(&pos, walk->graph, &e, i) < 0)
+			return -1;
 
-		while (buffer > committer_start && git__isspace(*buffer))
-			buffer--;
+		if (git_commit_table_lookup(&parent, t, &walk->graph->oid_lookup[pos]) < 0)
+			return -1;
 
-		while (buffer > committer_start && git__isdigit(*buffer))
-			buffer--;
+		/* saves looking the parent up again when it's parsed */
+		t->flags[parent] |= COMMIT_IN_GRAPH;
+		t->graph_pos[parent] = pos;
+		t->parents[start + i] = parent;
 	}
 
-	if ((buffer == committer_start) || (git__strtol32(&commit_time, (char *)(buffer + 1), NULL, 10) < 0))
-		return commit_error(commit, "cannot parse commit time");
-
-	commit->time = (time_t)commit_time;
-	commit->parsed = 1;
+	git_oid_cpy(&t->trees[commit], &e.tree_oid);
+	t->parents_start[commit] = start;
+	t->parent_count[commit] = (uint16_t)e.parent_count;
+	t->times[commit] = (uint32_t)e.commit_time;
+	t->generations[commit] = e.generation;
+	t->flags[commit] |= COMMIT_PARSED;
 	return 0;
 }
 
-int git_commit_list_parse(git_revwalk *walk, git_commit_list_node *commit)
+int git_commit_list_parse(git_revwalk *walk, git_commit_idx commit)
 {
 	git_odb_object *obj;
 	int error;
 
-	if (commit->parsed)
+	if (walk->commits.flags[commit] & COMMIT_PARSED)
 		return 0;
 
-	if ((error = git_odb_read(&obj, walk->odb, &commit->oid)) < 0)
+	if (walk->graph &&
+		(error = commit_graph_parse(walk, commit)) != GIT_ENOTFOUND)
+		return error;
+
+	if ((error = git_odb_read(&obj, walk->odb, &walk->commits.oids[commit])) < 0)
 		return error;
 
 	if (obj->raw.type != GIT_OBJ_COMMIT) {
@@ -192,3 +388,61 @@ int git_commit_list_parse(git_revwalk *walk, git_commit_list_node *commit)
 	return error;
 }
 
+int git_commit_list_generation(git_revwalk *walk, git_commit_idx commit)
+{
+	git_commit_table *t = &walk->commits;
+	git_commit_stack stack = GIT_COMMIT_STACK_INIT;
+	int error;
+
+	if ((error = git_commit_list_parse(walk, commit)) < 0 || t->generations[commit])
+		return error;
+
+	if (!walk->graph) {
+		t->generations[commit] = GIT_COMMIT_LIST_GENERATION_INFINITY;
+		return 0;
+	}
+
+	/*
+	 * The commits the graph doesn't know about are usually the few that
+	 * were made after it was written, so their parents soon lead into it.
+	 */
+	if (git_commit_stack_push(&stack, commit) < 0)
+		return -1;
+
+	while (stack.length > 0) {
+		git_commit_idx c = stack.ids[stack.length - 1];
+		uint32_t generation = 0;
+		int pending = 0;
+		unsigned short i;
+
+		if (t->generations[c]) {
+			stack.length--;
+			continue;
+		}
+
+		for (i = 0; i < t->parent_count[c]; ++i) {
+			git_commit_idx p = git_commit_table_parents(t, c)[i];
+
+			if ((error = git_commit_list_parse(walk, p)) < 0)
+				goto done;
+
+			if (!t->generations[p]) {
+				if ((error = git_commit_stack_push(&stack, p)) < 0)
+					goto done;
+				pending = 1;
+			} else if (t->generations[p] > generation)
+				generation = t->generations[p];
+		}
+
+		if (pending)
+			continue;
+
+		t->generations[c] = generation < GIT_COMMIT_GRAPH_GENERATION_MAX ?
+			generation + 1 : GIT_COMMIT_GRAPH_GENERATION_MAX;
+		stack.length--;
+	}
+
+done:
+	git_commit_stack_free(&stack);
+	return error;
+}
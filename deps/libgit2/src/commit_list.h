@@ -9,41 +9,131 @@
 
 #include "git2/oid.h"
 
+/* merge base and ahead/behind state; kept over resets */
 #define PARENT1  (1 << 0)
 #define PARENT2  (1 << 1)
 #define RESULT   (1 << 2)
 #define STALE    (1 << 3)
 
-#define PARENTS_PER_COMMIT	2
-#define COMMIT_ALLOC \
-	(sizeof(git_commit_list_node) + PARENTS_PER_COMMIT * sizeof(git_commit_list_node *))
-
-typedef struct git_commit_list_node {
-	git_oid oid;
-	uint32_t time;
-	unsigned int seen:1,
-			 uninteresting:1,
-			 topo_delay:1,
-			 parsed:1,
-			 flags : 4;
-
-	unsigned short in_degree;
-	unsigned short out_degree;
-
-	struct git_commit_list_node **parents;
-} git_commit_list_node;
-
-typedef struct git_commit_list {
-	git_commit_list_node *item;
-	struct git_commit_list *next;
-} git_commit_list;
-
-git_commit_list_node *git_commit_list_alloc_node(git_revwalk *walk);
-int git_commit_list_time_cmp(void *a, void *b);
-void git_commit_list_free(git_commit_list **list_p);
-git_commit_list *git_commit_list_insert(git_commit_list_node *item, git_commit_list **list_p);
-git_commit_list *git_commit_list_insert_by_date(git_commit_list_node *item, git_commit_list **list_p);
-int git_commit_list_parse(git_revwalk *walk, git_commit_list_node *commit);
-git_commit_list_node *git_commit_list_pop(git_commit_list **stack);
+/* walk state; cleared by git_revwalk_reset */
+#define COMMIT_SEEN           (1 << 4)
+#define COMMIT_UNINTERESTING  (1 << 5)
+/* its parents were processed, and counted in their in-degrees if it's shown */
+#define COMMIT_TOPO_EXPLORED  (1 << 6)
+/* put in the topological walk's output queue */
+#define COMMIT_TOPO_QUEUED    (1 << 7)
+/* leaves the walk's paths as one of its parents has them */
+#define COMMIT_TREESAME       (1 << 8)
+
+/* what's known about the commit */
+#define COMMIT_PARSED         (1 << 9)
+#define COMMIT_IN_GRAPH       (1 << 10)
+
+/* the generation of commits we know nothing about; sorts before all others */
+#define GIT_COMMIT_LIST_GENERATION_INFINITY 0xFFFFFFFF
+
+/* A commit's position in a git_commit_table */
+typedef uint32_t git_commit_idx;
+
+#define GIT_COMMIT_IDX_NONE 0xFFFFFFFF
+
+/*
+ * The commits a walk has come across, numbered in the order they were
+ * first seen. Each field is an array of its own, indexed by that
+ * number, so going over many commits only touches the fields that are
+ * looked at, and the parents of all of them are spans of one array.
+ */
+typedef struct {
+	size_t length, alloc;
+
+	git_oid *oids;
+	git_oid *trees;
+	int64_t *times;
+	uint16_t *flags;
+
+	/* 0 until git_commit_list_generation has been called */
+	uint32_t *generations;
+
+	/* position in the walk's commit-graph, valid with COMMIT_IN_GRAPH */
+	uint32_t *graph_pos;
+
+	/* the explored children left to show first, for topological sorting */
+	uint16_t *in_degree;
+
+	/* the `parent_count[i]` parents of `i` start at `parents[parents_start[i]]` */
+	uint32_t *parents_start;
+	uint16_t *parent_count;
+	git_commit_idx *parents;
+	size_t parents_length, parents_alloc;
+
+	/* open addressing over `oids`: 0 for an empty slot, or index + 1 */
+	uint32_t *slots;
+	size_t slots_mask;
+} git_commit_table;
+
+#define git_commit_table_parents(t, i) (&(t)->parents[(t)->parents_start[i]])
+
+int git_commit_table_init(git_commit_table *table);
+void git_commit_table_free(git_commit_table *table);
+
+/* Find the commit in the table, adding it if it's not there yet */
+int git_commit_table_lookup(
+	git_commit_idx *out, git_commit_table *table, const git_oid *oid);
+
+/* A growable stack of commits */
+typedef struct {
+	git_commit_idx *ids;
+	size_t length, alloc;
+} git_commit_stack;
+
+#define GIT_COMMIT_STACK_INIT { NULL, 0, 0 }
+
+int git_commit_stack_push(git_commit_stack *stack, git_commit_idx idx);
+#define git_commit_stack_pop(s) ((s)->ids[--(s)->length])
+#define git_commit_stack_clear(s) ((s)->length = 0)
+void git_commit_stack_free(git_commit_stack *stack);
+
+/*
+ * A priority queue of commits, comparing their fields in the table
+ * rather than following pointers to them. `cmp(table, a, b)` is true
+ * when `b` comes out first.
+ */
+typedef int (*git_commit_queue_cmp)(
+	const git_commit_table *table, git_commit_idx a, git_commit_idx b);
+
+typedef struct {
+	const git_commit_table *table;
+	git_commit_queue_cmp cmp;
+	/* element 0 isn't used, the heap starts at 1 */
+	git_commit_idx *d;
+	size_t size, alloc;
+} git_commit_queue;
+
+int git_commit_queue_init(
+	git_commit_queue *q, const git_commit_table *table, git_commit_queue_cmp cmp);
+void git_commit_queue_free(git_commit_queue *q);
+int git_commit_queue_insert(git_commit_queue *q, git_commit_idx idx);
+/* GIT_COMMIT_IDX_NONE when the queue is empty */
+git_commit_idx git_commit_queue_pop(git_commit_queue *q);
+#define git_commit_queue_peek(q) ((q)->size > 1 ? (q)->d[1] : GIT_COMMIT_IDX_NONE)
+#define git_commit_queue_length(q) ((q)->size - 1)
+#define git_commit_queue_clear(q) ((q)->size = 1)
+
+int git_commit_list_time_cmp(
+	const git_commit_table *table, git_commit_idx a, git_commit_idx b);
+int git_commit_list_generation_cmp(
+	const git_commit_table *table, git_commit_idx a, git_commit_idx b);
+
+int git_commit_list_parse(git_revwalk *walk, git_commit_idx commit);
+
+/*
+ * Parse `commit` and fill in its generation number: one more than the
+ * highest generation among its parents, or 1 for a root. Commits in the
+ * walk's commit-graph take theirs from there and the others are
+ * computed from their parents; without a commit-graph every commit is
+ * GIT_COMMIT_LIST_GENERATION_INFINITY, so that ordering by generation
+ * falls back to ordering by date.
+ */
+int git_commit_list_generation(git_revwalk *walk, git_commit_idx commit);
 
 #endif
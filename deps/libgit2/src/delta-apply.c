@@ -49,8 +49,9 @@ int git__delta_read_header(
 	return 0;
 }
 
-int git__delta_apply(
-	git_rawobj *out,
+int git__delta_apply_buf(
+	unsigned char *out,
+	size_t out_len,
 	const unsigned char *base,
 	size_t base_len,
 	const unsigned char *delta,
@@ -58,7 +59,7 @@ int git__delta_apply(
 {
 	const unsigned char *delta_end = delta + delta_len;
 	size_t base_sz, res_sz;
-	unsigned char *res_dp;
+	unsigned char *res_dp = out;
 
 	/* Check that the base size matches the data we were given;
 	 * if not we would underflow while accessing data from the
@@ -69,17 +70,12 @@ int git__delta_apply(
 		return -1;
 	}
 
-	if (hdr_sz(&res_sz, &delta, delta_end) < 0) {
+	if (hdr_sz(&res_sz, &delta, delta_end) < 0 || res_sz != out_len) {
 		giterr_set(GITERR_INVALID, "Failed to apply delta. Base size does not match given data");
 		return -1;
 	}
 
-	res_dp = git__malloc(res_sz + 1);
-	GITERR_CHECK_ALLOC(res_dp);
-
-	res_dp[res_sz] = '\0';
-	out->data = res_dp;
-	out->len = res_sz;
+	out[res_sz] = '\0';
 
 	while (delta < delta_end) {
 		unsigned char cmd = *delta++;
@@ -127,8 +123,35 @@ int git__delta_apply(
 	return 0;
 
 fail:
-	git__free(out->data);
-	out->data = NULL;
 	giterr_set(GITERR_INVALID, "Failed to apply delta");
 	return -1;
 }
+
+int git__delta_apply(
+	git_rawobj *out,
+	const unsigned char *base,
+	size_t base_len,
+	const unsigned char *delta,
+	size_t delta_len)
+{
+	size_t base_sz, res_sz;
+	unsigned char *res_dp;
+
+	if (git__delta_read_header(delta, delta_len, &base_sz, &res_sz) < 0) {
+		giterr_set(GITERR_INVALID, "Failed to apply delta. Base size does not match given data");
+		return -1;
+	}
+
+	res_dp = git__malloc(res_sz + 1);
+	GITERR_CHECK_ALLOC(res_dp);
+
+	if (git__delta_apply_buf(res_dp, res_sz, base, base_len, delta, delta_len) < 0) {
+		git__free(res_dp);
+		out->data = NULL;
+		return -1;
+	}
+
+	out->data = res_dp;
+	out->len = res_sz;
+	return 0;
+}
@@ -30,6 +30,29 @@ extern int git__delta_apply(
 	const unsigned char *delta,
 	size_t delta_len);
 
+/**
+ * Apply a git binary delta into a buffer owned by the caller.
+ *
+ * @param out the buffer to write the result to; it must have room
+ *		for `out_len + 1` bytes, as the result is NUL terminated.
+ * @param out_len the result size, as read by git__delta_read_header.
+ * @param base the base to copy from during copy instructions.
+ * @param base_len number of bytes available at base.
+ * @param delta the delta to execute copy/insert instructions from.
+ * @param delta_len total number of bytes in the delta.
+ * @return
+ * - 0 on a successful delta unpack.
+ * - GIT_ERROR if the delta is corrupt or doesn't match the base
+ *   or the result size.
+ */
+extern int git__delta_apply_buf(
+	unsigned char *out,
+	size_t out_len,
+	const unsigned char *base,
+	size_t base_len,
+	const unsigned char *delta,
+	size_t delta_len);
+
 /**
  * Read the header of a git binary delta.
  *
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "ewah.h"
+
+#define RLW_RUNNING_BIT(w) ((w) & 1)
+#define RLW_RUNNING_LEN(w) (((w) >> 1) & 0xffffffff)
+#define RLW_LITERALS(w) ((w) >> 33)
+
+#define RLW_MAX_RUNNING_LEN 0xffffffffu
+#define RLW_MAX_LITERALS 0x7fffffffu
+
+static int bitmap_grow(git_bitmap *bitmap, size_t words)
+{
+	if (words > bitmap->alloc) {
+		size_t alloc = bitmap->alloc ? bitmap->alloc : 8;
+		uint64_t *grown;
+
+		while (alloc < words)
+			alloc += alloc / 2;
+
+		grown = git__realloc(bitmap->words, alloc * sizeof(uint64_t));
+		GITERR_CHECK_ALLOC(grown);
+
+		bitmap->words = grown;
+		bitmap->alloc = alloc;
+	}
+
+	if (words > bitmap->length) {
+		memset(bitmap->words + bitmap->length, 0,
+			(words - bitmap->length) * sizeof(uint64_t));
+		bitmap->length = words;
+	}
+
+	return 0;
+}
+
+int git_bitmap_set(git_bitmap *bitmap, size_t pos)
+{
+	if (bitmap_grow(bitmap, pos / 64 + 1) < 0)
+		return -1;
+
+	bitmap->words[pos / 64] |= (uint64_t)1 << (pos % 64);
+	return 0;
+}
+
+int git_bitmap_or(git_bitmap *a, const git_bitmap *b)
+{
+	size_t i;
+
+	if (bitmap_grow(a, b->length) < 0)
+		return -1;
+
+	for (i = 0; i < b->length; ++i)
+		a->words[i] |= b->words[i];
+
+	return 0;
+}
+
+int git_bitmap_xor(git_bitmap *a, const git_bitmap *b)
+{
+	size_t i;
+
+	if (bitmap_grow(a, b->length) < 0)
+		return -1;
+
+	for (i = 0; i < b->length; ++i)
+		a->words[i] ^= b->words[i];
+
+	return 0;
+}
+
+void git_bitmap_and_not(git_bitmap *a, const git_bitmap *b)
+{
+	size_t i, n = min(a->length, b->length);
+
+	for (i = 0; i < n; ++i)
+		a->words[i] &= ~b->words[i];
+}
+
+size_t git_bitmap_count(const git_bitmap *bitmap)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < bitmap->length; ++i) {
+		uint64_t word = bitmap->words[i];
+
+		for (; word; word &= word - 1)
+			count++;
+	}
+
+	return count;
+}
+
+int git_bitmap_next(size_t *pos, const git_bitmap *bitmap)
+{
+	size_t i = *pos / 64;
+	uint64_t word;
+
+	if (i >= bitmap->length)
+		return GIT_ITEROVER;
+
+	word = bitmap->words[i] & (~(uint64_t)0 << (*pos % 64));
+
+	while (!word) {
+		if (++i == bitmap->length)
+			return GIT_ITEROVER;
+		word = bitmap->words[i];
+	}
+
+	*pos = i * 64;
+	for (; !(word & 1); word >>= 1)
+		(*pos)++;
+
+	return 0;
+}
+
+void git_bitmap_free(git_bitmap *bitmap)
+{
+	git__free(bitmap->words);
+	bitmap->words = NULL;
+	bitmap->length = bitmap->alloc = 0;
+}
+
+GIT_INLINE(uint32_t) get_be32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+GIT_INLINE(uint64_t) get_be64(const unsigned char *p)
+{
+	return ((uint64_t)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+static int ewah_error(const char *message)
+{
+	giterr_set(GITERR_ODB, "Invalid EWAH bitmap - %s", message);
+	return -1;
+}
+
+int git_ewah_read(
+	git_bitmap *out, size_t *consumed, const unsigned char *data, size_t len,
+	size_t max_bits)
+{
+	size_t bits, num_words, max_words, pos, i, w = 0;
+
+	if (len < 12)
+		return ewah_error("bitmap is truncated");
+
+	bits = get_be32(data);
+	num_words = get_be32(data + 4);
+	max_words = (bits + 63) / 64;
+
+	if (bits > max_bits)
+		return ewah_error("bitmap has more bits than there are objects");
+
+	if ((len - 12) / 8 < num_words)
+		return ewah_error("bitmap is truncated");
+
+	data += 8;
+	out->length = 0;
+
+	if (bitmap_grow(out, max_words) < 0)
+		return -1;
+
+	for (pos = 0; pos < num_words; ) {
+		uint64_t marker = get_be64(data + 8 * pos++);
+		size_t run = (size_t)RLW_RUNNING_LEN(marker);
+		size_t literals = (size_t)RLW_LITERALS(marker);
+
+		if (run > max_words - w || literals > max_words - w - run ||
+			literals > num_words - pos)
+			return ewah_error("bitmap is longer than its bit count");
+
+		if (RLW_RUNNING_BIT(marker))
+			memset(out->words + w, 0xff, run * sizeof(uint64_t));
+		w += run;
+
+		for (i = 0; i < literals; ++i)
+			out->words[w++] = get_be64(data + 8 * pos++);
+	}
+
+	if ((bits % 64) && w == max_words &&
+		(out->words[max_words - 1] >> (bits % 64)) != 0)
+		return ewah_error("bitmap has bits set past its bit count");
+
+	*consumed = 12 + num_words * 8;
+	return 0;
+}
+
+static int put_be64(git_buf *out, uint64_t v)
+{
+	uint32_t be[2];
+
+	be[0] = htonl((uint32_t)(v >> 32));
+	be[1] = htonl((uint32_t)v);
+
+	return git_buf_put(out, (const char *)be, sizeof(be));
+}
+
+GIT_INLINE(uint64_t) word_at(const git_bitmap *bitmap, size_t i, size_t bits)
+{
+	uint64_t word = i < bitmap->length ? bitmap->words[i] : 0;
+
+	/* bits past the end aren't encoded */
+	if (i == bits / 64)
+		word &= ((uint64_t)1 << (bits % 64)) - 1;
+
+	return word;
+}
+
+int git_ewah_write(git_buf *out, const git_bitmap *bitmap, size_t bits)
+{
+	size_t num_words = (bits + 63) / 64;
+	size_t start = out->size, marker_pos = 0, written = 0, i = 0;
+	uint32_t header[2] = { 0, 0 };
+
+	if (bits > 0xffffffff)
+		return ewah_error("bitmap is too large");
+
+	/* filled in once the number of words is known */
+	if (git_buf_put(out, (const char *)header, sizeof(header)) < 0)
+		return -1;
+
+	do {
+		size_t marker = out->size;
+		uint64_t word = word_at(bitmap, i, bits), run_bit = 0;
+		uint64_t run = 0, literals = 0;
+
+		if (put_be64(out, 0) < 0)
+			return -1;
+
+		if (i < num_words && (word == 0 || word == ~(uint64_t)0)) {
+			run_bit = word & 1;
+			while (i < num_words && run < RLW_MAX_RUNNING_LEN &&
+				word_at(bitmap, i, bits) == word) {
+				run++;
+				i++;
+			}
+		}
+
+		while (i < num_words && literals < RLW_MAX_LITERALS) {
+			word = word_at(bitmap, i, bits);
+			if (word == 0 || word == ~(uint64_t)0)
+				break;
+
+			if (put_be64(out, word) < 0)
+				return -1;
+			literals++;
+			i++;
+		}
+
+		marker_pos = written;
+		written += 1 + (size_t)literals;
+
+		word = run_bit | (run << 1) | (literals << 33);
+		header[0] = htonl((uint32_t)(word >> 32));
+		header[1] = htonl((uint32_t)word);
+		memcpy(out->ptr + marker, header, sizeof(header));
+	} while (i < num_words);
+
+	header[0] = htonl((uint32_t)bits);
+	header[1] = htonl((uint32_t)written);
+	memcpy(out->ptr + start, header, sizeof(header));
+
+	header[0] = htonl((uint32_t)marker_pos);
+	return git_buf_put(out, (const char *)header, sizeof(uint32_t));
+}
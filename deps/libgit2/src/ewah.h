@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_ewah_h__
+#define INCLUDE_ewah_h__
+
+#include "common.h"
+#include "buffer.h"
+
+/*
+ * A plain bitmap, one bit per object of a pack. It grows as bits are
+ * set; bits past the end read as zero.
+ */
+typedef struct {
+	uint64_t *words;
+	size_t length, alloc;
+} git_bitmap;
+
+#define GIT_BITMAP_INIT {NULL, 0, 0}
+
+int git_bitmap_set(git_bitmap *bitmap, size_t pos);
+
+GIT_INLINE(int) git_bitmap_get(const git_bitmap *bitmap, size_t pos)
+{
+	size_t word = pos / 64;
+
+	return word < bitmap->length &&
+		(bitmap->words[word] & ((uint64_t)1 << (pos % 64))) != 0;
+}
+
+/* `a |= b` */
+int git_bitmap_or(git_bitmap *a, const git_bitmap *b);
+
+/* `a ^= b` */
+int git_bitmap_xor(git_bitmap *a, const git_bitmap *b);
+
+/* `a &= ~b` */
+void git_bitmap_and_not(git_bitmap *a, const git_bitmap *b);
+
+size_t git_bitmap_count(const git_bitmap *bitmap);
+
+/*
+ * Find the first set bit at or after `*pos`; returns 0 and updates
+ * `*pos`, or GIT_ITEROVER once there are none left.
+ */
+int git_bitmap_next(size_t *pos, const git_bitmap *bitmap);
+
+void git_bitmap_free(git_bitmap *bitmap);
+
+/*
+ * EWAH is the word-aligned run-length encoding git stores bitmaps in:
+ * the bit count, the number of 64-bit words that follow, the words,
+ * and the position of the last marker word, all in network order.
+ * A marker word says how many words of all zeroes or all ones come
+ * next and how many literal words follow them.
+ */
+
+/*
+ * Decode the bitmap at `data`; `*consumed` gets the size of its encoding.
+ * A bitmap with more than `max_bits` bits, or with bits set past its bit
+ * count, is refused.
+ */
+int git_ewah_read(
+	git_bitmap *out, size_t *consumed, const unsigned char *data, size_t len,
+	size_t max_bits);
+
+/* Append the first `bits` bits of `bitmap` to `out` */
+int git_ewah_write(git_buf *out, const git_bitmap *bitmap, size_t bits);
+
+#endif
@@ -43,15 +43,48 @@ static int filter_ref__cb(git_remote_head *head, void *payload)
 	if (!match)
 		return 0;
 
-	/* If we have the object, mark it so we don't ask for it */
-	if (git_odb_exists(p->odb, &head->oid))
-		head->local = 1;
-	else
-		p->remote->need_pack = 1;
-
 	return git_vector_insert(&p->remote->refs, head);
 }
 
+/* If we have the object, mark it so we don't ask for it */
+static int mark_local_heads(git_remote *remote, git_odb *odb)
+{
+	git_remote_head *head;
+	git_oid *ids;
+	unsigned char *exists;
+	size_t i, count = remote->refs.length;
+	int error = -1;
+
+	if (!count)
+		return 0;
+
+	ids = git__malloc(count * sizeof(git_oid));
+	exists = git__malloc((count + 7) / 8);
+	if (!ids || !exists) {
+		giterr_set_oom();
+		goto cleanup;
+	}
+
+	git_vector_foreach(&remote->refs, i, head)
+		git_oid_cpy(&ids[i], &head->oid);
+
+	/* all at once: a remote can advertise thousands of refs */
+	if ((error = git_odb_exists_many(exists, odb, ids, count)) < 0)
+		goto cleanup;
+
+	git_vector_foreach(&remote->refs, i, head) {
+		if (exists[i / 8] & (1 << (i % 8)))
+			head->local = 1;
+		else
+			remote->need_pack = 1;
+	}
+
+cleanup:
+	git__free(ids);
+	git__free(exists);
+	return error;
+}
+
 static int filter_wants(git_remote *remote)
 {
 	struct filter_payload p;
@@ -76,7 +109,10 @@ static int filter_wants(git_remote *remote)
 	if (git_repository_odb__weakptr(&p.odb, remote->repo) < 0)
 		goto cleanup;
 
-	error = git_remote_ls(remote, filter_ref__cb, &p);
+	if ((error = git_remote_ls(remote, filter_ref__cb, &p)) < 0)
+		goto cleanup;
+
+	error = mark_local_heads(remote, p.odb);
 
 cleanup:
 	git_refspec__free(&tagspec);
@@ -12,6 +12,7 @@
 
 
 git_mutex git__mwindow_mutex;
+git_mutex git__delta_base_mutex;
 
 /**
  * Handle the global state with TLS
@@ -61,6 +62,7 @@ int git_threads_init(void)
 
 	_tls_index = TlsAlloc();
 	git_mutex_init(&git__mwindow_mutex);
+	git_mutex_init(&git__delta_base_mutex);
 
 	/* Initialize any other subsystems that have global state */
 	if ((error = git_hash_global_init()) >= 0)
@@ -79,6 +81,7 @@ void git_threads_shutdown(void)
 	TlsFree(_tls_index);
 	_tls_init = 0;
 	git_mutex_free(&git__mwindow_mutex);
+	git_mutex_free(&git__delta_base_mutex);
 
 	/* Shut down any subsystems that have global state */
 	git_hash_global_shutdown();
@@ -109,7 +112,10 @@ static int _tls_init = 0;
 
 static void cb__free_status(void *st)
 {
-	git__free(st);
+	git_global_st *state = st;
+
+	git__free(state->error_t.message);
+	git__free(state);
 }
 
 int git_threads_init(void)
@@ -120,6 +126,7 @@ int git_threads_init(void)
 		return 0;
 
 	git_mutex_init(&git__mwindow_mutex);
+	git_mutex_init(&git__delta_base_mutex);
 	pthread_key_create(&_tls_key, &cb__free_status);
 
 	/* Initialize any other subsystems that have global state */
@@ -136,6 +143,7 @@ void git_threads_shutdown(void)
 	pthread_key_delete(_tls_key);
 	_tls_init = 0;
 	git_mutex_free(&git__mwindow_mutex);
+	git_mutex_free(&git__delta_base_mutex);
 
 	/* Shut down any subsystems that have global state */
 	git_hash_global_shutdown();
@@ -21,11 +21,13 @@
 typedef struct {
 	git_error *last_error;
 	git_error error_t;
+	int cache_stripe; /* picked on the first cache lookup; 0 until then */
 } git_global_st;
 
 git_global_st *git__global_state(void);
 
 extern git_mutex git__mwindow_mutex;
+extern git_mutex git__delta_base_mutex;
 
 #define GIT_GLOBAL (git__global_state())
 
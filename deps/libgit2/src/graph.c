@@ -10,169 +10,131 @@
 #include "merge.h"
 #include "git2/graph.h"
 
-static int interesting(git_pqueue *list, git_commit_list *roots)
-{
-	unsigned int i;
-	/* element 0 isn't used - we need to start at 1 */
-	for (i = 1; i < list->size; i++) {
-		git_commit_list_node *commit = list->d[i];
-		if ((commit->flags & STALE) == 0)
-			return 1;
-	}
+struct ahead_behind {
+	git_revwalk *walk;
+	git_commit_queue queue;
+	size_t ahead, behind;
 
-	while(roots) {
-		if ((roots->item->flags & STALE) == 0)
-			return 1;
-		roots = roots->next;
-	}
+	/* queued commits which only one side can reach */
+	size_t unique;
+};
 
-	return 0;
-}
+#define BOTH (PARENT1 | PARENT2)
 
-static int mark_parents(git_revwalk *walk, git_commit_list_node *one,
-	git_commit_list_node *two)
+/*
+ * RESULT marks the commits which have been queued and STALE the ones
+ * which have been counted. A counted commit which turns out to be
+ * reachable from the other side too was counted too early; it's taken
+ * back and queued again so its parents learn about it as well. That
+ * only happens when commits come out of the queue by date, since by
+ * generation all of a commit's descendants come out before it does.
+ */
+static int enqueue(struct ahead_behind *ab, git_commit_idx commit, int flags)
 {
-	unsigned int i;
-	git_commit_list *roots = NULL;
-	git_pqueue list;
-
-	/* if the commit is repeated, we have a our merge base already */
-	if (one == two) {
-		one->flags |= PARENT1 | PARENT2 | RESULT;
-		return 0;
-	}
-
-	if (git_pqueue_init(&list, 2, git_commit_list_time_cmp) < 0)
-		return -1;
+	git_commit_table *t = &ab->walk->commits;
+	int old = t->flags[commit] & BOTH;
+	int error;
 
-	if (git_commit_list_parse(walk, one) < 0)
-		goto on_error;
-	one->flags |= PARENT1;
-	if (git_pqueue_insert(&list, one) < 0)
-		goto on_error;
+	if (t->flags[commit] & RESULT) {
+		if ((old | flags) == old)
+			return 0;
 
-	if (git_commit_list_parse(walk, two) < 0)
-		goto on_error;
-	two->flags |= PARENT2;
-	if (git_pqueue_insert(&list, two) < 0)
-		goto on_error;
+		t->flags[commit] |= flags;
 
-	/* as long as there are non-STALE commits */
-	while (interesting(&list, roots)) {
-		git_commit_list_node *commit;
-		int flags;
-
-		commit = git_pqueue_pop(&list);
-		if (commit == NULL)
-			break;
-
-		flags = commit->flags & (PARENT1 | PARENT2 | STALE);
-		if (flags == (PARENT1 | PARENT2)) {
-			if (!(commit->flags & RESULT))
-				commit->flags |= RESULT;
-			/* we mark the parents of a merge stale */
-			flags |= STALE;
+		if (!(t->flags[commit] & STALE)) {
+			ab->unique--;
+			return 0;
 		}
 
-		for (i = 0; i < commit->out_degree; i++) {
-			git_commit_list_node *p = commit->parents[i];
-			if ((p->flags & flags) == flags)
-				continue;
+		if (old & PARENT1)
+			ab->behind--;
+		else
+			ab->ahead--;
 
-			if (git_commit_list_parse(walk, p) < 0)
-				goto on_error;
-
-			p->flags |= flags;
-			if (git_pqueue_insert(&list, p) < 0)
-				goto on_error;
-		}
-
-		/* Keep track of root commits, to make sure the path gets marked */
-		if (commit->out_degree == 0) {
-			if (git_commit_list_insert(commit, &roots) == NULL)
-				goto on_error;
-		}
+		t->flags[commit] &= ~STALE;
+		return git_commit_queue_insert(&ab->queue, commit);
 	}
 
-	git_commit_list_free(&roots);
-	git_pqueue_free(&list);
-	return 0;
+	if ((error = git_commit_list_generation(ab->walk, commit)) < 0)
+		return error;
 
-on_error:
-	git_commit_list_free(&roots);
-	git_pqueue_free(&list);
-	return -1;
-}
+	t->flags[commit] |= flags | RESULT;
+	if ((t->flags[commit] & BOTH) != BOTH)
+		ab->unique++;
 
+	return git_commit_queue_insert(&ab->queue, commit);
+}
 
-static int ahead_behind(git_commit_list_node *one, git_commit_list_node *two,
-	size_t *ahead, size_t *behind)
+/*
+ * Count the commits reachable from only one of `one` and `two`. Once
+ * every queued commit is reachable from both, so is everything below
+ * them and the count is done.
+ */
+static int ahead_behind(struct ahead_behind *ab,
+	git_commit_idx one, git_commit_idx two)
 {
-	git_commit_list_node *commit;
-	git_pqueue pq;
-	int i;
-	*ahead = 0;
-	*behind = 0;
+	git_commit_table *t = &ab->walk->commits;
+	git_commit_idx commit;
+	unsigned short i;
 
-	if (git_pqueue_init(&pq, 2, git_commit_list_time_cmp) < 0)
+	if (enqueue(ab, one, PARENT1) < 0 || enqueue(ab, two, PARENT2) < 0)
 		return -1;
-	if (git_pqueue_insert(&pq, one) < 0)
-		goto on_error;
-	if (git_pqueue_insert(&pq, two) < 0)
-		goto on_error;
 
-	while ((commit = git_pqueue_pop(&pq)) != NULL) {
-		if (commit->flags & RESULT ||
-			(commit->flags & (PARENT1 | PARENT2)) == (PARENT1 | PARENT2))
-			continue;
-		else if (commit->flags & PARENT1)
-			(*behind)++;
-		else if (commit->flags & PARENT2)
-			(*ahead)++;
-
-		for (i = 0; i < commit->out_degree; i++) {
-			git_commit_list_node *p = commit->parents[i];
-			if (git_pqueue_insert(&pq, p) < 0)
-				return -1;
+	while (ab->unique > 0 &&
+		(commit = git_commit_queue_pop(&ab->queue)) != GIT_COMMIT_IDX_NONE) {
+		int flags = t->flags[commit] & BOTH;
+
+		t->flags[commit] |= STALE;
+
+		if (flags == PARENT1) {
+			ab->unique--;
+			ab->behind++;
+		} else if (flags == PARENT2) {
+			ab->unique--;
+			ab->ahead++;
 		}
-		commit->flags |= RESULT;
+
+		for (i = 0; i < t->parent_count[commit]; i++)
+			if (enqueue(ab, git_commit_table_parents(t, commit)[i], flags) < 0)
+				return -1;
 	}
 
-	git_pqueue_free(&pq);
 	return 0;
-
-on_error:
-	git_pqueue_free(&pq);
-	return -1;
 }
 
 int git_graph_ahead_behind(size_t *ahead, size_t *behind, git_repository *repo,
 	const git_oid *one, const git_oid *two)
 {
 	git_revwalk *walk;
-	git_commit_list_node *commit1, *commit2;
+	git_commit_idx commit1, commit2;
+	struct ahead_behind ab;
+
+	memset(&ab, 0, sizeof(ab));
 
 	if (git_revwalk_new(&walk, repo) < 0)
 		return -1;
 
-	commit2 = git_revwalk__commit_lookup(walk, two);
-	if (commit2 == NULL)
+	ab.walk = walk;
+	if (git_commit_queue_init(&ab.queue, &walk->commits, git_commit_list_generation_cmp) < 0)
 		goto on_error;
 
-	commit1 = git_revwalk__commit_lookup(walk, one);
-	if (commit1 == NULL)
+	if (git_revwalk__commit_lookup(&commit2, walk, two) < 0 ||
+		git_revwalk__commit_lookup(&commit1, walk, one) < 0)
 		goto on_error;
 
-	if (mark_parents(walk, commit1, commit2) < 0)
-		goto on_error;
-	if (ahead_behind(commit1, commit2, ahead, behind) < 0)
+	if (ahead_behind(&ab, commit1, commit2) < 0)
 		goto on_error;
 
+	*ahead = ab.ahead;
+	*behind = ab.behind;
+
+	git_commit_queue_free(&ab.queue);
 	git_revwalk_free(walk);
 
 	return 0;
 
 on_error:
+	git_commit_queue_free(&ab.queue);
 	git_revwalk_free(walk);
 	return -1;
 }
@@ -45,3 +45,21 @@ done:
 
 	return error;
 }
+
+int git_hash_vec_many(git_oid *out, git_buf_vec *vec, size_t parts, size_t n)
+{
+	size_t i;
+
+#ifdef X86_SHA1
+	int error = git_hash_x86__vec_many(out, vec, parts, n);
+	if (error != GIT_PASSTHROUGH)
+		return error;
+#endif
+
+	for (i = 0; i < n; i++) {
+		if (git_hash_vec(&out[i], vec + i * parts, parts) < 0)
+			return -1;
+	}
+
+	return 0;
+}
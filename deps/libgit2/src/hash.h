@@ -18,7 +18,14 @@ void git_hash_global_shutdown(void);
 int git_hash_ctx_init(git_hash_ctx *ctx);
 void git_hash_ctx_cleanup(git_hash_ctx *ctx);
 
-#if defined(OPENSSL_SHA1)
+typedef struct {
+	void *data;
+	size_t len;
+} git_buf_vec;
+
+#if defined(X86_SHA1)
+# include "hash/hash_x86.h"
+#elif defined(OPENSSL_SHA1)
 # include "hash/hash_openssl.h"
 #elif defined(WIN32_SHA1)
 # include "hash/hash_win32.h"
@@ -26,11 +33,6 @@ void git_hash_ctx_cleanup(git_hash_ctx *ctx);
 # include "hash/hash_generic.h"
 #endif
 
-typedef struct {
-	void *data;
-	size_t len;
-} git_buf_vec;
-
 int git_hash_init(git_hash_ctx *c);
 int git_hash_update(git_hash_ctx *c, const void *data, size_t len);
 int git_hash_final(git_oid *out, git_hash_ctx *c);
@@ -38,4 +40,11 @@ int git_hash_final(git_oid *out, git_hash_ctx *c);
 int git_hash_buf(git_oid *out, const void *data, size_t len);
 int git_hash_vec(git_oid *out, git_buf_vec *vec, size_t n);
 
+/*
+ * Hash `n` messages of `parts` pieces each into `out[0]` to `out[n-1]`:
+ * the i-th message is made of `vec[i * parts]` to `vec[i * parts +
+ * parts - 1]`. Where the CPU allows, they are hashed side by side.
+ */
+int git_hash_vec_many(git_oid *out, git_buf_vec *vec, size_t parts, size_t n);
+
 #endif /* INCLUDE_hash_h__ */
@@ -7,7 +7,6 @@
 
 #include "common.h"
 #include "hash.h"
-#include "hash/hash_generic.h"
 
 #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 
@@ -113,16 +112,16 @@
 #define T_40_59(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, ((B&C)+(D&(B^C))) , 0x8f1bbcdc, A, B, C, D, E )
 #define T_60_79(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, (B^C^D) , 0xca62c1d6, A, B, C, D, E )
 
-static void hash__block(git_hash_ctx *ctx, const unsigned int *data)
+static void hash__block(unsigned int H[5], const unsigned int *data)
 {
 	unsigned int A,B,C,D,E;
 	unsigned int array[16];
 
-	A = ctx->H[0];
-	B = ctx->H[1];
-	C = ctx->H[2];
-	D = ctx->H[3];
-	E = ctx->H[4];
+	A = H[0];
+	B = H[1];
+	C = H[2];
+	D = H[3];
+	E = H[4];
 
 	/* Round 1 - iterations 0-16 take their input from 'data' */
 	T_0_15( 0, A, B, C, D, E);
@@ -214,13 +213,26 @@ static void hash__block(git_hash_ctx *ctx, const unsigned int *data)
 	T_60_79(78, C, D, E, A, B);
 	T_60_79(79, B, C, D, E, A);
 
-	ctx->H[0] += A;
-	ctx->H[1] += B;
-	ctx->H[2] += C;
-	ctx->H[3] += D;
-	ctx->H[4] += E;
+	H[0] += A;
+	H[1] += B;
+	H[2] += C;
+	H[3] += D;
+	H[4] += E;
 }
 
+void git_hash_generic__blocks(unsigned int H[5], const void *data, size_t blocks)
+{
+	for (; blocks; --blocks, data = (const char *)data + 64)
+		hash__block(H, data);
+}
+
+/* The x86 build picks a faster one for the CPU it runs on */
+#ifdef X86_SHA1
+# define hash__blocks git_hash_x86__blocks
+#else
+# define hash__blocks git_hash_generic__blocks
+#endif
+
 int git_hash_init(git_hash_ctx *ctx)
 {
 	ctx->size = 0;
@@ -252,12 +264,12 @@ int git_hash_update(git_hash_ctx *ctx, const void *data, size_t len)
 		data = ((const char *)data + left);
 		if (lenW)
 			return 0;
-		hash__block(ctx, ctx->W);
+		hash__blocks(ctx->H, ctx->W, 1);
 	}
-	while (len >= 64) {
-		hash__block(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		hash__blocks(ctx->H, data, len / 64);
+		data = ((const char *)data + (len & ~(size_t)63));
+		len &= 63;
 	}
 	if (len)
 		memcpy(ctx->W, data, len);
@@ -16,6 +16,8 @@ struct git_hash_ctx {
     unsigned int W[16];
 };
 
+void git_hash_generic__blocks(unsigned int H[5], const void *data, size_t blocks);
+
 #define git_hash_global_init() 0
 #define git_hash_global_shutdown() /* noop */
 #define git_hash_ctx_init(ctx) git_hash_init(ctx)
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+#include "hash.h"
+
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) || \
+	(defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+# define GIT_HASH_X86_SIMD
+#endif
+
+#ifdef GIT_HASH_X86_SIMD
+
+#ifdef _MSC_VER
+# include <intrin.h>
+# define GIT_HASH_TARGET(t)
+#else
+# include <cpuid.h>
+# define GIT_HASH_TARGET(t) __attribute__((target(t)))
+#endif
+#include <immintrin.h>
+
+static void cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int *)regs, (int)leaf, 0);
+#else
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned int cpuid_max(void)
+{
+	unsigned int regs[4];
+	cpuid(0, regs);
+	return regs[0];
+}
+
+static int has_ssse3(void)
+{
+	unsigned int regs[4];
+	cpuid(1, regs);
+	return (regs[2] & (1 << 9)) != 0;
+}
+
+static int has_sha(void)
+{
+	unsigned int regs[4];
+
+	if (cpuid_max() < 7)
+		return 0;
+
+	cpuid(1, regs);
+	if (!(regs[2] & (1 << 9)) || !(regs[2] & (1 << 19))) /* SSSE3, SSE4.1 */
+		return 0;
+
+	cpuid(7, regs);
+	return (regs[1] & (1 << 29)) != 0;
+}
+
+static unsigned int xgetbv0(void)
+{
+#ifdef _MSC_VER
+	return (unsigned int)_xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return eax;
+#endif
+}
+
+static int has_avx2(void)
+{
+	unsigned int regs[4];
+
+	if (cpuid_max() < 7)
+		return 0;
+
+	/* AVX, and the OS saving the YMM registers */
+	cpuid(1, regs);
+	if (!(regs[2] & (1 << 27)) || !(regs[2] & (1 << 28)) || (xgetbv0() & 6) != 6)
+		return 0;
+
+	cpuid(7, regs);
+	return (regs[1] & (1 << 5)) != 0;
+}
+
+/*
+ * Four rounds with the SHA extensions. `M0` holds the message words
+ * for them; the ones after it get their next words scheduled along
+ * the way, as long as there are rounds left to use them.
+ */
+#define SHANI_ROUNDS(g, EA, EB, M0, M1, M2, M3) do { \
+	EA = _mm_sha1nexte_epu32(EA, M0); \
+	EB = abcd; \
+	if ((g) >= 3 && (g) <= 18) M1 = _mm_sha1msg2_epu32(M1, M0); \
+	abcd = _mm_sha1rnds4_epu32(abcd, EA, (g) / 5); \
+	if ((g) >= 1 && (g) <= 16) M3 = _mm_sha1msg1_epu32(M3, M0); \
+	if ((g) >= 2 && (g) <= 17) M2 = _mm_xor_si128(M2, M0); } while (0)
+
+GIT_HASH_TARGET("sha,sse4.1,ssse3")
+static void blocks_sha(unsigned int H[5], const void *data, size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	const unsigned char *p = data;
+	__m128i abcd, e0, e1, abcd_save, e0_save, m0, m1, m2, m3;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)H), 0x1b);
+	e0 = _mm_set_epi32((int)H[4], 0, 0, 0);
+
+	for (; blocks; --blocks, p += 64) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 0)), bswap);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), bswap);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 32)), bswap);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 48)), bswap);
+
+		/* the first four rounds add E in, the others rotate it */
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		SHANI_ROUNDS( 1, e1, e0, m1, m2, m3, m0);
+		SHANI_ROUNDS( 2, e0, e1, m2, m3, m0, m1);
+		SHANI_ROUNDS( 3, e1, e0, m3, m0, m1, m2);
+		SHANI_ROUNDS( 4, e0, e1, m0, m1, m2, m3);
+		SHANI_ROUNDS( 5, e1, e0, m1, m2, m3, m0);
+		SHANI_ROUNDS( 6, e0, e1, m2, m3, m0, m1);
+		SHANI_ROUNDS( 7, e1, e0, m3, m0, m1, m2);
+		SHANI_ROUNDS( 8, e0, e1, m0, m1, m2, m3);
+		SHANI_ROUNDS( 9, e1, e0, m1, m2, m3, m0);
+		SHANI_ROUNDS(10, e0, e1, m2, m3, m0, m1);
+		SHANI_ROUNDS(11, e1, e0, m3, m0, m1, m2);
+		SHANI_ROUNDS(12, e0, e1, m0, m1, m2, m3);
+		SHANI_ROUNDS(13, e1, e0, m1, m2, m3, m0);
+		SHANI_ROUNDS(14, e0, e1, m2, m3, m0, m1);
+		SHANI_ROUNDS(15, e1, e0, m3, m0, m1, m2);
+		SHANI_ROUNDS(16, e0, e1, m0, m1, m2, m3);
+		SHANI_ROUNDS(17, e1, e0, m1, m2, m3, m0);
+		SHANI_ROUNDS(18, e0, e1, m2, m3, m0, m1);
+		SHANI_ROUNDS(19, e1, e0, m3, m0, m1, m2);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)H, _mm_shuffle_epi32(abcd, 0x1b));
+	H[4] = (unsigned int)_mm_extract_epi32(e0, 3);
+}
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define VROL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+#define ROUND(t, f, A, B, C, D, E) do { \
+	E += ROL(A, 5) + (f) + wk[t]; \
+	B = ROL(B, 30); } while (0)
+
+#define ROUNDS5(t, f) do { \
+	ROUND(t + 0, f(B, C, D), A, B, C, D, E); \
+	ROUND(t + 1, f(A, B, C), E, A, B, C, D); \
+	ROUND(t + 2, f(E, A, B), D, E, A, B, C); \
+	ROUND(t + 3, f(D, E, A), C, D, E, A, B); \
+	ROUND(t + 4, f(C, D, E), B, C, D, E, A); } while (0)
+
+#define F1(b, c, d) ((((c) ^ (d)) & (b)) ^ (d))
+#define F2(b, c, d) ((b) ^ (c) ^ (d))
+#define F3(b, c, d) (((b) & (c)) + ((d) & ((b) ^ (c))))
+
+/*
+ * The rounds are plain C, but the message schedule (with the round
+ * constants added) is worked out four words at a time beforehand.
+ */
+GIT_HASH_TARGET("ssse3")
+static void blocks_ssse3(unsigned int H[5], const void *data, size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	const unsigned char *p = data;
+	unsigned int wk[80], A, B, C, D, E;
+	__m128i w[20], k[4];
+	int i;
+
+	k[0] = _mm_set1_epi32(0x5a827999);
+	k[1] = _mm_set1_epi32(0x6ed9eba1);
+	k[2] = _mm_set1_epi32((int)0x8f1bbcdc);
+	k[3] = _mm_set1_epi32((int)0xca62c1d6);
+
+	for (; blocks; --blocks, p += 64) {
+		for (i = 0; i < 4; ++i)
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16 * i)), bswap);
+
+		/*
+		 * W[t] = rol(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16], 1); the last
+		 * of four words needs the first, so it's patched in after.
+		 */
+		for (i = 4; i < 8; ++i) {
+			__m128i v = _mm_xor_si128(
+				_mm_xor_si128(w[i - 4], _mm_alignr_epi8(w[i - 3], w[i - 4], 8)),
+				_mm_xor_si128(w[i - 2], _mm_srli_si128(w[i - 1], 4)));
+
+			v = VROL(v, 1);
+			w[i] = _mm_xor_si128(v, VROL(_mm_slli_si128(v, 12), 1));
+		}
+
+		/* from 32 on, W[t] = rol(W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32], 2) */
+		for (i = 8; i < 20; ++i) {
+			__m128i v = _mm_xor_si128(
+				_mm_xor_si128(_mm_alignr_epi8(w[i - 1], w[i - 2], 8), w[i - 4]),
+				_mm_xor_si128(w[i - 7], w[i - 8]));
+
+			w[i] = VROL(v, 2);
+		}
+
+		for (i = 0; i < 20; ++i)
+			_mm_storeu_si128((__m128i *)&wk[4 * i], _mm_add_epi32(w[i], k[i / 5]));
+
+		A = H[0];
+		B = H[1];
+		C = H[2];
+		D = H[3];
+		E = H[4];
+
+		ROUNDS5( 0, F1); ROUNDS5( 5, F1); ROUNDS5(10, F1); ROUNDS5(15, F1);
+		ROUNDS5(20, F2); ROUNDS5(25, F2); ROUNDS5(30, F2); ROUNDS5(35, F2);
+		ROUNDS5(40, F3); ROUNDS5(45, F3); ROUNDS5(50, F3); ROUNDS5(55, F3);
+		ROUNDS5(60, F2); ROUNDS5(65, F2); ROUNDS5(70, F2); ROUNDS5(75, F2);
+
+		H[0] += A;
+		H[1] += B;
+		H[2] += C;
+		H[3] += D;
+		H[4] += E;
+	}
+}
+
+#define LADD(a, b) _mm256_add_epi32(a, b)
+#define LXOR(a, b) _mm256_xor_si256(a, b)
+#define LAND(a, b) _mm256_and_si256(a, b)
+#define LROL(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+#define LF1(b, c, d) LXOR(LAND(LXOR(c, d), b), d)
+#define LF2(b, c, d) LXOR(LXOR(b, c), d)
+#define LF3(b, c, d) LADD(LAND(b, c), LAND(d, LXOR(b, c)))
+
+#define LROUND(t, f, A, B, C, D, E) do { \
+	if ((t) >= 16) \
+		w[(t) & 15] = LROL(LXOR(LXOR(w[((t) - 3) & 15], w[((t) - 8) & 15]), \
+			LXOR(w[((t) - 14) & 15], w[(t) & 15])), 1); \
+	E = LADD(LADD(E, LROL(A, 5)), LADD(f, LADD(w[(t) & 15], k))); \
+	B = LROL(B, 30); } while (0)
+
+#define LROUNDS5(t, f) do { \
+	LROUND(t + 0, f(B, C, D), A, B, C, D, E); \
+	LROUND(t + 1, f(A, B, C), E, A, B, C, D); \
+	LROUND(t + 2, f(E, A, B), D, E, A, B, C); \
+	LROUND(t + 3, f(D, E, A), C, D, E, A, B); \
+	LROUND(t + 4, f(C, D, E), B, C, D, E, A); } while (0)
+
+/*
+ * One block of each of eight messages, each message in a lane of the
+ * registers: H[i][j] is the i-th word of the j-th message's state.
+ */
+GIT_HASH_TARGET("avx2")
+static void lanes_avx2(unsigned int H[5][8], const unsigned char *const blocks[8])
+{
+	const __m256i bswap = _mm256_set_epi64x(
+		0x0c0d0e0f08090a0bLL, 0x0405060700010203LL,
+		0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+	__m256i w[16], r[8], t[8], A, B, C, D, E, k;
+	int half, i;
+
+	/* transpose the blocks, eight words at a time, so w[i] is word i of all */
+	for (half = 0; half < 2; ++half) {
+		for (i = 0; i < 8; ++i)
+			r[i] = _mm256_loadu_si256((const __m256i *)(blocks[i] + 32 * half));
+
+		for (i = 0; i < 8; i += 2) {
+			t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+			t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+		}
+
+		r[0] = _mm256_unpacklo_epi64(t[0], t[2]);
+		r[1] = _mm256_unpackhi_epi64(t[0], t[2]);
+		r[2] = _mm256_unpacklo_epi64(t[1], t[3]);
+		r[3] = _mm256_unpackhi_epi64(t[1], t[3]);
+		r[4] = _mm256_unpacklo_epi64(t[4], t[6]);
+		r[5] = _mm256_unpackhi_epi64(t[4], t[6]);
+		r[6] = _mm256_unpacklo_epi64(t[5], t[7]);
+		r[7] = _mm256_unpackhi_epi64(t[5], t[7]);
+
+		for (i = 0; i < 4; ++i) {
+			w[8 * half + i] = _mm256_shuffle_epi8(
+				_mm256_permute2x128_si256(r[i], r[i + 4], 0x20), bswap);
+			w[8 * half + i + 4] = _mm256_shuffle_epi8(
+				_mm256_permute2x128_si256(r[i], r[i + 4], 0x31), bswap);
+		}
+	}
+
+	A = _mm256_loadu_si256((const __m256i *)H[0]);
+	B = _mm256_loadu_si256((const __m256i *)H[1]);
+	C = _mm256_loadu_si256((const __m256i *)H[2]);
+	D = _mm256_loadu_si256((const __m256i *)H[3]);
+	E = _mm256_loadu_si256((const __m256i *)H[4]);
+
+	k = _mm256_set1_epi32(0x5a827999);
+	LROUNDS5( 0, LF1); LROUNDS5( 5, LF1); LROUNDS5(10, LF1); LROUNDS5(15, LF1);
+	k = _mm256_set1_epi32(0x6ed9eba1);
+	LROUNDS5(20, LF2); LROUNDS5(25, LF2); LROUNDS5(30, LF2); LROUNDS5(35, LF2);
+	k = _mm256_set1_epi32((int)0x8f1bbcdc);
+	LROUNDS5(40, LF3); LROUNDS5(45, LF3); LROUNDS5(50, LF3); LROUNDS5(55, LF3);
+	k = _mm256_set1_epi32((int)0xca62c1d6);
+	LROUNDS5(60, LF2); LROUNDS5(65, LF2); LROUNDS5(70, LF2); LROUNDS5(75, LF2);
+
+	_mm256_storeu_si256((__m256i *)H[0], LADD(A, _mm256_loadu_si256((const __m256i *)H[0])));
+	_mm256_storeu_si256((__m256i *)H[1], LADD(B, _mm256_loadu_si256((const __m256i *)H[1])));
+	_mm256_storeu_si256((__m256i *)H[2], LADD(C, _mm256_loadu_si256((const __m256i *)H[2])));
+	_mm256_storeu_si256((__m256i *)H[3], LADD(D, _mm256_loadu_si256((const __m256i *)H[3])));
+	_mm256_storeu_si256((__m256i *)H[4], LADD(E, _mm256_loadu_si256((const __m256i *)H[4])));
+}
+
+#endif /* GIT_HASH_X86_SIMD */
+
+static int always(void)
+{
+	return 1;
+}
+
+const git_hash_x86_impl git_hash_x86__impls[] = {
+#ifdef GIT_HASH_X86_SIMD
+	{ "sha", blocks_sha, has_sha },
+	{ "ssse3", blocks_ssse3, has_ssse3 },
+#endif
+	{ "generic", git_hash_generic__blocks, always },
+	{ NULL, NULL, NULL }
+};
+
+git_hash_blocks_fn git_hash_x86__blocks = git_hash_generic__blocks;
+
+int git_hash_x86__use(const char *name)
+{
+	const git_hash_x86_impl *impl;
+
+	for (impl = git_hash_x86__impls; impl->name; ++impl) {
+		if (name && strcmp(name, impl->name))
+			continue;
+
+		if (impl->supported()) {
+			git_hash_x86__blocks = impl->blocks;
+			return 0;
+		}
+
+		if (name)
+			break;
+	}
+
+	return GIT_ENOTFOUND;
+}
+
+git_hash_lanes_fn git_hash_x86__lanes = NULL;
+
+int git_hash_x86__use_lanes(int enable)
+{
+	git_hash_x86__lanes = NULL;
+
+	if (!enable)
+		return 0;
+
+#ifdef GIT_HASH_X86_SIMD
+	if (has_avx2()) {
+		git_hash_x86__lanes = lanes_avx2;
+		return 0;
+	}
+#endif
+
+	return GIT_ENOTFOUND;
+}
+
+int git_hash_x86__init(void)
+{
+	if (git_hash_x86__use(NULL) < 0)
+		return -1;
+
+	git_hash_x86__use_lanes(1);
+	return 0;
+}
+
+/*
+ * A message being fed into a lane: its pieces, where we are in them,
+ * and the block the padding (or a block split across pieces) is put
+ * together in.
+ */
+typedef struct {
+	const git_buf_vec *vec;
+	size_t parts, part, pos;
+	unsigned long long size;
+	enum { LANE_DATA, LANE_LENGTH, LANE_DONE, LANE_IDLE } state;
+	git_oid *out;
+	unsigned char block[64];
+} hash_lane;
+
+static void lane_length(hash_lane *lane)
+{
+	unsigned long long bits = lane->size << 3;
+	int i;
+
+	for (i = 0; i < 8; ++i)
+		lane->block[63 - i] = (unsigned char)(bits >> (8 * i));
+}
+
+static const unsigned char *lane_next(hash_lane *lane)
+{
+	size_t fill = 0, n;
+
+	if (lane->state == LANE_LENGTH) {
+		memset(lane->block, 0, 56);
+		lane_length(lane);
+		lane->state = LANE_DONE;
+		return lane->block;
+	}
+
+	while (lane->part < lane->parts && lane->pos == lane->vec[lane->part].len) {
+		lane->part++;
+		lane->pos = 0;
+	}
+
+	/* the common case, a whole block there to be read in place */
+	if (lane->part < lane->parts && lane->vec[lane->part].len - lane->pos >= 64) {
+		const unsigned char *p = (const unsigned char *)lane->vec[lane->part].data + lane->pos;
+		lane->pos += 64;
+		lane->size += 64;
+		return p;
+	}
+
+	while (fill < 64 && lane->part < lane->parts) {
+		n = lane->vec[lane->part].len - lane->pos;
+		if (n > 64 - fill)
+			n = 64 - fill;
+
+		memcpy(lane->block + fill, (const char *)lane->vec[lane->part].data + lane->pos, n);
+		fill += n;
+		lane->pos += n;
+
+		if (lane->pos == lane->vec[lane->part].len) {
+			lane->part++;
+			lane->pos = 0;
+		}
+	}
+
+	lane->size += fill;
+	if (fill == 64)
+		return lane->block;
+
+	lane->block[fill++] = 0x80;
+	memset(lane->block + fill, 0, 64 - fill);
+
+	if (fill <= 56) {
+		lane_length(lane);
+		lane->state = LANE_DONE;
+	} else {
+		lane->state = LANE_LENGTH;
+	}
+
+	return lane->block;
+}
+
+#define LANE_MAX_SIZE (16 * 1024)
+
+static size_t message_size(const git_buf_vec *vec, size_t parts)
+{
+	size_t i, size = 0;
+
+	for (i = 0; i < parts; ++i)
+		size += vec[i].len;
+
+	return size;
+}
+
+int git_hash_x86__vec_many(git_oid *out, git_buf_vec *vec, size_t parts, size_t n)
+{
+	static const unsigned char idle[64];
+	static const unsigned int init[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+	hash_lane lanes[8];
+	const unsigned char *blocks[8];
+	unsigned int H[5][8];
+	size_t next = 0, active = 0;
+	int i, j;
+
+	/* a lone message is quicker hashed by itself */
+	if (!git_hash_x86__lanes || n < 2)
+		return GIT_PASSTHROUGH;
+
+#ifdef GIT_HASH_X86_SIMD
+	/* and so are a few, with the SHA extensions, as most lanes would idle */
+	if (git_hash_x86__blocks == blocks_sha && n < 8)
+		return GIT_PASSTHROUGH;
+#endif
+
+	for (i = 0; i < 8; ++i)
+		lanes[i].state = LANE_IDLE;
+
+	for (;;) {
+		for (i = 0; i < 8; ++i) {
+			if (lanes[i].state == LANE_DONE) {
+				for (j = 0; j < 5; ++j) {
+					lanes[i].out->id[4 * j + 0] = (unsigned char)(H[j][i] >> 24);
+					lanes[i].out->id[4 * j + 1] = (unsigned char)(H[j][i] >> 16);
+					lanes[i].out->id[4 * j + 2] = (unsigned char)(H[j][i] >> 8);
+					lanes[i].out->id[4 * j + 3] = (unsigned char)(H[j][i]);
+				}
+				lanes[i].state = LANE_IDLE;
+				active--;
+			}
+
+			/* a big one would keep its lane busy long after the others */
+			while (lanes[i].state == LANE_IDLE && next < n &&
+				message_size(vec + next * parts, parts) > LANE_MAX_SIZE) {
+				if (git_hash_vec(out + next, vec + next * parts, parts) < 0)
+					return -1;
+				next++;
+			}
+
+			if (lanes[i].state == LANE_IDLE && next < n) {
+				memset(&lanes[i], 0, sizeof(lanes[i]));
+				lanes[i].vec = vec + next * parts;
+				lanes[i].parts = parts;
+				lanes[i].out = out + next++;
+				lanes[i].state = LANE_DATA;
+				for (j = 0; j < 5; ++j)
+					H[j][i] = init[j];
+				active++;
+			}
+		}
+
+		if (!active)
+			return 0;
+
+		for (i = 0; i < 8; ++i)
+			blocks[i] = lanes[i].state == LANE_IDLE ? idle : lane_next(&lanes[i]);
+
+		git_hash_x86__lanes(H, blocks);
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#ifndef INCLUDE_hash_x86_h__
+#define INCLUDE_hash_x86_h__
+
+#include "hash.h"
+
+/*
+ * hash_generic.c does the buffering and the padding, and hands the
+ * full blocks to whichever of the implementations in hash_x86.c the
+ * CPU supports; they're picked once, by git_hash_global_init.
+ */
+struct git_hash_ctx {
+    unsigned long long size;
+    unsigned int H[5];
+    unsigned int W[16];
+};
+
+typedef void (*git_hash_blocks_fn)(
+	unsigned int H[5], const void *data, size_t blocks);
+
+typedef struct {
+	const char *name;
+	git_hash_blocks_fn blocks;
+	int (*supported)(void);
+} git_hash_x86_impl;
+
+/* Fastest first, ending in the portable one and a NULL name */
+extern const git_hash_x86_impl git_hash_x86__impls[];
+
+extern git_hash_blocks_fn git_hash_x86__blocks;
+
+void git_hash_generic__blocks(unsigned int H[5], const void *data, size_t blocks);
+
+/*
+ * Use the implementation called `name`, or the fastest one this CPU
+ * has if it's NULL. Returns GIT_ENOTFOUND, without setting an error,
+ * if there's no such implementation or the CPU can't run it.
+ */
+int git_hash_x86__use(const char *name);
+
+/*
+ * Hashing batches of objects, eight of them go side by side through
+ * the lanes of the AVX2 registers, a block of each at a time; a lane
+ * is given the next object as soon as it's done with one.
+ */
+typedef void (*git_hash_lanes_fn)(
+	unsigned int H[5][8], const unsigned char *const blocks[8]);
+
+extern git_hash_lanes_fn git_hash_x86__lanes;
+
+/*
+ * Hash batches in lanes if `enable` is set, or one object after the
+ * other. Returns GIT_ENOTFOUND, without setting an error, if the CPU
+ * has no AVX2.
+ */
+int git_hash_x86__use_lanes(int enable);
+
+/* git_hash_vec_many, or GIT_PASSTHROUGH if there are no lanes to use */
+int git_hash_x86__vec_many(git_oid *out, git_buf_vec *vec, size_t parts, size_t n);
+
+int git_hash_x86__init(void);
+
+#define git_hash_global_init() git_hash_x86__init()
+#define git_hash_global_shutdown() /* noop */
+#define git_hash_ctx_init(ctx) git_hash_init(ctx)
+#define git_hash_ctx_cleanup(ctx)
+
+#endif /* INCLUDE_hash_x86_h__ */
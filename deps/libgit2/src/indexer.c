@@ -82,6 +82,7 @@ static int open_pack(struct git_pack_file **out, const char *filename)
 	pack = git__calloc(1, sizeof(struct git_pack_file) + namelen + 1);
 	GITERR_CHECK_ALLOC(pack);
 
+	git_mutex_init(&pack->mwf.lock);
 	memcpy(pack->pack_name, filename, namelen + 1);
 
 	if (p_stat(filename, &st) < 0) {
@@ -101,6 +102,7 @@ static int open_pack(struct git_pack_file **out, const char *filename)
 	return 0;
 
 cleanup:
+	git_mutex_free(&pack->mwf.lock);
 	git__free(pack);
 	return -1;
 }
@@ -336,10 +338,10 @@ on_error:
 	return -1;
 }
 
-static int hash_and_save(git_indexer_stream *idx, git_rawobj *obj, git_off_t entry_start)
+static int save_entry(
+	git_indexer_stream *idx, const git_oid *oid, git_off_t entry_start, git_off_t entry_end)
 {
 	int i;
-	git_oid oid;
 	size_t entry_size;
 	struct entry *entry;
 	struct git_pack_entry *pentry;
@@ -354,26 +356,20 @@ static int hash_and_save(git_indexer_stream *idx, git_rawobj *obj, git_off_t ent
 		entry->offset = (uint32_t)entry_start;
 	}
 
-	/* FIXME: Parse the object instead of hashing it */
-	if (git_odb__hashobj(&oid, obj) < 0) {
-		giterr_set(GITERR_INDEXER, "Failed to hash object");
-		return -1;
-	}
-
 	pentry = git__malloc(sizeof(struct git_pack_entry));
 	GITERR_CHECK_ALLOC(pentry);
 
-	git_oid_cpy(&pentry->sha1, &oid);
+	git_oid_cpy(&pentry->sha1, oid);
 	pentry->offset = entry_start;
 	if (git_vector_insert(&idx->pack->cache, pentry) < 0) {
 		git__free(pentry);
 		goto on_error;
 	}
 
-	git_oid_cpy(&entry->oid, &oid);
+	git_oid_cpy(&entry->oid, oid);
 	entry->crc = crc32(0L, Z_NULL, 0);
 
-	entry_size = (size_t)(idx->off - entry_start);
+	entry_size = (size_t)(entry_end - entry_start);
 	if (crc_object(&entry->crc, &idx->pack->mwf, entry_start, entry_size) < 0)
 		goto on_error;
 
@@ -381,7 +377,7 @@ static int hash_and_save(git_indexer_stream *idx, git_rawobj *obj, git_off_t ent
 	if (git_vector_insert(&idx->objects, entry) < 0)
 		goto on_error;
 
-	for (i = oid.id[0]; i < 256; ++i) {
+	for (i = oid->id[0]; i < 256; ++i) {
 		idx->fanout[i]++;
 	}
 
@@ -389,7 +385,6 @@ static int hash_and_save(git_indexer_stream *idx, git_rawobj *obj, git_off_t ent
 
 on_error:
 	git__free(entry);
-	git__free(obj->data);
 	return -1;
 }
 
@@ -570,26 +565,100 @@ static int index_path_stream(git_buf *path, git_indexer_stream *idx, const char
 	return git_buf_oom(path) ? -1 : 0;
 }
 
+/* Resolved deltas wait in here to be hashed together */
+#define DELTA_BATCH_SIZE 8
+
+struct delta_batch {
+	git_rawobj objs[DELTA_BATCH_SIZE];
+	git_off_t start[DELTA_BATCH_SIZE];
+	git_off_t end[DELTA_BATCH_SIZE];
+	size_t n;
+};
+
+static void delta_batch_clear(struct delta_batch *batch)
+{
+	size_t i;
+
+	for (i = 0; i < batch->n; ++i)
+		git__free(batch->objs[i].data);
+
+	batch->n = 0;
+}
+
+static int delta_batch_save(
+	git_indexer_stream *idx, struct delta_batch *batch, git_transfer_progress *stats)
+{
+	git_oid ids[DELTA_BATCH_SIZE];
+	size_t i;
+	int error = 0;
+
+	/* FIXME: Parse the objects instead of hashing them */
+	if (git_odb__hashobj_many(ids, batch->objs, batch->n) < 0) {
+		giterr_set(GITERR_INDEXER, "Failed to hash object");
+		error = -1;
+	}
+
+	for (i = 0; i < batch->n && !error; ++i) {
+		if ((error = save_entry(idx, &ids[i], batch->start[i], batch->end[i])) < 0)
+			break;
+
+		stats->indexed_objects++;
+		do_progress_callback(idx, stats);
+	}
+
+	delta_batch_clear(batch);
+	return error;
+}
+
+/*
+ * A ref delta's base is found by its id, so the deltas resolved before
+ * it must have theirs in the pack's cache already.
+ */
+static int is_ref_delta(git_indexer_stream *idx, git_off_t off)
+{
+	git_mwindow *w = NULL;
+	git_otype type;
+	size_t size;
+	int error;
+
+	error = git_packfile_unpack_header(&size, &type, &idx->pack->mwf, &w, &off);
+	git_mwindow_close(&w);
+
+	return error < 0 || type == GIT_OBJ_REF_DELTA;
+}
+
 static int resolve_deltas(git_indexer_stream *idx, git_transfer_progress *stats)
 {
 	unsigned int i;
 	struct delta_info *delta;
+	struct delta_batch batch;
+
+	batch.n = 0;
 
 	git_vector_foreach(&idx->deltas, i, delta) {
-		git_rawobj obj;
+		git_rawobj *obj;
 
-		idx->off = delta->delta_off;
-		if (git_packfile_unpack(&obj, idx->pack, &idx->off) < 0)
+		if (batch.n > 0 && is_ref_delta(idx, delta->delta_off) &&
+			delta_batch_save(idx, &batch, stats) < 0)
 			return -1;
 
-		if (hash_and_save(idx, &obj, delta->delta_off) < 0)
+		obj = &batch.objs[batch.n];
+		idx->off = delta->delta_off;
+		if (git_packfile_unpack(obj, idx->pack, &idx->off) < 0) {
+			delta_batch_clear(&batch);
 			return -1;
+		}
 
-		git__free(obj.data);
-		stats->indexed_objects++;
-		do_progress_callback(idx, stats);
+		batch.start[batch.n] = delta->delta_off;
+		batch.end[batch.n] = idx->off;
+
+		if (++batch.n == DELTA_BATCH_SIZE && delta_batch_save(idx, &batch, stats) < 0)
+			return -1;
 	}
 
+	if (batch.n > 0 && delta_batch_save(idx, &batch, stats) < 0)
+		return -1;
+
 	return 0;
 }
 
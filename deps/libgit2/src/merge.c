@@ -51,11 +51,11 @@ cleanup:
 int git_merge_base_many(git_oid *out, git_repository *repo, const git_oid input_array[], size_t length)
 {
 	git_revwalk *walk;
-	git_vector list;
-	git_commit_list *result = NULL;
+	git_commit_stack list = GIT_COMMIT_STACK_INIT;
+	git_commit_stack result = GIT_COMMIT_STACK_INIT;
 	int error = -1;
 	unsigned int i;
-	git_commit_list_node *commit;
+	git_commit_idx commit;
 
 	assert(out && repo && input_array);
 
@@ -64,182 +64,186 @@ int git_merge_base_many(git_oid *out, git_repository *repo, const git_oid input_
 		return -1;
 	}
 
-	if (git_vector_init(&list, length - 1, NULL) < 0)
-		return -1;
-
 	if (git_revwalk_new(&walk, repo) < 0)
-		goto cleanup;
+		return -1;
 
 	for (i = 1; i < length; i++) {
-		commit = git_revwalk__commit_lookup(walk, &input_array[i]);
-		if (commit == NULL)
+		if (git_revwalk__commit_lookup(&commit, walk, &input_array[i]) < 0 ||
+			git_commit_stack_push(&list, commit) < 0)
 			goto cleanup;
-
-		git_vector_insert(&list, commit);
 	}
 
-	commit = git_revwalk__commit_lookup(walk, &input_array[0]);
-	if (commit == NULL)
+	if (git_revwalk__commit_lookup(&commit, walk, &input_array[0]) < 0)
 		goto cleanup;
 
 	if (git_merge__bases_many(&result, walk, commit, &list) < 0)
 		goto cleanup;
 
-	if (!result) {
+	if (!result.length) {
 		error = GIT_ENOTFOUND;
 		goto cleanup;
 	}
 
-	git_oid_cpy(out, &result->item->oid);
+	git_oid_cpy(out, &walk->commits.oids[result.ids[0]]);
 
 	error = 0;
 
 cleanup:
-	git_commit_list_free(&result);
+	git_commit_stack_free(&result);
+	git_commit_stack_free(&list);
 	git_revwalk_free(walk);
-	git_vector_free(&list);
 	return error;
 }
 
 int git_merge_base(git_oid *out, git_repository *repo, const git_oid *one, const git_oid *two)
 {
 	git_revwalk *walk;
-	git_vector list;
-	git_commit_list *result = NULL;
-	git_commit_list_node *commit;
-	void *contents[1];
+	git_commit_stack list, result = GIT_COMMIT_STACK_INIT;
+	git_commit_idx commit, contents[1];
 
 	if (git_revwalk_new(&walk, repo) < 0)
 		return -1;
 
-	commit = git_revwalk__commit_lookup(walk, two);
-	if (commit == NULL)
+	if (git_revwalk__commit_lookup(&contents[0], walk, two) < 0)
 		goto on_error;
 
 	/* This is just one value, so we can do it on the stack */
-	memset(&list, 0x0, sizeof(git_vector));
-	contents[0] = commit;
-	list.length = 1;
-	list.contents = contents;
+	list.ids = contents;
+	list.length = list.alloc = 1;
 
-	commit = git_revwalk__commit_lookup(walk, one);
-	if (commit == NULL)
+	if (git_revwalk__commit_lookup(&commit, walk, one) < 0)
 		goto on_error;
 
 	if (git_merge__bases_many(&result, walk, commit, &list) < 0)
 		goto on_error;
 
-	if (!result) {
+	if (!result.length) {
 		git_revwalk_free(walk);
 		giterr_clear();
 		return GIT_ENOTFOUND;
 	}
 
-	git_oid_cpy(out, &result->item->oid);
-	git_commit_list_free(&result);
+	git_oid_cpy(out, &walk->commits.oids[result.ids[0]]);
+	git_commit_stack_free(&result);
 	git_revwalk_free(walk);
 
 	return 0;
 
 on_error:
+	git_commit_stack_free(&result);
 	git_revwalk_free(walk);
 	return -1;
 }
 
-static int interesting(git_pqueue *list)
+/*
+ * Painting goes on as long as there are non-STALE commits. Once the
+ * commits come out by generation rather than by date, all of a commit's
+ * descendants have been painted before it is, so a new merge base can
+ * only turn up while there are non-STALE commits on both sides.
+ */
+static int interesting(git_commit_queue *list)
 {
-	unsigned int i;
+	const git_commit_table *t = list->table;
+	git_commit_idx top = git_commit_queue_peek(list);
+	size_t i;
+	int flags = 0;
+
 	/* element 0 isn't used - we need to start at 1 */
 	for (i = 1; i < list->size; i++) {
-		git_commit_list_node *commit = list->d[i];
-		if ((commit->flags & STALE) == 0)
-			return 1;
+		uint16_t f = t->flags[list->d[i]];
+		if ((f & STALE) == 0)
+			flags |= f & (PARENT1 | PARENT2);
 	}
 
-	return 0;
+	if (flags == 0)
+		return 0;
+
+	/* generations past the maximum aren't strictly ordered any more */
+	if (t->generations[top] >= GIT_COMMIT_GRAPH_GENERATION_MAX)
+		return 1;
+
+	return flags == (PARENT1 | PARENT2);
 }
 
-int git_merge__bases_many(git_commit_list **out, git_revwalk *walk, git_commit_list_node *one, git_vector *twos)
+int git_merge__bases_many(git_commit_stack *out, git_revwalk *walk, git_commit_idx one, git_commit_stack *twos)
 {
-	int error;
-	unsigned int i;
-	git_commit_list_node *two;
-	git_commit_list *result = NULL, *tmp = NULL;
-	git_pqueue list;
+	git_commit_table *t = &walk->commits;
+	git_commit_stack result = GIT_COMMIT_STACK_INIT;
+	git_commit_queue list;
+	size_t i;
+	int error = -1;
 
 	/* if the commit is repeated, we have a our merge base already */
-	git_vector_foreach(twos, i, two) {
-		if (one == two)
-			return git_commit_list_insert(one, out) ? 0 : -1;
+	for (i = 0; i < twos->length; i++) {
+		if (one == twos->ids[i])
+			return git_commit_stack_push(out, one);
 	}
 
-	if (git_pqueue_init(&list, twos->length * 2, git_commit_list_time_cmp) < 0)
+	if (git_commit_queue_init(&list, t, git_commit_list_generation_cmp) < 0)
 		return -1;
 
-	if (git_commit_list_parse(walk, one) < 0)
-	    return -1;
+	if (git_commit_list_generation(walk, one) < 0)
+		goto cleanup;
 
-	one->flags |= PARENT1;
-	if (git_pqueue_insert(&list, one) < 0)
-		return -1;
+	t->flags[one] |= PARENT1;
+	if (git_commit_queue_insert(&list, one) < 0)
+		goto cleanup;
 
-	git_vector_foreach(twos, i, two) {
-		git_commit_list_parse(walk, two);
-		two->flags |= PARENT2;
-		if (git_pqueue_insert(&list, two) < 0)
-			return -1;
+	for (i = 0; i < twos->length; i++) {
+		git_commit_idx two = twos->ids[i];
+
+		if (git_commit_list_generation(walk, two) < 0)
+			goto cleanup;
+		t->flags[two] |= PARENT2;
+		if (git_commit_queue_insert(&list, two) < 0)
+			goto cleanup;
 	}
 
 	/* as long as there are non-STALE commits */
 	while (interesting(&list)) {
-		git_commit_list_node *commit;
+		git_commit_idx commit = git_commit_queue_pop(&list);
 		int flags;
 
-		commit = git_pqueue_pop(&list);
-
-		flags = commit->flags & (PARENT1 | PARENT2 | STALE);
+		flags = t->flags[commit] & (PARENT1 | PARENT2 | STALE);
 		if (flags == (PARENT1 | PARENT2)) {
-			if (!(commit->flags & RESULT)) {
-				commit->flags |= RESULT;
-				if (git_commit_list_insert(commit, &result) == NULL)
-					return -1;
+			if (!(t->flags[commit] & RESULT)) {
+				t->flags[commit] |= RESULT;
+				if (git_commit_stack_push(&result, commit) < 0)
+					goto cleanup;
 			}
 			/* we mark the parents of a merge stale */
 			flags |= STALE;
 		}
 
-		for (i = 0; i < commit->out_degree; i++) {
-			git_commit_list_node *p = commit->parents[i];
-			if ((p->flags & flags) == flags)
+		for (i = 0; i < t->parent_count[commit]; i++) {
+			git_commit_idx p = git_commit_table_parents(t, commit)[i];
+			if ((t->flags[p] & flags) == flags)
 				continue;
 
-			if ((error = git_commit_list_parse(walk, p)) < 0)
-				return error;
+			if (git_commit_list_generation(walk, p) < 0)
+				goto cleanup;
 
-			p->flags |= flags;
-			if (git_pqueue_insert(&list, p) < 0)
-				return -1;
+			t->flags[p] |= flags;
+			if (git_commit_queue_insert(&list, p) < 0)
+				goto cleanup;
 		}
 	}
 
-	git_pqueue_free(&list);
-
-	/* filter out any stale commits in the results */
-	tmp = result;
-	result = NULL;
+	/* filter out any stale commits in the results, the last found first */
+	while (result.length > 0) {
+		git_commit_idx commit = git_commit_stack_pop(&result);
 
-	while (tmp) {
-		struct git_commit_list *next = tmp->next;
-		if (!(tmp->item->flags & STALE))
-			if (git_commit_list_insert_by_date(tmp->item, &result) == NULL)
-				return -1;
-
-		git__free(tmp);
-		tmp = next;
+		if (!(t->flags[commit] & STALE) &&
+			git_commit_stack_push(out, commit) < 0)
+			goto cleanup;
 	}
 
-	*out = result;
-	return 0;
+	error = 0;
+
+cleanup:
+	git_commit_queue_free(&list);
+	git_commit_stack_free(&result);
+	return error;
 }
 
 int git_repository_mergehead_foreach(git_repository *repo,
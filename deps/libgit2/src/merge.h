@@ -10,13 +10,16 @@
 #include "git2/types.h"
 #include "git2/merge.h"
 #include "commit_list.h"
-#include "vector.h"
 
 #define GIT_MERGE_MSG_FILE		"MERGE_MSG"
 #define GIT_MERGE_MODE_FILE		"MERGE_MODE"
 
 #define MERGE_CONFIG_FILE_MODE	0666
 
-int git_merge__bases_many(git_commit_list **out, git_revwalk *walk, git_commit_list_node *one, git_vector *twos);
+/*
+ * Find the merge bases of `one` and `twos`. They're pushed onto `out`
+ * newest first, so `out->ids[0]` is the best one.
+ */
+int git_merge__bases_many(git_commit_stack *out, git_revwalk *walk, git_commit_idx one, git_commit_stack *twos);
 
 #endif
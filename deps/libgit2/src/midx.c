@@ -0,0 +1,636 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+#include "midx.h"
+#include "pack.h"
+#include "odb.h"
+#include "fileops.h"
+#include "filebuf.h"
+#include "sha1_lookup.h"
+
+/*
+ * File layout (all integers in network order):
+ *
+ *	header:	"MIDX", version (1), oid version (1), number of chunks,
+ *		number of base files (0), number of packs
+ *	chunk table: (id, 64-bit offset) for each chunk, then a zero id
+ *		with the offset of the end of the last chunk
+ *	PNAM:	the sorted, NUL terminated ".idx" names of the packs
+ *	OIDF:	256 entry fanout table
+ *	OIDL:	the sorted object ids
+ *	OOFF:	(pack index, 32-bit offset) for each object; when the high
+ *		bit of the offset is set and there is a LOFF chunk, the rest
+ *		of it indexes into LOFF
+ *	LOFF:	64-bit offsets
+ *	trailer: SHA-1 of everything above
+ */
+
+#define MIDX_SIGNATURE 0x4d494458 /* "MIDX" */
+#define MIDX_VERSION 1
+#define MIDX_OID_VERSION 1 /* SHA-1 */
+#define MIDX_HEADER_SIZE 12
+#define MIDX_CHUNK_TABLE_ENTRY 12
+#define MIDX_CHUNK_ALIGNMENT 4
+
+#define MIDX_CHUNK_PNAM 0x504e414d
+#define MIDX_CHUNK_OIDF 0x4f494446
+#define MIDX_CHUNK_OIDL 0x4f49444c
+#define MIDX_CHUNK_OOFF 0x4f4f4646
+#define MIDX_CHUNK_LOFF 0x4c4f4646
+
+#define MIDX_LARGE_OFFSET 0x80000000
+
+struct midx_chunk {
+	size_t offset, length;
+};
+
+static int midx_error(const char *message)
+{
+	giterr_set(GITERR_ODB, "Invalid multi-pack-index file - %s", message);
+	return -1;
+}
+
+GIT_INLINE(uint32_t) get_be32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+GIT_INLINE(uint64_t) get_be64(const unsigned char *p)
+{
+	return ((uint64_t)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+static int midx_parse_packfile_names(
+	git_midx_file *idx,
+	const unsigned char *data,
+	uint32_t packfiles,
+	struct midx_chunk *chunk)
+{
+	const char *name = (const char *)(data + chunk->offset);
+	const char *end = name + chunk->length;
+	const char *prev = NULL;
+	uint32_t i;
+
+	if (git_vector_init(&idx->packfile_names, packfiles, NULL) < 0)
+		return -1;
+
+	for (i = 0; i < packfiles; ++i) {
+		const char *nul = memchr(name, '\0', end - name);
+		size_t len;
+
+		if (nul == NULL)
+			return midx_error("unterminated packfile name");
+
+		len = nul - name;
+		if (len <= strlen(".idx") || git__suffixcmp(name, ".idx") != 0)
+			return midx_error("unexpected packfile name");
+		if (prev && strcmp(prev, name) >= 0)
+			return midx_error("packfile names are not sorted");
+
+		if (git_vector_insert(&idx->packfile_names, (char *)name) < 0)
+			return -1;
+
+		prev = name;
+		name += len + 1;
+	}
+
+	return 0;
+}
+
+static int midx_parse_oid_fanout(
+	git_midx_file *idx,
+	const unsigned char *data,
+	struct midx_chunk *chunk)
+{
+	uint32_t i, nr = 0;
+
+	if (chunk->length != 256 * 4)
+		return midx_error("OID fanout chunk has wrong length");
+
+	idx->oid_fanout = (const uint32_t *)(data + chunk->offset);
+
+	for (i = 0; i < 256; ++i) {
+		uint32_t n = ntohl(idx->oid_fanout[i]);
+		if (n < nr)
+			return midx_error("index is non-monotonic");
+		nr = n;
+	}
+
+	idx->num_objects = nr;
+	return 0;
+}
+
+static int midx_parse(git_midx_file *idx, const unsigned char *data, size_t size)
+{
+	struct midx_chunk pnam = {0}, oidf = {0}, oidl = {0}, ooff = {0}, loff = {0};
+	struct midx_chunk *chunk = NULL;
+	const unsigned char *entry;
+	uint32_t packfiles, i;
+	size_t chunks, last_offset;
+
+	if (size < MIDX_HEADER_SIZE + MIDX_CHUNK_TABLE_ENTRY + GIT_OID_RAWSZ)
+		return midx_error("file is too short");
+
+	if (get_be32(data) != MIDX_SIGNATURE ||
+		data[4] != MIDX_VERSION || data[5] != MIDX_OID_VERSION)
+		return midx_error("unsupported signature or version");
+
+	/* chained multi-pack-indexes are not supported */
+	if (data[7] != 0)
+		return midx_error("unsupported base files");
+
+	chunks = data[6];
+	packfiles = get_be32(data + 8);
+
+	if (size < MIDX_HEADER_SIZE + (chunks + 1) * MIDX_CHUNK_TABLE_ENTRY + GIT_OID_RAWSZ)
+		return midx_error("wrong chunk table size");
+
+	last_offset = MIDX_HEADER_SIZE + (chunks + 1) * MIDX_CHUNK_TABLE_ENTRY;
+	entry = data + MIDX_HEADER_SIZE;
+
+	for (i = 0; i <= chunks; ++i, entry += MIDX_CHUNK_TABLE_ENTRY) {
+		uint64_t offset = get_be64(entry + 4);
+
+		if (offset < last_offset || offset > size - GIT_OID_RAWSZ)
+			return midx_error("chunks are not ordered or out of bounds");
+
+		if (chunk)
+			chunk->length = (size_t)offset - chunk->offset;
+
+		if (i == chunks)
+			break;
+
+		switch (get_be32(entry)) {
+		case MIDX_CHUNK_PNAM: chunk = &pnam; break;
+		case MIDX_CHUNK_OIDF: chunk = &oidf; break;
+		case MIDX_CHUNK_OIDL: chunk = &oidl; break;
+		case MIDX_CHUNK_OOFF: chunk = &ooff; break;
+		case MIDX_CHUNK_LOFF: chunk = &loff; break;
+		default: chunk = NULL; break; /* unknown chunks are skipped */
+		}
+
+		if (chunk)
+			chunk->offset = (size_t)offset;
+		last_offset = (size_t)offset;
+	}
+
+	if (!pnam.offset || !oidf.offset || !oidl.offset || !ooff.offset)
+		return midx_error("missing required chunks");
+
+	if (midx_parse_packfile_names(idx, data, packfiles, &pnam) < 0 ||
+		midx_parse_oid_fanout(idx, data, &oidf) < 0)
+		return -1;
+
+	if (oidl.length != (size_t)idx->num_objects * GIT_OID_RAWSZ)
+		return midx_error("OID lookup chunk has wrong length");
+	if (ooff.length != (size_t)idx->num_objects * 8)
+		return midx_error("object offsets chunk has wrong length");
+	if (loff.length % 8 != 0)
+		return midx_error("large offsets chunk has wrong length");
+
+	idx->oid_lookup = (const git_oid *)(data + oidl.offset);
+	idx->object_offsets = data + ooff.offset;
+	idx->object_large_offsets = loff.offset ? data + loff.offset : NULL;
+	idx->num_object_large_offsets = loff.length / 8;
+
+	git_oid_fromraw(&idx->checksum, data + size - GIT_OID_RAWSZ);
+	return 0;
+}
+
+int git_midx_open(git_midx_file **idx_out, const char *path)
+{
+	git_midx_file *idx;
+	git_file fd;
+	struct stat st;
+	int error;
+
+	*idx_out = NULL;
+
+	if ((fd = git_futils_open_ro(path)) < 0)
+		return fd;
+
+	if (p_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+		!git__is_sizet(st.st_size)) {
+		p_close(fd);
+		giterr_set(GITERR_OS, "Failed to check multi-pack-index");
+		return -1;
+	}
+
+	idx = git__calloc(1, sizeof(git_midx_file));
+	if (idx == NULL) {
+		p_close(fd);
+		return -1;
+	}
+
+	error = git_futils_mmap_ro(&idx->index_map, fd, 0, (size_t)st.st_size);
+	p_close(fd);
+
+	if (error < 0) {
+		git__free(idx);
+		return error;
+	}
+
+	if (midx_parse(idx, idx->index_map.data, idx->index_map.len) < 0) {
+		git_midx_free(idx);
+		return -1;
+	}
+
+	*idx_out = idx;
+	return 0;
+}
+
+bool git_midx_needs_refresh(const git_midx_file *idx, const char *path)
+{
+	git_file fd;
+	struct stat st;
+	git_oid checksum;
+	ssize_t nread;
+
+	/* TODO: properly open the file without access time using O_NOATIME */
+	if ((fd = git_futils_open_ro(path)) < 0) {
+		giterr_clear();
+		return true;
+	}
+
+	if (p_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+		(size_t)st.st_size != idx->index_map.len ||
+		p_lseek(fd, -GIT_OID_RAWSZ, SEEK_END) < 0) {
+		p_close(fd);
+		return true;
+	}
+
+	nread = p_read(fd, checksum.id, GIT_OID_RAWSZ);
+	p_close(fd);
+
+	return nread != GIT_OID_RAWSZ || git_oid_cmp(&checksum, &idx->checksum) != 0;
+}
+
+void git_midx_free(git_midx_file *idx)
+{
+	if (idx == NULL)
+		return;
+
+	git_vector_free(&idx->packfile_names);
+	git_futils_mmap_free(&idx->index_map);
+	git__free(idx);
+}
+
+static git_off_t midx_object_offset(git_midx_file *idx, uint32_t pos, size_t *pack_index)
+{
+	const unsigned char *entry = idx->object_offsets + (size_t)pos * 8;
+	uint32_t offset = get_be32(entry + 4);
+
+	*pack_index = get_be32(entry);
+
+	if (idx->object_large_offsets && (offset & MIDX_LARGE_OFFSET)) {
+		size_t large = offset & ~MIDX_LARGE_OFFSET;
+
+		if (large >= idx->num_object_large_offsets)
+			return -1;
+
+		return (git_off_t)get_be64(idx->object_large_offsets + large * 8);
+	}
+
+	return offset;
+}
+
+int git_midx_entry_find(
+	git_midx_entry *e,
+	git_midx_file *idx,
+	const git_oid *short_oid,
+	size_t len)
+{
+	int pos, found = 0;
+	unsigned hi, lo;
+	const git_oid *current = NULL;
+	git_off_t offset;
+	size_t pack_index;
+
+	hi = ntohl(idx->oid_fanout[(int)short_oid->id[0]]);
+	lo = ((short_oid->id[0] == 0x0) ? 0 : ntohl(idx->oid_fanout[(int)short_oid->id[0] - 1]));
+
+	pos = sha1_entry_pos(idx->oid_lookup, GIT_OID_RAWSZ, 0, lo, hi, idx->num_objects, short_oid->id);
+
+	if (pos >= 0) {
+		/* An object matching exactly the oid was found */
+		found = 1;
+		current = idx->oid_lookup + pos;
+	} else {
+		/* No object was found */
+		/* pos refers to the object with the "closest" oid to short_oid */
+		pos = -1 - pos;
+		if (pos < (int)idx->num_objects) {
+			current = idx->oid_lookup + pos;
+
+			if (!git_oid_ncmp(short_oid, current, len))
+				found = 1;
+		}
+	}
+
+	if (found && len != GIT_OID_HEXSZ && pos + 1 < (int)idx->num_objects) {
+		/* Check for ambiguousity */
+		const git_oid *next = current + 1;
+
+		if (!git_oid_ncmp(short_oid, next, len))
+			found = 2;
+	}
+
+	if (!found)
+		return git_odb__error_notfound("failed to find offset for multi-pack index entry", short_oid);
+	if (found > 1)
+		return git_odb__error_ambiguous("found multiple offsets for multi-pack index entry");
+
+	offset = midx_object_offset(idx, pos, &pack_index);
+	if (offset < 0 || pack_index >= idx->packfile_names.length)
+		return midx_error("object points outside of the index");
+
+	e->offset = offset;
+	e->pack_index = pack_index;
+	git_oid_cpy(&e->sha1, current);
+	return 0;
+}
+
+void git_midx_exists_many(
+	unsigned char *found,
+	git_midx_file *idx,
+	const git_oid *ids,
+	size_t count)
+{
+	sha1_entry_pos_many(found, ids->id, count,
+		idx->oid_fanout, idx->oid_lookup, GIT_OID_RAWSZ, 0);
+}
+
+/*
+ * Writing
+ */
+
+struct midx_write_pack {
+	struct git_pack_file *p;
+	char *idx_name;
+};
+
+struct midx_write_entry {
+	git_oid oid;
+	git_off_t offset;
+	uint32_t pack_index;
+	git_time_t mtime;
+};
+
+struct midx_write_ctx {
+	struct midx_write_entry *entries;
+	size_t count, alloc;
+	uint32_t pack_index;
+	git_time_t mtime;
+};
+
+static int midx_write_pack_cmp(const void *a_, const void *b_)
+{
+	const struct midx_write_pack *a = a_, *b = b_;
+	return strcmp(a->idx_name, b->idx_name);
+}
+
+/* By id; for the same object, the newest pack's copy comes first */
+static int midx_write_entry_cmp(const void *a_, const void *b_)
+{
+	const struct midx_write_entry *a = a_, *b = b_;
+	int cmp = git_oid_cmp(&a->oid, &b->oid);
+
+	if (cmp)
+		return cmp;
+	if (a->mtime != b->mtime)
+		return a->mtime > b->mtime ? -1 : 1;
+
+	return (int)a->pack_index - (int)b->pack_index;
+}
+
+static int midx_collect_cb(const git_oid *oid, git_off_t offset, void *payload)
+{
+	struct midx_write_ctx *ctx = payload;
+	struct midx_write_entry *entry;
+
+	if (ctx->count == ctx->alloc) {
+		size_t alloc = ctx->alloc ? ctx->alloc * 2 : 1024;
+		void *grown = git__realloc(ctx->entries, alloc * sizeof(struct midx_write_entry));
+
+		GITERR_CHECK_ALLOC(grown);
+		ctx->entries = grown;
+		ctx->alloc = alloc;
+	}
+
+	entry = &ctx->entries[ctx->count++];
+	git_oid_cpy(&entry->oid, oid);
+	entry->offset = offset;
+	entry->pack_index = ctx->pack_index;
+	entry->mtime = ctx->mtime;
+	return 0;
+}
+
+GIT_INLINE(void) put_be32(unsigned char *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static int write_be32(git_filebuf *f, uint32_t v)
+{
+	unsigned char buf[4];
+	put_be32(buf, v);
+	return git_filebuf_write(f, buf, sizeof(buf));
+}
+
+static int write_chunk_header(git_filebuf *f, uint32_t id, uint64_t offset)
+{
+	unsigned char buf[MIDX_CHUNK_TABLE_ENTRY];
+
+	put_be32(buf, id);
+	put_be32(buf + 4, (uint32_t)(offset >> 32));
+	put_be32(buf + 8, (uint32_t)offset);
+
+	return git_filebuf_write(f, buf, sizeof(buf));
+}
+
+static int midx_write_file(
+	const char *path,
+	struct midx_write_pack *packs,
+	size_t num_packs,
+	struct midx_write_entry *entries,
+	size_t count,
+	size_t num_large)
+{
+	git_filebuf f = GIT_FILEBUF_INIT;
+	unsigned char header[MIDX_HEADER_SIZE];
+	static const char padding[MIDX_CHUNK_ALIGNMENT];
+	size_t i, names_len = 0, large = 0, fanout_pos = 0;
+	uint64_t offset;
+	git_oid checksum;
+	int error = 0;
+
+	for (i = 0; i < num_packs; ++i)
+		names_len += strlen(packs[i].idx_name) + 1;
+
+	put_be32(header, MIDX_SIGNATURE);
+	header[4] = MIDX_VERSION;
+	header[5] = MIDX_OID_VERSION;
+	header[6] = num_large ? 5 : 4;
+	header[7] = 0;
+	put_be32(header + 8, (uint32_t)num_packs);
+
+	if ((error = git_filebuf_open(&f, path, GIT_FILEBUF_HASH_CONTENTS)) < 0)
+		return error;
+
+	error = git_filebuf_write(&f, header, sizeof(header));
+
+	/* chunk table */
+	offset = MIDX_HEADER_SIZE + (header[6] + 1) * MIDX_CHUNK_TABLE_ENTRY;
+	if (!error)
+		error = write_chunk_header(&f, MIDX_CHUNK_PNAM, offset);
+	offset += (names_len + MIDX_CHUNK_ALIGNMENT - 1) & ~(MIDX_CHUNK_ALIGNMENT - 1);
+	if (!error)
+		error = write_chunk_header(&f, MIDX_CHUNK_OIDF, offset);
+	offset += 256 * 4;
+	if (!error)
+		error = write_chunk_header(&f, MIDX_CHUNK_OIDL, offset);
+	offset += count * GIT_OID_RAWSZ;
+	if (!error)
+		error = write_chunk_header(&f, MIDX_CHUNK_OOFF, offset);
+	offset += count * 8;
+	if (!error && num_large) {
+		error = write_chunk_header(&f, MIDX_CHUNK_LOFF, offset);
+		offset += num_large * 8;
+	}
+	if (!error)
+		error = write_chunk_header(&f, 0, offset);
+
+	/* PNAM */
+	for (i = 0; !error && i < num_packs; ++i)
+		error = git_filebuf_write(&f, packs[i].idx_name, strlen(packs[i].idx_name) + 1);
+	if (!error && names_len % MIDX_CHUNK_ALIGNMENT)
+		error = git_filebuf_write(&f, padding,
+			MIDX_CHUNK_ALIGNMENT - names_len % MIDX_CHUNK_ALIGNMENT);
+
+	/* OIDF */
+	for (i = 0; !error && i < 256; ++i) {
+		while (fanout_pos < count && entries[fanout_pos].oid.id[0] <= i)
+			fanout_pos++;
+		error = write_be32(&f, (uint32_t)fanout_pos);
+	}
+
+	/* OIDL */
+	for (i = 0; !error && i < count; ++i)
+		error = git_filebuf_write(&f, entries[i].oid.id, GIT_OID_RAWSZ);
+
+	/* OOFF */
+	for (i = 0; !error && i < count; ++i) {
+		uint32_t word = (uint32_t)entries[i].offset;
+
+		if (num_large && (uint64_t)entries[i].offset >= MIDX_LARGE_OFFSET)
+			word = MIDX_LARGE_OFFSET | (uint32_t)large++;
+
+		if ((error = write_be32(&f, entries[i].pack_index)) == 0)
+			error = write_be32(&f, word);
+	}
+
+	/* LOFF */
+	for (i = 0; !error && num_large && i < count; ++i) {
+		uint64_t off = (uint64_t)entries[i].offset;
+
+		if (off < MIDX_LARGE_OFFSET)
+			continue;
+
+		if ((error = write_be32(&f, (uint32_t)(off >> 32))) == 0)
+			error = write_be32(&f, (uint32_t)off);
+	}
+
+	if (!error && (error = git_filebuf_hash(&checksum, &f)) == 0 &&
+		(error = git_filebuf_write(&f, checksum.id, GIT_OID_RAWSZ)) == 0)
+		error = git_filebuf_commit(&f, GIT_PACK_FILE_MODE);
+
+	if (error < 0)
+		git_filebuf_cleanup(&f);
+
+	return error;
+}
+
+int git_midx_write(const char *pack_dir, git_vector *packs)
+{
+	struct midx_write_pack *wpacks;
+	struct midx_write_ctx ctx = {0};
+	struct git_pack_file *p;
+	git_buf path = GIT_BUF_INIT;
+	size_t i, j, num_large = 0;
+	int error = 0;
+
+	wpacks = git__calloc(packs->length ? packs->length : 1, sizeof(struct midx_write_pack));
+	GITERR_CHECK_ALLOC(wpacks);
+
+	git_vector_foreach(packs, i, p) {
+		char *name = git_path_basename(p->pack_name);
+		size_t len;
+
+		if (name == NULL || (len = strlen(name)) <= strlen(".pack") ||
+			git__suffixcmp(name, ".pack") != 0) {
+			git__free(name);
+			giterr_set(GITERR_ODB, "Unexpected packfile name '%s'", p->pack_name);
+			error = -1;
+			goto cleanup;
+		}
+
+		/* the index is named after the pack; ".idx" fits in ".pack" */
+		strcpy(name + len - strlen(".pack"), ".idx");
+
+		wpacks[i].p = p;
+		wpacks[i].idx_name = name;
+	}
+
+	qsort(wpacks, packs->length, sizeof(struct midx_write_pack), midx_write_pack_cmp);
+
+	for (i = 0; i < packs->length; ++i) {
+		ctx.pack_index = (uint32_t)i;
+		ctx.mtime = wpacks[i].p->mtime;
+
+		if ((error = git_pack_foreach_entry_offset(wpacks[i].p, midx_collect_cb, &ctx)) < 0)
+			goto cleanup;
+	}
+
+	qsort(ctx.entries, ctx.count, sizeof(struct midx_write_entry), midx_write_entry_cmp);
+
+	/* keep one entry per object, and see whether any needs 64 bits */
+	for (i = 0, j = 0; i < ctx.count; ++i) {
+		if (j > 0 && git_oid_cmp(&ctx.entries[j - 1].oid, &ctx.entries[i].oid) == 0)
+			continue;
+
+		ctx.entries[j++] = ctx.entries[i];
+		if ((uint64_t)ctx.entries[i].offset > 0xffffffff)
+			num_large = 1;
+	}
+	ctx.count = j;
+
+	if (num_large) {
+		num_large = 0;
+		for (i = 0; i < ctx.count; ++i)
+			if ((uint64_t)ctx.entries[i].offset >= MIDX_LARGE_OFFSET)
+				num_large++;
+	}
+
+	if ((error = git_buf_joinpath(&path, pack_dir, GIT_MIDX_FILE)) < 0)
+		goto cleanup;
+
+	error = midx_write_file(git_buf_cstr(&path), wpacks, packs->length,
+		ctx.entries, ctx.count, num_large);
+
+cleanup:
+	for (i = 0; i < packs->length; ++i)
+		git__free(wpacks[i].idx_name);
+	git__free(wpacks);
+	git__free(ctx.entries);
+	git_buf_free(&path);
+
+	return error;
+}
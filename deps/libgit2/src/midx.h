@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_midx_h__
+#define INCLUDE_midx_h__
+
+#include "common.h"
+#include "map.h"
+#include "vector.h"
+#include "git2/oid.h"
+
+#define GIT_MIDX_FILE "multi-pack-index"
+
+/*
+ * A multi-pack-index maps every object of a set of packs to the pack
+ * that holds it and its offset there, so an object can be found with a
+ * single binary search instead of one per pack. The file lives next to
+ * the packs and uses git's format (version 1, SHA-1).
+ */
+typedef struct git_midx_file {
+	git_map index_map;
+
+	/* The names of the indexed ".idx" files; the position of a name
+	 * is the pack index used by the entries */
+	git_vector packfile_names;
+
+	const uint32_t *oid_fanout;
+	uint32_t num_objects;
+	const git_oid *oid_lookup;
+	const unsigned char *object_offsets;
+	const unsigned char *object_large_offsets;
+	size_t num_object_large_offsets;
+
+	/* The trailing checksum, to tell when the file was rewritten */
+	git_oid checksum;
+} git_midx_file;
+
+typedef struct git_midx_entry {
+	git_off_t offset;
+	size_t pack_index;
+	git_oid sha1;
+} git_midx_entry;
+
+int git_midx_open(git_midx_file **idx_out, const char *path);
+bool git_midx_needs_refresh(const git_midx_file *idx, const char *path);
+void git_midx_free(git_midx_file *idx);
+
+/*
+ * Find an object by a prefix of its id. Returns GIT_ENOTFOUND or
+ * GIT_EAMBIGUOUS when there is no single match.
+ */
+int git_midx_entry_find(
+	git_midx_entry *e,
+	git_midx_file *idx,
+	const git_oid *short_oid,
+	size_t len);
+
+/*
+ * Set bit `i % 8` of `found[i / 8]` for each of the sorted `ids` in the
+ * index; ids whose bit is already set are not looked up.
+ */
+void git_midx_exists_many(
+	unsigned char *found,
+	git_midx_file *idx,
+	const git_oid *ids,
+	size_t count);
+
+/*
+ * Write a multi-pack-index covering `packs` (a vector of
+ * `struct git_pack_file *`) into `pack_dir`. When an object is in
+ * several packs, the entry of the most recently modified one is kept.
+ */
+int git_midx_write(const char *pack_dir, git_vector *packs);
+
+#endif
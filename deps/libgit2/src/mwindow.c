@@ -23,7 +23,14 @@
 size_t git_mwindow__window_size = DEFAULT_WINDOW_SIZE;
 size_t git_mwindow__mapped_limit = DEFAULT_MAPPED_LIMIT;
 
-/* Whenever you want to read or modify this, grab git__mwindow_mutex */
+/*
+ * Each file's windows are guarded by the file's own lock, so readers of
+ * different packs never contend. Only the list of registered files needs
+ * git__mwindow_mutex; the mapped byte count and the LRU clock are updated
+ * atomically. When a new window pushes the total over the limit, the
+ * least recently used idle window of any file is closed, with the global
+ * lock taken before any file lock and never the other way around.
+ */
 static git_mwindow_ctl mem_ctl;
 
 /*
@@ -55,12 +62,19 @@ void git_mwindow_free_all(git_mwindow_file *mwf)
 		ctl->windowfiles.contents = NULL;
 	}
 
+	git_mutex_unlock(&git__mwindow_mutex);
+
+	if (git_mutex_lock(&mwf->lock)) {
+		giterr_set(GITERR_THREAD, "unable to lock mwindow mutex");
+		return;
+	}
+
 	while (mwf->windows) {
 		git_mwindow *w = mwf->windows;
-		assert(w->inuse_cnt == 0);
+		assert(w->inuse_cnt.val == 0);
 
-		ctl->mapped -= w->window_map.len;
-		ctl->open_windows--;
+		git_atomic_ssize_add(&ctl->mapped, -(ssize_t)w->window_map.len);
+		git_atomic_dec(&ctl->open_windows);
 
 		git_futils_mmap_free(&w->window_map);
 
@@ -68,7 +82,7 @@ void git_mwindow_free_all(git_mwindow_file *mwf)
 		git__free(w);
 	}
 
-	git_mutex_unlock(&git__mwindow_mutex);
+	git_mutex_unlock(&mwf->lock);
 }
 
 /*
@@ -82,7 +96,8 @@ int git_mwindow_contains(git_mwindow *win, git_off_t offset)
 }
 
 /*
- * Find the least-recently-used window in a file
+ * Find the least-recently-used window in a file. Called with the
+ * file's lock held.
  */
 static void git_mwindow_scan_lru(
 	git_mwindow_file *mwf,
@@ -92,7 +107,7 @@ static void git_mwindow_scan_lru(
 	git_mwindow *w, *w_l;
 
 	for (w_l = NULL, w = mwf->windows; w; w = w->next) {
-		if (!w->inuse_cnt) {
+		if (!w->inuse_cnt.val) {
 			/*
 			 * If the current one is more recent than the last one,
 			 * store it in the output parameter. If lru_w is NULL,
@@ -108,50 +123,74 @@ static void git_mwindow_scan_lru(
 }
 
 /*
- * Close the least recently used window. You should check to see if
- * the file descriptors need closing from time to time. Called under
- * lock from new_window.
+ * Close the least recently used window among all the registered files.
+ * Must be called without holding any file lock.
  */
-static int git_mwindow_close_lru(git_mwindow_file *mwf)
+static int git_mwindow_close_lru(void)
 {
 	git_mwindow_ctl *ctl = &mem_ctl;
+	git_mwindow_file *cur, *lru_f = NULL;
+	git_mwindow *lru_w, *lru_l;
+	ssize_t lru_used = 0;
 	unsigned int i;
-	git_mwindow *lru_w = NULL, *lru_l = NULL, **list = &mwf->windows;
 
-	/* FIXME: Does this give us any advantage? */
-	if(mwf->windows)
-		git_mwindow_scan_lru(mwf, &lru_w, &lru_l);
+	if (git_mutex_lock(&git__mwindow_mutex)) {
+		giterr_set(GITERR_THREAD, "unable to lock mwindow mutex");
+		return -1;
+	}
+
+	/* windows can only be compared while their file is locked, so
+	 * remember the file and the age of its oldest idle window */
+	git_vector_foreach(&ctl->windowfiles, i, cur) {
+		lru_w = lru_l = NULL;
+
+		if (git_mutex_lock(&cur->lock))
+			continue;
 
-	for (i = 0; i < ctl->windowfiles.length; ++i) {
-		git_mwindow *last = lru_w;
-		git_mwindow_file *cur = git_vector_get(&ctl->windowfiles, i);
 		git_mwindow_scan_lru(cur, &lru_w, &lru_l);
-		if (lru_w != last)
-			list = &cur->windows;
+		if (lru_w && (!lru_f || lru_w->last_used < lru_used)) {
+			lru_f = cur;
+			lru_used = lru_w->last_used;
+		}
+
+		git_mutex_unlock(&cur->lock);
+	}
+
+	lru_w = lru_l = NULL;
+
+	/* the file's windows may have changed in the meantime; take
+	 * whatever is oldest and idle now */
+	if (lru_f && git_mutex_lock(&lru_f->lock) == 0) {
+		git_mwindow_scan_lru(lru_f, &lru_w, &lru_l);
+
+		if (lru_w) {
+			if (lru_l)
+				lru_l->next = lru_w->next;
+			else
+				lru_f->windows = lru_w->next;
+		}
+
+		git_mutex_unlock(&lru_f->lock);
 	}
 
+	git_mutex_unlock(&git__mwindow_mutex);
+
 	if (!lru_w) {
 		giterr_set(GITERR_OS, "Failed to close memory window. Couldn't find LRU");
 		return -1;
 	}
 
-	ctl->mapped -= lru_w->window_map.len;
-	git_futils_mmap_free(&lru_w->window_map);
-
-	if (lru_l)
-		lru_l->next = lru_w->next;
-	else
-		*list = lru_w->next;
+	git_atomic_ssize_add(&ctl->mapped, -(ssize_t)lru_w->window_map.len);
+	git_atomic_dec(&ctl->open_windows);
 
+	git_futils_mmap_free(&lru_w->window_map);
 	git__free(lru_w);
-	ctl->open_windows--;
 
 	return 0;
 }
 
-/* This gets called under lock from git_mwindow_open */
+/* This gets called under the file's lock from git_mwindow_open */
 static git_mwindow *new_window(
-	git_mwindow_file *mwf,
 	git_file fd,
 	git_off_t size,
 	git_off_t offset)
@@ -160,6 +199,8 @@ static git_mwindow *new_window(
 	size_t walign = git_mwindow__window_size / 2;
 	git_off_t len;
 	git_mwindow *w;
+	ssize_t mapped;
+	int open_windows;
 
 	w = git__malloc(sizeof(*w));
 	
@@ -173,30 +214,20 @@ static git_mwindow *new_window(
 	if (len > (git_off_t)git_mwindow__window_size)
 		len = (git_off_t)git_mwindow__window_size;
 
-	ctl->mapped += (size_t)len;
-
-	while (git_mwindow__mapped_limit < ctl->mapped &&
-			git_mwindow_close_lru(mwf) == 0) /* nop */;
-
-	/*
-	 * We treat `mapped_limit` as a soft limit. If we can't find a
-	 * window to close and are above the limit, we still mmap the new
-	 * window.
-	 */
-
 	if (git_futils_mmap_ro(&w->window_map, fd, w->offset, (size_t)len) < 0) {
 		git__free(w);
 		return NULL;
 	}
 
-	ctl->mmap_calls++;
-	ctl->open_windows++;
+	mapped = git_atomic_ssize_add(&ctl->mapped, (ssize_t)len);
+	open_windows = git_atomic_inc(&ctl->open_windows);
+	git_atomic_inc(&ctl->mmap_calls);
 
-	if (ctl->mapped > ctl->peak_mapped)
-		ctl->peak_mapped = ctl->mapped;
+	if ((size_t)mapped > ctl->peak_mapped)
+		ctl->peak_mapped = (size_t)mapped;
 
-	if (ctl->open_windows > ctl->peak_open_windows)
-		ctl->peak_open_windows = ctl->open_windows;
+	if ((unsigned int)open_windows > ctl->peak_open_windows)
+		ctl->peak_open_windows = (unsigned int)open_windows;
 
 	return w;
 }
@@ -215,14 +246,17 @@ unsigned char *git_mwindow_open(
 	git_mwindow_ctl *ctl = &mem_ctl;
 	git_mwindow *w = *cursor;
 
-	if (git_mutex_lock(&git__mwindow_mutex)) {
-		giterr_set(GITERR_THREAD, "unable to lock mwindow mutex");
-		return NULL;
-	}
-
+	/* a window we hold stays mapped, so it can be used without a lock */
 	if (!w || !(git_mwindow_contains(w, offset) && git_mwindow_contains(w, offset + extra))) {
+		int created = 0;
+
+		if (git_mutex_lock(&mwf->lock)) {
+			giterr_set(GITERR_THREAD, "unable to lock mwindow mutex");
+			return NULL;
+		}
+
 		if (w) {
-			w->inuse_cnt--;
+			git_atomic_dec(&w->inuse_cnt);
 		}
 
 		for (w = mwf->windows; w; w = w->next) {
@@ -236,21 +270,31 @@ unsigned char *git_mwindow_open(
 		 * one.
 		 */
 		if (!w) {
-			w = new_window(mwf, mwf->fd, mwf->size, offset);
+			w = new_window(mwf->fd, mwf->size, offset);
 			if (w == NULL) {
-				git_mutex_unlock(&git__mwindow_mutex);
+				*cursor = NULL;
+				git_mutex_unlock(&mwf->lock);
 				return NULL;
 			}
 			w->next = mwf->windows;
 			mwf->windows = w;
+			created = 1;
 		}
-	}
 
-	/* If we changed w, store it in the cursor */
-	if (w != *cursor) {
-		w->last_used = ctl->used_ctr++;
-		w->inuse_cnt++;
+		w->last_used = git_atomic_ssize_add(&ctl->used_ctr, 1);
+		git_atomic_inc(&w->inuse_cnt);
 		*cursor = w;
+
+		git_mutex_unlock(&mwf->lock);
+
+		/*
+		 * We treat `mapped_limit` as a soft limit. If we can't find a
+		 * window to close and are above the limit, we keep the new
+		 * window anyway.
+		 */
+		while (created &&
+			git_mwindow__mapped_limit < (size_t)ctl->mapped.val &&
+			git_mwindow_close_lru() == 0) /* nop */;
 	}
 
 	offset -= w->offset;
@@ -258,7 +302,6 @@ unsigned char *git_mwindow_open(
 	if (left)
 		*left = (unsigned int)(w->window_map.len - offset);
 
-	git_mutex_unlock(&git__mwindow_mutex);
 	return (unsigned char *) w->window_map.data + offset;
 }
 
@@ -307,13 +350,7 @@ void git_mwindow_close(git_mwindow **window)
 {
 	git_mwindow *w = *window;
 	if (w) {
-		if (git_mutex_lock(&git__mwindow_mutex)) {
-			giterr_set(GITERR_THREAD, "unable to lock mwindow mutex");
-			return;
-		}
-
-		w->inuse_cnt--;
-		git_mutex_unlock(&git__mwindow_mutex);
+		git_atomic_dec(&w->inuse_cnt);
 		*window = NULL;
 	}
 }
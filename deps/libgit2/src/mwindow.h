@@ -10,28 +10,38 @@
 
 #include "map.h"
 #include "vector.h"
+#include "thread-utils.h"
 
 typedef struct git_mwindow {
 	struct git_mwindow *next;
 	git_map window_map;
 	git_off_t offset;
-	size_t last_used;
-	size_t inuse_cnt;
+	volatile ssize_t last_used;
+	git_atomic inuse_cnt;
 } git_mwindow;
 
+/*
+ * `lock` guards the window list of the file; it must be initialized
+ * with git_mutex_init before the file is used and freed with it.
+ */
 typedef struct git_mwindow_file {
+	git_mutex lock;
 	git_mwindow *windows;
 	int fd;
 	git_off_t size;
 } git_mwindow_file;
 
+/*
+ * The counters are updated without a lock; `windowfiles` is only read
+ * or modified with git__mwindow_mutex held. The peaks are advisory.
+ */
 typedef struct git_mwindow_ctl {
-	size_t mapped;
-	unsigned int open_windows;
-	unsigned int mmap_calls;
+	git_atomic_ssize mapped;
+	git_atomic open_windows;
+	git_atomic mmap_calls;
 	unsigned int peak_open_windows;
 	size_t peak_mapped;
-	size_t used_ctr;
+	git_atomic_ssize used_ctr;
 	git_vector windowfiles;
 } git_mwindow_ctl;
 
@@ -33,6 +33,7 @@ typedef struct
 } backend_internal;
 
 static int load_alternates(git_odb *odb, const char *objects_dir, int alternate_depth);
+static int odb_refresh(git_odb *db);
 
 int git_odb__format_object_header(char *hdr, size_t n, size_t obj_len, git_otype obj_type)
 {
@@ -67,6 +68,43 @@ int git_odb__hashobj(git_oid *id, git_rawobj *obj)
 	return 0;
 }
 
+int git_odb__hashobj_many(git_oid *ids, git_rawobj *objs, size_t n)
+{
+	git_buf_vec *vec;
+	char *headers;
+	size_t i;
+	int error;
+
+	assert(ids && (objs || !n));
+
+	for (i = 0; i < n; ++i) {
+		if (!git_object_typeisloose(objs[i].type) ||
+			(!objs[i].data && objs[i].len != 0)) {
+			giterr_set(GITERR_INVALID, "Cannot hash object %u of the batch", (unsigned int)i);
+			return -1;
+		}
+	}
+
+	vec = git__malloc(n * (2 * sizeof(git_buf_vec) + 64));
+	GITERR_CHECK_ALLOC(vec);
+	headers = (char *)(vec + 2 * n);
+
+	for (i = 0; i < n; ++i) {
+		char *header = headers + 64 * i;
+
+		vec[2 * i].data = header;
+		vec[2 * i].len = git_odb__format_object_header(
+			header, 64, objs[i].len, objs[i].type);
+		vec[2 * i + 1].data = objs[i].data;
+		vec[2 * i + 1].len = objs[i].len;
+	}
+
+	error = git_hash_vec_many(ids, vec, 2, n);
+
+	git__free(vec);
+	return error;
+}
+
 
 static git_odb_object *new_odb_object(const git_oid *oid, git_rawobj *source)
 {
@@ -75,6 +113,8 @@ static git_odb_object *new_odb_object(const git_oid *oid, git_rawobj *source)
 
 	git_oid_cpy(&object->cached.oid, oid);
 	memcpy(&object->raw, source, sizeof(git_rawobj));
+	object->cached.type = source->type;
+	object->cached.size = sizeof(git_odb_object) + source->len;
 
 	return object;
 }
@@ -109,6 +149,12 @@ git_otype git_odb_object_type(git_odb_object *object)
 	return object->raw.type;
 }
 
+void git_odb_cache_stats(git_cache_stats *out, git_odb *db)
+{
+	assert(out && db);
+	git_cache_read_stats(out, &db->cache);
+}
+
 void git_odb_object_free(git_odb_object *object)
 {
 	if (object == NULL)
@@ -327,6 +373,61 @@ static int init_fake_wstream(git_odb_stream **stream_p, git_odb_backend *backend
 	return 0;
 }
 
+typedef struct {
+	git_odb_stream stream;
+	git_odb_object *object;
+	size_t pos;
+} fake_rstream;
+
+static int fake_rstream__read(git_odb_stream *_stream, char *buffer, size_t len)
+{
+	fake_rstream *stream = (fake_rstream *)_stream;
+	size_t left = stream->object->raw.len - stream->pos;
+
+	if (len > left)
+		len = left;
+	if (len > INT_MAX)
+		len = INT_MAX;
+
+	memcpy(buffer, (char *)stream->object->raw.data + stream->pos, len);
+	stream->pos += len;
+	return (int)len;
+}
+
+static void fake_rstream__free(git_odb_stream *_stream)
+{
+	fake_rstream *stream = (fake_rstream *)_stream;
+
+	git_odb_object_free(stream->object);
+	git__free(stream);
+}
+
+/* For the objects no backend can stream: read them whole */
+static int init_fake_rstream(
+	git_odb_stream **stream_p, size_t *len_p, git_otype *type_p,
+	git_odb *db, const git_oid *oid)
+{
+	fake_rstream *stream;
+	int error;
+
+	stream = git__calloc(1, sizeof(fake_rstream));
+	GITERR_CHECK_ALLOC(stream);
+
+	if ((error = git_odb_read(&stream->object, db, oid)) < 0) {
+		git__free(stream);
+		return error;
+	}
+
+	stream->stream.read = &fake_rstream__read;
+	stream->stream.free = &fake_rstream__free;
+	stream->stream.mode = GIT_STREAM_RDONLY;
+
+	*len_p = stream->object->raw.len;
+	*type_p = stream->object->raw.type;
+	*stream_p = (git_odb_stream *)stream;
+	return 0;
+}
+
 /***********************************************************
  *
  * OBJECT DATABASE PUBLIC API
@@ -358,6 +459,8 @@ int git_odb_new(git_odb **out)
 		return -1;
 	}
 
+	git_mutex_init(&db->missing_lock);
+
 	*out = db;
 	GIT_REFCOUNT_INC(db);
 	return 0;
@@ -388,6 +491,9 @@ static int add_backend_internal(git_odb *odb, git_odb_backend *backend, int prio
 
 	git_vector_sort(&odb->backends);
 	internal->backend->odb = odb;
+
+	/* the new backend may well have them */
+	git_odb__forget_missing(odb);
 	return 0;
 }
 
@@ -513,6 +619,8 @@ static void odb_free(git_odb *db)
 
 	git_vector_free(&db->backends);
 	git_cache_free(&db->cache);
+	git_mutex_free(&db->missing_lock);
+	git__free(db->missing);
 	git__free(db);
 }
 
@@ -524,6 +632,78 @@ void git_odb_free(git_odb *db)
 	GIT_REFCOUNT_DEC(db, odb_free);
 }
 
+/*
+ * A miss makes the ODB refresh its backends and look again. Ids that
+ * are still missing after that are remembered here, so that asking for
+ * them again costs the first lookup and the refresh, which is a stat of
+ * each pack folder while nothing changes; when something does, the
+ * pack backend rescans the folder and forgets them.
+ */
+GIT_INLINE(git_oid *) missing_slot(git_odb *db, const git_oid *id)
+{
+	uint32_t h;
+
+	memcpy(&h, id->id, sizeof(h));
+	return &db->missing[h & (GIT_ODB_MISSING_SLOTS - 1)];
+}
+
+static bool odb_is_missing(git_odb *db, const git_oid *id)
+{
+	bool missing = false;
+
+	if (db->missing == NULL)
+		return false;
+
+	if (git_mutex_lock(&db->missing_lock) < 0)
+		return false;
+
+	if (db->missing != NULL)
+		missing = !git_oid_cmp(missing_slot(db, id), id);
+
+	git_mutex_unlock(&db->missing_lock);
+
+	return missing;
+}
+
+static void odb_set_missing(git_odb *db, const git_oid *id)
+{
+	/* the zero id marks empty slots */
+	if (git_oid_iszero(id) || git_mutex_lock(&db->missing_lock) < 0)
+		return;
+
+	if (db->missing == NULL)
+		db->missing = git__calloc(GIT_ODB_MISSING_SLOTS, sizeof(git_oid));
+
+	if (db->missing != NULL)
+		git_oid_cpy(missing_slot(db, id), id);
+
+	git_mutex_unlock(&db->missing_lock);
+}
+
+static void odb_unset_missing(git_odb *db, const git_oid *id)
+{
+	git_oid *slot;
+
+	if (db->missing == NULL || git_mutex_lock(&db->missing_lock) < 0)
+		return;
+
+	if (db->missing != NULL && !git_oid_cmp(slot = missing_slot(db, id), id))
+		memset(slot, 0, sizeof(git_oid));
+
+	git_mutex_unlock(&db->missing_lock);
+}
+
+void git_odb__forget_missing(git_odb *db)
+{
+	if (db == NULL || db->missing == NULL || git_mutex_lock(&db->missing_lock) < 0)
+		return;
+
+	git__free(db->missing);
+	db->missing = NULL;
+
+	git_mutex_unlock(&db->missing_lock);
+}
+
 int git_odb_exists(git_odb *db, const git_oid *id)
 {
 	git_odb_object *object;
@@ -548,18 +728,144 @@ attempt_lookup:
 	}
 
 	if (!found && !refreshed) {
-		if (git_odb_refresh(db) < 0) {
+		if (odb_refresh(db) < 0) {
 			giterr_clear();
 			return (int)false;
 		}
 
+		if (odb_is_missing(db, id))
+			return (int)false;
+
 		refreshed = true;
 		goto attempt_lookup;
 	}
 
+	if (!found)
+		odb_set_missing(db, id);
+
 	return (int)found;
 }
 
+#define BIT_ISSET(bits, i) ((bits)[(i) / 8] & (1 << ((i) % 8)))
+#define BIT_SET(bits, i) ((bits)[(i) / 8] |= (1 << ((i) % 8)))
+
+struct exists_entry {
+	git_oid id;
+	size_t pos;
+};
+
+static int exists_entry_cmp(const void *a, const void *b)
+{
+	return git_oid_cmp(
+		&((const struct exists_entry *)a)->id,
+		&((const struct exists_entry *)b)->id);
+}
+
+/* Ask every backend about the sorted `ids`, skipping those already found */
+static void odb_exists_many(git_odb *db, unsigned char *found, const git_oid *ids, size_t count)
+{
+	unsigned int i;
+	size_t j;
+
+	for (i = 0; i < db->backends.length; ++i) {
+		backend_internal *internal = git_vector_get(&db->backends, i);
+		git_odb_backend *b = internal->backend;
+
+		if (b->exists_many != NULL) {
+			if (b->exists_many(b, found, ids, count) < 0)
+				giterr_clear();
+		} else if (b->exists != NULL) {
+			for (j = 0; j < count; ++j)
+				if (!BIT_ISSET(found, j) && b->exists(b, &ids[j]))
+					BIT_SET(found, j);
+		}
+	}
+}
+
+int git_odb_exists_many(
+	unsigned char *out, git_odb *db, const git_oid *ids, size_t count)
+{
+	struct exists_entry *pending;
+	git_oid *sorted = NULL;
+	unsigned char *found = NULL;
+	size_t i, npending = 0;
+	bool refresh = false;
+	int error = 0;
+
+	assert(out && db && (ids || !count));
+
+	memset(out, 0, (count + 7) / 8);
+	if (!count)
+		return 0;
+
+	pending = git__malloc(count * sizeof(struct exists_entry));
+	GITERR_CHECK_ALLOC(pending);
+
+	for (i = 0; i < count; ++i) {
+		git_odb_object *object;
+
+		if ((object = git_cache_get(&db->cache, &ids[i])) != NULL) {
+			git_odb_object_free(object);
+			BIT_SET(out, i);
+			continue;
+		}
+
+		git_oid_cpy(&pending[npending].id, &ids[i]);
+		pending[npending++].pos = i;
+	}
+
+	if (!npending)
+		goto cleanup;
+
+	/* sorted, the ids can be merged against each pack index in one pass */
+	qsort(pending, npending, sizeof(struct exists_entry), exists_entry_cmp);
+
+	sorted = git__malloc(npending * sizeof(git_oid));
+	found = git__calloc((npending + 7) / 8, 1);
+	if (!sorted || !found) {
+		giterr_set_oom();
+		error = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < npending; ++i)
+		git_oid_cpy(&sorted[i], &pending[i].id);
+
+	odb_exists_many(db, found, sorted, npending);
+
+	/* as git_odb_exists does, refresh once and look again unless every miss is known */
+	for (i = 0; i < npending && !refresh; ++i)
+		refresh = !BIT_ISSET(found, i);
+
+	if (refresh && odb_refresh(db) < 0) {
+		giterr_clear();
+		refresh = 0;
+	}
+
+	if (refresh) {
+		for (refresh = 0, i = 0; i < npending && !refresh; ++i)
+			refresh = !BIT_ISSET(found, i) && !odb_is_missing(db, &sorted[i]);
+	}
+
+	if (refresh) {
+		odb_exists_many(db, found, sorted, npending);
+
+		for (i = 0; i < npending; ++i)
+			if (!BIT_ISSET(found, i))
+				odb_set_missing(db, &sorted[i]);
+	}
+
+	for (i = 0; i < npending; ++i)
+		if (BIT_ISSET(found, i))
+			BIT_SET(out, pending[i].pos);
+
+cleanup:
+	git__free(found);
+	git__free(sorted);
+	git__free(pending);
+	return error;
+}
+
 int git_odb_read_header(size_t *len_p, git_otype *type_p, git_odb *db, const git_oid *id)
 {
 	int error;
@@ -647,13 +953,19 @@ attempt_lookup:
 	}
 
 	if (error == GIT_ENOTFOUND && !refreshed) {
-		if ((error = git_odb_refresh(db)) < 0)
+		if ((error = odb_refresh(db)) < 0)
 			return error;
 
+		if (odb_is_missing(db, id))
+			return GIT_ENOTFOUND;
+
 		refreshed = true;
 		goto attempt_lookup;
 	}
 
+	if (error == GIT_ENOTFOUND)
+		odb_set_missing(db, id);
+
 	if (error && error != GIT_PASSTHROUGH)
 		return error;
 
@@ -711,15 +1023,21 @@ attempt_lookup:
 	}
 
 	if (!found && !refreshed) {
-		if ((error = git_odb_refresh(db)) < 0)
+		if ((error = odb_refresh(db)) < 0)
 			return error;
 
+		if (len == GIT_OID_HEXSZ && odb_is_missing(db, short_id))
+			return git_odb__error_notfound("no match for prefix", short_id);
+
 		refreshed = true;
 		goto attempt_lookup;
 	}
 
-	if (!found)
+	if (!found) {
+		if (len == GIT_OID_HEXSZ)
+			odb_set_missing(db, short_id);
 		return git_odb__error_notfound("no match for prefix", short_id);
+	}
 
 	*out = git_cache_try_store(&db->cache, new_odb_object(&found_full_oid, &raw));
 	return 0;
@@ -740,16 +1058,14 @@ int git_odb_foreach(git_odb *db, git_odb_foreach_cb cb, void *payload)
 	return 0;
 }
 
-int git_odb_write(
+/* Write an object whose id, `oid`, is already known */
+static int odb_write_hashed(
 	git_oid *oid, git_odb *db, const void *data, size_t len, git_otype type)
 {
 	unsigned int i;
 	int error = GIT_ERROR;
 	git_odb_stream *stream;
 
-	assert(oid && db);
-
-	git_odb_hash(oid, data, len, type);
 	if (git_odb_exists(db, oid))
 		return 0;
 
@@ -765,8 +1081,10 @@ int git_odb_write(
 			error = b->write(oid, b, data, len, type);
 	}
 
-	if (!error || error == GIT_PASSTHROUGH)
+	if (!error || error == GIT_PASSTHROUGH) {
+		odb_unset_missing(db, oid);
 		return 0;
+	}
 
 	/* if no backends were able to write the object directly, we try a streaming
 	 * write to the backends; just write the whole object into the stream in one
@@ -779,9 +1097,40 @@ int git_odb_write(
 	error = stream->finalize_write(oid, stream);
 	stream->free(stream);
 
+	if (!error)
+		odb_unset_missing(db, oid);
+
 	return error;
 }
 
+int git_odb_write(
+	git_oid *oid, git_odb *db, const void *data, size_t len, git_otype type)
+{
+	assert(oid && db);
+
+	git_odb_hash(oid, data, len, type);
+	return odb_write_hashed(oid, db, data, len, type);
+}
+
+int git_odb__write_many(git_oid *ids, git_odb *db, git_rawobj *objs, size_t n)
+{
+	size_t i;
+	int error;
+
+	assert(ids && db);
+
+	if ((error = git_odb__hashobj_many(ids, objs, n)) < 0)
+		return error;
+
+	for (i = 0; i < n; ++i) {
+		if ((error = odb_write_hashed(
+				&ids[i], db, objs[i].data, objs[i].len, objs[i].type)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
 int git_odb_open_wstream(
 	git_odb_stream **stream, git_odb *db, size_t size, git_otype type)
 {
@@ -831,6 +1180,31 @@ int git_odb_open_rstream(git_odb_stream **stream, git_odb *db, const git_oid *oi
 	return error;
 }
 
+int git_odb_open_rstream_ext(
+	git_odb_stream **stream, size_t *len, git_otype *type,
+	git_odb *db, const git_oid *oid)
+{
+	unsigned int i;
+	int error;
+
+	assert(stream && len && type && db && oid);
+
+	for (i = 0; i < db->backends.length; ++i) {
+		backend_internal *internal = git_vector_get(&db->backends, i);
+		git_odb_backend *b = internal->backend;
+
+		if (b->readstream_ext == NULL)
+			continue;
+
+		error = b->readstream_ext(stream, len, type, b, oid);
+		if (error != GIT_ENOTFOUND && error != GIT_PASSTHROUGH)
+			return error;
+	}
+
+	giterr_clear();
+	return init_fake_rstream(stream, len, type, db, oid);
+}
+
 int git_odb_write_pack(struct git_odb_writepack **out, git_odb *db, git_transfer_progress_callback progress_cb, void *progress_payload)
 {
 	unsigned int i;
@@ -856,6 +1230,36 @@ int git_odb_write_pack(struct git_odb_writepack **out, git_odb *db, git_transfer
 	return error;
 }
 
+int git_odb_write_multi_pack_index(git_odb *db)
+{
+	unsigned int i;
+	bool supported = false;
+
+	assert(db);
+
+	for (i = 0; i < db->backends.length; ++i) {
+		backend_internal *internal = git_vector_get(&db->backends, i);
+		git_odb_backend *b = internal->backend;
+		int error;
+
+		/* we don't write in alternates! */
+		if (internal->is_alternate || b->writemidx == NULL)
+			continue;
+
+		if ((error = b->writemidx(b)) < 0)
+			return error;
+
+		supported = true;
+	}
+
+	if (!supported) {
+		giterr_set(GITERR_ODB, "No ODB backend supports writing a multi-pack-index");
+		return GIT_ERROR;
+	}
+
+	return 0;
+}
+
 void *git_odb_backend_malloc(git_odb_backend *backend, size_t len)
 {
 	GIT_UNUSED(backend);
@@ -864,9 +1268,16 @@ void *git_odb_backend_malloc(git_odb_backend *backend, size_t len)
 
 int git_odb_refresh(struct git_odb *db)
 {
-	unsigned int i;
 	assert(db);
 
+	git_odb__forget_missing(db);
+	return odb_refresh(db);
+}
+
+static int odb_refresh(git_odb *db)
+{
+	unsigned int i;
+
 	for (i = 0; i < db->backends.length; ++i) {
 		backend_internal *internal = git_vector_get(&db->backends, i);
 		git_odb_backend *b = internal->backend;
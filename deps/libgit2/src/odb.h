@@ -19,6 +19,9 @@
 #define GIT_OBJECT_DIR_MODE 0777
 #define GIT_OBJECT_FILE_MODE 0444
 
+/* Number of ids an ODB remembers as missing */
+#define GIT_ODB_MISSING_SLOTS 1024
+
 /* DO NOT EXPORT */
 typedef struct {
 	void *data;			/**< Raw, decompressed object data. */
@@ -37,14 +40,38 @@ struct git_odb {
 	git_refcount rc;
 	git_vector backends;
 	git_cache cache;
+
+	/* Ids not found even after a refresh, direct-mapped and allocated
+	 * on the first such miss; a zero id marks an empty slot */
+	git_mutex missing_lock;
+	git_oid *missing;
 };
 
+/*
+ * Forget the ids remembered as missing, so the next lookup of any of
+ * them refreshes the backends again. Backends call this when they add
+ * objects that they would otherwise only find after a refresh.
+ */
+void git_odb__forget_missing(git_odb *db);
+
 /*
  * Hash a git_rawobj internally.
  * The `git_rawobj` is supposed to be previously initialized
  */
 int git_odb__hashobj(git_oid *id, git_rawobj *obj);
 
+/*
+ * Hash `n` objects at once, into `ids[0]` to `ids[n-1]`; this is
+ * quicker than one at a time where the CPU can hash them side by side.
+ */
+int git_odb__hashobj_many(git_oid *ids, git_rawobj *objs, size_t n);
+
+/*
+ * Write `n` objects, hashing them all together first, and skipping
+ * the ones the odb has already.
+ */
+int git_odb__write_many(git_oid *ids, git_odb *db, git_rawobj *objs, size_t n);
+
 /*
  * Format the object header such as it would appear in the on-disk object
  */
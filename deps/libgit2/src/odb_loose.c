@@ -14,6 +14,7 @@
 #include "odb.h"
 #include "delta-apply.h"
 #include "filebuf.h"
+#include "thread-utils.h"
 
 #include "git2/odb_backend.h"
 #include "git2/types.h"
@@ -28,26 +29,30 @@ typedef struct {
 	git_filebuf fbuf;
 } loose_writestream;
 
+/*
+ * The listing of one of the 256 fanout directories. Objects don't go
+ * away under us, so an id in the listing is taken to be there without
+ * looking; a miss is only believed once the directory is seen not to
+ * have changed since it was listed.
+ */
+typedef struct {
+	git_futils_filestamp stamp;
+	git_time_t listed_at;
+	git_oid *ids; /* sorted */
+	size_t count, alloc;
+	int loaded;
+} loose_fanout;
+
 typedef struct loose_backend {
 	git_odb_backend parent;
 
 	int object_zlib_level; /** loose object zlib compression level. */
 	int fsync_object_files; /** loose object file fsync flag. */
 	char *objects_dir;
-} loose_backend;
 
-/* State structure for exploring directories,
- * in order to locate objects matching a short oid.
- */
-typedef struct {
-	size_t dir_len;
-	unsigned char short_oid[GIT_OID_HEXSZ]; /* hex formatted oid to match */
-	size_t short_oid_len;
-	int found;				/* number of matching
-						 * objects already found */
-	unsigned char res_oid[GIT_OID_HEXSZ];	/* hex formatted oid of
-						 * the object found */
-} loose_locate_object_state;
+	git_mutex fanout_lock;
+	loose_fanout *fanout; /* all 256 of them, allocated on first use */
+} loose_backend;
 
 
 /***********************************************************
@@ -74,14 +79,42 @@ static int object_file_name(git_buf *name, const char *dir, const git_oid *id)
 	return 0;
 }
 
+GIT_INLINE(int) filename_to_oid(git_oid *oid, const char *ptr)
+{
+	int v, i = 0;
+	if (strlen(ptr) != 41)
+		return -1;
+
+	if (ptr[2] != '/') {
+		return -1;
+	}
+
+	v = (git__fromhex(ptr[i]) << 4) | git__fromhex(ptr[i+1]);
+	if (v < 0)
+		return -1;
+
+	oid->id[0] = (unsigned char) v;
+
+	ptr += 3;
+	for (i = 0; i < 38; i += 2) {
+		v = (git__fromhex(ptr[i]) << 4) | git__fromhex(ptr[i + 1]);
+		if (v < 0)
+			return -1;
+
+		oid->id[1 + i/2] = (unsigned char) v;
+	}
+
+	return 0;
+}
+
 
-static size_t get_binary_object_header(obj_hdr *hdr, git_buf *obj)
+static size_t get_binary_object_header(
+	obj_hdr *hdr, const unsigned char *data, size_t len)
 {
 	unsigned char c;
-	unsigned char *data = (unsigned char *)obj->ptr;
 	size_t shift, size, used = 0;
 
-	if (git_buf_len(obj) == 0)
+	if (len == 0)
 		return 0;
 
 	c = data[used++];
@@ -90,7 +123,7 @@ static size_t get_binary_object_header(obj_hdr *hdr, git_buf *obj)
 	size = c & 15;
 	shift = 4;
 	while (c & 0x80) {
-		if (git_buf_len(obj) <= used)
+		if (len <= used)
 			return 0;
 		if (sizeof(size_t) * 8 <= shift)
 			return 0;
@@ -177,12 +210,13 @@ static void set_stream_output(z_stream *s, void *out, size_t len)
 }
 
 
-static int start_inflate(z_stream *s, git_buf *obj, void *out, size_t len)
+static int start_inflate(
+	z_stream *s, const unsigned char *in, size_t inlen, void *out, size_t len)
 {
 	int status;
 
 	init_stream(s, out, len);
-	set_stream_input(s, obj->ptr, git_buf_len(obj));
+	set_stream_input(s, (void *)in, inlen);
 
 	if ((status = inflateInit(s)) < Z_OK)
 		return status;
@@ -207,7 +241,7 @@ static int finish_inflate(z_stream *s)
 	return 0;
 }
 
-static int is_zlib_compressed_data(unsigned char *data)
+static int is_zlib_compressed_data(const unsigned char *data)
 {
 	unsigned int w;
 
@@ -292,17 +326,18 @@ static void *inflate_tail(z_stream *s, void *hb, size_t used, obj_hdr *hdr)
  * of loose object data into packs. This format is no longer used, but
  * we must still read it.
  */
-static int inflate_packlike_loose_disk_obj(git_rawobj *out, git_buf *obj)
+static int inflate_packlike_loose_disk_obj(
+	git_rawobj *out, const unsigned char *data, size_t len)
 {
-	unsigned char *in, *buf;
+	unsigned char *buf;
 	obj_hdr hdr;
-	size_t len, used;
+	size_t used;
 
 	/*
 	 * read the object header, which is an (uncompressed)
 	 * binary encoding of the object type and size.
 	 */
-	if ((used = get_binary_object_header(&hdr, obj)) == 0 ||
+	if ((used = get_binary_object_header(&hdr, data, len)) == 0 ||
 		!git_object_typeisloose(hdr.type)) {
 		giterr_set(GITERR_ODB, "Failed to inflate loose object.");
 		return -1;
@@ -314,9 +349,7 @@ static int inflate_packlike_loose_disk_obj(git_rawobj *out, git_buf *obj)
 	buf = git__malloc(hdr.size + 1);
 	GITERR_CHECK_ALLOC(buf);
 
-	in = ((unsigned char *)obj->ptr) + used;
-	len = obj->size - used;
-	if (inflate_buffer(in, len, buf, hdr.size) < 0) {
+	if (inflate_buffer((void *)(data + used), len - used, buf, hdr.size) < 0) {
 		git__free(buf);
 		return -1;
 	}
@@ -329,7 +362,8 @@ static int inflate_packlike_loose_disk_obj(git_rawobj *out, git_buf *obj)
 	return 0;
 }
 
-static int inflate_disk_obj(git_rawobj *out, git_buf *obj)
+static int inflate_disk_obj(
+	git_rawobj *out, const unsigned char *data, size_t len)
 {
 	unsigned char head[64], *buf;
 	z_stream zs;
@@ -339,14 +373,19 @@ static int inflate_disk_obj(git_rawobj *out, git_buf *obj)
 	/*
 	 * check for a pack-like loose object
 	 */
-	if (!is_zlib_compressed_data((unsigned char *)obj->ptr))
-		return inflate_packlike_loose_disk_obj(out, obj);
+	if (len < 2) {
+		giterr_set(GITERR_ODB, "Failed to inflate disk object.");
+		return -1;
+	}
+
+	if (!is_zlib_compressed_data(data))
+		return inflate_packlike_loose_disk_obj(out, data, len);
 
 	/*
 	 * inflate the initial part of the io buffer in order
 	 * to parse the object header (type and size).
 	 */
-	if (start_inflate(&zs, obj, head, sizeof(head)) < Z_OK ||
+	if (start_inflate(&zs, data, len, head, sizeof(head)) < Z_OK ||
 		(used = get_object_header(&hdr, head)) == 0 ||
 		!git_object_typeisloose(hdr.type))
 	{
@@ -383,10 +422,17 @@ static int inflate_disk_obj(git_rawobj *out, git_buf *obj)
  *
  ***********************************************************/
 
+/*
+ * The file is mapped rather than read, and inflated straight from the
+ * map into the object's buffer. Returns GIT_ENOTFOUND if there's no
+ * such file, so callers needn't look for it first.
+ */
 static int read_loose(git_rawobj *out, git_buf *loc)
 {
 	int error;
-	git_buf obj = GIT_BUF_INIT;
+	git_file fd;
+	git_off_t size;
+	git_map map;
 
 	assert(out && loc);
 
@@ -397,10 +443,23 @@ static int read_loose(git_rawobj *out, git_buf *loc)
 	out->len = 0;
 	out->type = GIT_OBJ_BAD;
 
-	if (!(error = git_futils_readbuffer(&obj, loc->ptr)))
-		error = inflate_disk_obj(out, &obj);
+	if ((fd = git_futils_open_ro(loc->ptr)) < 0)
+		return fd;
+
+	if ((size = git_futils_filesize(fd)) < 0)
+		error = -1;
+	else if (!git__is_sizet(size)) {
+		giterr_set(GITERR_OS, "File `%s` too large to mmap", loc->ptr);
+		error = -1;
+	} else if (size == 0) {
+		giterr_set(GITERR_ODB, "Failed to inflate disk object.");
+		error = -1;
+	} else if (!(error = git_futils_mmap_ro(&map, fd, 0, (size_t)size))) {
+		error = inflate_disk_obj(out, map.data, map.len);
+		git_futils_mmap_free(&map);
+	}
 
-	git_buf_free(&obj);
+	p_close(fd);
 
 	return error;
 }
@@ -465,101 +524,266 @@ static int locate_object(
 	return error;
 }
 
-/* Explore an entry of a directory and see if it matches a short oid */
-static int fn_locate_object_short_oid(void *state, git_buf *pathbuf) {
-	loose_locate_object_state *sstate = (loose_locate_object_state *)state;
+/*
+ * Compare the first `len` hex digits of two ids, in order; `b` is the
+ * prefix being looked for, anything in it past them is ignored.
+ */
+static int prefix_cmp(const git_oid *a, const git_oid *b, size_t len)
+{
+	int cmp = memcmp(a->id, b->id, len / 2);
 
-	if (git_buf_len(pathbuf) - sstate->dir_len != GIT_OID_HEXSZ - 2) {
-		/* Entry cannot be an object. Continue to next entry */
-		return 0;
+	if (!cmp && (len & 1))
+		cmp = (int)(a->id[len / 2] & 0xf0) - (int)(b->id[len / 2] & 0xf0);
+
+	return cmp;
+}
+
+/* Where in the listing the first id with the prefix is, or would be */
+static size_t fanout_position(loose_fanout *fanout, const git_oid *id, size_t len)
+{
+	size_t lo = 0, hi = fanout->count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (prefix_cmp(&fanout->ids[mid], id, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	if (git_path_isdir(pathbuf->ptr) == false) {
-		/* We are already in the directory matching the 2 first hex characters,
-		 * compare the first ncmp characters of the oids */
-		if (!memcmp(sstate->short_oid + 2,
-			(unsigned char *)pathbuf->ptr + sstate->dir_len,
-			sstate->short_oid_len - 2)) {
+	return lo;
+}
 
-			if (!sstate->found) {
-				sstate->res_oid[0] = sstate->short_oid[0];
-				sstate->res_oid[1] = sstate->short_oid[1];
-				memcpy(sstate->res_oid+2, pathbuf->ptr+sstate->dir_len, GIT_OID_HEXSZ-2);
-			}
-			sstate->found++;
-		}
+/* How many listed ids have the prefix, stopping at 2; `out` gets the first */
+static int fanout_search(
+	git_oid *out, loose_fanout *fanout, const git_oid *id, size_t len)
+{
+	size_t pos = fanout_position(fanout, id, len);
+	int found = 0;
+
+	for (; pos < fanout->count && found < 2; ++pos) {
+		if (prefix_cmp(&fanout->ids[pos], id, len))
+			break;
+		if (!found)
+			git_oid_cpy(out, &fanout->ids[pos]);
+		found++;
 	}
 
-	if (sstate->found > 1)
-		return git_odb__error_ambiguous("multiple matches in loose objects");
+	return found;
+}
+
+static int fanout_grow(loose_fanout *fanout)
+{
+	if (fanout->count == fanout->alloc) {
+		size_t alloc = fanout->alloc ? fanout->alloc * 2 : 16;
+		git_oid *ids = git__realloc(fanout->ids, alloc * sizeof(git_oid));
+		GITERR_CHECK_ALLOC(ids);
+
+		fanout->ids = ids;
+		fanout->alloc = alloc;
+	}
 
 	return 0;
 }
 
-/* Locate an object matching a given short oid */
-static int locate_object_short_oid(
-	git_buf *object_location,
-	git_oid *res_oid,
-	loose_backend *backend,
-	const git_oid *short_oid,
-	size_t len)
+static int fanout_list_cb(void *payload, git_buf *path)
 {
-	char *objects_dir = backend->objects_dir;
-	size_t dir_len = strlen(objects_dir);
-	loose_locate_object_state state;
-	int error;
+	loose_fanout *fanout = payload;
 
-	/* prealloc memory for OBJ_DIR/xx/ */
-	if (git_buf_grow(object_location, dir_len + 5) < 0)
-		return -1;
+	/* "xx/" and the 38 hex digits after it; anything else isn't an object */
+	if (git_buf_len(path) < GIT_OID_HEXSZ + 1 ||
+		filename_to_oid(&fanout->ids[fanout->count],
+			path->ptr + git_buf_len(path) - GIT_OID_HEXSZ - 1) < 0)
+		return 0;
 
-	git_buf_sets(object_location, objects_dir);
-	git_path_to_dir(object_location);
+	fanout->count++;
+	return fanout_grow(fanout);
+}
 
-	/* save adjusted position at end of dir so it can be restored later */
-	dir_len = git_buf_len(object_location);
+static int fanout_oid_cmp(const void *a, const void *b)
+{
+	return git_oid_cmp(a, b);
+}
 
-	/* Convert raw oid to hex formatted oid */
-	git_oid_fmt((char *)state.short_oid, short_oid);
+static int fanout_dir(git_buf *path, loose_backend *backend, unsigned char n)
+{
+	git_buf_sets(path, backend->objects_dir);
+	git_path_to_dir(path);
 
-	/* Explore OBJ_DIR/xx/ where xx is the beginning of hex formatted short oid */
-	if (git_buf_printf(object_location, "%.2s/", state.short_oid) < 0)
-		return -1;
+	return git_buf_printf(path, "%02x/", n);
+}
 
-	/* Check that directory exists */
-	if (git_path_isdir(object_location->ptr) == false)
-		return git_odb__error_notfound("no matching loose object for prefix", short_oid);
+static int fanout_load(loose_fanout *fanout, git_buf *path)
+{
+	int error;
 
-	state.dir_len = git_buf_len(object_location);
-	state.short_oid_len = len;
-	state.found = 0;
+	fanout->loaded = 0;
+	fanout->count = 0;
+	fanout->listed_at = (git_time_t)time(NULL);
 
-	/* Explore directory to find a unique object matching short_oid */
-	error = git_path_direach(
-		object_location, fn_locate_object_short_oid, &state);
-	if (error)
+	if ((error = fanout_grow(fanout)) < 0)
 		return error;
 
-	if (!state.found)
-		return git_odb__error_notfound("no matching loose object for prefix", short_oid);
+	/* stamped first, so a change made while listing shows up later */
+	error = git_futils_filestamp_check(&fanout->stamp, path->ptr);
 
-	/* Convert obtained hex formatted oid to raw */
-	error = git_oid_fromstr(res_oid, (char *)state.res_oid);
-	if (error)
+	if (error == GIT_ENOTFOUND) {
+		/* no objects with this first byte yet */
+		git_futils_filestamp_set(&fanout->stamp, NULL);
+		error = 0;
+	} else if (error >= 0)
+		error = git_path_direach(path, fanout_list_cb, fanout);
+
+	if (error < 0)
 		return error;
 
-	/* Update the location according to the oid obtained */
+	qsort(fanout->ids, fanout->count, sizeof(git_oid), fanout_oid_cmp);
+	fanout->loaded = 1;
+
+	return 0;
+}
+
+/* Returns > 0 if the directory may have changed since it was listed */
+static int fanout_changed(loose_fanout *fanout, const char *path)
+{
+	int changed = git_futils_filestamp_check(&fanout->stamp, path);
+
+	if (changed == GIT_ENOTFOUND)
+		return fanout->count > 0;
+
+	/* changes made in the second it was listed in can't be told apart */
+	if (changed == 0 && fanout->stamp.mtime >= fanout->listed_at)
+		changed = 1;
+
+	return changed;
+}
+
+/*
+ * Find the loose objects whose ids start with the first `len` hex
+ * digits of `id`. Returns how many there are, stopping at 2, and
+ * puts the first in `out`; or < 0 on error.
+ */
+static int fanout_find(
+	git_oid *out, loose_backend *backend, const git_oid *id, size_t len)
+{
+	loose_fanout *fanout;
+	git_buf path = GIT_BUF_INIT;
+	int error = 0, found = 0, fresh = 0;
 
-	git_buf_truncate(object_location, dir_len);
-	if (git_buf_grow(object_location, dir_len + GIT_OID_HEXSZ + 2) < 0)
+	if (git_mutex_lock(&backend->fanout_lock) < 0) {
+		giterr_set(GITERR_OS, "Failed to lock loose object cache");
 		return -1;
+	}
+
+	if (backend->fanout == NULL &&
+		(backend->fanout = git__calloc(256, sizeof(loose_fanout))) == NULL) {
+		error = -1;
+		goto done;
+	}
 
-	git_oid_pathfmt(object_location->ptr + dir_len, res_oid);
+	fanout = &backend->fanout[id->id[0]];
 
-	object_location->size += GIT_OID_HEXSZ + 1;
-	object_location->ptr[object_location->size] = '\0';
+	if ((error = fanout_dir(&path, backend, id->id[0])) < 0)
+		goto done;
 
-	return 0;
+	if (!fanout->loaded) {
+		if ((error = fanout_load(fanout, &path)) < 0)
+			goto done;
+		fresh = 1;
+	}
+
+	found = fanout_search(out, fanout, id, len);
+
+	/*
+	 * The listing is only right if nothing was added since, nor pruned
+	 * away: a hit has to be checked as much as a miss.
+	 */
+	if (!fresh) {
+		if ((error = fanout_changed(fanout, path.ptr)) > 0) {
+			if ((error = fanout_load(fanout, &path)) < 0)
+				goto done;
+			found = fanout_search(out, fanout, id, len);
+		}
+	}
+
+done:
+	if (error < 0)
+		found = error;
+
+	git_mutex_unlock(&backend->fanout_lock);
+	git_buf_free(&path);
+
+	return found;
+}
+
+/* Add an object we've just written to the listing of its directory */
+static void fanout_add(loose_backend *backend, const git_oid *id)
+{
+	loose_fanout *fanout;
+	size_t pos;
+
+	if (git_mutex_lock(&backend->fanout_lock) < 0)
+		return;
+
+	if (backend->fanout == NULL || !(fanout = &backend->fanout[id->id[0]])->loaded)
+		goto done;
+
+	pos = fanout_position(fanout, id, GIT_OID_HEXSZ);
+
+	if (pos < fanout->count && !git_oid_cmp(&fanout->ids[pos], id))
+		goto done;
+
+	/* on failure, the next miss lists the directory again */
+	if (fanout_grow(fanout) < 0) {
+		giterr_clear();
+		fanout->loaded = 0;
+		goto done;
+	}
+
+	memmove(&fanout->ids[pos + 1], &fanout->ids[pos],
+		(fanout->count - pos) * sizeof(git_oid));
+	git_oid_cpy(&fanout->ids[pos], id);
+	fanout->count++;
+
+done:
+	git_mutex_unlock(&backend->fanout_lock);
+}
+
+static void fanout_free(loose_backend *backend)
+{
+	size_t i;
+
+	if (backend->fanout == NULL)
+		return;
+
+	for (i = 0; i < 256; ++i)
+		git__free(backend->fanout[i].ids);
+
+	git__free(backend->fanout);
+	backend->fanout = NULL;
+}
+
+/* Locate an object matching a given short oid */
+static int locate_object_short_oid(
+	git_buf *object_location,
+	git_oid *res_oid,
+	loose_backend *backend,
+	const git_oid *short_oid,
+	size_t len)
+{
+	int found = fanout_find(res_oid, backend, short_oid, len);
+
+	if (found < 0)
+		return found;
+
+	if (!found)
+		return git_odb__error_notfound("no matching loose object for prefix", short_oid);
+
+	if (found > 1)
+		return git_odb__error_ambiguous("multiple matches in loose objects");
+
+	return object_file_name(object_location, backend->objects_dir, res_oid);
 }
 
 
@@ -589,9 +813,13 @@ static int loose_backend__read_header(size_t *len_p, git_otype *type_p, git_odb_
 	raw.len = 0;
 	raw.type = GIT_OBJ_BAD;
 
-	if (locate_object(&object_path, (loose_backend *)backend, oid) < 0)
+	error = object_file_name(&object_path, ((loose_backend *)backend)->objects_dir, oid);
+
+	/* no need to look for the file first, it's opened right away */
+	if (!error && (error = read_header_loose(&raw, &object_path)) == GIT_ENOTFOUND)
 		error = git_odb__error_notfound("no matching loose object", oid);
-	else if ((error = read_header_loose(&raw, &object_path)) == 0) {
+
+	if (!error) {
 		*len_p = raw.len;
 		*type_p = raw.type;
 	}
@@ -609,9 +837,12 @@ static int loose_backend__read(void **buffer_p, size_t *len_p, git_otype *type_p
 
 	assert(backend && oid);
 
-	if (locate_object(&object_path, (loose_backend *)backend, oid) < 0)
+	error = object_file_name(&object_path, ((loose_backend *)backend)->objects_dir, oid);
+
+	if (!error && (error = read_loose(&raw, &object_path)) == GIT_ENOTFOUND)
 		error = git_odb__error_notfound("no matching loose object", oid);
-	else if ((error = read_loose(&raw, &object_path)) == 0) {
+
+	if (!error) {
 		*buffer_p = raw.data;
 		*len_p = raw.len;
 		*type_p = raw.type;
@@ -665,10 +896,16 @@ static int loose_backend__read_prefix(
 static int loose_backend__exists(git_odb_backend *backend, const git_oid *oid)
 {
 	git_buf object_path = GIT_BUF_INIT;
+	git_oid found;
 	int error;
 
 	assert(backend && oid);
 
+	if ((error = fanout_find(&found, (loose_backend *)backend, oid, GIT_OID_HEXSZ)) >= 0)
+		return error > 0;
+
+	/* the directory couldn't be listed; look for the file itself */
+	giterr_clear();
 	error = locate_object(&object_path, (loose_backend *)backend, oid);
 
 	git_buf_free(&object_path);
@@ -683,34 +920,6 @@ struct foreach_state {
 	int cb_error;
 };
 
-GIT_INLINE(int) filename_to_oid(git_oid *oid, const char *ptr)
-{
-	int v, i = 0;
-	if (strlen(ptr) != 41)
-		return -1;
-
-	if (ptr[2] != '/') {
-		return -1;
-	}
-
-	v = (git__fromhex(ptr[i]) << 4) | git__fromhex(ptr[i+1]);
-	if (v < 0)
-		return -1;
-
-	oid->id[0] = (unsigned char) v;
-
-	ptr += 3;
-	for (i = 0; i < 38; i += 2) {
-		v = (git__fromhex(ptr[i]) << 4) | git__fromhex(ptr[i + 1]);
-		if (v < 0)
-			return -1;
-
-		oid->id[1 + i/2] = (unsigned char) v;
-	}
-
-	return 0;
-}
-
 static int foreach_object_dir_cb(void *_state, git_buf *path)
 {
 	git_oid oid;
@@ -783,6 +992,9 @@ static int loose_backend__stream_fwrite(git_oid *oid, git_odb_stream *_stream)
 		error = git_filebuf_commit_at(
 			&stream->fbuf, final_path.ptr, GIT_OBJECT_FILE_MODE);
 
+	if (!error)
+		fanout_add(backend, oid);
+
 	git_buf_free(&final_path);
 
 	return error;
@@ -884,6 +1096,8 @@ static int loose_backend__write(git_oid *oid, git_odb_backend *_backend, const v
 		git_futils_mkpath2file(final_path.ptr, GIT_OBJECT_DIR_MODE) < 0 ||
 		git_filebuf_commit_at(&fbuf, final_path.ptr, GIT_OBJECT_FILE_MODE) < 0)
 		error = -1;
+	else
+		fanout_add(backend, oid);
 
 cleanup:
 	if (error < 0)
@@ -898,6 +1112,8 @@ static void loose_backend__free(git_odb_backend *_backend)
 	assert(_backend);
 	backend = (loose_backend *)_backend;
 
+	fanout_free(backend);
+	git_mutex_free(&backend->fanout_lock);
 	git__free(backend->objects_dir);
 	git__free(backend);
 }
@@ -922,6 +1138,7 @@ int git_odb_backend_loose(
 
 	backend->object_zlib_level = compression_level;
 	backend->fsync_object_files = do_fsync;
+	git_mutex_init(&backend->fanout_lock);
 
 	backend->parent.read = &loose_backend__read;
 	backend->parent.write = &loose_backend__write;
@@ -16,14 +16,18 @@
 #include "sha1_lookup.h"
 #include "mwindow.h"
 #include "pack.h"
+#include "midx.h"
 
 #include "git2/odb_backend.h"
 
 struct pack_backend {
 	git_odb_backend parent;
-	git_vector packs;
+	git_midx_file *midx;
+	git_vector midx_packs; /* the packs in the midx, in its order */
+	git_vector packs; /* all other packs */
 	struct git_pack_file *last_found;
 	char *pack_folder;
+	git_futils_filestamp pack_folder_stamp;
 };
 
 struct pack_writepack {
@@ -73,6 +77,12 @@ struct pack_writepack {
  *		we prioritize the "newer" packs because it's more likely they
  *		contain the objects we are looking for, and we prioritize local
  *		packs over remote ones.
+ *	|
+ *	|-# refresh_multi_pack_index
+ *		If the `pack` folder has a `multi-pack-index`, load it and
+ *		set the packs it covers apart: objects in those packs are
+ *		found through the midx, and only the remaining packs are
+ *		searched one by one.
  *
  *
  *
@@ -85,7 +95,8 @@ struct pack_writepack {
  * | that have been loaded for our ODB.
  * |
  * |-# pack_entry_find
- *	| Iterate through all the packs that have been preloaded
+ *	| Look the OID up in the multi-pack-index, if there is one,
+ *	| then iterate through all the packs it does not cover
  *	| (starting by the pack where the latest object was found)
  *	| to try to find the OID in one of them.
  *	|
@@ -210,21 +221,32 @@ static int packfile_sort__cb(const void *a_, const void *b_)
 
 
 
+static int packfile_find_by_index(git_vector *packs, const char *idx_path)
+{
+	size_t len = strlen(idx_path) - strlen(".idx");
+	unsigned int i;
+
+	for (i = 0; i < packs->length; ++i) {
+		struct git_pack_file *p = git_vector_get(packs, i);
+		if (memcmp(p->pack_name, idx_path, len) == 0)
+			return (int)i;
+	}
+
+	return GIT_ENOTFOUND;
+}
+
 static int packfile_load__cb(void *_data, git_buf *path)
 {
 	struct pack_backend *backend = (struct pack_backend *)_data;
 	struct git_pack_file *pack;
 	int error;
-	unsigned int i;
 
 	if (git__suffixcmp(path->ptr, ".idx") != 0)
 		return 0; /* not an index */
 
-	for (i = 0; i < backend->packs.length; ++i) {
-		struct git_pack_file *p = git_vector_get(&backend->packs, i);
-		if (memcmp(p->pack_name, git_buf_cstr(path), git_buf_len(path) - strlen(".idx")) == 0)
-			return 0;
-	}
+	if (packfile_find_by_index(&backend->packs, path->ptr) >= 0 ||
+		packfile_find_by_index(&backend->midx_packs, path->ptr) >= 0)
+		return 0;
 
 	error = git_packfile_check(&pack, path->ptr);
 	if (error == GIT_ENOTFOUND)
@@ -264,13 +286,70 @@ static int pack_entry_find_inner(
 	return -1;
 }
 
+/* Search the packs of the multi-pack-index one at a time */
+static int pack_entry_find_midx_packs(
+	struct git_pack_entry *e,
+	struct pack_backend *backend,
+	const git_oid *short_oid,
+	size_t len)
+{
+	struct git_pack_entry found_e;
+	struct git_pack_file *p;
+	unsigned int i;
+	int error, found = 0;
+
+	git_vector_foreach(&backend->midx_packs, i, p) {
+		error = git_pack_entry_find(&found_e, p, short_oid, len);
+		if (error == GIT_EAMBIGUOUS)
+			return error;
+		if (error < 0) {
+			giterr_clear();
+			continue;
+		}
+
+		if (found && git_oid_cmp(&e->sha1, &found_e.sha1) != 0)
+			return git_odb__error_ambiguous("found multiple pack entries");
+
+		*e = found_e;
+		found = 1;
+	}
+
+	return found ? 0 : GIT_ENOTFOUND;
+}
+
+static int pack_entry_find_midx(
+	struct git_pack_entry *e,
+	struct pack_backend *backend,
+	const git_oid *short_oid,
+	size_t len)
+{
+	git_midx_entry m;
+	int error;
+
+	if (!backend->midx)
+		return GIT_ENOTFOUND;
+
+	error = git_midx_entry_find(&m, backend->midx, short_oid, len);
+	if (!error)
+		error = git_pack_entry_from_offset(e,
+			git_vector_get(&backend->midx_packs, m.pack_index), &m.sha1, m.offset);
+
+	if (!error || error == GIT_ENOTFOUND || error == GIT_EAMBIGUOUS)
+		return error;
+
+	/* the index or one of its packs is unusable, as in `exists_many` */
+	giterr_clear();
+	return pack_entry_find_midx_packs(e, backend, short_oid, len);
+}
+
 static int pack_entry_find(struct git_pack_entry *e, struct pack_backend *backend, const git_oid *oid)
 {
 	struct git_pack_file *last_found = backend->last_found;
+	int error;
 
-	if (backend->last_found &&
-		git_pack_entry_find(e, backend->last_found, oid, GIT_OID_HEXSZ) == 0)
-		return 0;
+	/* one search covers every pack in the multi-pack-index */
+	if ((error = pack_entry_find_midx(e, backend, oid, GIT_OID_HEXSZ)) != GIT_ENOTFOUND)
+		return error;
 
 	if (!pack_entry_find_inner(e, backend, oid, last_found))
 		return 0;
@@ -288,13 +367,25 @@ static unsigned pack_entry_find_prefix_inner(
 	int error;
 	unsigned int i;
 	unsigned found = 0;
+	git_oid found_id;
+
+	error = pack_entry_find_midx(e, backend, short_oid, len);
+	if (error == GIT_EAMBIGUOUS)
+		return error;
+	if (!error) {
+		git_oid_cpy(&found_id, &e->sha1);
+		found = 1;
+	}
 
 	if (last_found) {
 		error = git_pack_entry_find(e, last_found, short_oid, len);
 		if (error == GIT_EAMBIGUOUS)
 			return error;
-		if (!error)
-			found = 1;
+		/* an object may be both in a pack of the midx and in a newer one */
+		if (!error && (!found || git_oid_cmp(&found_id, &e->sha1) != 0)) {
+			git_oid_cpy(&found_id, &e->sha1);
+			found++;
+		}
 	}
 
 	for (i = 0; i < backend->packs.length; ++i) {
@@ -308,8 +399,11 @@ static unsigned pack_entry_find_prefix_inner(
 		if (error == GIT_EAMBIGUOUS)
 			return error;
 		if (!error) {
+			if (found && git_oid_cmp(&found_id, &e->sha1) == 0)
+				continue;
 			if (++found > 1)
 				break;
+			git_oid_cpy(&found_id, &e->sha1);
 			backend->last_found = p;
 		}
 	}
@@ -335,6 +429,93 @@ static int pack_entry_find_prefix(
 }
 
 
+/* Give the packs of the multi-pack-index back to the linear search */
+static int release_multi_pack_index(struct pack_backend *backend)
+{
+	struct git_pack_file *p;
+	unsigned int i;
+	int error = 0;
+
+	git_vector_foreach(&backend->midx_packs, i, p) {
+		if (git_vector_insert(&backend->packs, p) < 0) {
+			git_packfile_free(p);
+			error = -1;
+		}
+	}
+
+	git_vector_clear(&backend->midx_packs);
+	git_midx_free(backend->midx);
+	backend->midx = NULL;
+
+	return error;
+}
+
+static int refresh_multi_pack_index(struct pack_backend *backend)
+{
+	git_buf midx_path = GIT_BUF_INIT, idx_path = GIT_BUF_INIT;
+	git_midx_file *midx;
+	const char *name;
+	unsigned int i;
+	int error;
+
+	if ((error = git_buf_joinpath(&midx_path, backend->pack_folder, GIT_MIDX_FILE)) < 0)
+		return error;
+
+	if (backend->midx) {
+		if (!git_midx_needs_refresh(backend->midx, git_buf_cstr(&midx_path)))
+			goto done;
+
+		if ((error = release_multi_pack_index(backend)) < 0)
+			goto done;
+	}
+
+	if (!git_path_exists(git_buf_cstr(&midx_path)))
+		goto done;
+
+	if (git_midx_open(&midx, git_buf_cstr(&midx_path)) < 0) {
+		/* a broken midx only costs us the fast lookups */
+		giterr_clear();
+		goto done;
+	}
+
+	backend->midx = midx;
+
+	git_vector_foreach(&midx->packfile_names, i, name) {
+		struct git_pack_file *p;
+		int pos;
+
+		if ((error = git_buf_joinpath(&idx_path, backend->pack_folder, name)) < 0)
+			break;
+
+		if ((pos = packfile_find_by_index(&backend->packs, git_buf_cstr(&idx_path))) >= 0) {
+			p = git_vector_get(&backend->packs, pos);
+			git_vector_remove(&backend->packs, pos);
+		} else if ((error = git_packfile_check(&p, git_buf_cstr(&idx_path))) < 0)
+			break;
+
+		if ((error = git_vector_insert(&backend->midx_packs, p)) < 0) {
+			git_packfile_free(p);
+			break;
+		}
+	}
+
+	if (error < 0) {
+		/* a midx naming packs that are gone is stale; do without it */
+		if (release_multi_pack_index(backend) == 0 && error == GIT_ENOTFOUND) {
+			giterr_clear();
+			error = 0;
+		}
+	}
+
+	/* the midx knows where objects are; the packs' order says nothing */
+	backend->last_found = NULL;
+
+done:
+	git_buf_free(&midx_path);
+	git_buf_free(&idx_path);
+	return error;
+}
+
 /***********************************************************
  *
  * PACKED BACKEND PUBLIC API
@@ -347,26 +528,44 @@ static int pack_backend__refresh(git_odb_backend *_backend)
 	struct pack_backend *backend = (struct pack_backend *)_backend;
 
 	int error;
-	struct stat st;
+	time_t scan_time = time(NULL);
 	git_buf path = GIT_BUF_INIT;
 
 	if (backend->pack_folder == NULL)
 		return 0;
 
-	if (p_stat(backend->pack_folder, &st) < 0 || !S_ISDIR(st.st_mode))
+	/* Packs and indexes are only ever added, removed or renamed into
+	 * place, so the folder is unchanged since the last scan if its
+	 * stamp is. Misses can then refresh as often as they like. */
+	error = git_futils_filestamp_check(&backend->pack_folder_stamp, backend->pack_folder);
+	if (!error)
+		return 0;
+	else if (error < 0)
 		return git_odb__error_notfound("failed to refresh packfiles", NULL);
 
-	git_buf_sets(&path, backend->pack_folder);
+	/* load the multi-pack-index first, so its packs are not listed twice */
+	if ((error = refresh_multi_pack_index(backend)) == 0) {
+		git_buf_sets(&path, backend->pack_folder);
 
-	/* reload all packs */
-	error = git_path_direach(&path, packfile_load__cb, (void *)backend);
+		/* reload all packs */
+		error = git_path_direach(&path, packfile_load__cb, (void *)backend);
 
-	git_buf_free(&path);
+		git_buf_free(&path);
+	}
+
+	/* The mtime only has a resolution of a second, so a change later in
+	 * the second the folder was last changed may not show. Scan again
+	 * next time unless that second had already passed when we started. */
+	if (error < 0 || backend->pack_folder_stamp.mtime >= (git_time_t)scan_time)
+		git_futils_filestamp_set(&backend->pack_folder_stamp, NULL);
 
 	if (error < 0)
 		return error;
 
 	git_vector_sort(&backend->packs);
+
+	/* what the odb remembers as missing may be in the new packs */
+	git_odb__forget_missing(backend->parent.odb);
 	return 0;
 }
 
@@ -401,6 +600,63 @@ static int pack_backend__read(void **buffer_p, size_t *len_p, git_otype *type_p,
 	return 0;
 }
 
+typedef struct {
+	git_odb_stream parent;
+	git_packfile_reader *reader;
+} pack_readstream;
+
+static int pack_readstream__read(git_odb_stream *_stream, char *buffer, size_t len)
+{
+	pack_readstream *stream = (pack_readstream *)_stream;
+
+	if (len > INT_MAX)
+		len = INT_MAX;
+
+	return (int)git_packfile_reader_read(stream->reader, buffer, len);
+}
+
+static void pack_readstream__free(git_odb_stream *_stream)
+{
+	pack_readstream *stream = (pack_readstream *)_stream;
+
+	git_packfile_reader_free(stream->reader);
+	git__free(stream);
+}
+
+static int pack_backend__readstream_ext(
+	git_odb_stream **stream_out,
+	size_t *len_p,
+	git_otype *type_p,
+	git_odb_backend *backend,
+	const git_oid *oid)
+{
+	struct git_pack_entry e;
+	pack_readstream *stream;
+	int error;
+
+	assert(stream_out && len_p && type_p && backend && oid);
+
+	if ((error = pack_entry_find(&e, (struct pack_backend *)backend, oid)) < 0)
+		return error;
+
+	stream = git__calloc(1, sizeof(pack_readstream));
+	GITERR_CHECK_ALLOC(stream);
+
+	if ((error = git_packfile_reader_open(
+			&stream->reader, len_p, type_p, e.p, e.offset)) < 0) {
+		git__free(stream);
+		return error;
+	}
+
+	stream->parent.backend = backend;
+	stream->parent.read = &pack_readstream__read;
+	stream->parent.free = &pack_readstream__free;
+	stream->parent.mode = GIT_STREAM_RDONLY;
+
+	*stream_out = (git_odb_stream *)stream;
+	return 0;
+}
+
 static int pack_backend__read_prefix(
 	git_oid *out_oid,
 	void **buffer_p,
@@ -444,6 +700,42 @@ static int pack_backend__exists(git_odb_backend *backend, const git_oid *oid)
 	return pack_entry_find(&e, (struct pack_backend *)backend, oid) == 0;
 }
 
+static int pack_backend__exists_many(
+	git_odb_backend *_backend, unsigned char *found, const git_oid *ids, size_t count)
+{
+	struct pack_backend *backend = (struct pack_backend *)_backend;
+	struct git_pack_file *p;
+	bool use_midx = (backend->midx != NULL);
+	unsigned int i;
+
+	/* the midx answers for its packs in a single pass, as long as
+	 * they can all be opened and none has known bad objects */
+	git_vector_foreach(&backend->midx_packs, i, p) {
+		if (p->num_bad_objects || git_packfile_open(p) < 0) {
+			giterr_clear();
+			use_midx = false;
+			break;
+		}
+	}
+
+	if (use_midx)
+		git_midx_exists_many(found, backend->midx, ids, count);
+	else {
+		git_vector_foreach(&backend->midx_packs, i, p) {
+			if (git_pack_entry_exists_many(found, p, ids, count) < 0)
+				giterr_clear();
+		}
+	}
+
+	/* a pack that can't be opened has no objects, as for `exists` */
+	git_vector_foreach(&backend->packs, i, p) {
+		if (git_pack_entry_exists_many(found, p, ids, count) < 0)
+			giterr_clear();
+	}
+
+	return 0;
+}
+
 static int pack_backend__foreach(git_odb_backend *_backend, git_odb_foreach_cb cb, void *data)
 {
 	int error;
@@ -458,6 +750,11 @@ static int pack_backend__foreach(git_odb_backend *_backend, git_odb_foreach_cb c
 	if ((error = pack_backend__refresh(_backend)) < 0)
 		return error;
 
+	git_vector_foreach(&backend->midx_packs, i, p) {
+		if ((error = git_pack_foreach_entry(p, cb, data)) < 0)
+			return error;
+	}
+
 	git_vector_foreach(&backend->packs, i, p) {
 		if ((error = git_pack_foreach_entry(p, cb, data)) < 0)
 			return error;
@@ -466,6 +763,49 @@ static int pack_backend__foreach(git_odb_backend *_backend, git_odb_foreach_cb c
 	return 0;
 }
 
+static int pack_backend__writemidx(git_odb_backend *_backend)
+{
+	struct pack_backend *backend;
+	struct git_pack_file *p;
+	git_vector packs = GIT_VECTOR_INIT;
+	unsigned int i;
+	int error;
+
+	assert(_backend);
+	backend = (struct pack_backend *)_backend;
+
+	if (backend->pack_folder == NULL)
+		return 0;
+
+	/* Make sure we know about the packfiles */
+	if ((error = pack_backend__refresh(_backend)) < 0)
+		return error;
+
+	if ((error = git_vector_init(&packs,
+			backend->midx_packs.length + backend->packs.length, NULL)) < 0)
+		return error;
+
+	git_vector_foreach(&backend->midx_packs, i, p) {
+		if ((error = git_vector_insert(&packs, p)) < 0)
+			goto done;
+	}
+
+	git_vector_foreach(&backend->packs, i, p) {
+		if ((error = git_vector_insert(&packs, p)) < 0)
+			goto done;
+	}
+
+	if ((error = git_midx_write(backend->pack_folder, &packs)) < 0)
+		goto done;
+
+	/* and start using it */
+	error = pack_backend__refresh(_backend);
+
+done:
+	git_vector_free(&packs);
+	return error;
+}
+
 static int pack_backend__writepack_add(struct git_odb_writepack *_writepack, const void *data, size_t size, git_transfer_progress *stats)
 {
 	struct pack_writepack *writepack = (struct pack_writepack *)_writepack;
@@ -478,10 +818,16 @@ static int pack_backend__writepack_add(struct git_odb_writepack *_writepack, con
 static int pack_backend__writepack_commit(struct git_odb_writepack *_writepack, git_transfer_progress *stats)
 {
 	struct pack_writepack *writepack = (struct pack_writepack *)_writepack;
+	int error;
 
 	assert(writepack);
 
-	return git_indexer_stream_finalize(writepack->indexer_stream, stats);
+	if ((error = git_indexer_stream_finalize(writepack->indexer_stream, stats)) < 0)
+		return error;
+
+	/* the new pack is only seen after a refresh */
+	git_odb__forget_missing(writepack->parent.backend->odb);
+	return 0;
 }
 
 static void pack_backend__writepack_free(struct git_odb_writepack *_writepack)
@@ -536,12 +882,19 @@ static void pack_backend__free(git_odb_backend *_backend)
 
 	backend = (struct pack_backend *)_backend;
 
+	for (i = 0; i < backend->midx_packs.length; ++i) {
+		struct git_pack_file *p = git_vector_get(&backend->midx_packs, i);
+		git_packfile_free(p);
+	}
+
 	for (i = 0; i < backend->packs.length; ++i) {
 		struct git_pack_file *p = git_vector_get(&backend->packs, i);
 		git_packfile_free(p);
 	}
 
+	git_vector_free(&backend->midx_packs);
 	git_vector_free(&backend->packs);
+	git_midx_free(backend->midx);
 	git__free(backend->pack_folder);
 	git__free(backend);
 }
@@ -568,6 +921,8 @@ int git_odb_backend_one_pack(git_odb_backend **backend_out, const char *idx)
 	backend->parent.read_prefix = &pack_backend__read_prefix;
 	backend->parent.read_header = &pack_backend__read_header;
 	backend->parent.exists = &pack_backend__exists;
+	backend->parent.exists_many = &pack_backend__exists_many;
+	backend->parent.readstream_ext = &pack_backend__readstream_ext;
 	backend->parent.refresh = &pack_backend__refresh;
 	backend->parent.foreach = &pack_backend__foreach;
 	backend->parent.free = &pack_backend__free;
@@ -612,9 +967,12 @@ int git_odb_backend_pack(git_odb_backend **backend_out, const char *objects_dir)
 	backend->parent.read_prefix = &pack_backend__read_prefix;
 	backend->parent.read_header = &pack_backend__read_header;
 	backend->parent.exists = &pack_backend__exists;
+	backend->parent.exists_many = &pack_backend__exists_many;
+	backend->parent.readstream_ext = &pack_backend__readstream_ext;
 	backend->parent.refresh = &pack_backend__refresh;
 	backend->parent.foreach = &pack_backend__foreach;
 	backend->parent.writepack = &pack_backend__writepack;
+	backend->parent.writemidx = &pack_backend__writemidx;
 	backend->parent.free = &pack_backend__free;
 
 	*backend_out = (git_odb_backend *)backend;
@@ -11,6 +11,17 @@
 #include <string.h>
 #include <limits.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#	define GIT_OID_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if defined(GIT_OID_SSE2) && defined(__GNUC__) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#	define GIT_OID_AVX2
+#	include <immintrin.h>
+#endif
+
 static char to_hex[] = "0123456789abcdef";
 
 static int oid_error_invalid(const char *msg)
@@ -71,6 +82,235 @@ void git_oid_fmt(char *str, const git_oid *oid)
 		str = fmt_one(str, oid->id[i]);
 }
 
+/*
+ * Bulk hex codecs
+ *
+ * A run of oids is just a run of bytes, so formatting or parsing many
+ * of them at once is plain hex encoding over the whole buffer. The
+ * vectorized versions handle as many full blocks as they can and
+ * return how far they got; the scalar ones finish the job (and are
+ * the ones reporting invalid characters).
+ */
+
+static void hex_encode(char *out, const unsigned char *in, size_t len)
+{
+	while (len--)
+		out = fmt_one(out, *in++);
+}
+
+static int hex_decode(unsigned char *out, const char *str, size_t len)
+{
+	int v;
+
+	for (; len >= 2; len -= 2, str += 2) {
+		v = (git__fromhex(str[0]) << 4) | git__fromhex(str[1]);
+		if (v < 0)
+			return oid_error_invalid("contains invalid characters");
+		*out++ = (unsigned char)v;
+	}
+
+	return 0;
+}
+
+#ifdef GIT_OID_SSE2
+
+/* nibbles (0..15 per byte) to their lowercase hex digits */
+GIT_INLINE(__m128i) nibbles_to_hex_sse2(__m128i n)
+{
+	__m128i letters = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+	n = _mm_add_epi8(n, _mm_set1_epi8('0'));
+	return _mm_add_epi8(n, _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static size_t hex_encode_sse2(char *out, const unsigned char *in, size_t len)
+{
+	const __m128i low = _mm_set1_epi8(0x0f);
+	size_t done;
+
+	for (done = 0; done + 16 <= len; done += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + done));
+		__m128i hi = nibbles_to_hex_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), low));
+		__m128i lo = nibbles_to_hex_sse2(_mm_and_si128(v, low));
+
+		_mm_storeu_si128((__m128i *)(out + 2 * done), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(out + 2 * done + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+
+	return done;
+}
+
+/*
+ * Turns 16 hex digits into their 16 nibble values.
+ * Returns false if any of them is not a valid digit.
+ */
+GIT_INLINE(int) hex_to_nibbles_sse2(__m128i *out, __m128i c)
+{
+	__m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i digit = _mm_and_si128(
+		_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i alpha = _mm_and_si128(
+		_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+
+	if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+		return 0;
+
+	*out = _mm_or_si128(
+		_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+		_mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+	return 1;
+}
+
+/* [hi, lo] nibble pairs in each 16-bit lane to (hi << 4 | lo) */
+GIT_INLINE(__m128i) join_nibbles_sse2(__m128i n)
+{
+	__m128i hi = _mm_and_si128(n, _mm_set1_epi16(0x00ff));
+	return _mm_or_si128(_mm_slli_epi16(hi, 4), _mm_srli_epi16(n, 8));
+}
+
+static size_t hex_decode_sse2(unsigned char *out, const char *str, size_t len)
+{
+	size_t done;
+
+	for (done = 0; done + 32 <= len; done += 32) {
+		__m128i a, b;
+
+		if (!hex_to_nibbles_sse2(&a, _mm_loadu_si128((const __m128i *)(str + done))) ||
+			!hex_to_nibbles_sse2(&b, _mm_loadu_si128((const __m128i *)(str + done + 16))))
+			break;
+
+		_mm_storeu_si128((__m128i *)(out + done / 2),
+			_mm_packus_epi16(join_nibbles_sse2(a), join_nibbles_sse2(b)));
+	}
+
+	return done;
+}
+
+#endif
+
+#ifdef GIT_OID_AVX2
+
+#define GIT_AVX2 __attribute__((target("avx2")))
+
+GIT_AVX2 GIT_INLINE(__m256i) nibbles_to_hex_avx2(__m256i n)
+{
+	__m256i letters = _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9));
+	n = _mm256_add_epi8(n, _mm256_set1_epi8('0'));
+	return _mm256_add_epi8(n, _mm256_and_si256(letters, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+GIT_AVX2 static size_t hex_encode_avx2(char *out, const unsigned char *in, size_t len)
+{
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	size_t done;
+
+	for (done = 0; done + 32 <= len; done += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + done));
+		__m256i hi = nibbles_to_hex_avx2(_mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+		__m256i lo = nibbles_to_hex_avx2(_mm256_and_si256(v, low));
+		/* unpack works per 128-bit lane, so put the lanes back in order */
+		__m256i a = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b = _mm256_unpackhi_epi8(hi, lo);
+
+		_mm256_storeu_si256((__m256i *)(out + 2 * done), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(out + 2 * done + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+
+	return done;
+}
+
+GIT_AVX2 GIT_INLINE(int) hex_to_nibbles_avx2(__m256i *out, __m256i c)
+{
+	__m256i lc = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+	__m256i digit = _mm256_andnot_si256(
+		_mm256_cmpgt_epi8(c, _mm256_set1_epi8('9')),
+		_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)));
+	__m256i alpha = _mm256_andnot_si256(
+		_mm256_cmpgt_epi8(lc, _mm256_set1_epi8('f')),
+		_mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)));
+
+	if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1)
+		return 0;
+
+	*out = _mm256_or_si256(
+		_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+		_mm256_and_si256(alpha, _mm256_sub_epi8(lc, _mm256_set1_epi8('a' - 10))));
+	return 1;
+}
+
+GIT_AVX2 GIT_INLINE(__m256i) join_nibbles_avx2(__m256i n)
+{
+	__m256i hi = _mm256_and_si256(n, _mm256_set1_epi16(0x00ff));
+	return _mm256_or_si256(_mm256_slli_epi16(hi, 4), _mm256_srli_epi16(n, 8));
+}
+
+GIT_AVX2 static size_t hex_decode_avx2(unsigned char *out, const char *str, size_t len)
+{
+	size_t done;
+
+	for (done = 0; done + 64 <= len; done += 64) {
+		__m256i a, b;
+
+		if (!hex_to_nibbles_avx2(&a, _mm256_loadu_si256((const __m256i *)(str + done))) ||
+			!hex_to_nibbles_avx2(&b, _mm256_loadu_si256((const __m256i *)(str + done + 32))))
+			break;
+
+		/* pack works per 128-bit lane too */
+		_mm256_storeu_si256((__m256i *)(out + done / 2), _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(join_nibbles_avx2(a), join_nibbles_avx2(b)), 0xd8));
+	}
+
+	return done;
+}
+
+static int has_avx2(void)
+{
+	static int cached = -1;
+
+	if (cached < 0)
+		cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+	return cached;
+}
+
+#endif
+
+int git_oid_fromstr_many(git_oid *out, const char *str, size_t count)
+{
+	unsigned char *raw = (unsigned char *)out;
+	size_t len = count * GIT_OID_HEXSZ, done = 0;
+
+	assert(out && (str || !count));
+
+#ifdef GIT_OID_AVX2
+	if (has_avx2())
+		done = hex_decode_avx2(raw, str, len);
+#endif
+#ifdef GIT_OID_SSE2
+	done += hex_decode_sse2(raw + done / 2, str + done, len - done);
+#endif
+
+	return hex_decode(raw + done / 2, str + done, len - done);
+}
+
+void git_oid_fmt_many(char *out, const git_oid *ids, size_t count)
+{
+	const unsigned char *raw = (const unsigned char *)ids;
+	size_t len = count * GIT_OID_RAWSZ, done = 0;
+
+	assert(out && (ids || !count));
+
+#ifdef GIT_OID_AVX2
+	if (has_avx2())
+		done = hex_encode_avx2(out, raw, len);
+#endif
+#ifdef GIT_OID_SSE2
+	done += hex_encode_sse2(out + 2 * done, raw + done, len - done);
+#endif
+
+	hex_encode(out + 2 * done, raw + done, len - done);
+}
+
 void git_oid_pathfmt(char *str, const git_oid *oid)
 {
 	size_t i;
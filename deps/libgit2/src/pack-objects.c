@@ -12,6 +12,9 @@
 #include "iterator.h"
 #include "netops.h"
 #include "pack.h"
+#include "pack_bitmap.h"
+#include "repository.h"
+#include "revwalk.h"
 #include "thread-utils.h"
 #include "tree.h"
 
@@ -54,7 +57,7 @@ struct tree_walk_context {
 #define git_packbuilder__progress_lock(pb) GIT_PACKBUILDER__MUTEX_OP(pb, progress_mutex, lock)
 #define git_packbuilder__progress_unlock(pb) GIT_PACKBUILDER__MUTEX_OP(pb, progress_mutex, unlock)
 
-static unsigned name_hash(const char *name)
+unsigned int git_packbuilder__name_hash(const char *name)
 {
 	unsigned c, hash = 0;
 
@@ -169,15 +172,13 @@ static void rehash(git_packbuilder *pb)
 	}
 }
 
-int git_packbuilder_insert(git_packbuilder *pb, const git_oid *oid,
-			   const char *name)
+static int insert_object(git_packbuilder *pb, const git_oid *oid,
+			 unsigned int hash)
 {
 	git_pobject *po;
 	khiter_t pos;
 	int ret;
 
-	assert(pb && oid);
-
 	/* If the object already exists in the hash table, then we don't
 	 * have any work to do */
 	pos = kh_get(oid, pb->object_ix, oid);
@@ -200,7 +201,7 @@ int git_packbuilder_insert(git_packbuilder *pb, const git_oid *oid,
 
 	pb->nr_objects++;
 	git_oid_cpy(&po->id, oid);
-	po->hash = name_hash(name);
+	po->hash = hash;
 
 	pos = kh_put(oid, pb->object_ix, &po->id, &ret);
 	assert(ret != 0);
@@ -210,6 +211,14 @@ int git_packbuilder_insert(git_packbuilder *pb, const git_oid *oid,
 	return 0;
 }
 
+int git_packbuilder_insert(git_packbuilder *pb, const git_oid *oid,
+			   const char *name)
+{
+	assert(pb && oid);
+
+	return insert_object(pb, oid, git_packbuilder__name_hash(name));
+}
+
 /*
  * The per-object header is a pretty dense thing, which is
  *  - first byte: low four bits are "size",
@@ -1306,6 +1315,113 @@ int git_packbuilder_insert_tree(git_packbuilder *pb, const git_oid *oid)
 	return 0;
 }
 
+/*
+ * With a bitmap index, what a walk needs is what its tips reach and its
+ * hidden commits don't, without parsing a tree. Returns GIT_ENOTFOUND
+ * when there's no bitmap index, or the walk reaches something outside
+ * the pack it covers.
+ */
+static int insert_walk_bitmap(git_packbuilder *pb, git_revwalk *walk)
+{
+	static const git_otype order[] = {
+		GIT_OBJ_COMMIT, GIT_OBJ_TAG, GIT_OBJ_TREE, GIT_OBJ_BLOB
+	};
+	git_pack_bitmap_index *index;
+	git_bitmap want = GIT_BITMAP_INIT, have = GIT_BITMAP_INIT;
+	git_commit_stack wants = GIT_COMMIT_STACK_INIT, haves = GIT_COMMIT_STACK_INIT;
+	git_oid *ids = NULL;
+	size_t i, pos;
+	int error;
+
+	if (walk->walking)
+		return GIT_ENOTFOUND;
+
+	if ((error = git_repository__pack_bitmap(&index, pb->repo)) < 0)
+		return error;
+	if (index == NULL)
+		return GIT_ENOTFOUND;
+
+	if (walk->one != GIT_COMMIT_IDX_NONE &&
+		(error = git_commit_stack_push(&wants, walk->one)) < 0)
+		goto cleanup;
+
+	for (i = 0; i < walk->twos.length; ++i) {
+		git_commit_idx commit = walk->twos.ids[i];
+		int hidden = walk->commits.flags[commit] & COMMIT_UNINTERESTING;
+
+		if ((error = git_commit_stack_push(hidden ? &haves : &wants, commit)) < 0)
+			goto cleanup;
+	}
+
+	if ((ids = git__malloc(max(wants.length, haves.length) * sizeof(git_oid) + 1)) == NULL) {
+		error = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < haves.length; ++i)
+		git_oid_cpy(&ids[i], &walk->commits.oids[haves.ids[i]]);
+	if ((error = git_pack_bitmap_fill(&have, index, pb->repo, ids, haves.length,
+			git_pack_bitmap_lookup, index, NULL)) < 0)
+		goto cleanup;
+
+	for (i = 0; i < wants.length; ++i)
+		git_oid_cpy(&ids[i], &walk->commits.oids[wants.ids[i]]);
+	if ((error = git_pack_bitmap_fill(&want, index, pb->repo, ids, wants.length,
+			git_pack_bitmap_lookup, index, NULL)) < 0)
+		goto cleanup;
+
+	git_bitmap_and_not(&want, &have);
+
+	/* commits first, then the rest, as git_packbuilder_insert prefers */
+	for (i = 0; i < ARRAY_SIZE(order); ++i) {
+		const git_bitmap *type = &index->types[order[i] - GIT_OBJ_COMMIT];
+
+		for (pos = 0; !error && git_bitmap_next(&pos, &want) == 0; ++pos) {
+			if (git_bitmap_get(type, pos))
+				error = insert_object(pb, git_pack_bitmap_oid(index, (uint32_t)pos),
+					git_pack_bitmap_name_hash(index, (uint32_t)pos));
+		}
+	}
+
+cleanup:
+	git__free(ids);
+	git_commit_stack_free(&wants);
+	git_commit_stack_free(&haves);
+	git_bitmap_free(&want);
+	git_bitmap_free(&have);
+	git_pack_bitmap_free(index);
+	return error;
+}
+
+int git_packbuilder_insert_walk(git_packbuilder *pb, git_revwalk *walk)
+{
+	git_oid id;
+	int error;
+
+	assert(pb && walk);
+
+	if ((error = insert_walk_bitmap(pb, walk)) != GIT_ENOTFOUND)
+		return error;
+
+	while ((error = git_revwalk_next(&id, walk)) == 0) {
+		git_commit *commit;
+
+		if ((error = git_commit_lookup(&commit, pb->repo, &id)) < 0)
+			return error;
+
+		error = git_packbuilder_insert(pb, &id, NULL);
+		if (!error)
+			error = git_packbuilder_insert_tree(pb, git_commit_tree_id(commit));
+
+		git_commit_free(commit);
+
+		if (error < 0)
+			return error;
+	}
+
+	return error == GIT_ITEROVER ? 0 : error;
+}
+
 uint32_t git_packbuilder_object_count(git_packbuilder *pb)
 {
 	return pb->nr_objects;
@@ -84,4 +84,7 @@ struct git_packbuilder {
 
 int git_packbuilder_write_buf(git_buf *buf, git_packbuilder *pb);
 
+/* The delta search's hint of how alike two objects are, from their paths */
+unsigned int git_packbuilder__name_hash(const char *name);
+
 #endif /* INCLUDE_pack_objects_h__ */
@@ -11,6 +11,7 @@
 #include "delta-apply.h"
 #include "sha1_lookup.h"
 #include "mwindow.h"
+#include "global.h"
 #include "fileops.h"
 
 #include "git2/oid.h"
@@ -25,6 +26,12 @@ int packfile_unpack_compressed(
 		git_off_t *curpos,
 		size_t size,
 		git_otype type);
+static int packfile_inflate(
+		unsigned char *buffer,
+		struct git_pack_file *p,
+		git_mwindow **w_curs,
+		git_off_t *curpos,
+		size_t size);
 
 /* Can find the offset of an object given
  * a prefix of an identifier.
@@ -50,12 +57,26 @@ static int packfile_error(const char *message)
  * Delta base cache
  ********************/
 
-static git_pack_cache_entry *new_cache_object(git_rawobj *source)
+size_t git_pack__cache_memory_limit = GIT_PACK_CACHE_MEMORY_LIMIT;
+size_t git_pack__cache_size_limit = GIT_PACK_CACHE_SIZE_LIMIT;
+
+/* Whenever you want to read or modify this, grab git__delta_base_mutex */
+static struct {
+	git_pack_cache_entry lru; /* sentinel: lru.next is the most recently used */
+	size_t memory_used, entries;
+	size_t hits, misses, stores, evictions;
+} delta_bases = { { &delta_bases.lru, &delta_bases.lru } };
+
+static git_pack_cache_entry *new_cache_object(
+	struct git_pack_file *p, git_off_t offset, git_rawobj *source)
 {
 	git_pack_cache_entry *e = git__calloc(1, sizeof(git_pack_cache_entry));
 	if (!e)
 		return NULL;
 
+	e->p = p;
+	e->offset = offset;
+	git_atomic_set(&e->refcount, 1);
 	memcpy(&e->raw, source, sizeof(git_rawobj));
 
 	return e;
@@ -72,30 +93,69 @@ static void free_cache_object(void *o)
 	}
 }
 
+static void cache_release(git_pack_cache_entry *e)
+{
+	if (git_atomic_dec(&e->refcount) == 0)
+		free_cache_object(e);
+}
+
+GIT_INLINE(void) lru_unlink(git_pack_cache_entry *e)
+{
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+}
+
+GIT_INLINE(void) lru_push_front(git_pack_cache_entry *e)
+{
+	e->prev = &delta_bases.lru;
+	e->next = delta_bases.lru.next;
+	e->next->prev = e;
+	delta_bases.lru.next = e;
+}
+
+/* Run with the cache lock held; entries still in use are freed by their last user */
+static void cache_drop(git_pack_cache_entry *e, khiter_t k)
+{
+	git_pack_cache *cache = &e->p->bases;
+
+	lru_unlink(e);
+	kh_del(off, cache->entries, k);
+
+	cache->memory_used -= e->raw.len;
+	delta_bases.memory_used -= e->raw.len;
+	delta_bases.entries--;
+
+	cache_release(e);
+}
+
+/* Run with the cache lock held */
+static void cache_evict_lru(size_t limit)
+{
+	while (delta_bases.memory_used > limit && delta_bases.lru.prev != &delta_bases.lru) {
+		git_pack_cache_entry *e = delta_bases.lru.prev;
+
+		cache_drop(e, kh_get(off, e->p->bases.entries, e->offset));
+		delta_bases.evictions++;
+	}
+}
+
 static void cache_free(git_pack_cache *cache)
 {
 	khiter_t k;
 
+	if (git_mutex_lock(&git__delta_base_mutex) < 0)
+		return;
+
 	if (cache->entries) {
 		for (k = kh_begin(cache->entries); k != kh_end(cache->entries); k++) {
 			if (kh_exist(cache->entries, k))
-				free_cache_object(kh_value(cache->entries, k));
+				cache_drop(kh_value(cache->entries, k), k);
 		}
 
 		git_offmap_free(cache->entries);
-		git_mutex_free(&cache->lock);
 	}
-}
-
-static int cache_init(git_pack_cache *cache)
-{
-	memset(cache, 0, sizeof(git_pack_cache));
-	cache->entries = git_offmap_alloc();
-	GITERR_CHECK_ALLOC(cache->entries);
-	cache->memory_limit = GIT_PACK_CACHE_MEMORY_LIMIT;
-	git_mutex_init(&cache->lock);
 
-	return 0;
+	git_mutex_unlock(&git__delta_base_mutex);
 }
 
 static git_pack_cache_entry *cache_get(git_pack_cache *cache, git_off_t offset)
@@ -103,77 +163,111 @@ static git_pack_cache_entry *cache_get(git_pack_cache *cache, git_off_t offset)
 	khiter_t k;
 	git_pack_cache_entry *entry = NULL;
 
-	if (git_mutex_lock(&cache->lock) < 0)
+	if (git_mutex_lock(&git__delta_base_mutex) < 0)
 		return NULL;
 
-	k = kh_get(off, cache->entries, offset);
-	if (k != kh_end(cache->entries)) { /* found it */
-		entry = kh_value(cache->entries, k);
-		git_atomic_inc(&entry->refcount);
-		entry->last_usage = cache->use_ctr++;
+	if (cache->entries != NULL) {
+		k = kh_get(off, cache->entries, offset);
+		if (k != kh_end(cache->entries)) { /* found it */
+			entry = kh_value(cache->entries, k);
+			git_atomic_inc(&entry->refcount);
+
+			lru_unlink(entry);
+			lru_push_front(entry);
+		}
 	}
-	git_mutex_unlock(&cache->lock);
+
+	if (entry)
+		delta_bases.hits++;
+	else
+		delta_bases.misses++;
+
+	git_mutex_unlock(&git__delta_base_mutex);
 
 	return entry;
 }
 
-/* Run with the cache lock held */
-static void free_lowest_entry(git_pack_cache *cache)
+/*
+ * Unless `evict` is set, the base is only added if it fits in the budget
+ * without pushing anything else out.
+ */
+static int cache_add(struct git_pack_file *p, git_rawobj *base, git_off_t offset, int evict)
 {
+	git_pack_cache *cache = &p->bases;
 	git_pack_cache_entry *entry;
+	int error;
 	khiter_t k;
 
-	for (k = kh_begin(cache->entries); k != kh_end(cache->entries); k++) {
-		if (!kh_exist(cache->entries, k))
-			continue;
+	if (base->len > git_pack__cache_size_limit ||
+		base->len > git_pack__cache_memory_limit)
+		return -1;
 
-		entry = kh_value(cache->entries, k);
+	if ((entry = new_cache_object(p, offset, base)) == NULL)
+		return -1;
 
-		if (entry && entry->refcount.val == 0) {
-			cache->memory_used -= entry->raw.len;
-			kh_del(off, cache->entries, k);
-			free_cache_object(entry);
-		}
+	if (git_mutex_lock(&git__delta_base_mutex) < 0) {
+		giterr_set(GITERR_OS, "failed to lock cache");
+		git__free(entry);
+		return -1;
 	}
-}
 
-static int cache_add(git_pack_cache *cache, git_rawobj *base, git_off_t offset)
-{
-	git_pack_cache_entry *entry;
-	int error, exists = 0;
-	khiter_t k;
+	if (cache->entries == NULL)
+		cache->entries = git_offmap_alloc();
 
-	if (base->len > GIT_PACK_CACHE_SIZE_LIMIT)
+	/* Add it to the cache if nobody else has */
+	if (cache->entries == NULL ||
+		kh_get(off, cache->entries, offset) != kh_end(cache->entries) ||
+		(!evict && delta_bases.memory_used + base->len > git_pack__cache_memory_limit)) {
+		git_mutex_unlock(&git__delta_base_mutex);
+		git__free(entry);
 		return -1;
-
-	entry = new_cache_object(base);
-	if (entry) {
-		if (git_mutex_lock(&cache->lock) < 0) {
-			giterr_set(GITERR_OS, "failed to lock cache");
-			return -1;
-		}
-		/* Add it to the cache if nobody else has */
-		exists = kh_get(off, cache->entries, offset) != kh_end(cache->entries);
-		if (!exists) {
-			while (cache->memory_used + base->len > cache->memory_limit)
-				free_lowest_entry(cache);
-
-			k = kh_put(off, cache->entries, offset, &error);
-			assert(error != 0);
-			kh_value(cache->entries, k) = entry;
-			cache->memory_used += entry->raw.len;
-		}
-		git_mutex_unlock(&cache->lock);
-		/* Somebody beat us to adding it into the cache */
-		if (exists) {
-			git__free(entry);
-			return -1;
-		}
 	}
 
+	cache_evict_lru(git_pack__cache_memory_limit - base->len);
+
+	k = kh_put(off, cache->entries, offset, &error);
+	assert(error != 0);
+	kh_value(cache->entries, k) = entry;
+	lru_push_front(entry);
+
+	cache->memory_used += base->len;
+	delta_bases.memory_used += base->len;
+	delta_bases.entries++;
+	delta_bases.stores++;
+
+	git_mutex_unlock(&git__delta_base_mutex);
+
 	return 0;
 }
 
+void git_packfile_cache_trim(void)
+{
+	if (git_mutex_lock(&git__delta_base_mutex) < 0)
+		return;
+
+	cache_evict_lru(git_pack__cache_memory_limit);
+	git_mutex_unlock(&git__delta_base_mutex);
+}
+
+void git_odb_delta_base_cache_stats(git_cache_stats *out)
+{
+	assert(out);
+
+	memset(out, 0x0, sizeof(git_cache_stats));
+
+	if (git_mutex_lock(&git__delta_base_mutex) < 0)
+		return;
+
+	out->hits = delta_bases.hits;
+	out->misses = delta_bases.misses;
+	out->stores = delta_bases.stores;
+	out->evictions = delta_bases.evictions;
+	out->entries = delta_bases.entries;
+	out->bytes = delta_bases.memory_used;
+
+	git_mutex_unlock(&git__delta_base_mutex);
+}
+
 /***********************************************************
  *
  * PACK INDEX METHODS
@@ -455,38 +549,179 @@ int git_packfile_resolve_header(
 	return error;
 }
 
-static int packfile_unpack_delta(
-		git_rawobj *obj,
-		struct git_pack_file *p,
-		git_mwindow **w_curs,
-		git_off_t *curpos,
-		size_t delta_size,
-		git_otype delta_type,
-		git_off_t obj_offset)
+/* One delta of a chain, from the requested object down towards its base */
+struct delta_link {
+	git_off_t offset;   /* where the entry header starts; the base cache key */
+	git_off_t data_pos; /* where its compressed delta data starts */
+	size_t size;        /* inflated size of the delta */
+};
+
+#define DELTA_CHAIN_PREALLOC 32
+
+/*
+ * Each link of a delta chain is an object of its own, so a chain with
+ * more links than the pack has objects has to be coming back to itself.
+ * While the pack is still being indexed its object count isn't known;
+ * every entry takes at least a header byte, a base reference and a zlib
+ * stream, so fall back to an eighth of the pack's size then.
+ */
+#define DELTA_ENTRY_MIN_SIZE 8
+
+GIT_INLINE(bool) delta_chain_loops(struct git_pack_file *p, size_t depth)
 {
-	git_off_t base_offset, base_key;
-	git_rawobj base, delta;
-	git_pack_cache_entry *cached = NULL;
-	int error, found_base = 0;
+	if (p->num_objects > 0)
+		return depth > p->num_objects;
 
-	base_offset = get_delta_base(p, w_curs, curpos, delta_type, obj_offset);
-	git_mwindow_close(w_curs);
-	if (base_offset == 0)
-		return packfile_error("delta offset is zero");
-	if (base_offset < 0) /* must actually be an error code */
-		return (int)base_offset;
+	return (git_off_t)depth > p->mwf.size / DELTA_ENTRY_MIN_SIZE;
+}
 
-	if (!p->bases.entries && (cache_init(&p->bases) < 0))
-		return -1;
+/*
+ * Intermediate results this many links apart are always kept in the base
+ * cache; the others only while the cache has room to spare.
+ */
+#define DELTA_CHAIN_CACHE_STRIDE 8
+
+typedef struct {
+	unsigned char *ptr;
+	size_t alloc;
+} delta_scratch;
+
+static int scratch_reserve(delta_scratch *s, size_t size)
+{
+	if (s->alloc > size)
+		return 0;
+
+	git__free(s->ptr);
+	s->alloc = 0;
+
+	s->ptr = git__malloc(size + 1);
+	GITERR_CHECK_ALLOC(s->ptr);
+	s->alloc = size + 1;
+
+	return 0;
+}
 
-	base_key = base_offset; /* git_packfile_unpack modifies base_offset */
-	if ((cached = cache_get(&p->bases, base_offset)) != NULL) {
-		memcpy(&base, &cached->raw, sizeof(git_rawobj));
-		found_base = 1;
+static int cache_has_room(size_t len)
+{
+	int room;
+
+	if (len > git_pack__cache_size_limit ||
+		git_mutex_lock(&git__delta_base_mutex) < 0)
+		return 0;
+
+	room = (delta_bases.memory_used + len <= git_pack__cache_memory_limit);
+	git_mutex_unlock(&git__delta_base_mutex);
+
+	return room;
+}
+
+static void cache_copy(
+	struct git_pack_file *p, git_off_t offset,
+	const unsigned char *data, size_t len, git_otype type, int evict)
+{
+	git_rawobj copy;
+
+	if (len > git_pack__cache_size_limit || (!evict && !cache_has_room(len)))
+		return;
+
+	if ((copy.data = git__malloc(len + 1)) == NULL) {
+		giterr_clear();
+		return;
 	}
 
-	if (!cached) { /* have to inflate it */
-		error = git_packfile_unpack(&base, p, &base_offset);
+	memcpy(copy.data, data, len + 1);
+	copy.len = len;
+	copy.type = type;
+
+	if (cache_add(p, &copy, offset, evict) < 0)
+		git__free(copy.data);
+}
+
+/*
+ * Unpack an object stored as a chain of deltas.
+ *
+ * The chain is first walked down to a cached base or a full object,
+ * recording each link. The deltas are then applied bottom-up, with the
+ * results ping-ponging between two scratch buffers; the last one becomes
+ * the object. The chain's root, the object's own base and every few
+ * intermediate results are kept in the base cache for the chains that
+ * share them; the rest only if they fit without evicting anything.
+ */
+static int packfile_unpack_delta_chain(
+	git_rawobj *obj,
+	struct git_pack_file *p,
+	git_off_t *obj_offset,
+	git_off_t data_pos,
+	size_t size,
+	git_otype type)
+{
+	git_mwindow *w_curs = NULL;
+	struct delta_link chain_prealloc[DELTA_CHAIN_PREALLOC], *chain = chain_prealloc;
+	size_t depth = 0, chain_alloc = DELTA_CHAIN_PREALLOC, i;
+	git_off_t offset = *obj_offset, curpos = data_pos, base_offset;
+	git_pack_cache_entry *cached = NULL;
+	delta_scratch scratch[2] = {{NULL, 0}, {NULL, 0}}, delta = {NULL, 0};
+	git_rawobj root = { NULL, 0, GIT_OBJ_BAD };
+	const unsigned char *base;
+	size_t base_len, res_len = 0;
+	git_otype base_type;
+	int error = 0;
+
+	/* walk down to something we can start from */
+	for (;;) {
+		base_offset = get_delta_base(p, &w_curs, &curpos, type, offset);
+		git_mwindow_close(&w_curs);
+		if (base_offset == 0) {
+			error = packfile_error("delta offset is zero");
+			goto cleanup;
+		}
+		if (base_offset < 0) { /* must actually be an error code */
+			error = (int)base_offset;
+			goto cleanup;
+		}
+
+		if (depth == chain_alloc) {
+			struct delta_link *grown;
+
+			if (delta_chain_loops(p, depth)) {
+				error = packfile_error("delta chain loops");
+				goto cleanup;
+			}
+
+			grown = git__malloc(chain_alloc * 2 * sizeof(struct delta_link));
+			if (grown == NULL) {
+				error = -1;
+				goto cleanup;
+			}
+			memcpy(grown, chain, depth * sizeof(struct delta_link));
+
+			if (chain != chain_prealloc)
+				git__free(chain);
+			chain = grown;
+			chain_alloc *= 2;
+		}
+
+		chain[depth].offset = offset;
+		chain[depth].data_pos = curpos;
+		chain[depth].size = size;
+		depth++;
+
+		if ((cached = cache_get(&p->bases, base_offset)) != NULL)
+			break;
+
+		offset = curpos = base_offset;
+		error = git_packfile_unpack_header(&size, &type, &p->mwf, &w_curs, &curpos);
+		git_mwindow_close(&w_curs);
+		if (error < 0)
+			goto cleanup;
+
+		if (type == GIT_OBJ_OFS_DELTA || type == GIT_OBJ_REF_DELTA)
+			continue;
+
+		if (type < GIT_OBJ_COMMIT || type > GIT_OBJ_TAG) {
+			error = packfile_error("invalid packfile type in header");
+			goto cleanup;
+		}
 
 		/*
 		 * TODO: git.git tries to load the base from other packfiles
@@ -494,33 +729,75 @@ static int packfile_unpack_delta(
 		 *
 		 * We'll need to do this in order to support thin packs.
 		 */
-		if (error < 0)
-			return error;
+		if ((error = packfile_unpack_compressed(
+				&root, p, &w_curs, &curpos, size, type)) < 0)
+			goto cleanup;
+		break;
 	}
 
-	error = packfile_unpack_compressed(&delta, p, w_curs, curpos, delta_size, delta_type);
-	git_mwindow_close(w_curs);
+	if (cached) {
+		base = cached->raw.data;
+		base_len = cached->raw.len;
+		base_type = cached->raw.type;
+	} else {
+		base = root.data;
+		base_len = root.len;
+		base_type = root.type;
+	}
 
-	if (error < 0) {
-		if (!found_base)
-			git__free(base.data);
-		return error;
+	/* and climb back up, applying each delta to the previous result */
+	for (i = depth; i-- > 0; ) {
+		delta_scratch *out = &scratch[i & 1];
+		size_t base_sz;
+
+		curpos = chain[i].data_pos;
+
+		if ((error = scratch_reserve(&delta, chain[i].size)) < 0 ||
+			(error = packfile_inflate(delta.ptr, p, &w_curs, &curpos, chain[i].size)) < 0)
+			goto cleanup;
+
+		if (git__delta_read_header(delta.ptr, chain[i].size, &base_sz, &res_len) < 0) {
+			error = packfile_error("corrupt delta header");
+			goto cleanup;
+		}
+
+		if ((error = scratch_reserve(out, res_len)) < 0 ||
+			(error = git__delta_apply_buf(out->ptr, res_len,
+				base, base_len, delta.ptr, chain[i].size)) < 0)
+			goto cleanup;
+
+		if (i == 0)
+			*obj_offset = curpos;
+		else
+			cache_copy(p, chain[i].offset, out->ptr, res_len, base_type,
+				i == 1 || (depth - i) % DELTA_CHAIN_CACHE_STRIDE == 0);
+
+		base = out->ptr;
+		base_len = res_len;
 	}
 
-	obj->type = base.type;
-	error = git__delta_apply(obj, base.data, base.len, delta.data, delta.len);
-	if (error < 0)
-		goto on_error;
+	/* the last result is handed over to the caller */
+	obj->data = scratch[0].ptr;
+	obj->len = res_len;
+	obj->type = base_type;
+	scratch[0].ptr = NULL;
 
-	if (found_base)
-		git_atomic_dec(&cached->refcount);
-	else if (cache_add(&p->bases, &base, base_key) < 0)
-		git__free(base.data);
+	/* the root of the chain is shared by every object built on it */
+	if (root.data != NULL && cache_add(p, &root, base_offset, 1) == 0)
+		root.data = NULL;
 
-on_error:
-	git__free(delta.data);
+cleanup:
+	if (cached)
+		cache_release(cached);
+	if (chain != chain_prealloc)
+		git__free(chain);
 
-	return error; /* error set by git__delta_apply */
+	git__free(root.data);
+	git__free(scratch[0].ptr);
+	git__free(scratch[1].ptr);
+	git__free(delta.ptr);
+
+	return error;
 }
 
 int git_packfile_unpack(
@@ -552,10 +829,8 @@ int git_packfile_unpack(
 	switch (type) {
 	case GIT_OBJ_OFS_DELTA:
 	case GIT_OBJ_REF_DELTA:
-		error = packfile_unpack_delta(
-				obj, p, &w_curs, &curpos,
-				size, type, *obj_offset);
-		break;
+		return packfile_unpack_delta_chain(
+				obj, p, obj_offset, curpos, size, type);
 
 	case GIT_OBJ_COMMIT:
 	case GIT_OBJ_TREE:
@@ -600,7 +875,6 @@ int git_packfile_stream_open(git_packfile_stream *obj, struct git_pack_file *p,
 	obj->zstream.next_out = Z_NULL;
 	st = inflateInit(&obj->zstream);
 	if (st != Z_OK) {
-		git__free(obj);
 		giterr_set(GITERR_ZLIB, "Failed to inflate packfile");
 		return -1;
 	}
@@ -653,20 +927,550 @@ void git_packfile_stream_free(git_packfile_stream *obj)
 	inflateEnd(&obj->zstream);
 }
 
-int packfile_unpack_compressed(
-	git_rawobj *obj,
+/*
+ * Object readers
+ *
+ * An object too large to keep in memory whole is inflated as it's read.
+ * A delta is applied the same way: its instructions are inflated as
+ * they're needed, and the data they copy is read from a reader of its
+ * base. That reader keeps the last GIT_PACKFILE_READER_WINDOW bytes it
+ * produced, as a delta may copy the same part of its base twice or out
+ * of order. A copy from further back has the base unpacked whole, once,
+ * rather than inflated again from the start for every such copy, as long
+ * as it's no larger than READER_LOAD_LIMIT. Objects no larger than the
+ * window, and bases found in the delta base cache, are simply kept in
+ * memory.
+ *
+ * Each streamed link of a chain holds an input buffer and a window, so
+ * only READER_MAX_DEPTH of them are; the base below the last one is
+ * unpacked whole, within the same limit.
+ */
+
+#define READER_INPUT_SIZE (64 * 1024)
+#define READER_MAX_DEPTH 16
+#define READER_LOAD_LIMIT (64 * 1024 * 1024)
+
+struct git_packfile_reader {
+	struct git_pack_file *p;
+	git_otype type;
+	git_off_t offset; /* of the object in the pack */
+	size_t size; /* of the content */
+	size_t pos; /* how much of it has been produced */
+
+	/* the whole content, when it's kept in memory */
+	const unsigned char *data;
+	unsigned char *owned;
+	git_pack_cache_entry *cached;
+
+	/* the compressed object or delta */
+	git_off_t data_pos;
+	git_packfile_stream zstream;
+	int zstream_open;
+
+	/* a delta: its base, and the instructions inflated so far */
+	git_packfile_reader *base;
+	unsigned char *in;
+	size_t in_pos, in_len;
+	size_t copy_from, copy_left, insert_left;
+
+	/* a base: the last bytes it produced, and room to skip forward */
+	unsigned char *window;
+	size_t window_used;
+	unsigned char *skip;
+};
+
+static int reader_zstream_start(git_packfile_reader *r)
+{
+	if (r->zstream_open) {
+		git_packfile_stream_free(&r->zstream);
+		r->zstream_open = 0;
+	}
+
+	if (git_packfile_stream_open(&r->zstream, r->p, r->data_pos) < 0)
+		return -1;
+
+	r->zstream_open = 1;
+	return 0;
+}
+
+static int reader_inflate(
+	git_packfile_reader *r, unsigned char *out, size_t len, size_t *written)
+{
+	for (;;) {
+		git_off_t before = r->zstream.curpos;
+		ssize_t n = git_packfile_stream_read(&r->zstream, out, len);
+
+		/* the input ended with a window before there was any output */
+		if (n == GIT_EBUFS && r->zstream.curpos != before)
+			continue;
+		if (n == GIT_EBUFS)
+			return packfile_error("object data is truncated");
+		if (n < 0)
+			return (int)n;
+
+		*written = (size_t)n;
+		return 0;
+	}
+}
+
+/* Have at least `need` bytes of delta instructions at `r->in + r->in_pos` */
+static int delta_fill(git_packfile_reader *r, size_t need)
+{
+	size_t n;
+
+	if (r->in_len - r->in_pos >= need)
+		return 0;
+
+	memmove(r->in, r->in + r->in_pos, r->in_len - r->in_pos);
+	r->in_len -= r->in_pos;
+	r->in_pos = 0;
+
+	while (r->in_len < need) {
+		if (reader_inflate(r, r->in + r->in_len, READER_INPUT_SIZE - r->in_len, &n) < 0)
+			return -1;
+		if (!n)
+			return packfile_error("delta is truncated");
+		r->in_len += n;
+	}
+
+	return 0;
+}
+
+static int delta_header_size(git_packfile_reader *r, size_t *out)
+{
+	size_t size = 0;
+	unsigned int shift = 0;
+	unsigned char c;
+
+	do {
+		if (delta_fill(r, 1) < 0)
+			return -1;
+		if (shift >= sizeof(size_t) * 8)
+			return packfile_error("delta header is too large");
+
+		c = r->in[r->in_pos++];
+		size |= (size_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	*out = size;
+	return 0;
+}
+
+static int delta_start(git_packfile_reader *r, size_t *base_size, size_t *result_size)
+{
+	r->in_pos = r->in_len = 0;
+	r->copy_left = r->insert_left = 0;
+
+	if (reader_zstream_start(r) < 0 ||
+		delta_header_size(r, base_size) < 0 ||
+		delta_header_size(r, result_size) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void reader_close(git_packfile_reader *r)
+{
+	if (r->zstream_open) {
+		git_packfile_stream_free(&r->zstream);
+		r->zstream_open = 0;
+	}
+
+	git_packfile_reader_free(r->base);
+	r->base = NULL;
+
+	git__free(r->in);
+	git__free(r->window);
+	git__free(r->skip);
+	r->in = r->window = r->skip = NULL;
+}
+
+/* Stop streaming a base and keep all of its content in memory instead */
+static int reader_load(git_packfile_reader *r)
+{
+	git_rawobj raw;
+	git_off_t offset = r->offset;
+
+	if (r->size > READER_LOAD_LIMIT)
+		return packfile_error("delta base is too large to load whole");
+
+	if (git_packfile_unpack(&raw, r->p, &offset) < 0)
+		return -1;
+
+	if (raw.len != r->size) {
+		git__free(raw.data);
+		return packfile_error("delta base size doesn't match");
+	}
+
+	reader_close(r);
+	r->data = r->owned = raw.data;
+	return 0;
+}
+
+/* Remember `len` bytes just produced at `r->pos` */
+static void window_add(git_packfile_reader *r, const unsigned char *data, size_t len)
+{
+	size_t pos = r->pos, at, first;
+
+	r->window_used = min(r->window_used + len, GIT_PACKFILE_READER_WINDOW);
+
+	if (len > GIT_PACKFILE_READER_WINDOW) {
+		pos += len - GIT_PACKFILE_READER_WINDOW;
+		data += len - GIT_PACKFILE_READER_WINDOW;
+		len = GIT_PACKFILE_READER_WINDOW;
+	}
+
+	at = pos % GIT_PACKFILE_READER_WINDOW;
+	first = min(len, GIT_PACKFILE_READER_WINDOW - at);
+
+	memcpy(r->window + at, data, first);
+	memcpy(r->window, data + first, len - first);
+}
+
+static void window_get(git_packfile_reader *r, size_t pos, unsigned char *out, size_t len)
+{
+	size_t at = pos % GIT_PACKFILE_READER_WINDOW;
+	size_t first = min(len, GIT_PACKFILE_READER_WINDOW - at);
+
+	memcpy(out, r->window + at, first);
+	memcpy(out + first, r->window, len - first);
+}
+
+static int reader_read_at(git_packfile_reader *r, size_t pos, unsigned char *out, size_t len);
+
+static int delta_next_op(git_packfile_reader *r, size_t remaining)
+{
+	unsigned char cmd;
+
+	if (delta_fill(r, 1) < 0)
+		return -1;
+
+	cmd = r->in[r->in_pos++];
+
+	if (cmd & 0x80) {
+		size_t off = 0, len = 0, need = 0, i;
+
+		for (i = 0; i < 7; ++i)
+			need += (cmd >> i) & 1;
+		if (delta_fill(r, need) < 0)
+			return -1;
+
+		for (i = 0; i < 4; ++i)
+			if (cmd & (0x01 << i))
+				off |= (size_t)r->in[r->in_pos++] << (8 * i);
+		for (i = 0; i < 3; ++i)
+			if (cmd & (0x10 << i))
+				len |= (size_t)r->in[r->in_pos++] << (8 * i);
+		if (!len)
+			len = 0x10000;
+
+		if (off > r->base->size || len > r->base->size - off || len > remaining)
+			return packfile_error("delta copies more than there is");
+
+		r->copy_from = off;
+		r->copy_left = len;
+	} else if (cmd) {
+		if (cmd > remaining)
+			return packfile_error("delta inserts more than there is");
+
+		r->insert_left = cmd;
+	} else
+		return packfile_error("unexpected delta opcode 0");
+
+	return 0;
+}
+
+static int delta_produce(git_packfile_reader *r, unsigned char *out, size_t len)
+{
+	size_t done = 0, n;
+
+	while (done < len) {
+		if (r->copy_left) {
+			n = min(r->copy_left, len - done);
+			if (reader_read_at(r->base, r->copy_from, out + done, n) < 0)
+				return -1;
+
+			r->copy_from += n;
+			r->copy_left -= n;
+		} else if (r->insert_left) {
+			if (delta_fill(r, 1) < 0)
+				return -1;
+
+			n = min(min(r->insert_left, len - done), r->in_len - r->in_pos);
+			memcpy(out + done, r->in + r->in_pos, n);
+
+			r->in_pos += n;
+			r->insert_left -= n;
+		} else {
+			if (delta_next_op(r, r->size - r->pos - done) < 0)
+				return -1;
+			continue;
+		}
+
+		done += n;
+	}
+
+	return 0;
+}
+
+/* Produce the next bytes of the content, up to `len` of them */
+static int reader_produce(
+	git_packfile_reader *r, unsigned char *out, size_t len, size_t *written)
+{
+	len = min(len, r->size - r->pos);
+	*written = 0;
+
+	if (!len)
+		return 0;
+
+	if (r->data)
+		memcpy(out, r->data + r->pos, len);
+	else if (r->base) {
+		if (delta_produce(r, out, len) < 0)
+			return -1;
+	} else {
+		if (reader_inflate(r, out, len, &len) < 0)
+			return -1;
+		if (!len)
+			return packfile_error("object is shorter than its header says");
+	}
+
+	if (r->window)
+		window_add(r, out, len);
+
+	r->pos += len;
+	*written = len;
+	return 0;
+}
+
+/* Read `len` bytes of a base's content at `pos`, which the caller checked */
+static int reader_read_at(git_packfile_reader *r, size_t pos, unsigned char *out, size_t len)
+{
+	size_t n;
+
+	if (r->data) {
+		memcpy(out, r->data + pos, len);
+		return 0;
+	}
+
+	while (len > 0) {
+		if (pos < r->pos) {
+			if (r->pos - pos > r->window_used) {
+				if (reader_load(r) < 0)
+					return -1;
+
+				memcpy(out, r->data + pos, len);
+				return 0;
+			}
+
+			n = min(len, r->pos - pos);
+			window_get(r, pos, out, n);
+		} else if (pos > r->pos) {
+			/* what's skipped goes to the window */
+			if (reader_produce(r, r->skip,
+					min(pos - r->pos, READER_INPUT_SIZE), &n) < 0)
+				return -1;
+			continue;
+		} else if (reader_produce(r, out, len, &n) < 0)
+			return -1;
+
+		pos += n;
+		out += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Open a reader of the object at `offset`, `depth` links down a chain.
+ * A delta that's streamed gives back the offset of its base and the size
+ * the base must have, for the caller to open the next link; anything
+ * else gives back a zero offset.
+ */
+static int reader_open(
+	git_packfile_reader **out,
+	git_off_t *base_offset,
+	size_t *base_size,
+	struct git_pack_file *p,
+	git_off_t offset,
+	size_t depth)
+{
+	git_packfile_reader *r;
+	git_mwindow *w_curs = NULL;
+	git_off_t curpos = offset;
+	size_t size;
+	git_otype type;
+	int error;
+
+	*base_offset = 0;
+
+	r = git__calloc(1, sizeof(git_packfile_reader));
+	GITERR_CHECK_ALLOC(r);
+	r->p = p;
+	r->offset = offset;
+
+	/* a base that's cached is as good as read */
+	if (depth > 0 && (r->cached = cache_get(&p->bases, offset)) != NULL) {
+		r->data = r->cached->raw.data;
+		r->size = r->cached->raw.len;
+		r->type = r->cached->raw.type;
+		goto done;
+	}
+
+	error = git_packfile_unpack_header(&size, &type, &p->mwf, &w_curs, &curpos);
+	git_mwindow_close(&w_curs);
+	if (error < 0)
+		goto on_error;
+
+	if (type == GIT_OBJ_OFS_DELTA || type == GIT_OBJ_REF_DELTA) {
+		*base_offset = get_delta_base(p, &w_curs, &curpos, type, offset);
+		git_mwindow_close(&w_curs);
+		if (*base_offset <= 0) {
+			error = *base_offset ? (int)*base_offset :
+				packfile_error("delta offset is zero");
+			goto on_error;
+		}
+
+		r->data_pos = curpos;
+		if ((r->in = git__malloc(READER_INPUT_SIZE)) == NULL) {
+			error = -1;
+			goto on_error;
+		}
+		if ((error = delta_start(r, base_size, &r->size)) < 0)
+			goto on_error;
+	} else if (type >= GIT_OBJ_COMMIT && type <= GIT_OBJ_TAG) {
+		r->data_pos = curpos;
+		r->size = size;
+		r->type = type;
+	} else {
+		error = packfile_error("invalid packfile type in header");
+		goto on_error;
+	}
+
+	if (r->size <= GIT_PACKFILE_READER_WINDOW || depth == READER_MAX_DEPTH) {
+		git_rawobj raw;
+
+		if (r->size > READER_LOAD_LIMIT) {
+			error = packfile_error("delta chain is too deep to stream");
+			goto on_error;
+		}
+
+		if ((error = git_packfile_unpack(&raw, p, &offset)) < 0)
+			goto on_error;
+
+		reader_close(r);
+		*base_offset = 0;
+
+		r->data = r->owned = raw.data;
+		r->size = raw.len;
+		r->type = raw.type;
+		goto done;
+	}
+
+	if (!*base_offset && (error = reader_zstream_start(r)) < 0)
+		goto on_error;
+
+	if (depth > 0) {
+		r->window = git__malloc(GIT_PACKFILE_READER_WINDOW);
+		r->skip = git__malloc(READER_INPUT_SIZE);
+		if (r->window == NULL || r->skip == NULL) {
+			error = -1;
+			goto on_error;
+		}
+	}
+
+done:
+	*out = r;
+	return 0;
+
+on_error:
+	git_packfile_reader_free(r);
+	return error;
+}
+
+int git_packfile_reader_open(
+	git_packfile_reader **out,
+	size_t *size,
+	git_otype *type,
+	struct git_pack_file *p,
+	git_off_t offset)
+{
+	git_packfile_reader *top = NULL, **link = &top, *r;
+	git_off_t base_offset;
+	size_t base_size = 0, wanted, depth;
+	int error;
+
+	assert(out && size && type && p);
+
+	/* open the chain a link at a time, each delta reading from the next */
+	for (depth = 0; ; depth++) {
+		wanted = base_size;
+
+		if ((error = reader_open(link, &base_offset, &base_size, p, offset, depth)) < 0)
+			goto on_error;
+
+		if (depth > 0 && (*link)->size != wanted) {
+			error = packfile_error("delta base size doesn't match");
+			goto on_error;
+		}
+
+		if (!base_offset)
+			break;
+
+		offset = base_offset;
+		link = &(*link)->base;
+	}
+
+	/* the whole chain has the type of its root */
+	for (r = top; r != NULL; r = r->base)
+		r->type = (*link)->type;
+
+	*out = top;
+	*size = top->size;
+	*type = top->type;
+	return 0;
+
+on_error:
+	git_packfile_reader_free(top);
+	return error;
+}
+
+ssize_t git_packfile_reader_read(git_packfile_reader *r, void *buffer, size_t len)
+{
+	size_t written;
+
+	if (reader_produce(r, buffer, len, &written) < 0)
+		return -1;
+
+	return (ssize_t)written;
+}
+
+void git_packfile_reader_free(git_packfile_reader *r)
+{
+	if (r == NULL)
+		return;
+
+	if (r->cached)
+		cache_release(r->cached);
+
+	reader_close(r);
+	git__free(r->owned);
+	git__free(r);
+}
+
+/* Inflate exactly `size` bytes of object data at `curpos` into `buffer` */
+static int packfile_inflate(
+	unsigned char *buffer,
 	struct git_pack_file *p,
 	git_mwindow **w_curs,
 	git_off_t *curpos,
-	size_t size,
-	git_otype type)
+	size_t size)
 {
 	int st;
 	z_stream stream;
-	unsigned char *buffer, *in;
-
-	buffer = git__calloc(1, size + 1);
-	GITERR_CHECK_ALLOC(buffer);
+	unsigned char *in;
 
 	memset(&stream, 0, sizeof(stream));
 	stream.next_out = buffer;
@@ -676,7 +1480,6 @@ int packfile_unpack_compressed(
 
 	st = inflateInit(&stream);
 	if (st != Z_OK) {
-		git__free(buffer);
 		giterr_set(GITERR_ZLIB, "Failed to inflate packfile");
 
 		return -1;
@@ -693,7 +1496,6 @@ int packfile_unpack_compressed(
 
 		if (st == Z_BUF_ERROR && in == NULL) {
 			inflateEnd(&stream);
-			git__free(buffer);
 			return GIT_EBUFS;
 		}
 
@@ -703,11 +1505,33 @@ int packfile_unpack_compressed(
 	inflateEnd(&stream);
 
 	if ((st != Z_STREAM_END) || stream.total_out != size) {
-		git__free(buffer);
 		giterr_set(GITERR_ZLIB, "Failed to inflate packfile");
 		return -1;
 	}
 
+	buffer[size] = '\0';
+	return 0;
+}
+
+int packfile_unpack_compressed(
+	git_rawobj *obj,
+	struct git_pack_file *p,
+	git_mwindow **w_curs,
+	git_off_t *curpos,
+	size_t size,
+	git_otype type)
+{
+	int error;
+	unsigned char *buffer;
+
+	buffer = git__calloc(1, size + 1);
+	GITERR_CHECK_ALLOC(buffer);
+
+	if ((error = packfile_inflate(buffer, p, w_curs, curpos, size)) < 0) {
+		git__free(buffer);
+		return error;
+	}
+
 	obj->type = type;
 	obj->len = size;
 	obj->data = buffer;
@@ -788,11 +1612,19 @@ git_off_t get_delta_base(
 static struct git_pack_file *packfile_alloc(size_t extra)
 {
 	struct git_pack_file *p = git__calloc(1, sizeof(*p) + extra);
-	if (p != NULL)
+	if (p != NULL) {
+		git_mutex_init(&p->mwf.lock);
 		p->mwf.fd = -1;
+	}
 	return p;
 }
 
+static void packfile_free_unopened(struct git_pack_file *p)
+{
+	git_mutex_free(&p->mwf.lock);
+	git__free(p);
+}
+
 
 void git_packfile_free(struct git_pack_file *p)
 {
@@ -809,6 +1641,7 @@ void git_packfile_free(struct git_pack_file *p)
 	pack_index_free(p);
 
 	git__free(p->bad_object_sha1);
+	git_mutex_free(&p->mwf.lock);
 	git__free(p);
 }
 
@@ -897,7 +1730,7 @@ int git_packfile_check(struct git_pack_file **pack_out, const char *path)
 	 */
 	path_len -= strlen(".idx");
 	if (path_len < 1) {
-		git__free(p);
+		packfile_free_unopened(p);
 		return git_odb__error_notfound("invalid packfile path", NULL);
 	}
 
@@ -909,7 +1742,7 @@ int git_packfile_check(struct git_pack_file **pack_out, const char *path)
 
 	strcpy(p->pack_name + path_len, ".pack");
 	if (p_stat(p->pack_name, &st) < 0 || !S_ISREG(st.st_mode)) {
-		git__free(p);
+		packfile_free_unopened(p);
 		return git_odb__error_notfound("packfile not found", NULL);
 	}
 
@@ -1018,6 +1851,48 @@ int git_pack_foreach_entry(
 	return 0;
 }
 
+int git_pack_foreach_entry_offset(
+	struct git_pack_file *p,
+	git_pack_foreach_entry_offset_cb cb,
+	void *data)
+{
+	const unsigned char *index;
+	size_t stride;
+	uint32_t i;
+	int error;
+
+	if (p->index_map.data == NULL && (error = pack_index_open(p)) < 0)
+		return error;
+
+	index = (const unsigned char *)p->index_map.data + 4 * 256;
+
+	if (p->index_version > 1) {
+		index += 8;
+		stride = 20;
+	} else {
+		index += 4;
+		stride = 24;
+	}
+
+	for (i = 0; i < p->num_objects; i++) {
+		if (cb((const git_oid *)(index + i * stride), nth_packed_object_offset(p, i), data))
+			return GIT_EUSER;
+	}
+
+	return 0;
+}
+
+static bool is_bad_object(struct git_pack_file *p, const git_oid *id)
+{
+	unsigned i;
+
+	for (i = 0; i < p->num_bad_objects; i++)
+		if (git_oid_cmp(id, &p->bad_object_sha1[i]) == 0)
+			return true;
+
+	return false;
+}
+
 static int pack_entry_find_offset(
 	git_off_t *offset_out,
 	git_oid *found_oid,
@@ -1124,12 +1999,8 @@ int git_pack_entry_find(
 
 	assert(p);
 
-	if (len == GIT_OID_HEXSZ && p->num_bad_objects) {
-		unsigned i;
-		for (i = 0; i < p->num_bad_objects; i++)
-			if (git_oid_cmp(short_oid, &p->bad_object_sha1[i]) == 0)
-				return packfile_error("bad object found in packfile");
-	}
+	if (len == GIT_OID_HEXSZ && is_bad_object(p, short_oid))
+		return packfile_error("bad object found in packfile");
 
 	error = pack_entry_find_offset(&offset, &found_oid, p, short_oid, len);
 	if (error < 0)
@@ -1147,3 +2018,83 @@ int git_pack_entry_find(
 	git_oid_cpy(&e->sha1, &found_oid);
 	return 0;
 }
+
+int git_pack_entry_from_offset(
+		struct git_pack_entry *e,
+		struct git_pack_file *p,
+		const git_oid *oid,
+		git_off_t offset)
+{
+	int error;
+
+	if (is_bad_object(p, oid))
+		return packfile_error("bad object found in packfile");
+
+	if ((error = git_packfile_open(p)) < 0)
+		return error;
+
+	e->offset = offset;
+	e->p = p;
+
+	git_oid_cpy(&e->sha1, oid);
+	return 0;
+}
+
+int git_packfile_open(struct git_pack_file *p)
+{
+	int error;
+
+	/* opening the pack checks it against its index */
+	if (p->mwf.fd == -1 &&
+		((error = pack_index_open(p)) < 0 || (error = packfile_open(p)) < 0))
+		return error;
+
+	return 0;
+}
+
+int git_pack_entry_exists_many(
+		unsigned char *found,
+		struct git_pack_file *p,
+		const git_oid *ids,
+		size_t count)
+{
+	const uint32_t *level1_ofs;
+	const unsigned char *index;
+	size_t i;
+	int error;
+
+	/* bad objects are rare enough to take the slow path */
+	if (p->num_bad_objects) {
+		for (i = 0; i < count; ++i) {
+			struct git_pack_entry e;
+
+			if (!(found[i / 8] & (1 << (i % 8))) &&
+				git_pack_entry_find(&e, p, &ids[i], GIT_OID_HEXSZ) == 0)
+				found[i / 8] |= (1 << (i % 8));
+		}
+
+		giterr_clear();
+		return 0;
+	}
+
+	/* the objects are only there if the pack is */
+	if ((error = git_packfile_open(p)) < 0)
+		return error;
+
+	level1_ofs = p->index_map.data;
+	index = p->index_map.data;
+
+	if (p->index_version > 1) {
+		level1_ofs += 2;
+		index += 8;
+	}
+
+	index += 4 * 256;
+
+	if (p->index_version > 1)
+		sha1_entry_pos_many(found, ids->id, count, level1_ofs, index, 20, 0);
+	else
+		sha1_entry_pos_many(found, ids->id, count, level1_ofs, index + 4, 24, 0);
+
+	return 0;
+}
@@ -53,9 +53,16 @@ struct git_pack_idx_header {
 	uint32_t idx_version;
 };
 
+/*
+ * Delta bases of all pack files share one cache, with a single memory
+ * budget and a single LRU list. Each pack keeps an index of its own
+ * entries and the number of bytes they use.
+ */
 typedef struct git_pack_cache_entry {
-	size_t last_usage; /* enough? */
-	git_atomic refcount;
+	struct git_pack_cache_entry *prev, *next; /* LRU, most recent first */
+	struct git_pack_file *p;
+	git_off_t offset;
+	git_atomic refcount; /* one for the cache, one for each user */
 	git_rawobj raw;
 } git_pack_cache_entry;
 
@@ -63,14 +70,14 @@ typedef struct git_pack_cache_entry {
 
 GIT__USE_OFFMAP;
 
-#define GIT_PACK_CACHE_MEMORY_LIMIT 16 * 1024 * 1024
-#define GIT_PACK_CACHE_SIZE_LIMIT 1024 * 1024 /* don't bother caching anything over 1MB */
+#define GIT_PACK_CACHE_MEMORY_LIMIT (96 * 1024 * 1024)
+#define GIT_PACK_CACHE_SIZE_LIMIT (1024 * 1024) /* don't bother caching anything over 1MB */
+
+extern size_t git_pack__cache_memory_limit;
+extern size_t git_pack__cache_size_limit;
 
 typedef struct {
 	size_t memory_used;
-	size_t memory_limit;
-	size_t use_ctr;
-	git_mutex lock;
 	git_offmap *entries;
 } git_pack_cache;
 
@@ -135,11 +142,35 @@ int git_packfile_stream_open(git_packfile_stream *obj, struct git_pack_file *p,
 ssize_t git_packfile_stream_read(git_packfile_stream *obj, void *buffer, size_t len);
 void git_packfile_stream_free(git_packfile_stream *obj);
 
+/*
+ * Read an object's content in order, without holding all of it in memory
+ * when it's larger than GIT_PACKFILE_READER_WINDOW (deltas are applied as
+ * they are read; only a base that a delta copies from far back, out of
+ * order, is unpacked whole).
+ */
+#define GIT_PACKFILE_READER_WINDOW (1024 * 1024)
+
+typedef struct git_packfile_reader git_packfile_reader;
+
+int git_packfile_reader_open(
+		git_packfile_reader **out,
+		size_t *size,
+		git_otype *type,
+		struct git_pack_file *p,
+		git_off_t offset);
+
+/* Returns how much was read, 0 at the end */
+ssize_t git_packfile_reader_read(git_packfile_reader *r, void *buffer, size_t len);
+void git_packfile_reader_free(git_packfile_reader *r);
+
 git_off_t get_delta_base(struct git_pack_file *p, git_mwindow **w_curs,
 		git_off_t *curpos, git_otype type,
 		git_off_t delta_obj_offset);
 
 void git_packfile_free(struct git_pack_file *p);
+
+/* Evict delta bases until the cache fits git_pack__cache_memory_limit */
+void git_packfile_cache_trim(void);
 int git_packfile_check(struct git_pack_file **pack_out, const char *path);
 int git_pack_entry_find(
 		struct git_pack_entry *e,
@@ -151,4 +182,36 @@ int git_pack_foreach_entry(
 		git_odb_foreach_cb cb,
 		void *data);
 
+typedef int (*git_pack_foreach_entry_offset_cb)(
+		const git_oid *id,
+		git_off_t offset,
+		void *payload);
+
+/* Iterate over the objects of a pack in index (oid) order */
+int git_pack_foreach_entry_offset(
+		struct git_pack_file *p,
+		git_pack_foreach_entry_offset_cb cb,
+		void *data);
+
+/* Fill in an entry for an object whose offset was found elsewhere,
+ * e.g. in a multi-pack-index, opening the pack if needed */
+int git_pack_entry_from_offset(
+		struct git_pack_entry *e,
+		struct git_pack_file *p,
+		const git_oid *oid,
+		git_off_t offset);
+
+/* Open the index and the pack itself, if that wasn't done yet */
+int git_packfile_open(struct git_pack_file *p);
+
+/*
+ * Set bit `i % 8` of `found[i / 8]` for each of the sorted `ids` that
+ * is in the pack; ids whose bit is already set are not looked up.
+ */
+int git_pack_entry_exists_many(
+		unsigned char *found,
+		struct git_pack_file *p,
+		const git_oid *ids,
+		size_t count);
+
 #endif
@@ -0,0 +1,864 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+#include "pack_bitmap.h"
+#include "pack-objects.h"
+#include "repository.h"
+#include "revwalk.h"
+#include "fileops.h"
+#include "filebuf.h"
+#include "git2/commit.h"
+#include "git2/tree.h"
+#include "git2/revwalk.h"
+#include "git2/pack.h"
+
+GIT__USE_OIDMAP;
+
+/*
+ * File layout (all integers in network order):
+ *
+ *	header:	"BITM", version (1), options, number of entries, and the
+ *		checksum of the pack
+ *	the EWAH bitmaps of the pack's commits, trees, blobs and tags
+ *	entries: the index position of a commit, an XOR offset, flags and
+ *		an EWAH bitmap. When the XOR offset `n` isn't 0, the bitmap
+ *		is stored XORed with that of the entry `n` places before
+ *	name hashes: if the options say so, a 32-bit hash of each object's
+ *		path, by bit
+ *	trailer: SHA-1 of everything above
+ */
+
+#define BITMAP_SIGNATURE "BITM"
+#define BITMAP_VERSION 1
+#define BITMAP_OPT_FULL_DAG 0x1
+#define BITMAP_OPT_HASH_CACHE 0x4
+#define BITMAP_HEADER_SIZE (4 + 2 + 2 + 4 + GIT_OID_RAWSZ)
+#define BITMAP_ENTRY_HEADER_SIZE (4 + 1 + 1)
+#define BITMAP_EWAH_MIN_SIZE 12
+
+static int bitmap_error(const char *message)
+{
+	giterr_set(GITERR_ODB, "Invalid pack bitmap - %s", message);
+	return -1;
+}
+
+GIT_INLINE(uint32_t) get_be32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+GIT_INLINE(uint16_t) get_be16(const unsigned char *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+struct offset_entry {
+	git_off_t offset;
+	uint32_t index_pos;
+};
+
+struct collect_offsets {
+	git_pack_bitmap_index *index;
+	struct offset_entry *offsets;
+	uint32_t count;
+};
+
+static int collect_offset(const git_oid *id, git_off_t offset, void *payload)
+{
+	struct collect_offsets *c = payload;
+
+	c->index->oids[c->count] = id;
+	c->offsets[c->count].offset = offset;
+	c->offsets[c->count].index_pos = c->count;
+	c->count++;
+
+	return 0;
+}
+
+static int offset_entry_cmp(const void *a_, const void *b_)
+{
+	const struct offset_entry *a = a_, *b = b_;
+
+	if (a->offset < b->offset)
+		return -1;
+	return a->offset > b->offset;
+}
+
+static void pack_bitmap_index_free(git_pack_bitmap_index *index)
+{
+	size_t i;
+
+	for (i = 0; i < index->num_entries; ++i) {
+		if (index->entries[i].bitmap) {
+			git_bitmap_free(index->entries[i].bitmap);
+			git__free(index->entries[i].bitmap);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(index->types); ++i)
+		git_bitmap_free(&index->types[i]);
+
+	if (index->commits)
+		git_oidmap_free(index->commits);
+	if (index->map.data)
+		git_futils_mmap_free(&index->map);
+	if (index->pack)
+		git_packfile_free(index->pack);
+
+	git__free(index->entries);
+	git__free(index->oids);
+	git__free(index->bit_of);
+	git__free(index->index_of);
+	git_mutex_free(&index->lock);
+	git__free(index);
+}
+
+void git_pack_bitmap_free(git_pack_bitmap_index *index)
+{
+	if (index == NULL)
+		return;
+
+	GIT_REFCOUNT_DEC(index, pack_bitmap_index_free);
+}
+
+int git_pack_bitmap_index_new(git_pack_bitmap_index **out, const char *idx_path)
+{
+	git_pack_bitmap_index *index;
+	struct collect_offsets c = { NULL, NULL, 0 };
+	uint32_t i, n;
+	int error;
+
+	*out = NULL;
+
+	index = git__calloc(1, sizeof(git_pack_bitmap_index));
+	GITERR_CHECK_ALLOC(index);
+	GIT_REFCOUNT_INC(index);
+	git_mutex_init(&index->lock);
+
+	if ((error = git_packfile_check(&index->pack, idx_path)) < 0 ||
+		(error = git_packfile_open(index->pack)) < 0)
+		goto on_error;
+
+	n = index->num_objects = index->pack->num_objects;
+
+	index->oids = git__malloc(n * sizeof(git_oid *));
+	index->bit_of = git__malloc(n * sizeof(uint32_t));
+	index->index_of = git__malloc(n * sizeof(uint32_t));
+	c.offsets = git__malloc(n * sizeof(struct offset_entry));
+	c.index = index;
+
+	if (!index->oids || !index->bit_of || !index->index_of || !c.offsets) {
+		giterr_set_oom();
+		error = -1;
+		goto on_error;
+	}
+
+	if ((error = git_pack_foreach_entry_offset(index->pack, collect_offset, &c)) < 0)
+		goto on_error;
+
+	/* objects are stored in the pack in offset order */
+	qsort(c.offsets, n, sizeof(struct offset_entry), offset_entry_cmp);
+
+	for (i = 0; i < n; ++i) {
+		index->index_of[i] = c.offsets[i].index_pos;
+		index->bit_of[c.offsets[i].index_pos] = i;
+	}
+
+	git__free(c.offsets);
+	*out = index;
+	return 0;
+
+on_error:
+	git__free(c.offsets);
+	git_pack_bitmap_free(index);
+	return error;
+}
+
+static int pack_bitmap_parse(
+	git_pack_bitmap_index *index, const unsigned char *data, size_t size)
+{
+	const unsigned char *pack_checksum;
+	size_t pos = BITMAP_HEADER_SIZE, end, consumed, i;
+	uint16_t options;
+	uint32_t count;
+	int ret;
+
+	if (size < BITMAP_HEADER_SIZE + GIT_OID_RAWSZ)
+		return bitmap_error("file is too short");
+
+	if (memcmp(data, BITMAP_SIGNATURE, 4) != 0 ||
+		get_be16(data + 4) != BITMAP_VERSION)
+		return bitmap_error("unsupported signature or version");
+
+	options = get_be16(data + 6);
+	if (!(options & BITMAP_OPT_FULL_DAG))
+		return bitmap_error("bitmaps don't cover the full history");
+
+	/* the .idx ends with the pack's checksum and its own */
+	pack_checksum = (const unsigned char *)index->pack->index_map.data +
+		index->pack->index_map.len - 2 * GIT_OID_RAWSZ;
+	if (memcmp(data + 12, pack_checksum, GIT_OID_RAWSZ) != 0)
+		return bitmap_error("bitmap is for another pack");
+
+	end = size - GIT_OID_RAWSZ;
+
+	/* every bit stands for an object of the pack; none may lie past it */
+	for (i = 0; i < ARRAY_SIZE(index->types); ++i) {
+		if (git_ewah_read(&index->types[i], &consumed, data + pos, end - pos,
+				index->num_objects) < 0)
+			return -1;
+		pos += consumed;
+	}
+
+	count = get_be32(data + 8);
+	if (count > (end - pos) / (BITMAP_ENTRY_HEADER_SIZE + BITMAP_EWAH_MIN_SIZE))
+		return bitmap_error("too many entries");
+
+	index->entries = git__calloc(count, sizeof(git_pack_bitmap_entry));
+	GITERR_CHECK_ALLOC(index->entries);
+	index->num_entries = count;
+
+	index->commits = git_oidmap_alloc();
+	GITERR_CHECK_ALLOC(index->commits);
+
+	for (i = 0; i < count; ++i) {
+		git_pack_bitmap_entry *entry = &index->entries[i];
+		size_t words;
+		khiter_t k;
+
+		if (end - pos < BITMAP_ENTRY_HEADER_SIZE + BITMAP_EWAH_MIN_SIZE)
+			return bitmap_error("entry is truncated");
+
+		entry->index_pos = get_be32(data + pos);
+		entry->xor_offset = data[pos + 4];
+		pos += BITMAP_ENTRY_HEADER_SIZE;
+
+		words = get_be32(data + pos + 4);
+		if ((end - pos - BITMAP_EWAH_MIN_SIZE) / 8 < words)
+			return bitmap_error("entry is truncated");
+
+		/* it's only decoded when needed, but its size is known now */
+		if (get_be32(data + pos) > index->num_objects)
+			return bitmap_error("entry has more bits than there are objects");
+
+		entry->data = data + pos;
+		entry->len = BITMAP_EWAH_MIN_SIZE + words * 8;
+		pos += entry->len;
+
+		if (entry->index_pos >= index->num_objects || entry->xor_offset > i)
+			return bitmap_error("entry is out of range");
+
+		k = kh_put(oid, index->commits, index->oids[entry->index_pos], &ret);
+		if (ret < 0) {
+			giterr_set_oom();
+			return -1;
+		}
+		kh_value(index->commits, k) = entry;
+	}
+
+	if (options & BITMAP_OPT_HASH_CACHE) {
+		if ((end - pos) / 4 < index->num_objects)
+			return bitmap_error("name hashes are truncated");
+
+		index->name_hashes = data + pos;
+		pos += 4 * index->num_objects;
+	}
+
+	if (pos != end)
+		return bitmap_error("unexpected data after the bitmaps");
+
+	return 0;
+}
+
+int git_pack_bitmap_open(git_pack_bitmap_index **out, const char *path)
+{
+	git_pack_bitmap_index *index;
+	git_buf idx_path = GIT_BUF_INIT;
+	git_file fd;
+	struct stat st;
+	size_t len = strlen(path);
+	int error;
+
+	*out = NULL;
+
+	if (len < strlen(GIT_PACK_BITMAP_EXT) ||
+		strcmp(path + len - strlen(GIT_PACK_BITMAP_EXT), GIT_PACK_BITMAP_EXT) != 0)
+		return bitmap_error("file name doesn't end in .bitmap");
+
+	if (git_buf_put(&idx_path, path, len - strlen(GIT_PACK_BITMAP_EXT)) < 0 ||
+		git_buf_puts(&idx_path, ".idx") < 0)
+		return -1;
+
+	error = git_pack_bitmap_index_new(&index, idx_path.ptr);
+	git_buf_free(&idx_path);
+
+	if (error < 0)
+		return error;
+
+	if ((fd = git_futils_open_ro(path)) < 0) {
+		git_pack_bitmap_free(index);
+		return fd;
+	}
+
+	if (p_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+		!git__is_sizet(st.st_size)) {
+		p_close(fd);
+		git_pack_bitmap_free(index);
+		giterr_set(GITERR_OS, "Failed to check pack bitmap");
+		return -1;
+	}
+
+	error = git_futils_mmap_ro(&index->map, fd, 0, (size_t)st.st_size);
+	p_close(fd);
+
+	if (error < 0 ||
+		(error = pack_bitmap_parse(index, index->map.data, index->map.len)) < 0) {
+		git_pack_bitmap_free(index);
+		return error;
+	}
+
+	*out = index;
+	return 0;
+}
+
+int git_pack_bitmap_position(
+	uint32_t *bit, git_pack_bitmap_index *index, const git_oid *id)
+{
+	const uint32_t *fanout = index->pack->index_map.data;
+	uint32_t lo, hi;
+
+	if (index->pack->index_version > 1)
+		fanout += 2;
+
+	lo = id->id[0] ? ntohl(fanout[id->id[0] - 1]) : 0;
+	hi = ntohl(fanout[id->id[0]]);
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int cmp = git_oid_cmp(index->oids[mid], id);
+
+		if (!cmp) {
+			*bit = index->bit_of[mid];
+			return 0;
+		}
+
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return GIT_ENOTFOUND;
+}
+
+uint32_t git_pack_bitmap_name_hash(git_pack_bitmap_index *index, uint32_t bit)
+{
+	return index->name_hashes ? get_be32(index->name_hashes + 4 * bit) : 0;
+}
+
+/* Called with the index's lock held */
+static int entry_bitmap(
+	const git_bitmap **out,
+	git_pack_bitmap_index *index,
+	git_pack_bitmap_entry *entry)
+{
+	git_bitmap *bitmap;
+	size_t consumed;
+
+	if (entry->bitmap == NULL) {
+		bitmap = git__calloc(1, sizeof(git_bitmap));
+		GITERR_CHECK_ALLOC(bitmap);
+
+		if (git_ewah_read(bitmap, &consumed, entry->data, entry->len,
+				index->num_objects) < 0)
+			goto on_error;
+
+		if (entry->xor_offset) {
+			const git_bitmap *base;
+
+			if (entry_bitmap(&base, index, entry - entry->xor_offset) < 0 ||
+				git_bitmap_xor(bitmap, base) < 0)
+				goto on_error;
+		}
+
+		entry->bitmap = bitmap;
+	}
+
+	*out = entry->bitmap;
+	return 0;
+
+on_error:
+	git_bitmap_free(bitmap);
+	git__free(bitmap);
+	return -1;
+}
+
+int git_pack_bitmap_lookup(
+	const git_bitmap **out, const git_oid *id, void *payload)
+{
+	git_pack_bitmap_index *index = payload;
+	khiter_t pos;
+	int error;
+
+	if (index->commits == NULL)
+		return GIT_ENOTFOUND;
+
+	pos = kh_get(oid, index->commits, id);
+	if (pos == kh_end(index->commits))
+		return GIT_ENOTFOUND;
+
+	/* the index is shared by everyone using the repository; once
+	 * decoded, a bitmap doesn't change until the index is freed */
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Failed to lock pack bitmap index");
+		return -1;
+	}
+
+	error = entry_bitmap(out, index, kh_value(index->commits, pos));
+
+	git_mutex_unlock(&index->lock);
+	return error;
+}
+
+struct fill_state {
+	git_bitmap *out;
+	git_pack_bitmap_index *index;
+	git_repository *repo;
+	uint32_t *hashes;
+	git_buf path;
+};
+
+static int fill_tree(struct fill_state *st, const git_oid *id)
+{
+	size_t path_len = st->path.size, i, count;
+	git_tree *tree;
+	uint32_t bit;
+	int error;
+
+	if ((error = git_pack_bitmap_position(&bit, st->index, id)) < 0)
+		return error;
+
+	if (git_bitmap_get(st->out, bit))
+		return 0;
+
+	if (git_bitmap_set(st->out, bit) < 0)
+		return -1;
+
+	if (st->hashes && path_len)
+		st->hashes[bit] = git_packbuilder__name_hash(st->path.ptr);
+
+	if ((error = git_tree_lookup(&tree, st->repo, id)) < 0)
+		return error;
+
+	count = git_tree_entrycount(tree);
+
+	for (i = 0; i < count && !error; ++i) {
+		const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+		git_otype type = git_tree_entry_type(entry);
+
+		/* a commit inside a tree is a submodule's */
+		if (type == GIT_OBJ_COMMIT)
+			continue;
+
+		git_buf_truncate(&st->path, path_len);
+		if (path_len)
+			git_buf_putc(&st->path, '/');
+		git_buf_puts(&st->path, git_tree_entry_name(entry));
+
+		if (git_buf_oom(&st->path)) {
+			error = -1;
+			break;
+		}
+
+		if (type == GIT_OBJ_TREE) {
+			error = fill_tree(st, git_tree_entry_id(entry));
+			continue;
+		}
+
+		if ((error = git_pack_bitmap_position(&bit, st->index, git_tree_entry_id(entry))) < 0 ||
+			git_bitmap_get(st->out, bit))
+			continue;
+
+		if ((error = git_bitmap_set(st->out, bit)) == 0 && st->hashes)
+			st->hashes[bit] = git_packbuilder__name_hash(st->path.ptr);
+	}
+
+	git_buf_truncate(&st->path, path_len);
+	git_tree_free(tree);
+	return error;
+}
+
+int git_pack_bitmap_fill(
+	git_bitmap *out,
+	git_pack_bitmap_index *index,
+	git_repository *repo,
+	const git_oid *commits,
+	size_t count,
+	git_pack_bitmap_lookup_cb lookup,
+	void *payload,
+	uint32_t *hashes)
+{
+	struct fill_state st = { out, index, repo, hashes, GIT_BUF_INIT };
+	git_oid *stack = NULL;
+	size_t len = 0, alloc = 0;
+	int error = 0;
+
+	while (count > 0 || len > 0) {
+		const git_bitmap *stored;
+		git_commit *commit;
+		git_oid id;
+		uint32_t bit;
+		unsigned int i, parents;
+
+		if (count > 0) {
+			git_oid_cpy(&id, commits++);
+			count--;
+		} else
+			git_oid_cpy(&id, &stack[--len]);
+
+		if ((error = git_pack_bitmap_position(&bit, index, &id)) < 0)
+			break;
+
+		if (git_bitmap_get(out, bit))
+			continue;
+
+		if (lookup && (error = lookup(&stored, &id, payload)) != GIT_ENOTFOUND) {
+			if (error < 0 || (error = git_bitmap_or(out, stored)) < 0)
+				break;
+			continue;
+		}
+
+		if ((error = git_bitmap_set(out, bit)) < 0 ||
+			(error = git_commit_lookup(&commit, repo, &id)) < 0)
+			break;
+
+		error = fill_tree(&st, git_commit_tree_id(commit));
+		parents = git_commit_parentcount(commit);
+
+		if (!error && len + parents > alloc) {
+			git_oid *grown;
+
+			alloc = (len + parents) * 2;
+			if ((grown = git__realloc(stack, alloc * sizeof(git_oid))) == NULL)
+				error = -1;
+			else
+				stack = grown;
+		}
+
+		for (i = 0; !error && i < parents; ++i)
+			git_oid_cpy(&stack[len++], git_commit_parent_id(commit, i));
+
+		git_commit_free(commit);
+
+		if (error < 0)
+			break;
+	}
+
+	git__free(stack);
+	git_buf_free(&st.path);
+	return error;
+}
+
+/*
+ * Writing
+ */
+
+struct bitmap_write_entry {
+	git_oid id;
+	git_bitmap bitmap;
+};
+
+static int writer_lookup(const git_bitmap **out, const git_oid *id, void *payload)
+{
+	git_oidmap *map = payload;
+	khiter_t pos = kh_get(oid, map, id);
+
+	if (pos == kh_end(map))
+		return GIT_ENOTFOUND;
+
+	*out = &((struct bitmap_write_entry *)kh_value(map, pos))->bitmap;
+	return 0;
+}
+
+struct find_pack {
+	const git_oid *id;
+	git_buf idx_path;
+	uint32_t num_objects;
+};
+
+static int find_pack_cb(void *payload, git_buf *path)
+{
+	struct find_pack *f = payload;
+	struct git_pack_file *p;
+	struct git_pack_entry e;
+	int found;
+
+	if (git__suffixcmp(path->ptr, ".idx") != 0)
+		return 0;
+
+	if (git_packfile_check(&p, path->ptr) < 0) {
+		giterr_clear();
+		return 0;
+	}
+
+	found = git_pack_entry_find(&e, p, f->id, GIT_OID_HEXSZ) == 0 &&
+		(!f->idx_path.size || p->num_objects > f->num_objects);
+	if (found)
+		f->num_objects = p->num_objects;
+
+	git_packfile_free(p);
+	giterr_clear();
+
+	return found ? git_buf_sets(&f->idx_path, path->ptr) : 0;
+}
+
+/* The largest local pack that has `id`, usually the one a repack made */
+static int find_pack(git_buf *idx_path, git_repository *repo, const git_oid *id)
+{
+	struct find_pack f = { id, GIT_BUF_INIT, 0 };
+	git_buf dir = GIT_BUF_INIT;
+	int error;
+
+	if (git_buf_joinpath(&dir, repo->path_repository, GIT_OBJECTS_DIR "pack") < 0)
+		return -1;
+
+	error = git_path_direach(&dir, find_pack_cb, &f);
+	git_buf_free(&dir);
+
+	if (!error && !f.idx_path.size) {
+		giterr_set(GITERR_ODB, "No pack has the commits to write a bitmap for");
+		error = GIT_ENOTFOUND;
+	}
+
+	if (!error)
+		git_buf_swap(idx_path, &f.idx_path);
+
+	git_buf_free(&f.idx_path);
+	return error;
+}
+
+static int write_be32(git_buf *buf, uint32_t v)
+{
+	v = htonl(v);
+	return git_buf_put(buf, (const char *)&v, sizeof(v));
+}
+
+static int pack_bitmap_write_file(
+	git_pack_bitmap_index *index,
+	git_vector *entries,
+	const uint32_t *hashes,
+	const char *path)
+{
+	git_filebuf f = GIT_FILEBUF_INIT;
+	git_bitmap types[4];
+	git_buf buf = GIT_BUF_INIT;
+	struct bitmap_write_entry *entry;
+	const unsigned char *pack_checksum;
+	git_oid checksum;
+	uint32_t bit;
+	size_t i;
+	int error = 0;
+
+	memset(types, 0, sizeof(types));
+
+	for (bit = 0; bit < index->num_objects && !error; ++bit) {
+		struct git_pack_entry e;
+		git_otype type;
+		size_t size;
+
+		if ((error = git_pack_entry_find(&e, index->pack,
+				git_pack_bitmap_oid(index, bit), GIT_OID_HEXSZ)) < 0 ||
+			(error = git_packfile_resolve_header(&size, &type, index->pack, e.offset)) < 0)
+			break;
+
+		if (type < GIT_OBJ_COMMIT || type > GIT_OBJ_TAG) {
+			error = bitmap_error("unexpected object type in the pack");
+			break;
+		}
+
+		error = git_bitmap_set(&types[type - GIT_OBJ_COMMIT], bit);
+	}
+
+	pack_checksum = (const unsigned char *)index->pack->index_map.data +
+		index->pack->index_map.len - 2 * GIT_OID_RAWSZ;
+
+	if (!error) {
+		git_buf_put(&buf, BITMAP_SIGNATURE, 4);
+		git_buf_putc(&buf, 0);
+		git_buf_putc(&buf, BITMAP_VERSION);
+		git_buf_putc(&buf, 0);
+		git_buf_putc(&buf, BITMAP_OPT_FULL_DAG | BITMAP_OPT_HASH_CACHE);
+		write_be32(&buf, (uint32_t)entries->length);
+		git_buf_put(&buf, (const char *)pack_checksum, GIT_OID_RAWSZ);
+
+		for (i = 0; i < ARRAY_SIZE(types) && !error; ++i)
+			error = git_ewah_write(&buf, &types[i], index->num_objects);
+	}
+
+	git_vector_foreach(entries, i, entry) {
+		uint32_t pos;
+
+		if (error)
+			break;
+
+		git_pack_bitmap_position(&bit, index, &entry->id);
+		pos = index->index_of[bit];
+
+		write_be32(&buf, pos);
+		git_buf_putc(&buf, 0); /* not XORed */
+		git_buf_putc(&buf, 0);
+		error = git_ewah_write(&buf, &entry->bitmap, index->num_objects);
+	}
+
+	for (bit = 0; bit < index->num_objects && !error; ++bit)
+		error = write_be32(&buf, hashes[bit]);
+
+	if (!error && git_buf_oom(&buf))
+		error = -1;
+
+	if (!error &&
+		(error = git_filebuf_open(&f, path, GIT_FILEBUF_HASH_CONTENTS)) == 0 &&
+		(error = git_filebuf_write(&f, buf.ptr, buf.size)) == 0 &&
+		(error = git_filebuf_hash(&checksum, &f)) == 0 &&
+		(error = git_filebuf_write(&f, checksum.id, GIT_OID_RAWSZ)) == 0)
+		error = git_filebuf_commit(&f, GIT_PACK_FILE_MODE);
+
+	if (error < 0)
+		git_filebuf_cleanup(&f);
+
+	for (i = 0; i < ARRAY_SIZE(types); ++i)
+		git_bitmap_free(&types[i]);
+	git_buf_free(&buf);
+	return error;
+}
+
+static int is_tip(git_revwalk *walk, const git_oid *id)
+{
+	const git_commit_table *t = &walk->commits;
+	size_t i;
+
+	if (walk->one != GIT_COMMIT_IDX_NONE && git_oid_equal(&t->oids[walk->one], id))
+		return 1;
+
+	for (i = 0; i < walk->twos.length; ++i) {
+		git_commit_idx commit = walk->twos.ids[i];
+
+		if (!(t->flags[commit] & COMMIT_UNINTERESTING) &&
+			git_oid_equal(&t->oids[commit], id))
+			return 1;
+	}
+
+	return 0;
+}
+
+int git_pack_bitmap_write(git_repository *repo, git_revwalk *walk)
+{
+	git_pack_bitmap_index *index = NULL;
+	git_vector selected = GIT_VECTOR_INIT;
+	git_buf path = GIT_BUF_INIT;
+	git_oidmap *map = NULL;
+	struct bitmap_write_entry *entry;
+	uint32_t *hashes = NULL;
+	git_oid id;
+	size_t i, n = 0;
+	int error;
+
+	assert(repo && walk);
+
+	if ((map = git_oidmap_alloc()) == NULL) {
+		giterr_set_oom();
+		return -1;
+	}
+
+	/*
+	 * Every branch tip gets a bitmap, and so does every so many commit
+	 * on the way down; fetches then mostly start from a bitmap.
+	 */
+	while ((error = git_revwalk_next(&id, walk)) == 0) {
+		if (!is_tip(walk, &id) && n++ % GIT_PACK_BITMAP_INTERVAL != 0)
+			continue;
+
+		if ((entry = git__calloc(1, sizeof(struct bitmap_write_entry))) == NULL ||
+			git_vector_insert(&selected, entry) < 0) {
+			git__free(entry);
+			error = -1;
+			goto cleanup;
+		}
+
+		git_oid_cpy(&entry->id, &id);
+	}
+
+	if (error != GIT_ITEROVER)
+		goto cleanup;
+
+	if (!selected.length) {
+		giterr_set(GITERR_INVALID, "Nothing to write a bitmap for");
+		error = -1;
+		goto cleanup;
+	}
+
+	entry = git_vector_get(&selected, 0);
+	if ((error = find_pack(&path, repo, &entry->id)) < 0 ||
+		(error = git_pack_bitmap_index_new(&index, path.ptr)) < 0)
+		goto cleanup;
+
+	hashes = git__calloc(index->num_objects ? index->num_objects : 1, sizeof(uint32_t));
+	if (hashes == NULL) {
+		error = -1;
+		goto cleanup;
+	}
+
+	/* oldest first, so that the newer ones can start from them */
+	for (i = selected.length; i > 0; --i) {
+		int ret;
+		khiter_t pos;
+
+		entry = git_vector_get(&selected, i - 1);
+		error = git_pack_bitmap_fill(&entry->bitmap, index, repo,
+			&entry->id, 1, writer_lookup, map, hashes);
+
+		if (error == GIT_ENOTFOUND) {
+			char hex[GIT_OID_HEXSZ + 1];
+			git_oid_tostr(hex, sizeof(hex), &entry->id);
+			giterr_set(GITERR_ODB,
+				"The pack doesn't have everything %s references", hex);
+		}
+		if (error < 0)
+			goto cleanup;
+
+		pos = kh_put(oid, map, &entry->id, &ret);
+		if (ret < 0) {
+			giterr_set_oom();
+			error = -1;
+			goto cleanup;
+		}
+		kh_value(map, pos) = entry;
+	}
+
+	/* "pack-xxx.idx" -> "pack-xxx.bitmap" */
+	git_buf_truncate(&path, path.size - strlen(".idx"));
+	if ((error = git_buf_puts(&path, GIT_PACK_BITMAP_EXT)) < 0)
+		goto cleanup;
+
+	if ((error = pack_bitmap_write_file(index, &selected, hashes, path.ptr)) == 0)
+		git_repository__pack_bitmap_changed(repo);
+
+cleanup:
+	git_vector_foreach(&selected, i, entry) {
+		git_bitmap_free(&entry->bitmap);
+		git__free(entry);
+	}
+	git_vector_free(&selected);
+	git_oidmap_free(map);
+	git__free(hashes);
+	git_pack_bitmap_free(index);
+	git_buf_free(&path);
+	return error;
+}
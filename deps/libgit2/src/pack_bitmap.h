@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_pack_bitmap_h__
+#define INCLUDE_pack_bitmap_h__
+
+#include "common.h"
+#include "ewah.h"
+#include "map.h"
+#include "oidmap.h"
+#include "pack.h"
+#include "git2/oid.h"
+
+#define GIT_PACK_BITMAP_EXT ".bitmap"
+
+/* a selected commit gets a bitmap every this many commits of a walk */
+#define GIT_PACK_BITMAP_INTERVAL 100
+
+typedef struct git_pack_bitmap_entry {
+	uint32_t index_pos;
+	unsigned char xor_offset;
+	const unsigned char *data;
+	size_t len;
+
+	/* decoded on first use */
+	git_bitmap *bitmap;
+} git_pack_bitmap_entry;
+
+/*
+ * A reachability bitmap index (".bitmap" file, git's version 1 format)
+ * lives next to the pack whose objects it covers. Bit `n` of a bitmap
+ * stands for the `n`th object in the pack, in the order they are stored
+ * in; a commit's bitmap has the bit of every object it reaches set.
+ *
+ * Without a file this is only the mapping between objects and their
+ * bits, which is what the writer starts from.
+ */
+typedef struct git_pack_bitmap_index {
+	git_refcount rc;
+	struct git_pack_file *pack;
+	uint32_t num_objects;
+
+	/* index (oid) order, as in the .idx */
+	const git_oid **oids;
+	uint32_t *bit_of; /* index position -> bit */
+	uint32_t *index_of; /* bit -> index position */
+
+	git_map map;
+	git_bitmap types[4]; /* commits, trees, blobs, tags */
+	git_pack_bitmap_entry *entries;
+	size_t num_entries;
+	git_oidmap *commits; /* commit id -> entry */
+	git_mutex lock; /* held while the entries' bitmaps are decoded */
+	const unsigned char *name_hashes; /* by bit, if the file has them */
+} git_pack_bitmap_index;
+
+/* Index the objects of the pack whose ".idx" is at `idx_path` */
+int git_pack_bitmap_index_new(git_pack_bitmap_index **out, const char *idx_path);
+
+/* Open a ".bitmap" file and the pack next to it */
+int git_pack_bitmap_open(git_pack_bitmap_index **out, const char *path);
+
+/* Drops a reference; everything is freed once the last one is gone */
+void git_pack_bitmap_free(git_pack_bitmap_index *index);
+
+/* Returns GIT_ENOTFOUND, without setting an error, if `id` isn't in the pack */
+int git_pack_bitmap_position(
+	uint32_t *bit, git_pack_bitmap_index *index, const git_oid *id);
+
+GIT_INLINE(const git_oid *) git_pack_bitmap_oid(
+	git_pack_bitmap_index *index, uint32_t bit)
+{
+	return index->oids[index->index_of[bit]];
+}
+
+/* The name hash of the object at `bit`, or 0 when the file has none */
+uint32_t git_pack_bitmap_name_hash(git_pack_bitmap_index *index, uint32_t bit);
+
+/* Returns GIT_ENOTFOUND, without setting an error, if there's no bitmap for `id` */
+typedef int (*git_pack_bitmap_lookup_cb)(
+	const git_bitmap **out, const git_oid *id, void *payload);
+
+int git_pack_bitmap_lookup(
+	const git_bitmap **out, const git_oid *id, void *index);
+
+/*
+ * Set the bit of every object reachable from the `commits`, starting
+ * from the bitmaps `lookup` has for the commits it comes across and
+ * walking the history from the others. `hashes`, if given, gets the
+ * name hash of the trees and blobs found in the walk, by bit.
+ *
+ * Returns GIT_ENOTFOUND, without setting an error, if some object
+ * isn't in the pack.
+ */
+int git_pack_bitmap_fill(
+	git_bitmap *out,
+	git_pack_bitmap_index *index,
+	git_repository *repo,
+	const git_oid *commits,
+	size_t count,
+	git_pack_bitmap_lookup_cb lookup,
+	void *payload,
+	uint32_t *hashes);
+
+#endif
@@ -242,12 +242,11 @@ on_error:
 	return error;
 }
 
-static int revwalk(git_vector *commits, git_push *push)
+static int revwalk(git_revwalk **out, git_push *push)
 {
 	git_remote_head *head;
 	push_spec *spec;
 	git_revwalk *rw;
-	git_oid oid;
 	unsigned int i;
 	int error = -1;
 
@@ -340,76 +339,25 @@ static int revwalk(git_vector *commits, git_push *push)
 		git_revwalk_hide(rw, &head->oid);
 	}
 
-	while ((error = git_revwalk_next(&oid, rw)) == 0) {
-		git_oid *o = git__malloc(GIT_OID_RAWSZ);
-		GITERR_CHECK_ALLOC(o);
-		git_oid_cpy(o, &oid);
-		if (git_vector_insert(commits, o) < 0) {
-			error = -1;
-			goto on_error;
-		}
-	}
+	*out = rw;
+	return 0;
 
 on_error:
 	git_revwalk_free(rw);
-	return error == GIT_ITEROVER ? 0 : error;
+	return error;
 }
 
 static int queue_objects(git_push *push)
 {
-	git_vector commits;
-	git_oid *o;
-	unsigned int i;
+	git_revwalk *rw;
 	int error;
 
-	if (git_vector_init(&commits, 0, NULL) < 0)
-		return -1;
-
-	if ((error = revwalk(&commits, push)) < 0)
-		goto on_error;
-
-	if (!commits.length) {
-		git_vector_free(&commits);
-		return 0; /* nothing to do */
-	}
-
-	git_vector_foreach(&commits, i, o) {
-		if ((error = git_packbuilder_insert(push->pb, o, NULL)) < 0)
-			goto on_error;
-	}
-
-	git_vector_foreach(&commits, i, o) {
-		git_object *obj;
-
-		if ((error = git_object_lookup(&obj, push->repo, o, GIT_OBJ_ANY)) < 0)
-			goto on_error;
+	if ((error = revwalk(&rw, push)) < 0)
+		return error;
 
-		switch (git_object_type(obj)) {
-		case GIT_OBJ_TAG: /* TODO: expect tags */
-		case GIT_OBJ_COMMIT:
-			if ((error = git_packbuilder_insert_tree(push->pb,
-					git_commit_tree_id((git_commit *)obj))) < 0) {
-				git_object_free(obj);
-				goto on_error;
-			}
-			break;
-		case GIT_OBJ_TREE:
-		case GIT_OBJ_BLOB:
-		default:
-			git_object_free(obj);
-			giterr_set(GITERR_INVALID, "Given object type invalid");
-			error = -1;
-			goto on_error;
-		}
-		git_object_free(obj);
-	}
-	error = 0;
+	error = git_packbuilder_insert_walk(push->pb, rw);
 
-on_error:
-	git_vector_foreach(&commits, i, o) {
-		git__free(o);
-	}
-	git_vector_free(&commits);
+	git_revwalk_free(rw);
 	return error;
 }
 
@@ -412,6 +412,10 @@ static int packed_load(git_repository *repo)
 	const char *buffer_start, *buffer_end;
 	git_refcache *ref_cache = &repo->references;
 
+	/* A batch lookup already loaded the packfile for us */
+	if (ref_cache->packfile != NULL && ref_cache->packfile_pinned)
+		return 0;
+
 	/* First we make sure we have allocated the hash table */
 	if (ref_cache->packfile == NULL) {
 		ref_cache->packfile = git_strmap_alloc();
@@ -1092,6 +1096,35 @@ int git_reference_name_to_id(
 	return 0;
 }
 
+int git_reference_name_to_id_many(
+	git_oid *out,
+	int *errors,
+	git_repository *repo,
+	const char **names,
+	size_t count)
+{
+	size_t i;
+
+	assert(out && errors && repo && (names || !count));
+
+	/* load (or stat) the packfile once for the whole batch */
+	if (packed_load(repo) < 0)
+		return -1;
+
+	repo->references.packfile_pinned = 1;
+
+	for (i = 0; i < count; ++i) {
+		errors[i] = git_reference_name_to_id(&out[i], repo, names[i]);
+		if (errors[i] < 0)
+			memset(&out[i], 0x0, sizeof(git_oid));
+	}
+
+	repo->references.packfile_pinned = 0;
+
+	giterr_clear();
+	return 0;
+}
+
 int git_reference_lookup_resolved(
 	git_reference **ref_out,
 	git_repository *repo,
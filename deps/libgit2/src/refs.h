@@ -61,6 +61,8 @@ struct git_reference {
 typedef struct {
 	git_strmap *packfile;
 	time_t packfile_time;
+	/* while set, the loaded packfile is trusted without a stat */
+	unsigned int packfile_pinned:1;
 } git_refcache;
 
 void git_repository__refcache_free(git_refcache *refs);
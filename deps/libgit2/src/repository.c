@@ -39,6 +39,22 @@ static void drop_odb(git_repository *repo)
 	}
 }
 
+/* The two below are called with the repository locked, or while freeing it */
+static void drop_commit_graph(git_repository *repo)
+{
+	git_commit_graph_free(repo->_commit_graph);
+	repo->_commit_graph = NULL;
+}
+
+static void drop_pack_bitmap(git_repository *repo)
+{
+	git_pack_bitmap_free(repo->_pack_bitmap);
+	repo->_pack_bitmap = NULL;
+
+	git__free(repo->pack_bitmap_path);
+	repo->pack_bitmap_path = NULL;
+}
+
 static void drop_config(git_repository *repo)
 {
 	if (repo->_config != NULL) {
@@ -75,7 +91,10 @@ void git_repository_free(git_repository *repo)
 	drop_config(repo);
 	drop_index(repo);
 	drop_odb(repo);
+	drop_commit_graph(repo);
+	drop_pack_bitmap(repo);
 
+	git_mutex_free(&repo->lock);
 	git__free(repo);
 }
 
@@ -113,6 +132,8 @@ static git_repository *repository_alloc(void)
 		return NULL;
 	}
 
+	git_mutex_init(&repo->lock);
+
 	/* set all the entries in the cvar cache to `unset` */
 	git_repository__cvar_cache_clear(repo);
 
@@ -588,6 +609,145 @@ int git_repository_odb(git_odb **out, git_repository *repo)
 	return 0;
 }
 
+int git_repository__commit_graph(git_commit_graph_file **out, git_repository *repo)
+{
+	git_buf path = GIT_BUF_INIT;
+	int error;
+
+	assert(repo && out);
+
+	*out = NULL;
+
+	/* a repository wrapping an odb has no objects directory */
+	if (repo->path_repository == NULL)
+		return 0;
+
+	if (git_buf_joinpath(&path, repo->path_repository, GIT_OBJECTS_DIR) < 0 ||
+		git_buf_joinpath(&path, path.ptr, GIT_COMMIT_GRAPH_FILE) < 0)
+		return -1;
+
+	if (git_mutex_lock(&repo->lock)) {
+		giterr_set(GITERR_OS, "Failed to lock repository");
+		git_buf_free(&path);
+		return -1;
+	}
+
+	error = git_futils_filestamp_check(&repo->commit_graph_stamp, path.ptr);
+
+	if (error == GIT_ENOTFOUND) {
+		git_futils_filestamp_set(&repo->commit_graph_stamp, NULL);
+		drop_commit_graph(repo);
+	} else if (error > 0) {
+		drop_commit_graph(repo);
+
+		/* a graph that can't be read is ignored until it changes */
+		if (git_commit_graph_open(&repo->_commit_graph, path.ptr) < 0)
+			giterr_clear();
+	}
+
+	if ((*out = repo->_commit_graph) != NULL)
+		GIT_REFCOUNT_INC(*out);
+
+	git_mutex_unlock(&repo->lock);
+	git_buf_free(&path);
+
+	return 0;
+}
+
+void git_repository__commit_graph_changed(git_repository *repo)
+{
+	if (git_mutex_lock(&repo->lock))
+		return;
+
+	git_futils_filestamp_set(&repo->commit_graph_stamp, NULL);
+	git_mutex_unlock(&repo->lock);
+}
+
+/* git uses a single bitmap index; if there are more, take the first */
+static int find_pack_bitmap_cb(void *payload, git_buf *path)
+{
+	git_buf *found = payload;
+
+	if (git__suffixcmp(path->ptr, GIT_PACK_BITMAP_EXT) != 0 ||
+		(found->size && strcmp(path->ptr, found->ptr) >= 0))
+		return 0;
+
+	return git_buf_sets(found, path->ptr);
+}
+
+int git_repository__pack_bitmap(git_pack_bitmap_index **out, git_repository *repo)
+{
+	git_buf path = GIT_BUF_INIT, found = GIT_BUF_INIT;
+	int error = 0;
+
+	assert(repo && out);
+
+	*out = NULL;
+
+	if (repo->path_repository == NULL)
+		return 0;
+
+	if (git_buf_joinpath(&path, repo->path_repository, GIT_OBJECTS_DIR "pack") < 0)
+		return -1;
+
+	if (git_path_isdir(path.ptr) &&
+		(error = git_path_direach(&path, find_pack_bitmap_cb, &found)) < 0)
+		goto cleanup;
+
+	if (git_mutex_lock(&repo->lock)) {
+		giterr_set(GITERR_OS, "Failed to lock repository");
+		error = -1;
+		goto cleanup;
+	}
+
+	if (repo->pack_bitmap_path &&
+		(!found.size || strcmp(found.ptr, repo->pack_bitmap_path) != 0)) {
+		git_futils_filestamp_set(&repo->pack_bitmap_stamp, NULL);
+		drop_pack_bitmap(repo);
+	}
+
+	if (!found.size)
+		goto unlock;
+
+	error = git_futils_filestamp_check(&repo->pack_bitmap_stamp, found.ptr);
+
+	if (error == GIT_ENOTFOUND) {
+		git_futils_filestamp_set(&repo->pack_bitmap_stamp, NULL);
+		drop_pack_bitmap(repo);
+		error = 0;
+	} else if (error > 0) {
+		drop_pack_bitmap(repo);
+		error = 0;
+
+		/* a bitmap that can't be read is ignored until it changes */
+		if (git_pack_bitmap_open(&repo->_pack_bitmap, found.ptr) < 0)
+			giterr_clear();
+
+		repo->pack_bitmap_path = git_buf_detach(&found);
+	}
+
+	if (repo->_pack_bitmap != NULL) {
+		GIT_REFCOUNT_INC(repo->_pack_bitmap);
+		*out = repo->_pack_bitmap;
+	}
+
+unlock:
+	git_mutex_unlock(&repo->lock);
+cleanup:
+	git_buf_free(&path);
+	git_buf_free(&found);
+	return error;
+}
+
+void git_repository__pack_bitmap_changed(git_repository *repo)
+{
+	if (git_mutex_lock(&repo->lock))
+		return;
+
+	git_futils_filestamp_set(&repo->pack_bitmap_stamp, NULL);
+	git_mutex_unlock(&repo->lock);
+}
+
 void git_repository_set_odb(git_repository *repo, git_odb *odb)
 {
 	assert(repo && odb);
@@ -1639,3 +1799,9 @@ int git_repository_state(git_repository *repo)
 	git_buf_free(&repo_path);
 	return state;
 }
+
+void git_repository_cache_stats(git_cache_stats *out, git_repository *repo)
+{
+	assert(out && repo);
+	git_cache_read_stats(out, &repo->objects);
+}
@@ -21,6 +21,9 @@
 #include "object.h"
 #include "attr.h"
 #include "strmap.h"
+#include "commit_graph.h"
+#include "pack_bitmap.h"
+#include "fileops.h"
 
 #define DOT_GIT ".git"
 #define GIT_DIR DOT_GIT "/"
@@ -87,6 +90,15 @@ struct git_repository {
 	git_attr_cache attrcache;
 	git_strmap *submodules;
 
+	git_mutex lock; /* guards the commit-graph and bitmap below */
+
+	git_commit_graph_file *_commit_graph;
+	git_futils_filestamp commit_graph_stamp;
+
+	git_pack_bitmap_index *_pack_bitmap;
+	char *pack_bitmap_path;
+	git_futils_filestamp pack_bitmap_stamp;
+
 	char *path_repository;
 	char *workdir;
 
@@ -114,6 +126,27 @@ int git_repository_config__weakptr(git_config **out, git_repository *repo);
 int git_repository_odb__weakptr(git_odb **out, git_repository *repo);
 int git_repository_index__weakptr(git_index **out, git_repository *repo);
 
+/*
+ * The commit-graph of the repository, or NULL when it has none (or it
+ * can't be read). It's reopened when the file changes; the caller owns
+ * a reference and must release it with `git_commit_graph_free`.
+ */
+int git_repository__commit_graph(git_commit_graph_file **out, git_repository *repo);
+
+/* Make the next `git_repository__commit_graph` look at the file again */
+void git_repository__commit_graph_changed(git_repository *repo);
+
+/*
+ * The reachability bitmap index of one of the repository's packs, or
+ * NULL when none has one (or it can't be read). Like the commit-graph,
+ * it's reopened when the file changes and the caller owns a reference,
+ * to be released with `git_pack_bitmap_free`.
+ */
+int git_repository__pack_bitmap(git_pack_bitmap_index **out, git_repository *repo);
+
+/* Make the next `git_repository__pack_bitmap` look at the file again */
+void git_repository__pack_bitmap_changed(git_repository *repo);
+
 /*
  * CVAR cache
  *
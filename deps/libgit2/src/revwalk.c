@@ -8,65 +8,49 @@
 #include "common.h"
 #include "commit.h"
 #include "odb.h"
-#include "pool.h"
+#include "tree.h"
 
 #include "revwalk.h"
 #include "merge.h"
 
 #include <regex.h>
 
-git_commit_list_node *git_revwalk__commit_lookup(
-	git_revwalk *walk, const git_oid *oid)
+int git_revwalk__commit_lookup(
+	git_commit_idx *out, git_revwalk *walk, const git_oid *oid)
 {
-	git_commit_list_node *commit;
-	khiter_t pos;
-	int ret;
-
-	/* lookup and reserve space if not already present */
-	pos = kh_get(oid, walk->commits, oid);
-	if (pos != kh_end(walk->commits))
-		return kh_value(walk->commits, pos);
-
-	commit = git_commit_list_alloc_node(walk);
-	if (commit == NULL)
-		return NULL;
-
-	git_oid_cpy(&commit->oid, oid);
-
-	pos = kh_put(oid, walk->commits, &commit->oid, &ret);
-	assert(ret != 0);
-	kh_value(walk->commits, pos) = commit;
-
-	return commit;
+	return git_commit_table_lookup(out, &walk->commits, oid);
 }
 
-static void mark_uninteresting(git_commit_list_node *commit)
+static void mark_uninteresting(git_commit_table *t, git_commit_idx commit)
 {
 	unsigned short i;
-	assert(commit);
 
-	commit->uninteresting = 1;
+	t->flags[commit] |= COMMIT_UNINTERESTING;
 
 	/* This means we've reached a merge base, so there's no need to walk any more */
-	if ((commit->flags & (RESULT | STALE)) == RESULT)
+	if ((t->flags[commit] & (RESULT | STALE)) == RESULT)
 		return;
 
-	for (i = 0; i < commit->out_degree; ++i)
-		if (!commit->parents[i]->uninteresting)
-			mark_uninteresting(commit->parents[i]);
+	for (i = 0; i < t->parent_count[commit]; ++i) {
+		git_commit_idx parent = git_commit_table_parents(t, commit)[i];
+
+		if (!(t->flags[parent] & COMMIT_UNINTERESTING))
+			mark_uninteresting(t, parent);
+	}
 }
 
-static int process_commit(git_revwalk *walk, git_commit_list_node *commit, int hide)
+static int process_commit(git_revwalk *walk, git_commit_idx commit, int hide)
 {
+	git_commit_table *t = &walk->commits;
 	int error;
 
 	if (hide)
-		mark_uninteresting(commit);
+		mark_uninteresting(t, commit);
 
-	if (commit->seen)
+	if (t->flags[commit] & COMMIT_SEEN)
 		return 0;
 
-	commit->seen = 1;
+	t->flags[commit] |= COMMIT_SEEN;
 
 	if ((error = git_commit_list_parse(walk, commit)) < 0)
 		return error;
@@ -74,13 +58,159 @@ static int process_commit(git_revwalk *walk, git_commit_list_node *commit, int h
 	return walk->enqueue(walk, commit);
 }
 
-static int process_commit_parents(git_revwalk *walk, git_commit_list_node *commit)
+/*
+ * Look up the entry `name` in tree `id` (NULL for a missing tree).
+ * `out`, which may be `id`, gets its id and `mode` its mode, or 0 when
+ * it's not there.
+ */
+static int path_entry(
+	git_oid *out, unsigned int *mode,
+	git_revwalk *walk, const git_oid *id, const char *name, size_t len)
+{
+	const git_tree_entry *entry;
+	git_tree *tree;
+
+	*mode = 0;
+	if (id == NULL)
+		return 0;
+
+	if (git_tree_lookup(&tree, walk->repo, id) < 0)
+		return -1;
+
+	if ((entry = git_tree__entry_fromname(tree, name, len)) != NULL) {
+		git_oid_cpy(out, &entry->oid);
+		*mode = entry->attr;
+	}
+
+	git_tree_free(tree);
+	return 0;
+}
+
+/*
+ * Whether `path` differs between trees `a` and `b` (NULL for none).
+ * It's looked for one level at a time, and a subtree with the same id
+ * on both sides has the same everything below it, so the trees under
+ * it are never read.
+ */
+static int path_changed(
+	int *changed, git_revwalk *walk,
+	const git_oid *a, const git_oid *b, const char *path)
+{
+	git_oid ids[2];
+	unsigned int modes[2];
+	const char *slash;
+	size_t len;
+
+	for (;;) {
+		if ((a == NULL && b == NULL) || (a && b && git_oid_equal(a, b))) {
+			*changed = 0;
+			return 0;
+		}
+
+		slash = strchr(path, '/');
+		len = slash ? (size_t)(slash - path) : strlen(path);
+
+		if (path_entry(&ids[0], &modes[0], walk, a, path, len) < 0 ||
+			path_entry(&ids[1], &modes[1], walk, b, path, len) < 0)
+			return -1;
+
+		if (slash == NULL) {
+			*changed = modes[0] != modes[1] ||
+				(modes[0] && !git_oid_equal(&ids[0], &ids[1]));
+			return 0;
+		}
+
+		/* something that isn't a tree has no paths below it */
+		a = S_ISDIR(modes[0]) ? &ids[0] : NULL;
+		b = S_ISDIR(modes[1]) ? &ids[1] : NULL;
+		path = slash + 1;
+	}
+}
+
+/* Whether any of the walk's paths differ between trees `a` and `b` */
+static int paths_changed(
+	int *changed, git_revwalk *walk, const git_oid *a, const git_oid *b)
+{
+	const char *path;
+	size_t i;
+
+	*changed = 0;
+
+	git_vector_foreach(&walk->paths, i, path) {
+		if (path_changed(changed, walk, a, b, path) < 0)
+			return -1;
+		if (*changed)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * History simplification, as `git log -- <paths>` does it by default:
+ * a commit which has the paths as one of its parents has them is left
+ * out (COMMIT_TREESAME), and only the first such parent is followed;
+ * `follow` gets its position, or -1 when all the parents are to be
+ * followed. A root commit is left out when it has none of the paths.
+ */
+static int simplify(int *follow, git_revwalk *walk, git_commit_idx commit)
+{
+	git_commit_table *t = &walk->commits;
+	unsigned short i;
+	int changed;
+
+	*follow = -1;
+
+	if (t->parent_count[commit] == 0) {
+		if (paths_changed(&changed, walk, &t->trees[commit], NULL) < 0)
+			return -1;
+		if (!changed)
+			t->flags[commit] |= COMMIT_TREESAME;
+		return 0;
+	}
+
+	for (i = 0; i < t->parent_count[commit]; ++i) {
+		git_commit_idx parent = git_commit_table_parents(t, commit)[i];
+
+		/* this may grow the table, so the trees are looked at afterwards */
+		if (git_commit_list_parse(walk, parent) < 0)
+			return -1;
+
+		if (paths_changed(&changed, walk, &t->trees[commit], &t->trees[parent]) < 0)
+			return -1;
+
+		if (!changed) {
+			t->flags[commit] |= COMMIT_TREESAME;
+			*follow = i;
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+static int process_commit_parents(git_revwalk *walk, git_commit_idx commit)
 {
+	git_commit_table *t = &walk->commits;
+	int hide = (t->flags[commit] & COMMIT_UNINTERESTING) != 0;
 	unsigned short i;
 	int error = 0;
 
-	for (i = 0; i < commit->out_degree && !error; ++i)
-		error = process_commit(walk, commit->parents[i], commit->uninteresting);
+	/* hidden commits hide all of their history, whatever it changes */
+	if (walk->paths.length > 0 && !hide) {
+		int follow;
+
+		if ((error = simplify(&follow, walk, commit)) < 0)
+			return error;
+
+		if (follow >= 0)
+			return process_commit(
+				walk, git_commit_table_parents(t, commit)[follow], 0);
+	}
+
+	/* the parents are read again each time, processing one may add commits */
+	for (i = 0; i < t->parent_count[commit] && !error; ++i)
+		error = process_commit(walk, git_commit_table_parents(t, commit)[i], hide);
 
 	return error;
 }
@@ -89,7 +219,7 @@ static int push_commit(git_revwalk *walk, const git_oid *oid, int uninteresting)
 {
 	git_object *obj;
 	git_otype type;
-	git_commit_list_node *commit;
+	git_commit_idx commit;
 
 	if (git_object_lookup(&obj, walk->repo, oid, GIT_OBJ_ANY) < 0)
 		return -1;
@@ -102,15 +232,18 @@ static int push_commit(git_revwalk *walk, const git_oid *oid, int uninteresting)
 		return -1;
 	}
 
-	commit = git_revwalk__commit_lookup(walk, oid);
-	if (commit == NULL)
-		return -1; /* error already reported by failed lookup */
+	if (git_revwalk__commit_lookup(&commit, walk, oid) < 0)
+		return -1;
 
-	commit->uninteresting = uninteresting;
-	if (walk->one == NULL && !uninteresting) {
+	if (uninteresting)
+		walk->commits.flags[commit] |= COMMIT_UNINTERESTING;
+	else
+		walk->commits.flags[commit] &= ~COMMIT_UNINTERESTING;
+
+	if (walk->one == GIT_COMMIT_IDX_NONE && !uninteresting) {
 		walk->one = commit;
 	} else {
-		if (git_vector_insert(&walk->twos, commit) < 0)
+		if (git_commit_stack_push(&walk->twos, commit) < 0)
 			return -1;
 	}
 
@@ -234,145 +367,284 @@ int git_revwalk_hide_ref(git_revwalk *walk, const char *refname)
 	return push_ref(walk, refname, 1);
 }
 
-static int revwalk_enqueue_timesort(git_revwalk *walk, git_commit_list_node *commit)
+static int revwalk_enqueue_timesort(git_revwalk *walk, git_commit_idx commit)
+{
+	return git_commit_queue_insert(&walk->iterator_time, commit);
+}
+
+static int revwalk_enqueue_unsorted(git_revwalk *walk, git_commit_idx commit)
 {
-	return git_pqueue_insert(&walk->iterator_time, commit);
+	return git_commit_stack_push(&walk->iterator_rand, commit);
 }
 
-static int revwalk_enqueue_unsorted(git_revwalk *walk, git_commit_list_node *commit)
+/*
+ * The parents of a hidden commit are hidden as well, so once everything
+ * that's queued is hidden, nothing that's left to walk can be shown and
+ * there's no need to go down the rest of the hidden history.
+ */
+static int everybody_uninteresting(
+	const git_commit_table *t, const git_commit_idx *ids, size_t n)
 {
-	return git_commit_list_insert(commit, &walk->iterator_rand) ? 0 : -1;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (!(t->flags[ids[i]] & COMMIT_UNINTERESTING))
+			return 0;
+
+	return 1;
 }
 
-static int revwalk_next_timesort(git_commit_list_node **object_out, git_revwalk *walk)
+static int revwalk_next_timesort(git_commit_idx *object_out, git_revwalk *walk)
 {
+	git_commit_queue *queue = &walk->iterator_time;
+	git_commit_idx next;
 	int error;
-	git_commit_list_node *next;
 
-	while ((next = git_pqueue_pop(&walk->iterator_time)) != NULL) {
+	while ((next = git_commit_queue_pop(queue)) != GIT_COMMIT_IDX_NONE) {
 		if ((error = process_commit_parents(walk, next)) < 0)
 			return error;
 
-		if (!next->uninteresting) {
+		if (!(walk->commits.flags[next] & COMMIT_UNINTERESTING)) {
 			*object_out = next;
 			return 0;
 		}
+
+		/* element 0 isn't used - we need to start at 1 */
+		if (everybody_uninteresting(&walk->commits,
+				queue->d + 1, git_commit_queue_length(queue))) {
+			git_commit_queue_clear(queue);
+			break;
+		}
 	}
 
 	giterr_clear();
 	return GIT_ITEROVER;
 }
 
-static int revwalk_next_unsorted(git_commit_list_node **object_out, git_revwalk *walk)
+static int revwalk_next_unsorted(git_commit_idx *object_out, git_revwalk *walk)
 {
+	git_commit_stack *stack = &walk->iterator_rand;
+	git_commit_idx next;
 	int error;
-	git_commit_list_node *next;
 
-	while ((next = git_commit_list_pop(&walk->iterator_rand)) != NULL) {
+	while (stack->length > 0) {
+		next = git_commit_stack_pop(stack);
+
 		if ((error = process_commit_parents(walk, next)) < 0)
 			return error;
 
-		if (!next->uninteresting) {
+		if (!(walk->commits.flags[next] & COMMIT_UNINTERESTING)) {
 			*object_out = next;
 			return 0;
 		}
+
+		if (everybody_uninteresting(&walk->commits, stack->ids, stack->length)) {
+			git_commit_stack_clear(stack);
+			break;
+		}
 	}
 
 	giterr_clear();
 	return GIT_ITEROVER;
 }
 
-static int revwalk_next_toposort(git_commit_list_node **object_out, git_revwalk *walk)
+static int revwalk_enqueue_explore(git_revwalk *walk, git_commit_idx commit)
+{
+	/* the queue is ordered by generation, so it has to be known first */
+	if (git_commit_list_generation(walk, commit) < 0)
+		return -1;
+
+	return git_commit_queue_insert(&walk->iterator_explore, commit);
+}
+
+/*
+ * Explore the walk down to `generation`: process the parents of every
+ * queued commit at that generation or above, and count the edges from
+ * the ones that are shown into their parents' in-degrees. A commit's
+ * children all have higher generations (or the same one, when it's
+ * capped or unknown), so afterwards the in-degree of any commit at
+ * `generation` only goes down as its children are shown.
+ *
+ * Without a commit-graph every commit is at the same generation and
+ * the first call explores all of the walk.
+ */
+static int topo_explore(git_revwalk *walk, uint32_t generation)
 {
-	git_commit_list_node *next;
+	git_commit_table *t = &walk->commits;
+	git_commit_queue *queue = &walk->iterator_explore;
+	git_commit_idx next;
 	unsigned short i;
+	int error;
 
-	for (;;) {
-		next = git_commit_list_pop(&walk->iterator_topo);
-		if (next == NULL) {
-			giterr_clear();
-			return GIT_ITEROVER;
-		}
+	while ((next = git_commit_queue_peek(queue)) != GIT_COMMIT_IDX_NONE &&
+		t->generations[next] >= generation) {
+		git_commit_queue_pop(queue);
+
+		if ((error = process_commit_parents(walk, next)) < 0)
+			return error;
 
-		if (next->in_degree > 0) {
-			next->topo_delay = 1;
+		t->flags[next] |= COMMIT_TOPO_EXPLORED;
+
+		if (!(t->flags[next] & COMMIT_UNINTERESTING)) {
+			for (i = 0; i < t->parent_count[next]; ++i)
+				t->in_degree[git_commit_table_parents(t, next)[i]]++;
 			continue;
 		}
 
-		for (i = 0; i < next->out_degree; ++i) {
-			git_commit_list_node *parent = next->parents[i];
-
-			if (--parent->in_degree == 0 && parent->topo_delay) {
-				parent->topo_delay = 0;
-				if (git_commit_list_insert(parent, &walk->iterator_topo) == NULL)
-					return -1;
-			}
+		/* element 0 isn't used - we need to start at 1 */
+		if (everybody_uninteresting(t,
+				queue->d + 1, git_commit_queue_length(queue))) {
+			git_commit_queue_clear(queue);
+			break;
 		}
+	}
 
-		*object_out = next;
+	return 0;
+}
+
+/* Queue `commit` to be shown, if it's an explored, shown one which isn't yet */
+static int topo_ready(git_revwalk *walk, git_commit_idx commit)
+{
+	uint16_t *flags = &walk->commits.flags[commit];
+
+	if ((*flags & (COMMIT_TOPO_EXPLORED | COMMIT_UNINTERESTING | COMMIT_TOPO_QUEUED))
+		!= COMMIT_TOPO_EXPLORED)
 		return 0;
+
+	*flags |= COMMIT_TOPO_QUEUED;
+
+	if (walk->sorting & GIT_SORT_TIME)
+		return git_commit_queue_insert(&walk->iterator_time, commit);
+
+	return git_commit_stack_push(&walk->iterator_topo, commit);
+}
+
+/*
+ * Kahn's algorithm, with the in-degrees worked out as the walk goes
+ * instead of all up front: a parent is only explored as far as it
+ * takes to know whether all of its children have been shown. With
+ * generation numbers from a commit-graph, the first commits come out
+ * after reading about as many as are shown rather than all of history.
+ */
+static int revwalk_next_toposort(git_commit_idx *object_out, git_revwalk *walk)
+{
+	git_commit_table *t = &walk->commits;
+	git_commit_idx next;
+	unsigned short i;
+	int error;
+
+	if (walk->sorting & GIT_SORT_TIME)
+		next = git_commit_queue_pop(&walk->iterator_time);
+	else if (walk->iterator_topo.length > 0)
+		next = git_commit_stack_pop(&walk->iterator_topo);
+	else
+		next = GIT_COMMIT_IDX_NONE;
+
+	if (next == GIT_COMMIT_IDX_NONE) {
+		giterr_clear();
+		return GIT_ITEROVER;
+	}
+
+	for (i = 0; i < t->parent_count[next]; ++i) {
+		git_commit_idx parent = git_commit_table_parents(t, next)[i];
+
+		/*
+		 * One that hasn't been queued may still be, by one of its
+		 * other children, which will then explore down to it
+		 */
+		if ((t->flags[parent] & COMMIT_SEEN) &&
+			(error = topo_explore(walk, t->generations[parent])) < 0)
+			return error;
+
+		if (--t->in_degree[parent] == 0 && topo_ready(walk, parent) < 0)
+			return -1;
 	}
+
+	*object_out = next;
+	return 0;
 }
 
-static int revwalk_next_reverse(git_commit_list_node **object_out, git_revwalk *walk)
+/* Explore down to the lowest of the tips that are shown, and queue those without children */
+static int prepare_toposort(git_revwalk *walk)
 {
-	*object_out = git_commit_list_pop(&walk->iterator_reverse);
-	return *object_out ? 0 : GIT_ITEROVER;
+	git_commit_table *t = &walk->commits;
+	uint32_t generation = GIT_COMMIT_LIST_GENERATION_INFINITY;
+	git_commit_idx tip;
+	size_t i;
+	int error;
+
+	for (i = 0; i <= walk->twos.length; ++i) {
+		tip = i ? walk->twos.ids[i - 1] : walk->one;
+
+		if (!(t->flags[tip] & COMMIT_UNINTERESTING) && t->generations[tip] < generation)
+			generation = t->generations[tip];
+	}
+
+	if ((error = topo_explore(walk, generation)) < 0)
+		return error;
+
+	for (i = 0; i <= walk->twos.length; ++i) {
+		tip = i ? walk->twos.ids[i - 1] : walk->one;
+
+		if (t->in_degree[tip] == 0 && topo_ready(walk, tip) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int revwalk_next_reverse(git_commit_idx *object_out, git_revwalk *walk)
+{
+	if (walk->iterator_reverse.length == 0)
+		return GIT_ITEROVER;
+
+	*object_out = git_commit_stack_pop(&walk->iterator_reverse);
+	return 0;
 }
 
 
 static int prepare_walk(git_revwalk *walk)
 {
+	git_commit_table *t = &walk->commits;
+	git_commit_stack bases = GIT_COMMIT_STACK_INIT;
+	git_commit_idx next;
+	size_t i;
 	int error;
-	unsigned int i;
-	git_commit_list_node *next, *two;
-	git_commit_list *bases = NULL;
 
 	/*
-	 * If walk->one is NULL, there were no positive references,
+	 * If walk->one is unset, there were no positive references,
 	 * so we know that the walk is already over.
 	 */
-	if (walk->one == NULL) {
+	if (walk->one == GIT_COMMIT_IDX_NONE) {
 		giterr_clear();
 		return GIT_ITEROVER;
 	}
 
 	/* first figure out what the merge bases are */
-	if (git_merge__bases_many(&bases, walk, walk->one, &walk->twos) < 0)
+	error = git_merge__bases_many(&bases, walk, walk->one, &walk->twos);
+	git_commit_stack_free(&bases);
+	if (error < 0)
 		return -1;
 
-	git_commit_list_free(&bases);
-	if (process_commit(walk, walk->one, walk->one->uninteresting) < 0)
+	if (process_commit(walk, walk->one,
+			t->flags[walk->one] & COMMIT_UNINTERESTING) < 0)
 		return -1;
 
-	git_vector_foreach(&walk->twos, i, two) {
-		if (process_commit(walk, two, two->uninteresting) < 0)
+	for (i = 0; i < walk->twos.length; ++i) {
+		git_commit_idx two = walk->twos.ids[i];
+
+		if (process_commit(walk, two, t->flags[two] & COMMIT_UNINTERESTING) < 0)
 			return -1;
 	}
 
-	if (walk->sorting & GIT_SORT_TOPOLOGICAL) {
-		unsigned short i;
-
-		while ((error = walk->get_next(&next, walk)) == 0) {
-			for (i = 0; i < next->out_degree; ++i) {
-				git_commit_list_node *parent = next->parents[i];
-				parent->in_degree++;
-			}
-
-			if (git_commit_list_insert(next, &walk->iterator_topo) == NULL)
-				return -1;
-		}
-
-		if (error != GIT_ITEROVER)
-			return error;
-
-		walk->get_next = &revwalk_next_toposort;
-	}
+	if ((walk->sorting & GIT_SORT_TOPOLOGICAL) &&
+		(error = prepare_toposort(walk)) < 0)
+		return error;
 
 	if (walk->sorting & GIT_SORT_REVERSE) {
 
 		while ((error = walk->get_next(&next, walk)) == 0)
-			if (git_commit_list_insert(next, &walk->iterator_reverse) == NULL)
+			if (git_commit_stack_push(&walk->iterator_reverse, next) < 0)
 				return -1;
 
 		if (error != GIT_ITEROVER)
@@ -386,6 +658,17 @@ static int prepare_walk(git_revwalk *walk)
 }
 
 
+static void clear_paths(git_revwalk *walk)
+{
+	char *path;
+	size_t i;
+
+	git_vector_foreach(&walk->paths, i, path)
+		git__free(path);
+
+	git_vector_clear(&walk->paths);
+}
+
 int git_revwalk_new(git_revwalk **revwalk_out, git_repository *repo)
 {
 	git_revwalk *walk;
@@ -395,21 +678,26 @@ int git_revwalk_new(git_revwalk **revwalk_out, git_repository *repo)
 
 	memset(walk, 0x0, sizeof(git_revwalk));
 
-	walk->commits = git_oidmap_alloc();
-	GITERR_CHECK_ALLOC(walk->commits);
+	walk->one = GIT_COMMIT_IDX_NONE;
 
-	if (git_pqueue_init(&walk->iterator_time, 8, git_commit_list_time_cmp) < 0 ||
-		git_vector_init(&walk->twos, 4, NULL) < 0 ||
-		git_pool_init(&walk->commit_pool, 1,
-			git_pool__suggest_items_per_page(COMMIT_ALLOC) * COMMIT_ALLOC) < 0)
+	if (git_commit_table_init(&walk->commits) < 0 ||
+		git_commit_queue_init(&walk->iterator_time,
+			&walk->commits, git_commit_list_time_cmp) < 0 ||
+		git_commit_queue_init(&walk->iterator_explore,
+			&walk->commits, git_commit_list_generation_cmp) < 0) {
+		git_commit_queue_free(&walk->iterator_time);
+		git_commit_table_free(&walk->commits);
+		git__free(walk);
 		return -1;
+	}
 
 	walk->get_next = &revwalk_next_unsorted;
 	walk->enqueue = &revwalk_enqueue_unsorted;
 
 	walk->repo = repo;
 
-	if (git_repository_odb(&walk->odb, repo) < 0) {
+	if (git_repository_odb(&walk->odb, repo) < 0 ||
+		git_repository__commit_graph(&walk->graph, repo) < 0) {
 		git_revwalk_free(walk);
 		return -1;
 	}
@@ -425,11 +713,17 @@ void git_revwalk_free(git_revwalk *walk)
 
 	git_revwalk_reset(walk);
 	git_odb_free(walk->odb);
-
-	git_oidmap_free(walk->commits);
-	git_pool_clear(&walk->commit_pool);
-	git_pqueue_free(&walk->iterator_time);
-	git_vector_free(&walk->twos);
+	git_commit_graph_free(walk->graph);
+
+	git_commit_table_free(&walk->commits);
+	git_commit_queue_free(&walk->iterator_time);
+	git_commit_queue_free(&walk->iterator_explore);
+	git_commit_stack_free(&walk->iterator_topo);
+	git_commit_stack_free(&walk->iterator_rand);
+	git_commit_stack_free(&walk->iterator_reverse);
+	git_commit_stack_free(&walk->twos);
+	clear_paths(walk);
+	git_vector_free(&walk->paths);
 	git__free(walk);
 }
 
@@ -448,7 +742,10 @@ void git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode)
 
 	walk->sorting = sort_mode;
 
-	if (walk->sorting & GIT_SORT_TIME) {
+	if (walk->sorting & GIT_SORT_TOPOLOGICAL) {
+		walk->get_next = &revwalk_next_toposort;
+		walk->enqueue = &revwalk_enqueue_explore;
+	} else if (walk->sorting & GIT_SORT_TIME) {
 		walk->get_next = &revwalk_next_timesort;
 		walk->enqueue = &revwalk_enqueue_timesort;
 	} else {
@@ -457,10 +754,45 @@ void git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode)
 	}
 }
 
+int git_revwalk_set_paths(git_revwalk *walk, const git_strarray *paths)
+{
+	size_t i, len;
+	char *path;
+
+	assert(walk);
+
+	if (walk->walking)
+		git_revwalk_reset(walk);
+
+	clear_paths(walk);
+
+	for (i = 0; paths && i < paths->count; ++i) {
+		/* "dir/" is "dir", and "" is everything */
+		len = strlen(paths->strings[i]);
+		while (len > 0 && paths->strings[i][len - 1] == '/')
+			len--;
+
+		if (len == 0) {
+			clear_paths(walk);
+			return 0;
+		}
+
+		path = git__strndup(paths->strings[i], len);
+		GITERR_CHECK_ALLOC(path);
+
+		if (git_vector_insert(&walk->paths, path) < 0) {
+			git__free(path);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 int git_revwalk_next(git_oid *oid, git_revwalk *walk)
 {
 	int error;
-	git_commit_list_node *next;
+	git_commit_idx next;
 
 	assert(walk && oid);
 
@@ -469,7 +801,10 @@ int git_revwalk_next(git_oid *oid, git_revwalk *walk)
 			return error;
 	}
 
-	error = walk->get_next(&next, walk);
+	/* the commits left out by simplification are still walked through */
+	do
+		error = walk->get_next(&next, walk);
+	while (!error && (walk->commits.flags[next] & COMMIT_TREESAME));
 
 	if (error == GIT_ITEROVER) {
 		git_revwalk_reset(walk);
@@ -478,31 +813,33 @@ int git_revwalk_next(git_oid *oid, git_revwalk *walk)
 	}
 
 	if (!error)
-		git_oid_cpy(oid, &next->oid);
+		git_oid_cpy(oid, &walk->commits.oids[next]);
 
 	return error;
 }
 
 void git_revwalk_reset(git_revwalk *walk)
 {
-	git_commit_list_node *commit;
+	git_commit_table *t;
+	size_t i;
 
 	assert(walk);
 
-	kh_foreach_value(walk->commits, commit, {
-		commit->seen = 0;
-		commit->in_degree = 0;
-		commit->topo_delay = 0;
-		commit->uninteresting = 0;
-		});
-
-	git_pqueue_clear(&walk->iterator_time);
-	git_commit_list_free(&walk->iterator_topo);
-	git_commit_list_free(&walk->iterator_rand);
-	git_commit_list_free(&walk->iterator_reverse);
+	/* the merge base flags are kept, as they were before */
+	t = &walk->commits;
+	for (i = 0; i < t->length; ++i) {
+		t->flags[i] &= ~(COMMIT_SEEN | COMMIT_UNINTERESTING |
+			COMMIT_TOPO_EXPLORED | COMMIT_TOPO_QUEUED | COMMIT_TREESAME);
+		t->in_degree[i] = 0;
+	}
+
+	git_commit_queue_clear(&walk->iterator_time);
+	git_commit_queue_clear(&walk->iterator_explore);
+	git_commit_stack_clear(&walk->iterator_topo);
+	git_commit_stack_clear(&walk->iterator_rand);
+	git_commit_stack_clear(&walk->iterator_reverse);
 	walk->walking = 0;
 
-	walk->one = NULL;
-	git_vector_clear(&walk->twos);
+	walk->one = GIT_COMMIT_IDX_NONE;
+	git_commit_stack_clear(&walk->twos);
 }
-
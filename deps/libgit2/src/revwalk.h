@@ -8,37 +8,42 @@
 #define INCLUDE_revwalk_h__
 
 #include "git2/revwalk.h"
-#include "oidmap.h"
 #include "commit_list.h"
-#include "pqueue.h"
-#include "pool.h"
+#include "commit_graph.h"
 #include "vector.h"
 
-GIT__USE_OIDMAP;
-
 struct git_revwalk {
 	git_repository *repo;
 	git_odb *odb;
 
-	git_oidmap *commits;
-	git_pool commit_pool;
+	/* commits found here are parsed without touching the odb */
+	git_commit_graph_file *graph;
+
+	git_commit_table commits;
 
-	git_commit_list *iterator_topo;
-	git_commit_list *iterator_rand;
-	git_commit_list *iterator_reverse;
-	git_pqueue iterator_time;
+	git_commit_stack iterator_topo;
+	git_commit_stack iterator_rand;
+	git_commit_stack iterator_reverse;
+	git_commit_queue iterator_time;
 
-	int (*get_next)(git_commit_list_node **, git_revwalk *);
-	int (*enqueue)(git_revwalk *, git_commit_list_node *);
+	/* commits whose parents the topological walk has yet to look at, by generation */
+	git_commit_queue iterator_explore;
+
+	int (*get_next)(git_commit_idx *, git_revwalk *);
+	int (*enqueue)(git_revwalk *, git_commit_idx);
 
 	unsigned walking:1;
 	unsigned int sorting;
 
-	/* merge base calculation */
-	git_commit_list_node *one;
-	git_vector twos;
+	/* only the commits changing one of these are shown, if there are any */
+	git_vector paths;
+
+	/* merge base calculation; `one` is GIT_COMMIT_IDX_NONE when unset */
+	git_commit_idx one;
+	git_commit_stack twos;
 };
 
-git_commit_list_node *git_revwalk__commit_lookup(git_revwalk *walk, const git_oid *oid);
+int git_revwalk__commit_lookup(
+	git_commit_idx *out, git_revwalk *walk, const git_oid *oid);
 
 #endif
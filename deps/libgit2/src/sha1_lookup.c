@@ -176,3 +176,60 @@ int sha1_entry_pos(const void *table,
 	} while (lo < hi);
 	return -((int)lo)-1;
 }
+
+/*
+ * The keys are merged against the table one fanout bucket at a time.
+ * Each search starts where the previous key ended, first doubling its
+ * step until it overshoots and then bisecting the last step, so a
+ * dense batch walks the table nearly sequentially while a sparse one
+ * costs about a binary search per key.
+ */
+size_t sha1_entry_pos_many(unsigned char *found,
+			const unsigned char *keys, size_t count,
+			const uint32_t *fanout,
+			const void *table,
+			size_t elem_size,
+			size_t key_offset)
+{
+	const unsigned char *base = (const unsigned char *)table + key_offset;
+	size_t i = 0, set = 0;
+
+	while (i < count) {
+		unsigned char first = keys[i * 20];
+		size_t pos = first ? ntohl(fanout[first - 1]) : 0;
+		size_t end = ntohl(fanout[first]);
+
+		for (; i < count && keys[i * 20] == first; ++i) {
+			const unsigned char *key = keys + i * 20;
+			size_t lo = pos, hi, step = 1;
+
+			if (found[i / 8] & (1 << (i % 8)))
+				continue;
+
+			/* every entry before `lo` sorts before the key */
+			while (lo + step < end && memcmp(base + (lo + step) * elem_size, key, 20) < 0) {
+				lo += step;
+				step <<= 1;
+			}
+
+			hi = lo + step < end ? lo + step + 1 : end;
+			while (lo < hi) {
+				size_t mi = lo + (hi - lo) / 2;
+
+				if (memcmp(base + mi * elem_size, key, 20) < 0)
+					lo = mi + 1;
+				else
+					hi = mi;
+			}
+
+			pos = lo;
+
+			if (pos < end && !memcmp(base + pos * elem_size, key, 20)) {
+				found[i / 8] |= (1 << (i % 8));
+				set++;
+			}
+		}
+	}
+
+	return set;
+}
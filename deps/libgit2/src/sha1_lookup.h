@@ -8,6 +8,7 @@
 #define INCLUDE_sha1_lookup_h__
 
 #include <stdlib.h>
+#include <stdint.h>
 
 int sha1_entry_pos(const void *table,
 			size_t elem_size,
@@ -15,4 +16,18 @@ int sha1_entry_pos(const void *table,
 			unsigned lo, unsigned hi, unsigned nr,
 			const unsigned char *key);
 
+/*
+ * Look up the `count` sorted 20-byte keys of `keys` in a sorted table,
+ * such as a pack index, with `fanout[b]` (in network order) being the
+ * number of entries whose key starts with a byte up to `b`. Bit `i % 8`
+ * of `found[i / 8]` is set for each key that is in the table; keys whose
+ * bit is already set are not looked up. Returns how many bits were set.
+ */
+size_t sha1_entry_pos_many(unsigned char *found,
+			const unsigned char *keys, size_t count,
+			const uint32_t *fanout,
+			const void *table,
+			size_t elem_size,
+			size_t key_offset);
+
 #endif
@@ -23,6 +23,15 @@ GIT_INLINE(void) git_atomic_set(git_atomic *a, int val)
 	a->val = val;
 }
 
+/* Counters that may outgrow an int */
+typedef struct {
+#if defined(GIT_WIN32)
+	volatile __int64 val;
+#else
+	volatile ssize_t val;
+#endif
+} git_atomic_ssize;
+
 #ifdef GIT_THREADS
 
 #define git_thread pthread_t
@@ -68,6 +77,57 @@ GIT_INLINE(int) git_atomic_dec(git_atomic *a)
 #endif
 }
 
+/* Set `a` to `newval` if it holds `oldval`; returns what it held */
+GIT_INLINE(int) git_atomic_compare_and_swap(git_atomic *a, int oldval, int newval)
+{
+#if defined(GIT_WIN32)
+	return InterlockedCompareExchange(&a->val, newval, oldval);
+#elif defined(__GNUC__)
+	return __sync_val_compare_and_swap(&a->val, oldval, newval);
+#else
+#	error "Unsupported architecture for atomic operations"
+#endif
+}
+
+GIT_INLINE(ssize_t) git_atomic_ssize_add(git_atomic_ssize *a, ssize_t addend)
+{
+#if defined(GIT_WIN32)
+	return (ssize_t)InterlockedExchangeAdd64(&a->val, addend) + addend;
+#elif defined(__GNUC__)
+	return __sync_add_and_fetch(&a->val, addend);
+#else
+#	error "Unsupported architecture for atomic operations"
+#endif
+}
+
+/* Full memory barrier */
+GIT_INLINE(void) git_memory_barrier(void)
+{
+#if defined(GIT_WIN32)
+	MemoryBarrier();
+#elif defined(__GNUC__)
+	__sync_synchronize();
+#else
+#	error "Unsupported architecture for atomic operations"
+#endif
+}
+
+/*
+ * Publish `newval` in `*ptr` and return the previous value. Everything
+ * written before the swap is visible to a thread that reads `newval`.
+ */
+GIT_INLINE(void *) git___swap(void * volatile *ptr, void *newval)
+{
+#if defined(GIT_WIN32)
+	return InterlockedExchangePointer(ptr, newval);
+#elif defined(__GNUC__)
+	git_memory_barrier();
+	return __sync_lock_test_and_set(ptr, newval);
+#else
+#	error "Unsupported architecture for atomic operations"
+#endif
+}
+
 #else
 
 #define git_thread unsigned int
@@ -101,6 +161,31 @@ GIT_INLINE(int) git_atomic_dec(git_atomic *a)
 	return --a->val;
 }
 
+GIT_INLINE(int) git_atomic_compare_and_swap(git_atomic *a, int oldval, int newval)
+{
+	int found = a->val;
+	if (found == oldval)
+		a->val = newval;
+	return found;
+}
+
+GIT_INLINE(ssize_t) git_atomic_ssize_add(git_atomic_ssize *a, ssize_t addend)
+{
+	a->val += addend;
+	return a->val;
+}
+
+GIT_INLINE(void) git_memory_barrier(void)
+{
+}
+
+GIT_INLINE(void *) git___swap(void * volatile *ptr, void *newval)
+{
+	void *old = *ptr;
+	*ptr = newval;
+	return old;
+}
+
 #endif
 
 extern int git_online_cpus(void);
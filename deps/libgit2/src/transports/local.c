@@ -272,7 +272,6 @@ static int local_download_pack(
 	git_remote_head *rhead;
 	unsigned int i;
 	int error = -1;
-	git_oid oid;
 	git_packbuilder *pack = NULL;
 	git_odb_writepack *writepack = NULL;
 	git_odb *odb = NULL;
@@ -289,6 +288,9 @@ static int local_download_pack(
 	stats->received_objects = 0;
 	stats->received_bytes = 0;
 
+	if ((error = git_repository_odb__weakptr(&odb, repo)) < 0)
+		goto cleanup;
+
 	git_vector_foreach(&t->refs, i, rhead) {
 		git_object *obj;
 		if ((error = git_object_lookup(&obj, t->repo, &rhead->oid, GIT_OBJ_ANY)) < 0)
@@ -297,39 +299,32 @@ static int local_download_pack(
 		if (git_object_type(obj) == GIT_OBJ_COMMIT) {
 			/* Revwalker includes only wanted commits */
 			error = git_revwalk_push(walk, &rhead->oid);
-			if (!git_oid_iszero(&rhead->loid))
-				error = git_revwalk_hide(walk, &rhead->loid);
+
+			/*
+			 * Skip the history we already have. The hidden commits
+			 * may be missing from this side; that only means less
+			 * gets skipped.
+			 */
+			if (!error && !git_oid_iszero(&rhead->loid) &&
+				git_revwalk_hide(walk, &rhead->loid) < 0)
+				giterr_clear();
+
+			if (!error && git_odb_exists(odb, &rhead->oid))
+				error = git_revwalk_hide(walk, &rhead->oid);
 		} else {
 			/* Tag or some other wanted object. Add it on its own */
 			error = git_packbuilder_insert(pack, &rhead->oid, rhead->name);
 		}
-      git_object_free(obj);
+		git_object_free(obj);
+
+		if (error < 0)
+			goto cleanup;
 	}
 
-	/* Walk the objects, building a packfile */
-	if ((error = git_repository_odb__weakptr(&odb, repo)) < 0)
+	/* Find the objects, with the pack bitmaps if there are any */
+	if ((error = git_packbuilder_insert_walk(pack, walk)) < 0)
 		goto cleanup;
 
-	while ((error = git_revwalk_next(&oid, walk)) == 0) {
-		git_commit *commit;
-
-		/* Skip commits we already have */
-		if (git_odb_exists(odb, &oid)) continue;
-
-		if (!git_object_lookup((git_object**)&commit, t->repo, &oid, GIT_OBJ_COMMIT)) {
-			const git_oid *tree_oid = git_commit_tree_id(commit);
-
-			/* Add the commit and its tree */
-			if ((error = git_packbuilder_insert(pack, &oid, NULL)) < 0 ||
-				 (error = git_packbuilder_insert_tree(pack, tree_oid)) < 0) {
-				git_commit_free(commit);
-				goto cleanup;
-			}
-
-			git_commit_free(commit);
-		}
-	}
-
 	if ((error = git_odb_write_pack(&writepack, odb, progress_cb, progress_payload)) < 0)
 		goto cleanup;
 
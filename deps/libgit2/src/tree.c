@@ -274,7 +274,7 @@ int git_tree_entry_to_object(
 	return git_object_lookup(object_out, repo, &entry->oid, GIT_OBJ_ANY);
 }
 
-static const git_tree_entry *entry_fromname(
+const git_tree_entry *git_tree__entry_fromname(
 	git_tree *tree, const char *name, size_t name_len)
 {
 	size_t idx;
@@ -289,7 +289,7 @@ const git_tree_entry *git_tree_entry_byname(
 	git_tree *tree, const char *filename)
 {
 	assert(tree && filename);
-	return entry_fromname(tree, filename, strlen(filename));
+	return git_tree__entry_fromname(tree, filename, strlen(filename));
 }
 
 const git_tree_entry *git_tree_entry_byindex(
@@ -806,7 +806,7 @@ int git_tree_entry_bypath(
 		return GIT_ENOTFOUND;
 	}
 
-	entry = entry_fromname(root, path, filename_len);
+	entry = git_tree__entry_fromname(root, path, filename_len);
 
 	if (entry == NULL) {
 		giterr_set(GITERR_TREE,
@@ -54,6 +54,10 @@ int git_tree__parse(git_tree *tree, git_odb_object *obj);
  */
 int git_tree__prefix_position(git_tree *tree, const char *prefix);
 
+/* git_tree_entry_byname, for a name which isn't NUL-terminated */
+const git_tree_entry *git_tree__entry_fromname(
+	git_tree *tree, const char *name, size_t name_len);
+
 
 /**
  * Write a tree to the given repository
@@ -37,6 +37,10 @@ int git_libgit2_capabilities()
 /* Declarations for tuneable settings */
 extern size_t git_mwindow__window_size;
 extern size_t git_mwindow__mapped_limit;
+extern size_t git_cache__budget[];
+extern size_t git_pack__cache_memory_limit;
+extern size_t git_pack__cache_size_limit;
+extern void git_packfile_cache_trim(void);
 
 void git_libgit2_opts(int key, ...)
 {
@@ -60,6 +64,43 @@ void git_libgit2_opts(int key, ...)
 	case GIT_OPT_GET_MWINDOW_MAPPED_LIMIT:
 		*(va_arg(ap, size_t *)) = git_mwindow__mapped_limit;
 		break;
+
+	case GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT:
+		git_pack__cache_memory_limit = va_arg(ap, size_t);
+		git_packfile_cache_trim();
+		break;
+
+	case GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT:
+		*(va_arg(ap, size_t *)) = git_pack__cache_memory_limit;
+		break;
+
+	case GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT:
+		git_pack__cache_size_limit = va_arg(ap, size_t);
+		break;
+
+	case GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT:
+		*(va_arg(ap, size_t *)) = git_pack__cache_size_limit;
+		break;
+
+	case GIT_OPT_SET_CACHE_LIMIT:
+		{
+			git_otype type = (git_otype)va_arg(ap, int);
+			size_t size = va_arg(ap, size_t);
+
+			if (type >= GIT_OBJ_COMMIT && type <= GIT_OBJ_TAG)
+				git_cache__budget[type] = size;
+		}
+		break;
+
+	case GIT_OPT_GET_CACHE_LIMIT:
+		{
+			git_otype type = (git_otype)va_arg(ap, int);
+			size_t *out = va_arg(ap, size_t *);
+
+			*out = (type >= GIT_OBJ_COMMIT && type <= GIT_OBJ_TAG) ?
+				git_cache__budget[type] : 0;
+		}
+		break;
 	}
 
 	va_end(ap);
@@ -2,6 +2,7 @@
 #include <git2/types.h>
 #include "commit.h"
 #include "signature.h"
+#include "commit_header.h"
 
 // Fixture setup
 static git_repository *g_repo;
@@ -307,6 +308,56 @@ void test_commit_parse__entire_commit(void)
 }
 
 
+void test_commit_parse__header_scan(void)
+{
+	static const char *data =
+		"tree 1810dff58d8a660512d4832e740f692884338ccd\n"
+		"parent e90810b8df3e80c413d903f631643c716887138d\n"
+		"parent 05452d6349abcd67aa396dfb28660d765d8b2a36\n"
+		"author Vicent Marti <tanoku@gmail.com> 1273848544 +0200\n"
+		"committer Vicent Marti <tanoku@gmail.com> 1273848600 +0200\n"
+		"encoding ISO-8859-1\n"
+		"\n"
+		"a merge\n";
+	git_commit_header header;
+	git_oid id;
+
+	cl_git_pass(git_commit_header_scan(&header, data, strlen(data)));
+
+	cl_git_pass(git_commit_header_tree(&id, &header));
+	cl_assert(git_oid_streq(&id, "1810dff58d8a660512d4832e740f692884338ccd") == 0);
+
+	cl_assert_equal_i(2, header.parent_count);
+	cl_git_pass(git_commit_header_parent(&id, &header, 1));
+	cl_assert(git_oid_streq(&id, "05452d6349abcd67aa396dfb28660d765d8b2a36") == 0);
+
+	cl_assert(git__prefixcmp(header.author, "author Vicent") == 0);
+	cl_assert(git__prefixcmp(header.committer, "committer Vicent") == 0);
+	cl_assert_equal_i(1273848544, header.author_time);
+	cl_assert_equal_i(1273848600, header.committer_time);
+
+	cl_assert_equal_i(strlen("ISO-8859-1"), header.encoding_len);
+	cl_assert(memcmp(data + header.encoding, "ISO-8859-1", header.encoding_len) == 0);
+
+	cl_assert_equal_s("\na merge\n", data + header.header_len);
+}
+
+void test_commit_parse__header_scan_fails_on_broken_ids(void)
+{
+	static const char *broken[] = {
+		"",
+		"tree 1810dff58d8a660512d4832e740f692884338ccd",
+		"tree 1810dff58d8a660512d4832e740f692884338ccd\r\n",
+		"tree 1810dff58d8a660512d4832e740f692884338ccd\nparent e90810b8df3e",
+		"tree 1810dff58d8a660512d4832e740f692884338ccd\nauthor A <a@b.c> 1",
+	};
+	git_commit_header header;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(broken); ++i)
+		cl_git_fail(git_commit_header_scan(&header, broken[i], strlen(broken[i])));
+}
+
 // query the details on a parsed commit
 void test_commit_parse__details0(void) {
    static const char *commit_ids[] = {
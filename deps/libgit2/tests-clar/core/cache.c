@@ -0,0 +1,219 @@
+#include "clar_libgit2.h"
+
+#include "cache.h"
+#include "repository.h"
+
+/* 16 sets of 8 slots, so every shard owns exactly one set */
+#define TEST_CACHE_SIZE (GIT_CACHE_SHARDS * GIT_CACHE_WAYS)
+
+static git_cache g_cache;
+static size_t g_freed;
+static size_t g_old_budget;
+
+static void free_obj(void *obj)
+{
+	g_freed++;
+	git__free(obj);
+}
+
+static git_cached_obj *new_obj(unsigned char set, unsigned char n, size_t size)
+{
+	git_cached_obj *obj = git__calloc(1, sizeof(git_cached_obj));
+	cl_assert(obj);
+
+	obj->oid.id[0] = set;
+	obj->oid.id[19] = n;
+	obj->type = GIT_OBJ_COMMIT;
+	obj->size = size;
+	return obj;
+}
+
+static git_cached_obj *store(git_cached_obj *obj)
+{
+	git_cached_obj *stored = git_cache_try_store(&g_cache, obj);
+	cl_assert(stored == obj);
+	git_cached_obj_decref(stored, free_obj);
+	return obj;
+}
+
+static int is_cached(const git_cached_obj *obj)
+{
+	git_cached_obj *found = git_cache_get(&g_cache, &obj->oid);
+
+	if (found == NULL)
+		return 0;
+
+	git_cached_obj_decref(found, free_obj);
+	return 1;
+}
+
+void test_core_cache__initialize(void)
+{
+	g_freed = 0;
+	git_libgit2_opts(GIT_OPT_GET_CACHE_LIMIT, GIT_OBJ_COMMIT, &g_old_budget);
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_COMMIT, (size_t)(GIT_CACHE_SHARDS * 1000));
+	cl_git_pass(git_cache_init(&g_cache, TEST_CACHE_SIZE, free_obj));
+}
+
+void test_core_cache__cleanup(void)
+{
+	git_cache_free(&g_cache);
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_COMMIT, g_old_budget);
+}
+
+void test_core_cache__counts_hits_and_misses(void)
+{
+	git_cache_stats stats;
+	git_cached_obj *obj = store(new_obj(0, 1, 10));
+	git_cached_obj *missing = new_obj(0, 2, 10);
+
+	cl_assert(is_cached(obj));
+	cl_assert(is_cached(obj));
+	cl_assert(!is_cached(missing));
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(2, stats.hits);
+	cl_assert_equal_i(1, stats.misses);
+	cl_assert_equal_i(1, stats.stores);
+	cl_assert_equal_i(1, stats.entries);
+	cl_assert_equal_i(10, stats.bytes);
+
+	git__free(missing);
+}
+
+void test_core_cache__storing_twice_returns_the_cached_object(void)
+{
+	git_cached_obj *obj = store(new_obj(3, 1, 10));
+	git_cached_obj *dup = new_obj(3, 1, 10);
+
+	cl_assert(git_cache_try_store(&g_cache, dup) == obj);
+	cl_assert_equal_i(1, g_freed);
+	git_cached_obj_decref(obj, free_obj);
+}
+
+void test_core_cache__set_conflicts_evict_the_least_recently_used(void)
+{
+	git_cached_obj *objs[GIT_CACHE_WAYS + 1];
+	git_cache_stats stats;
+	int i;
+
+	for (i = 0; i < GIT_CACHE_WAYS; ++i)
+		objs[i] = store(new_obj(0, (unsigned char)i, 10));
+
+	/* touch the oldest entry, so the second one becomes the victim */
+	cl_assert(is_cached(objs[0]));
+
+	objs[GIT_CACHE_WAYS] = store(new_obj(0, GIT_CACHE_WAYS, 10));
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(1, stats.evictions);
+	cl_assert_equal_i(GIT_CACHE_WAYS, stats.entries);
+	cl_assert_equal_i(1, g_freed);
+
+	cl_assert(is_cached(objs[0]));
+	cl_assert(is_cached(objs[GIT_CACHE_WAYS]));
+	for (i = 2; i < GIT_CACHE_WAYS; ++i)
+		cl_assert(is_cached(objs[i]));
+}
+
+void test_core_cache__byte_budget_is_enforced_per_type(void)
+{
+	git_cache_stats stats;
+	int i;
+
+	/* each shard gets 1000 bytes of commits; the fifth 250 byte commit
+	 * pushes the oldest one out */
+	for (i = 0; i < 5; ++i)
+		store(new_obj(5, (unsigned char)i, 250));
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(1, stats.evictions);
+	cl_assert_equal_i(4, stats.entries);
+	cl_assert_equal_i(1000, stats.bytes);
+}
+
+void test_core_cache__writers_do_not_wait_for_readers(void)
+{
+	git_cache_stats stats;
+	git_atomic *reader;
+	int i;
+
+	/* a lookup still going on from before anything was evicted */
+	reader = &g_cache.stripes[0].readers[g_cache.epoch.val % 3];
+	git_atomic_inc(reader);
+
+	/* what's evicted can't be freed under it, so it's parked, up to
+	 * twice the budget */
+	for (i = 0; i < 8; ++i)
+		store(new_obj(5, (unsigned char)i, 250));
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(4, stats.evictions);
+	cl_assert_equal_i(2000, stats.bytes);
+	cl_assert_equal_i(0, g_freed);
+
+	/* past that, objects are handed back without being cached */
+	store(new_obj(5, 8, 250));
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(8, stats.stores);
+	cl_assert_equal_i(1, g_freed);
+
+	/* once the lookup is over, the parked ones go */
+	git_atomic_dec(reader);
+	store(new_obj(5, 9, 250));
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(1000, stats.bytes);
+	cl_assert_equal_i(6, g_freed);
+}
+
+void test_core_cache__oversized_objects_are_not_cached(void)
+{
+	git_cache_stats stats;
+	git_cached_obj *obj = new_obj(7, 1, 251);
+
+	cl_assert(git_cache_try_store(&g_cache, obj) == obj);
+	cl_assert_equal_i(1, obj->refcount.val);
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert_equal_i(0, stats.stores);
+	cl_assert_equal_i(0, stats.entries);
+
+	git_cached_obj_decref(obj, free_obj);
+	cl_assert_equal_i(1, g_freed);
+}
+
+void test_core_cache__zero_budget_disables_caching(void)
+{
+	git_cached_obj *obj = new_obj(9, 1, 0);
+
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_COMMIT, (size_t)0);
+
+	cl_assert(git_cache_try_store(&g_cache, obj) == obj);
+	git_cached_obj_decref(obj, free_obj);
+	cl_assert_equal_i(1, g_freed);
+}
+
+void test_core_cache__repository_lookups_hit_the_cache(void)
+{
+	git_repository *repo;
+	git_object *a, *b;
+	git_oid oid;
+	git_cache_stats stats;
+
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_COMMIT, g_old_budget);
+	cl_git_pass(git_repository_open(&repo, cl_fixture("testrepo.git")));
+	cl_git_pass(git_oid_fromstr(&oid, "e90810b8df3e80c413d903f631643c716887138d"));
+
+	cl_git_pass(git_object_lookup(&a, repo, &oid, GIT_OBJ_COMMIT));
+	cl_git_pass(git_object_lookup(&b, repo, &oid, GIT_OBJ_COMMIT));
+	cl_assert(a == b);
+
+	git_repository_cache_stats(&stats, repo);
+	cl_assert_equal_i(1, stats.hits);
+	cl_assert_equal_i(1, stats.stores);
+
+	git_object_free(a);
+	git_object_free(b);
+	git_repository_free(repo);
+}
@@ -16,3 +16,73 @@ void test_core_oid__streq(void)
 	cl_assert(git_oid_streq(&id, "deadbeef") == -1);
 	cl_assert(git_oid_streq(&id, "I'm not an oid.... :)") == -1);
 }
+
+#define MANY_OIDS 9
+
+static void fill_many(git_oid *oids, char *hex)
+{
+	size_t i, j;
+
+	for (i = 0; i < MANY_OIDS; ++i) {
+		for (j = 0; j < GIT_OID_RAWSZ; ++j)
+			oids[i].id[j] = (unsigned char)(i * 37 + j * 11 + 0x5a);
+		git_oid_fmt(hex + i * GIT_OID_HEXSZ, &oids[i]);
+	}
+}
+
+void test_core_oid__fmt_many(void)
+{
+	git_oid oids[MANY_OIDS];
+	char expected[MANY_OIDS * GIT_OID_HEXSZ], out[MANY_OIDS * GIT_OID_HEXSZ];
+	size_t count;
+
+	fill_many(oids, expected);
+
+	/* every count, so both the vectorized and the scalar tails run */
+	for (count = 0; count <= MANY_OIDS; ++count) {
+		memset(out, 0, sizeof(out));
+		git_oid_fmt_many(out, oids, count);
+		cl_assert(memcmp(out, expected, count * GIT_OID_HEXSZ) == 0);
+	}
+}
+
+void test_core_oid__fromstr_many(void)
+{
+	git_oid oids[MANY_OIDS], out[MANY_OIDS];
+	char hex[MANY_OIDS * GIT_OID_HEXSZ];
+	size_t count, i;
+
+	fill_many(oids, hex);
+
+	for (count = 0; count <= MANY_OIDS; ++count) {
+		memset(out, 0, sizeof(out));
+		cl_git_pass(git_oid_fromstr_many(out, hex, count));
+		cl_assert(memcmp(out, oids, count * GIT_OID_RAWSZ) == 0);
+	}
+
+	/* uppercase digits are fine too */
+	for (i = 0; i < sizeof(hex); ++i)
+		if (hex[i] >= 'a')
+			hex[i] -= 'a' - 'A';
+	cl_git_pass(git_oid_fromstr_many(out, hex, MANY_OIDS));
+	cl_assert(memcmp(out, oids, sizeof(oids)) == 0);
+}
+
+void test_core_oid__fromstr_many_rejects_invalid_chars(void)
+{
+	git_oid oids[MANY_OIDS], out[MANY_OIDS];
+	char hex[MANY_OIDS * GIT_OID_HEXSZ];
+	const char bad[] = { 'g', 'G', '/', ':', '@', '`', 0x10, (char)0xe1 };
+	size_t pos, i;
+
+	fill_many(oids, hex);
+
+	for (pos = 0; pos < sizeof(hex); pos += 7) {
+		for (i = 0; i < sizeof(bad); ++i) {
+			char saved = hex[pos];
+			hex[pos] = bad[i];
+			cl_git_fail(git_oid_fromstr_many(out, hex, MANY_OIDS));
+			hex[pos] = saved;
+		}
+	}
+}
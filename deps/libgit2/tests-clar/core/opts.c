@@ -16,3 +16,38 @@ void test_core_opts__readwrite(void)
 
 	cl_assert(new_val == old_val);
 }
+
+void test_core_opts__cache_limit(void)
+{
+	size_t old_val = 0;
+	size_t new_val = 0;
+
+	git_libgit2_opts(GIT_OPT_GET_CACHE_LIMIT, GIT_OBJ_TREE, &old_val);
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_TREE, (size_t)4321);
+	git_libgit2_opts(GIT_OPT_GET_CACHE_LIMIT, GIT_OBJ_TREE, &new_val);
+
+	cl_assert(new_val == 4321);
+
+	git_libgit2_opts(GIT_OPT_SET_CACHE_LIMIT, GIT_OBJ_TREE, old_val);
+	git_libgit2_opts(GIT_OPT_GET_CACHE_LIMIT, GIT_OBJ_TREE, &new_val);
+
+	cl_assert(new_val == old_val);
+}
+
+void test_core_opts__delta_base_cache_limits(void)
+{
+	size_t old_val = 0;
+	size_t new_val = 0;
+
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, &old_val);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, (size_t)1234567);
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, &new_val);
+	cl_assert(new_val == 1234567);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, old_val);
+
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT, &old_val);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, (size_t)4321);
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT, &new_val);
+	cl_assert(new_val == 4321);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, old_val);
+}
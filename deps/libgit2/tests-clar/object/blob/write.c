@@ -67,3 +67,39 @@ void test_object_blob_write__can_create_a_blob_in_a_bare_repo_from_a_absolute_fi
 	git_buf_free(&full_path);
 	cl_must_pass(git_futils_rmdir_r(ELSEWHERE, NULL, GIT_RMDIR_REMOVE_FILES));
 }
+
+void test_object_blob_write__can_create_blobs_from_buffers(void)
+{
+	static const char *contents[] = {
+		"1..2...3... Can you hear me?\n", "", "hello world\n",
+		"1..2...3... Can you hear me?\n", "a bit more than a block of data, "
+		"so it doesn't all fit in the first one with the padding\n",
+		"h", "he", "hel", "hell", "hello" };
+	const void *buffers[ARRAY_SIZE(contents)];
+	size_t lens[ARRAY_SIZE(contents)], i;
+	git_oid ids[ARRAY_SIZE(contents)], id;
+	git_blob *blob;
+
+	repo = cl_git_sandbox_init(BARE_REPO);
+
+	for (i = 0; i < ARRAY_SIZE(contents); ++i) {
+		buffers[i] = contents[i];
+		lens[i] = strlen(contents[i]);
+	}
+
+	cl_git_pass(git_blob_create_frombuffers(ids, repo, buffers, lens, ARRAY_SIZE(contents)));
+	cl_assert(git_oid_streq(&ids[0], "da5e4f20c91c81b44a7e298f3d3fb3fe2f178e32") == 0);
+	cl_assert(git_oid_equal(&ids[0], &ids[3]));
+
+	for (i = 0; i < ARRAY_SIZE(contents); ++i) {
+		cl_git_pass(git_blob_create_frombuffer(&id, repo, buffers[i], lens[i]));
+		cl_assert(git_oid_equal(&id, &ids[i]));
+
+		cl_git_pass(git_blob_lookup(&blob, repo, &ids[i]));
+		cl_assert_equal_i(lens[i], git_blob_rawsize(blob));
+		cl_assert(memcmp(git_blob_rawcontent(blob), contents[i], lens[i]) == 0);
+		git_blob_free(blob);
+	}
+
+	cl_git_pass(git_blob_create_frombuffers(ids, repo, NULL, NULL, 0));
+}
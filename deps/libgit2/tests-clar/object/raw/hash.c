@@ -164,3 +164,129 @@ void test_object_raw_hash__hash_multi_byte_object(void)
     hash_object_pass(&id2, &some_obj);
     cl_assert(git_oid_cmp(&id1, &id2) == 0);
 }
+
+void test_object_raw_hash__x86_implementations_agree(void)
+{
+#ifdef X86_SHA1
+	const git_hash_x86_impl *impl;
+	static const size_t lens[] = { 0, 1, 55, 56, 63, 64, 65, 127, 128, 1000, 4096 + 7 };
+	unsigned char data[4096 + 7];
+	git_oid expected[ARRAY_SIZE(lens)], id;
+	git_hash_ctx ctx;
+	uint32_t seed = 7;
+	size_t i, j;
+
+	for (i = 0; i < sizeof(data); ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)(seed >> 16);
+	}
+
+	cl_git_pass(git_hash_x86__use("generic"));
+	for (i = 0; i < ARRAY_SIZE(lens); ++i)
+		cl_git_pass(git_hash_buf(&expected[i], data, lens[i]));
+
+	for (impl = git_hash_x86__impls; impl->name; ++impl) {
+		if (!impl->supported())
+			continue;
+
+		cl_git_pass(git_hash_x86__use(impl->name));
+
+		for (i = 0; i < ARRAY_SIZE(lens); ++i) {
+			cl_git_pass(git_hash_buf(&id, data, lens[i]));
+			cl_assert(!git_oid_cmp(&expected[i], &id));
+
+			/* fed in uneven pieces, so some blocks come from the buffer */
+			cl_git_pass(git_hash_init(&ctx));
+			for (j = 0; j < lens[i]; j += 37)
+				cl_git_pass(git_hash_update(&ctx, data + j, min(37, lens[i] - j)));
+			cl_git_pass(git_hash_final(&id, &ctx));
+			cl_assert(!git_oid_cmp(&expected[i], &id));
+		}
+	}
+
+	cl_git_pass(git_hash_x86__use(NULL));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_hash_x86__use("nonexistent"));
+#endif
+}
+
+static void assert_many_hash_like_one_by_one(void)
+{
+	static const size_t lens[] = {
+		0, 1, 55, 56, 63, 64, 65, 119, 120, 127, 128, 1000, 20000, 3, 200, 64 };
+	size_t size = 20000 + ARRAY_SIZE(lens);
+	unsigned char *data = git__malloc(size);
+	git_buf_vec vec[2 * ARRAY_SIZE(lens)];
+	git_oid expected[ARRAY_SIZE(lens)], ids[ARRAY_SIZE(lens)];
+	uint32_t seed = 11;
+	size_t i, n;
+
+	cl_assert(data);
+	for (i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)(seed >> 16);
+	}
+
+	/* each in two pieces, split somewhere different every time */
+	for (i = 0; i < ARRAY_SIZE(lens); ++i) {
+		size_t split = lens[i] ? (i * 29) % lens[i] : 0;
+
+		vec[2 * i].data = data + i;
+		vec[2 * i].len = split;
+		vec[2 * i + 1].data = data + i + split;
+		vec[2 * i + 1].len = lens[i] - split;
+		cl_git_pass(git_hash_vec(&expected[i], &vec[2 * i], 2));
+	}
+
+	/* every count, so some lanes are left over and idle */
+	for (n = 0; n <= ARRAY_SIZE(lens); ++n) {
+		memset(ids, 0, sizeof(ids));
+		cl_git_pass(git_hash_vec_many(ids, vec, 2, n));
+		for (i = 0; i < n; ++i)
+			cl_assert(!git_oid_cmp(&expected[i], &ids[i]));
+	}
+
+	git__free(data);
+}
+
+void test_object_raw_hash__many_hash_like_one_by_one(void)
+{
+#ifdef X86_SHA1
+	const git_hash_x86_impl *impl;
+
+	for (impl = git_hash_x86__impls; impl->name; ++impl) {
+		if (!impl->supported())
+			continue;
+
+		cl_git_pass(git_hash_x86__use(impl->name));
+		git_hash_x86__use_lanes(0);
+		assert_many_hash_like_one_by_one();
+
+		if (git_hash_x86__use_lanes(1) == 0)
+			assert_many_hash_like_one_by_one();
+	}
+
+	cl_git_pass(git_hash_x86__use(NULL));
+#else
+	assert_many_hash_like_one_by_one();
+#endif
+}
+
+void test_object_raw_hash__many_objects(void)
+{
+	git_rawobj objs[3];
+	git_oid ids[3], id;
+	size_t i;
+
+	objs[0] = commit_obj;
+	objs[1] = tree_obj;
+	objs[2] = zero_obj;
+
+	cl_git_pass(git_odb__hashobj_many(ids, objs, 3));
+	for (i = 0; i < 3; ++i) {
+		hash_object_pass(&id, &objs[i]);
+		cl_assert(!git_oid_cmp(&id, &ids[i]));
+	}
+
+	objs[1] = junk_obj;
+	cl_git_fail(git_odb__hashobj_many(ids, objs, 3));
+}
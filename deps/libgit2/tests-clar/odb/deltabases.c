@@ -0,0 +1,122 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "pack.h"
+
+static git_odb *_odb;
+static size_t _old_limit, _old_object_limit;
+
+void test_odb_deltabases__initialize(void)
+{
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, &_old_limit);
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT, &_old_object_limit);
+
+	cl_git_pass(git_odb_open(&_odb, cl_fixture("testrepo.git/objects")));
+}
+
+void test_odb_deltabases__cleanup(void)
+{
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, _old_limit);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, _old_object_limit);
+}
+
+static int read_cb(const git_oid *oid, void *data)
+{
+	git_odb_object *obj;
+	GIT_UNUSED(data);
+
+	cl_git_pass(git_odb_read(&obj, _odb, oid));
+	git_odb_object_free(obj);
+
+	return 0;
+}
+
+static int verify_cb(const git_oid *oid, void *data)
+{
+	git_odb_object *obj;
+	git_oid actual;
+	GIT_UNUSED(data);
+
+	cl_git_pass(git_odb_read(&obj, _odb, oid));
+	cl_git_pass(git_odb_hash(&actual, git_odb_object_data(obj),
+		git_odb_object_size(obj), git_odb_object_type(obj)));
+	cl_assert(git_oid_cmp(oid, &actual) == 0);
+	git_odb_object_free(obj);
+
+	return 0;
+}
+
+static void read_all(git_cache_stats *before, git_cache_stats *after)
+{
+	git_odb_delta_base_cache_stats(before);
+	cl_git_pass(git_odb_foreach(_odb, read_cb, NULL));
+	git_odb_delta_base_cache_stats(after);
+}
+
+void test_odb_deltabases__bases_are_cached_and_reused(void)
+{
+	git_cache_stats before, after;
+
+	read_all(&before, &after);
+
+	cl_assert(after.stores > before.stores);
+	cl_assert(after.hits > before.hits);
+	cl_assert(after.bytes <= _old_limit);
+}
+
+void test_odb_deltabases__budget_is_enforced(void)
+{
+	git_cache_stats before, after;
+
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, (size_t)4096);
+	read_all(&before, &after);
+
+	cl_assert(after.evictions > before.evictions);
+	cl_assert(after.bytes <= 4096);
+
+	/* lowering the limit shrinks the cache right away */
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, (size_t)0);
+	git_odb_delta_base_cache_stats(&after);
+	cl_assert_equal_i(0, after.bytes);
+	cl_assert_equal_i(0, after.entries);
+}
+
+void test_odb_deltabases__large_bases_are_not_cached(void)
+{
+	git_cache_stats before, after;
+
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, (size_t)0);
+	read_all(&before, &after);
+
+	cl_assert_equal_i(before.stores, after.stores);
+	cl_assert(after.misses > before.misses);
+}
+
+void test_odb_deltabases__closing_packs_releases_their_bases(void)
+{
+	git_cache_stats before, after;
+
+	read_all(&before, &after);
+	cl_assert(after.entries > 0);
+
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	git_odb_delta_base_cache_stats(&after);
+	cl_assert_equal_i(0, after.entries);
+	cl_assert_equal_i(0, after.bytes);
+}
+
+void test_odb_deltabases__chains_resolve_to_the_right_content(void)
+{
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, NULL));
+
+	/* again, with every chain walked down to its root */
+	git_odb_free(_odb);
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, (size_t)0);
+	cl_git_pass(git_odb_open(&_odb, cl_fixture("testrepo.git/objects")));
+
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, NULL));
+}
@@ -0,0 +1,130 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "pack_data.h"
+
+#define IS_FOUND(found, i) (((found)[(i) / 8] >> ((i) % 8)) & 1)
+
+static git_odb *_odb;
+static git_oid *_ids;
+static size_t _count;
+
+void test_odb_exists_many__initialize(void)
+{
+	cl_fixture_sandbox("testrepo.git");
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+}
+
+void test_odb_exists_many__cleanup(void)
+{
+	git__free(_ids);
+	_ids = NULL;
+	_count = 0;
+
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	cl_fixture_cleanup("testrepo.git");
+}
+
+static void add_id(const git_oid *id)
+{
+	_ids = git__realloc(_ids, (_count + 1) * sizeof(git_oid));
+	cl_assert(_ids != NULL);
+	git_oid_cpy(&_ids[_count++], id);
+}
+
+static void add_str(const char *str)
+{
+	git_oid id;
+
+	cl_git_pass(git_oid_fromstr(&id, str));
+	add_id(&id);
+}
+
+/*
+ * Every packed and loose object, interleaved with ids that differ
+ * from them in the last byte and the odd duplicate, so that neither
+ * the objects nor the misses arrive in order.
+ */
+static void add_mixed_ids(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(packed_objects); ++i) {
+		git_oid id;
+
+		cl_git_pass(git_oid_fromstr(&id, packed_objects[ARRAY_SIZE(packed_objects) - 1 - i]));
+		add_id(&id);
+
+		id.id[GIT_OID_RAWSZ - 1] ^= 0x5a;
+		add_id(&id);
+
+		if (i % 7 == 0)
+			add_str(packed_objects[i]);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(loose_objects); ++i)
+		add_str(loose_objects[i]);
+}
+
+static void check_against_exists(void)
+{
+	unsigned char *found;
+	size_t i, present = 0;
+
+	found = git__malloc((_count + 7) / 8);
+	cl_assert(found != NULL);
+	memset(found, 0xff, (_count + 7) / 8);
+
+	cl_git_pass(git_odb_exists_many(found, _odb, _ids, _count));
+
+	for (i = 0; i < _count; ++i) {
+		cl_assert_equal_i(git_odb_exists(_odb, &_ids[i]), IS_FOUND(found, i));
+		present += IS_FOUND(found, i);
+	}
+
+	/* the padding bits of the last byte are cleared too */
+	for (; i % 8; ++i)
+		cl_assert(!IS_FOUND(found, i));
+
+	cl_assert(present > 0 && present < _count);
+	git__free(found);
+}
+
+void test_odb_exists_many__agrees_with_exists(void)
+{
+	add_mixed_ids();
+	check_against_exists();
+}
+
+void test_odb_exists_many__agrees_with_exists_through_a_midx(void)
+{
+	add_mixed_ids();
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+	git_odb_free(_odb);
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+
+	check_against_exists();
+}
+
+void test_odb_exists_many__partial_last_byte(void)
+{
+	unsigned char found[2] = { 0xff, 0xff };
+
+	add_str(packed_objects[0]);
+	add_str("0000000000000000000000000000000000000001");
+	add_str(loose_objects[0]);
+
+	cl_git_pass(git_odb_exists_many(found, _odb, _ids, _count));
+	cl_assert_equal_i(0x05, found[0]);
+	cl_assert_equal_i(0xff, found[1]);
+}
+
+void test_odb_exists_many__no_ids(void)
+{
+	unsigned char found = 0xff;
+
+	cl_git_pass(git_odb_exists_many(&found, _odb, NULL, 0));
+	cl_assert_equal_i(0xff, found);
+}
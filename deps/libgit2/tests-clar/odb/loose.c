@@ -82,3 +82,55 @@ void test_odb_loose__simple_reads(void)
 	test_read_object(&two);
 	test_read_object(&some);
 }
+
+void test_odb_loose__listing_follows_the_directories(void)
+{
+	git_oid id, found;
+	git_odb *odb;
+	git_odb_object *obj;
+
+	cl_git_pass(git_odb_open(&odb, "test-objects"));
+	cl_git_pass(git_oid_fromstr(&id, one.id));
+
+	/* listed while the object isn't there, then written behind our back */
+	cl_assert(!git_odb_exists(odb, &id));
+	write_object_files(&one);
+	cl_assert(git_odb_exists(odb, &id));
+
+	/* and pruned behind our back */
+	cl_must_pass(p_unlink(one.file));
+	cl_assert(!git_odb_exists(odb, &id));
+
+	cl_git_pass(git_oid_fromstrn(&id, commit.id, 8));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_odb_read_prefix(&obj, odb, &id, 8));
+	write_object_files(&commit);
+	cl_git_pass(git_odb_read_prefix(&obj, odb, &id, 8));
+	cl_git_pass(git_oid_fromstr(&found, commit.id));
+	cl_assert(!git_oid_cmp(&found, git_odb_object_id(obj)));
+	git_odb_object_free(obj);
+
+	/* what we write ourselves is listed right away */
+	cl_git_pass(git_odb_write(&id, odb, "listed\n", 7, GIT_OBJ_BLOB));
+	cl_assert(git_odb_exists(odb, &id));
+	cl_git_pass(git_odb_read_prefix(&obj, odb, &id, 7));
+	git_odb_object_free(obj);
+
+	git_odb_free(odb);
+}
+
+void test_odb_loose__empty_files_fail_to_read(void)
+{
+	git_oid id;
+	git_odb *odb;
+	git_odb_object *obj;
+	int fd;
+
+	cl_must_pass(p_mkdir(one.dir, GIT_OBJECT_DIR_MODE));
+	cl_assert((fd = p_creat(one.file, S_IREAD | S_IWRITE)) >= 0);
+	p_close(fd);
+
+	cl_git_pass(git_odb_open(&odb, "test-objects"));
+	cl_git_pass(git_oid_fromstr(&id, one.id));
+	cl_git_fail(git_odb_read(&obj, odb, &id));
+	git_odb_free(odb);
+}
@@ -0,0 +1,193 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "midx.h"
+#include "pack_data.h"
+
+#define MIDX_PATH "testrepo.git/objects/pack/" GIT_MIDX_FILE
+
+static git_odb *_odb;
+
+void test_odb_midx__initialize(void)
+{
+	cl_fixture_sandbox("testrepo.git");
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+}
+
+void test_odb_midx__cleanup(void)
+{
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	cl_fixture_cleanup("testrepo.git");
+}
+
+static int verify_cb(const git_oid *oid, void *data)
+{
+	git_odb_object *obj;
+	git_oid actual;
+	size_t *count = data;
+
+	cl_assert(git_odb_exists(_odb, oid));
+	cl_git_pass(git_odb_read(&obj, _odb, oid));
+	cl_git_pass(git_odb_hash(&actual, git_odb_object_data(obj),
+		git_odb_object_size(obj), git_odb_object_type(obj)));
+	cl_assert(git_oid_cmp(oid, &actual) == 0);
+	git_odb_object_free(obj);
+
+	(*count)++;
+	return 0;
+}
+
+static void reopen_odb(void)
+{
+	git_odb_free(_odb);
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+}
+
+void test_odb_midx__write_covers_every_pack(void)
+{
+	git_midx_file *idx;
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+
+	cl_git_pass(git_midx_open(&idx, MIDX_PATH));
+	cl_assert_equal_i(3, idx->packfile_names.length);
+	cl_assert_equal_s("pack-a81e489679b7d3418f9ab594bda8ceb37dd4c695.idx",
+		git_vector_get(&idx->packfile_names, 0));
+	cl_assert_equal_i(1640, idx->num_objects);
+	git_midx_free(idx);
+}
+
+void test_odb_midx__objects_are_found_through_the_index(void)
+{
+	size_t before = 0, after = 0, i;
+
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, &before));
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+	reopen_odb();
+
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, &after));
+	cl_assert_equal_i(before, after);
+
+	for (i = 0; i < ARRAY_SIZE(packed_objects); ++i) {
+		git_oid id;
+		size_t len;
+		git_otype type;
+
+		cl_git_pass(git_oid_fromstr(&id, packed_objects[i]));
+		cl_git_pass(git_odb_read_header(&len, &type, _odb, &id));
+	}
+}
+
+void test_odb_midx__prefixes_are_resolved_through_the_index(void)
+{
+	git_odb_object *obj;
+	git_oid id, expected;
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+	reopen_odb();
+
+	cl_git_pass(git_oid_fromstrn(&id, "1fd98a6", 7));
+	cl_git_pass(git_oid_fromstr(&expected, "1fd98a61779c499739cbc3f34f351eb40d3cb4ee"));
+	cl_git_pass(git_odb_read_prefix(&obj, _odb, &id, 7));
+	cl_assert(git_oid_cmp(&expected, git_odb_object_id(obj)) == 0);
+	git_odb_object_free(obj);
+
+	/* 1fd98a6... and 1fd9c75... */
+	cl_git_pass(git_oid_fromstrn(&id, "1fd9", 4));
+	cl_assert_equal_i(GIT_EAMBIGUOUS, git_odb_read_prefix(&obj, _odb, &id, 4));
+
+	cl_git_pass(git_oid_fromstrn(&id, "1fd9f", 5));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_odb_read_prefix(&obj, _odb, &id, 5));
+}
+
+void test_odb_midx__missing_objects_are_not_found(void)
+{
+	git_oid id;
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+	reopen_odb();
+
+	cl_git_pass(git_oid_fromstr(&id, "1fd98a61779c499739cbc3f34f351eb40d3cb4ef"));
+	cl_assert(!git_odb_exists(_odb, &id));
+}
+
+void test_odb_midx__an_index_naming_missing_packs_is_ignored(void)
+{
+	size_t count = 0;
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	cl_must_pass(p_unlink("testrepo.git/objects/pack/pack-d7c6adf9f61318f041845b01440d09aa7a91e1b5.pack"));
+	cl_must_pass(p_unlink("testrepo.git/objects/pack/pack-d7c6adf9f61318f041845b01440d09aa7a91e1b5.idx"));
+
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, &count));
+	cl_assert(count > 0);
+}
+
+void test_odb_midx__a_corrupt_index_is_ignored(void)
+{
+	size_t count = 0;
+
+	cl_git_mkfile(MIDX_PATH, "MIDX but not really");
+	reopen_odb();
+
+	cl_git_pass(git_odb_foreach(_odb, verify_cb, &count));
+	cl_assert(count > 0);
+}
+
+void test_odb_midx__objects_are_found_past_a_bad_index_entry(void)
+{
+	git_midx_file *idx;
+	unsigned char *data;
+	size_t len, i, chunks, ooff = 0, count;
+	git_odb_object *obj;
+	git_oid id;
+	int fd;
+
+	cl_git_pass(git_odb_write_multi_pack_index(_odb));
+
+	cl_git_pass(git_midx_open(&idx, MIDX_PATH));
+	count = idx->num_objects;
+	git_midx_free(idx);
+
+	/* point every object at a pack the index doesn't have */
+	cl_assert((fd = p_open(MIDX_PATH, O_RDWR)) >= 0);
+	len = (size_t)p_lseek(fd, 0, SEEK_END);
+	cl_assert((data = git__malloc(len)) != NULL);
+	cl_assert(p_lseek(fd, 0, SEEK_SET) == 0);
+	cl_assert(p_read(fd, data, len) == (ssize_t)len);
+
+	chunks = data[6];
+	for (i = 0; i < chunks; ++i) {
+		unsigned char *entry = data + 12 + i * 12;
+		if (memcmp(entry, "OOFF", 4) == 0)
+			ooff = ((size_t)entry[8] << 24) | (entry[9] << 16) | (entry[10] << 8) | entry[11];
+	}
+	cl_assert(ooff > 0);
+
+	for (i = 0; i < count; ++i)
+		memset(data + ooff + i * 8, 0xff, 4);
+
+	cl_assert(p_lseek(fd, 0, SEEK_SET) == 0);
+	cl_git_pass(p_write(fd, data, len));
+	p_close(fd);
+	git__free(data);
+
+	reopen_odb();
+
+	for (i = 0; i < ARRAY_SIZE(packed_objects); ++i) {
+		cl_git_pass(git_oid_fromstr(&id, packed_objects[i]));
+		cl_assert(git_odb_exists(_odb, &id));
+		cl_git_pass(git_odb_read(&obj, _odb, &id));
+		git_odb_object_free(obj);
+	}
+
+	cl_git_pass(git_oid_fromstrn(&id, packed_objects[0], 10));
+	cl_git_pass(git_odb_read_prefix(&obj, _odb, &id, 10));
+	git_odb_object_free(obj);
+}
@@ -0,0 +1,82 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "fileops.h"
+
+/* only in bad_tag.git's pack */
+#define BAD_TAG_ID "eda9f45a2a98d4c17a09d681d88569fa4ea91755"
+#define BAD_TAG_PACK "pack-7a28f4e000a17f49a41d7a79fc2f762a8a7d9164"
+
+static git_odb *_odb;
+static git_oid _id;
+
+void test_odb_missing__initialize(void)
+{
+	cl_fixture_sandbox("testrepo.git");
+	cl_git_pass(git_odb_open(&_odb, "testrepo.git/objects"));
+	cl_git_pass(git_oid_fromstr(&_id, BAD_TAG_ID));
+}
+
+void test_odb_missing__cleanup(void)
+{
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	cl_fixture_cleanup("testrepo.git");
+}
+
+/* what another application fetching into the repository would do */
+static void add_bad_tag_pack(void)
+{
+	cl_git_pass(git_futils_cp(
+		cl_fixture("bad_tag.git/objects/pack/" BAD_TAG_PACK ".pack"),
+		"testrepo.git/objects/pack/" BAD_TAG_PACK ".pack", 0444));
+	cl_git_pass(git_futils_cp(
+		cl_fixture("bad_tag.git/objects/pack/" BAD_TAG_PACK ".idx"),
+		"testrepo.git/objects/pack/" BAD_TAG_PACK ".idx", 0444));
+}
+
+void test_odb_missing__packs_added_later_are_found(void)
+{
+	git_odb_object *obj;
+
+	add_bad_tag_pack();
+
+	cl_assert(git_odb_exists(_odb, &_id));
+	cl_git_pass(git_odb_read(&obj, _odb, &_id));
+	git_odb_object_free(obj);
+}
+
+void test_odb_missing__remembered_misses_are_dropped_when_packs_change(void)
+{
+	git_odb_object *obj;
+
+	/* the second time round it's remembered */
+	cl_assert(!git_odb_exists(_odb, &_id));
+	cl_assert(!git_odb_exists(_odb, &_id));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_odb_read(&obj, _odb, &_id));
+
+	/* without anyone calling git_odb_refresh */
+	add_bad_tag_pack();
+
+	cl_assert(git_odb_exists(_odb, &_id));
+	cl_git_pass(git_odb_read(&obj, _odb, &_id));
+	git_odb_object_free(obj);
+}
+
+void test_odb_missing__writing_an_object_forgets_it_was_missing(void)
+{
+	const char *data = "not in testrepo yet\n";
+	git_odb_object *obj;
+	git_oid id, written;
+
+	cl_git_pass(git_odb_hash(&id, data, strlen(data), GIT_OBJ_BLOB));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_odb_read(&obj, _odb, &id));
+	cl_assert(!git_odb_exists(_odb, &id));
+
+	cl_git_pass(git_odb_write(&written, _odb, data, strlen(data), GIT_OBJ_BLOB));
+	cl_assert(git_oid_cmp(&id, &written) == 0);
+
+	cl_assert(git_odb_exists(_odb, &id));
+	cl_git_pass(git_odb_read(&obj, _odb, &id));
+	git_odb_object_free(obj);
+}
@@ -0,0 +1,220 @@
+#include "clar_libgit2.h"
+#include "odb.h"
+#include "pack.h"
+#include "posix.h"
+#include "buffer.h"
+
+static git_odb *_odb;
+static git_repository *_repo;
+
+void test_odb_streaming__initialize(void)
+{
+	_odb = NULL;
+	_repo = NULL;
+}
+
+void test_odb_streaming__cleanup(void)
+{
+	git_odb_free(_odb);
+	_odb = NULL;
+
+	if (_repo) {
+		git_repository_free(_repo);
+		_repo = NULL;
+		cl_fixture_cleanup("streaming.git");
+	}
+}
+
+/* Read the object through a stream, `chunk` bytes at a time */
+static void assert_streams_like_read(const git_oid *oid, size_t chunk)
+{
+	git_odb_object *obj;
+	git_odb_stream *stream;
+	git_otype type;
+	size_t len, total = 0;
+	char *buf = git__malloc(chunk);
+	int n;
+
+	cl_assert(buf);
+	cl_git_pass(git_odb_read(&obj, _odb, oid));
+	cl_git_pass(git_odb_open_rstream_ext(&stream, &len, &type, _odb, oid));
+
+	cl_assert_equal_i(git_odb_object_size(obj), len);
+	cl_assert_equal_i(git_odb_object_type(obj), type);
+
+	while ((n = stream->read(stream, buf, chunk)) > 0) {
+		cl_assert(total + n <= len);
+		cl_assert(memcmp((const char *)git_odb_object_data(obj) + total, buf, n) == 0);
+		total += n;
+	}
+
+	cl_assert_equal_i(0, n);
+	cl_assert_equal_i(len, total);
+
+	stream->free(stream);
+	git_odb_object_free(obj);
+	git__free(buf);
+}
+
+static int stream_cb(const git_oid *oid, void *data)
+{
+	GIT_UNUSED(data);
+	assert_streams_like_read(oid, 7);
+	return 0;
+}
+
+void test_odb_streaming__every_object_streams(void)
+{
+	git_odb_stream *stream;
+	git_otype type;
+	git_oid oid;
+	size_t len;
+
+	/* a mix of loose objects, plain packed ones and deltas */
+	cl_git_pass(git_odb_open(&_odb, cl_fixture("testrepo.git/objects")));
+	cl_git_pass(git_odb_foreach(_odb, stream_cb, NULL));
+
+	cl_git_pass(git_oid_fromstr(&oid, "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef"));
+	cl_assert_equal_i(GIT_ENOTFOUND,
+		git_odb_open_rstream_ext(&stream, &len, &type, _odb, &oid));
+}
+
+static git_transfer_progress _stats;
+
+static int index_cb(void *buf, size_t len, void *payload)
+{
+	return git_indexer_stream_add(payload, buf, len, &_stats);
+}
+
+#define BIG_SIZE (3 * 1024 * 1024)
+#define BIG_BLOCK (64 * 1024)
+
+void test_odb_streaming__large_deltas_stream(void)
+{
+	unsigned char *a, *b, *c, *d;
+	uint32_t seed = 42;
+	git_oid ids[4];
+	git_packbuilder *pb;
+	git_indexer_stream *idx;
+	git_buf pack = GIT_BUF_INIT;
+	struct stat st;
+	char hex[GIT_OID_HEXSZ + 1];
+	size_t half = BIG_SIZE / 2, i;
+
+	cl_git_pass(git_repository_init(&_repo, "streaming.git", 1));
+	cl_git_pass(git_repository_odb(&_odb, _repo));
+
+	/* random, so the only way the pack gets small is with deltas */
+	a = git__malloc(BIG_SIZE);
+	b = git__malloc(BIG_SIZE + 5);
+	c = git__malloc(BIG_SIZE + 5 + half / 2);
+	d = git__malloc(BIG_SIZE);
+	cl_assert(a && b && c && d);
+
+	for (i = 0; i < BIG_SIZE; ++i) {
+		seed = seed * 1103515245 + 12345;
+		a[i] = (unsigned char)(seed >> 16);
+	}
+
+	/* the second half first: the base is read out of order */
+	memcpy(b, a + half, BIG_SIZE - half);
+	memcpy(b + BIG_SIZE - half, "hello", 5);
+	memcpy(b + BIG_SIZE - half + 5, a, half);
+
+	/* a part repeated: the base is read again from not so far back */
+	memcpy(c, b, half + half / 2);
+	memcpy(c + half + half / 2, b + half, half / 2);
+	memcpy(c + half + half / 2 + half / 2, b + half + half / 2, BIG_SIZE + 5 - half - half / 2);
+
+	/* blocks in reverse: every copy goes back past the window */
+	for (i = 0; i < BIG_SIZE; i += BIG_BLOCK)
+		memcpy(d + i, a + BIG_SIZE - BIG_BLOCK - i, BIG_BLOCK);
+
+	cl_git_pass(git_blob_create_frombuffer(&ids[0], _repo, a, BIG_SIZE));
+	cl_git_pass(git_blob_create_frombuffer(&ids[1], _repo, b, BIG_SIZE + 5));
+	cl_git_pass(git_blob_create_frombuffer(&ids[2], _repo, c, BIG_SIZE + 5 + half / 2));
+	cl_git_pass(git_blob_create_frombuffer(&ids[3], _repo, d, BIG_SIZE));
+
+	cl_git_pass(git_packbuilder_new(&pb, _repo));
+	for (i = 0; i < 4; ++i)
+		cl_git_pass(git_packbuilder_insert(pb, &ids[i], "big"));
+
+	memset(&_stats, 0, sizeof(_stats));
+	cl_git_pass(git_indexer_stream_new(&idx, "streaming.git/objects/pack", NULL, NULL));
+	cl_git_pass(git_packbuilder_foreach(pb, index_cb, idx));
+	cl_git_pass(git_indexer_stream_finalize(idx, &_stats));
+
+	git_oid_tostr(hex, sizeof(hex), git_indexer_stream_hash(idx));
+	cl_git_pass(git_buf_printf(&pack, "streaming.git/objects/pack/pack-%s.pack", hex));
+	cl_git_pass(p_stat(pack.ptr, &st));
+	cl_assert(st.st_size < 2 * BIG_SIZE);
+
+	git_indexer_stream_free(idx);
+	git_packbuilder_free(pb);
+
+	/* the loose copies have no streams; the packed ones are used */
+	cl_git_pass(git_odb_refresh(_odb));
+
+	for (i = 0; i < 4; ++i) {
+		assert_streams_like_read(&ids[i], 4096);
+		assert_streams_like_read(&ids[i], GIT_PACKFILE_READER_WINDOW + 3);
+	}
+
+	git_buf_free(&pack);
+	git__free(a);
+	git__free(b);
+	git__free(c);
+	git__free(d);
+}
+
+#define DEEP_SIZE (GIT_PACKFILE_READER_WINDOW + 256 * 1024)
+#define DEEP_VERSIONS 24
+
+/*
+ * Versions of a blob that each change a few bytes of the one before it,
+ * so the builder chains them deeper than the reader streams.
+ */
+void test_odb_streaming__deep_delta_chains_stream(void)
+{
+	unsigned char *data;
+	uint32_t seed = 7;
+	git_oid ids[DEEP_VERSIONS];
+	git_packbuilder *pb;
+	git_indexer_stream *idx;
+	size_t i;
+
+	cl_git_pass(git_repository_init(&_repo, "streaming.git", 1));
+	cl_git_pass(git_repository_odb(&_odb, _repo));
+
+	data = git__malloc(DEEP_SIZE);
+	cl_assert(data);
+
+	for (i = 0; i < DEEP_SIZE; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)(seed >> 16);
+	}
+
+	for (i = 0; i < DEEP_VERSIONS; ++i) {
+		data[(i * 40503) % DEEP_SIZE] ^= 0x5a;
+		cl_git_pass(git_blob_create_frombuffer(&ids[i], _repo, data, DEEP_SIZE));
+	}
+
+	cl_git_pass(git_packbuilder_new(&pb, _repo));
+	for (i = 0; i < DEEP_VERSIONS; ++i)
+		cl_git_pass(git_packbuilder_insert(pb, &ids[i], "deep"));
+
+	memset(&_stats, 0, sizeof(_stats));
+	cl_git_pass(git_indexer_stream_new(&idx, "streaming.git/objects/pack", NULL, NULL));
+	cl_git_pass(git_packbuilder_foreach(pb, index_cb, idx));
+	cl_git_pass(git_indexer_stream_finalize(idx, &_stats));
+
+	git_indexer_stream_free(idx);
+	git_packbuilder_free(pb);
+
+	cl_git_pass(git_odb_refresh(_odb));
+
+	for (i = 0; i < DEEP_VERSIONS; ++i)
+		assert_streams_like_read(&ids[i], 64 * 1024);
+
+	git__free(data);
+}
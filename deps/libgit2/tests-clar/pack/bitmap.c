@@ -0,0 +1,336 @@
+#include "clar_libgit2.h"
+#include "ewah.h"
+#include "pack-objects.h"
+#include "pack_bitmap.h"
+#include "repository.h"
+#include "fileops.h"
+#include "posix.h"
+
+static git_repository *_repo;
+
+void test_pack_bitmap__initialize(void)
+{
+	_repo = NULL;
+}
+
+void test_pack_bitmap__cleanup(void)
+{
+	if (_repo) {
+		cl_git_sandbox_cleanup();
+		_repo = NULL;
+	}
+}
+
+static void assert_ewah_roundtrip(const git_bitmap *bitmap, size_t bits)
+{
+	git_bitmap read = GIT_BITMAP_INIT;
+	git_buf buf = GIT_BUF_INIT;
+	size_t consumed, i;
+
+	cl_git_pass(git_ewah_write(&buf, bitmap, bits));
+	cl_git_pass(git_ewah_read(&read, &consumed, (unsigned char *)buf.ptr, buf.size, bits));
+	cl_assert_equal_i(buf.size, consumed);
+
+	for (i = 0; i < bits; ++i)
+		cl_assert_equal_i(git_bitmap_get(bitmap, i), git_bitmap_get(&read, i));
+	cl_assert(!git_bitmap_get(&read, bits));
+
+	/* a truncated encoding is refused, and so are more bits than asked for */
+	cl_git_fail(git_ewah_read(&read, &consumed, (unsigned char *)buf.ptr, buf.size - 5, bits));
+	if (bits > 0)
+		cl_git_fail(git_ewah_read(&read, &consumed, (unsigned char *)buf.ptr, buf.size, bits - 1));
+
+	git_bitmap_free(&read);
+	git_buf_free(&buf);
+}
+
+void test_pack_bitmap__ewah_roundtrip(void)
+{
+	git_bitmap bitmap = GIT_BITMAP_INIT;
+	uint32_t seed = 1;
+	size_t i;
+
+	assert_ewah_roundtrip(&bitmap, 0);
+	assert_ewah_roundtrip(&bitmap, 1000);
+
+	/* runs of ones and zeroes, with literal words in between */
+	for (i = 0; i < 300; ++i)
+		cl_git_pass(git_bitmap_set(&bitmap, i));
+	for (i = 1000; i < 1100; i += 3)
+		cl_git_pass(git_bitmap_set(&bitmap, i));
+	for (i = 5000; i < 9000; ++i)
+		cl_git_pass(git_bitmap_set(&bitmap, i));
+	assert_ewah_roundtrip(&bitmap, 9000);
+	assert_ewah_roundtrip(&bitmap, 9001);
+	assert_ewah_roundtrip(&bitmap, 4000);
+
+	git_bitmap_free(&bitmap);
+
+	for (i = 0; i < 2000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) & 1)
+			cl_git_pass(git_bitmap_set(&bitmap, i));
+	}
+	assert_ewah_roundtrip(&bitmap, 2000);
+	assert_ewah_roundtrip(&bitmap, 1999);
+
+	git_bitmap_free(&bitmap);
+}
+
+void test_pack_bitmap__ewah_bits_past_the_bit_count_are_refused(void)
+{
+	git_bitmap bitmap = GIT_BITMAP_INIT;
+	git_buf buf = GIT_BUF_INIT;
+	size_t consumed;
+
+	cl_git_pass(git_bitmap_set(&bitmap, 3));
+	cl_git_pass(git_bitmap_set(&bitmap, 40));
+	cl_git_pass(git_ewah_write(&buf, &bitmap, 64));
+
+	/* claim only 10 bits: bit 40 lies past the end */
+	buf.ptr[3] = 10;
+	cl_git_fail(git_ewah_read(&bitmap, &consumed, (unsigned char *)buf.ptr, buf.size, 64));
+
+	buf.ptr[3] = 41;
+	cl_git_pass(git_ewah_read(&bitmap, &consumed, (unsigned char *)buf.ptr, buf.size, 41));
+
+	git_bitmap_free(&bitmap);
+	git_buf_free(&buf);
+}
+
+void test_pack_bitmap__bitmap_operations(void)
+{
+	git_bitmap a = GIT_BITMAP_INIT, b = GIT_BITMAP_INIT;
+	size_t pos = 0;
+
+	cl_git_pass(git_bitmap_set(&a, 3));
+	cl_git_pass(git_bitmap_set(&a, 70));
+	cl_git_pass(git_bitmap_set(&b, 70));
+	cl_git_pass(git_bitmap_set(&b, 200));
+
+	cl_git_pass(git_bitmap_or(&a, &b));
+	cl_assert_equal_i(3, git_bitmap_count(&a));
+
+	git_bitmap_and_not(&a, &b);
+	cl_assert_equal_i(1, git_bitmap_count(&a));
+	cl_assert(git_bitmap_get(&a, 3));
+
+	cl_git_pass(git_bitmap_xor(&a, &b));
+	cl_git_pass(git_bitmap_next(&pos, &a));
+	cl_assert_equal_i(3, pos);
+	pos++;
+	cl_git_pass(git_bitmap_next(&pos, &a));
+	cl_assert_equal_i(70, pos);
+	pos++;
+	cl_git_pass(git_bitmap_next(&pos, &a));
+	cl_assert_equal_i(200, pos);
+	pos++;
+	cl_assert_equal_i(GIT_ITEROVER, git_bitmap_next(&pos, &a));
+
+	git_bitmap_free(&a);
+	git_bitmap_free(&b);
+}
+
+static git_transfer_progress _stats;
+
+static int foreach_cb(void *buf, size_t len, void *payload)
+{
+	return git_indexer_stream_add(payload, buf, len, &_stats);
+}
+
+/* Repack everything the branches reach and write a bitmap for the pack */
+static void repack_with_bitmap(void)
+{
+	git_packbuilder *pb;
+	git_indexer_stream *idx;
+	git_revwalk *walk;
+
+	cl_git_pass(git_packbuilder_new(&pb, _repo));
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+	cl_git_pass(git_packbuilder_insert_walk(pb, walk));
+	git_revwalk_free(walk);
+
+	memset(&_stats, 0, sizeof(_stats));
+	cl_git_pass(git_indexer_stream_new(&idx, "testrepo.git/objects/pack", NULL, NULL));
+	cl_git_pass(git_packbuilder_foreach(pb, foreach_cb, idx));
+	cl_git_pass(git_indexer_stream_finalize(idx, &_stats));
+	git_indexer_stream_free(idx);
+	git_packbuilder_free(pb);
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL);
+	cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+	cl_git_pass(git_pack_bitmap_write(_repo, walk));
+	git_revwalk_free(walk);
+}
+
+/* Everything reachable from `id`, found by walking every commit's tree */
+static void reachable(git_packbuilder *pb, const char *id)
+{
+	git_revwalk *walk;
+	git_commit *commit;
+	git_oid oid;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_oid_fromstr(&oid, id));
+	cl_git_pass(git_revwalk_push(walk, &oid));
+
+	while (git_revwalk_next(&oid, walk) == 0) {
+		cl_git_pass(git_commit_lookup(&commit, _repo, &oid));
+		cl_git_pass(git_packbuilder_insert(pb, &oid, NULL));
+		cl_git_pass(git_packbuilder_insert_tree(pb, git_commit_tree_id(commit)));
+		git_commit_free(commit);
+	}
+
+	git_revwalk_free(walk);
+}
+
+static int has_object(git_packbuilder *pb, const git_oid *id)
+{
+	uint32_t i;
+
+	for (i = 0; i < pb->nr_objects; ++i)
+		if (git_oid_equal(&pb->object_list[i].id, id))
+			return 1;
+
+	return 0;
+}
+
+static void assert_enumeration(const char *want, const char *have, int with_bitmap)
+{
+	git_packbuilder *expected, *wants, *haves, *actual;
+	git_revwalk *walk;
+	git_oid oid;
+	uint32_t i, count = 0;
+
+	cl_git_pass(git_packbuilder_new(&wants, _repo));
+	cl_git_pass(git_packbuilder_new(&haves, _repo));
+	cl_git_pass(git_packbuilder_new(&expected, _repo));
+	reachable(wants, want);
+	if (have)
+		reachable(haves, have);
+
+	for (i = 0; i < wants->nr_objects; ++i) {
+		if (!has_object(haves, &wants->object_list[i].id)) {
+			cl_git_pass(git_packbuilder_insert(expected, &wants->object_list[i].id, NULL));
+			count++;
+		}
+	}
+
+	cl_git_pass(git_packbuilder_new(&actual, _repo));
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_oid_fromstr(&oid, want));
+	cl_git_pass(git_revwalk_push(walk, &oid));
+	if (have) {
+		cl_git_pass(git_oid_fromstr(&oid, have));
+		cl_git_pass(git_revwalk_hide(walk, &oid));
+	}
+	cl_git_pass(git_packbuilder_insert_walk(actual, walk));
+
+	/*
+	 * The bitmaps answer without running the walk, which is reset once
+	 * it has been run; a walk finds more, as it doesn't look in the
+	 * trees of the hidden commits.
+	 */
+	cl_assert_equal_i(with_bitmap, git_revwalk_next(&oid, walk) == 0);
+	if (with_bitmap)
+		cl_assert_equal_i(count, actual->nr_objects);
+	else
+		cl_assert(actual->nr_objects >= count);
+
+	for (i = 0; i < expected->nr_objects; ++i)
+		cl_assert(has_object(actual, &expected->object_list[i].id));
+
+	git_revwalk_free(walk);
+	git_packbuilder_free(actual);
+	git_packbuilder_free(expected);
+	git_packbuilder_free(haves);
+	git_packbuilder_free(wants);
+}
+
+void test_pack_bitmap__enumerates_with_bitmaps(void)
+{
+	git_pack_bitmap_index *index;
+
+	_repo = cl_git_sandbox_init("testrepo.git");
+
+	/* without a bitmap, the trees of every commit are walked */
+	assert_enumeration("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"a4a7dce85cf63874e984719f4fdd239f5145052f", 0);
+
+	repack_with_bitmap();
+
+	cl_git_pass(git_repository__pack_bitmap(&index, _repo));
+	cl_assert(index != NULL);
+	cl_assert(kh_size(index->commits) > 0);
+	git_pack_bitmap_free(index);
+
+	/* branch tips, commits in between and commits with no bitmap */
+	assert_enumeration("a65fedf39aefe402d3bb6e24df4d4f5fe4547750", NULL, 1);
+	assert_enumeration("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"a4a7dce85cf63874e984719f4fdd239f5145052f", 1);
+	assert_enumeration("763d71aadf09a7951596c9746c024e7eece7c7af",
+		"9fd738e8f7967c078dceed8190330fc8648ee56a", 1);
+	assert_enumeration("e90810b8df3e80c413d903f631643c716887138d",
+		"5b5b025afb0b4c913b4c338a42934a3863bf3644", 1);
+	assert_enumeration("4a202b346bb0fb0db7eff3cffeb3c70babbd2045",
+		"41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9", 1);
+}
+
+/* Flip a bit of the byte at `offset` of the repository's .bitmap */
+static void corrupt_bitmap(git_off_t offset)
+{
+	git_vector files = GIT_VECTOR_INIT;
+	char *name, byte;
+	size_t i;
+	int fd;
+
+	cl_git_pass(git_path_dirload("testrepo.git/objects/pack", 0, 0, &files));
+
+	git_vector_foreach(&files, i, name) {
+		if (git__suffixcmp(name, GIT_PACK_BITMAP_EXT) == 0) {
+			cl_assert((fd = p_open(name, O_RDWR)) >= 0);
+			cl_assert(p_lseek(fd, offset, SEEK_SET) == offset);
+			cl_assert(p_read(fd, &byte, 1) == 1);
+			byte ^= 0x40;
+			cl_assert(p_lseek(fd, offset, SEEK_SET) == offset);
+			cl_git_pass(p_write(fd, &byte, 1));
+			p_close(fd);
+		}
+		git__free(name);
+	}
+	git_vector_free(&files);
+
+	git_repository__pack_bitmap_changed(_repo);
+}
+
+void test_pack_bitmap__corrupt_bitmaps_are_ignored(void)
+{
+	git_pack_bitmap_index *index;
+
+	_repo = cl_git_sandbox_init("testrepo.git");
+	repack_with_bitmap();
+
+	/* as if it were left over from before a repack */
+	corrupt_bitmap(12);
+	cl_git_pass(git_repository__pack_bitmap(&index, _repo));
+	cl_assert(index == NULL);
+
+	assert_enumeration("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"a4a7dce85cf63874e984719f4fdd239f5145052f", 0);
+}
+
+void test_pack_bitmap__bitmaps_larger_than_the_pack_are_refused(void)
+{
+	git_pack_bitmap_index *index;
+
+	_repo = cl_git_sandbox_init("testrepo.git");
+	repack_with_bitmap();
+
+	/* the bit count of the commits' bitmap, just after the header */
+	corrupt_bitmap(32 + 2);
+
+	cl_git_pass(git_repository__pack_bitmap(&index, _repo));
+	cl_assert(index == NULL);
+}
@@ -103,3 +103,43 @@ void test_pack_packbuilder__foreach(void)
 	cl_git_pass(git_indexer_stream_finalize(idx, &stats));
 	git_indexer_stream_free(idx);
 }
+
+/*
+ * Versions of a blob that each rewrite one of its lines, so every one
+ * is closest to the one before it and the builder makes long chains of
+ * deltas; the indexer has to walk them down to their roots when there's
+ * no delta base cache to stop at.
+ */
+void test_pack_packbuilder__indexes_long_delta_chains_without_a_base_cache(void)
+{
+	git_indexer_stream *idx;
+	char content[64][32];
+	unsigned int seed = 1;
+	size_t old_limit;
+	git_oid id;
+	int i, j;
+
+	git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, &old_limit);
+
+	for (i = 0; i < 100; i++) {
+		for (j = 0; j < 64; j++) {
+			if (i > 0 && j != i % 64)
+				continue;
+			seed = seed * 1103515245 + 12345;
+			p_snprintf(content[j], sizeof(content[j]), "%030u\n", seed);
+		}
+
+		cl_git_pass(git_blob_create_frombuffer(&id, _repo, content, sizeof(content)));
+		cl_git_pass(git_packbuilder_insert(_packbuilder, &id, NULL));
+	}
+
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, (size_t)0);
+
+	cl_git_pass(git_indexer_stream_new(&idx, ".", NULL, NULL));
+	cl_git_pass(git_packbuilder_foreach(_packbuilder, foreach_cb, idx));
+	cl_git_pass(git_indexer_stream_finalize(idx, &stats));
+	cl_assert_equal_i(100, stats.indexed_objects);
+	git_indexer_stream_free(idx);
+
+	git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, old_limit);
+}
@@ -1,5 +1,6 @@
 #include "clar_libgit2.h"
 #include "refs.h"
+#include "repository.h"
 
 static git_repository *g_repo;
 
@@ -40,3 +41,36 @@ void test_refs_lookup__oid(void)
 	cl_git_pass(git_oid_fromstr(&expected, "1385f264afb75a56a5bec74243be9b367ba4ca08"));
 	cl_assert(git_oid_cmp(&tag, &expected) == 0);
 }
+
+void test_refs_lookup__many_oids(void)
+{
+	const char *names[] = {
+		"HEAD", "refs/heads/packed", "refs/tags/point_to_blob",
+		"refs/heads/missing", "refs/heads/invalid..name"
+	};
+	git_oid out[5], expected;
+	int errors[5];
+
+	cl_git_pass(git_reference_name_to_id_many(out, errors, g_repo, names, 5));
+
+	cl_assert_equal_i(0, errors[0]);
+	cl_git_pass(git_oid_fromstr(&expected, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	cl_assert(git_oid_cmp(&out[0], &expected) == 0);
+
+	cl_assert_equal_i(0, errors[1]);
+	cl_git_pass(git_oid_fromstr(&expected, "41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9"));
+	cl_assert(git_oid_cmp(&out[1], &expected) == 0);
+
+	cl_assert_equal_i(0, errors[2]);
+	cl_git_pass(git_oid_fromstr(&expected, "1385f264afb75a56a5bec74243be9b367ba4ca08"));
+	cl_assert(git_oid_cmp(&out[2], &expected) == 0);
+
+	cl_assert_equal_i(GIT_ENOTFOUND, errors[3]);
+	cl_assert(git_oid_iszero(&out[3]));
+
+	cl_assert_equal_i(GIT_EINVALIDSPEC, errors[4]);
+	cl_assert(git_oid_iszero(&out[4]));
+
+	/* the pin doesn't outlive the batch */
+	cl_assert(!g_repo->references.packfile_pinned);
+}
@@ -0,0 +1,410 @@
+#include "clar_libgit2.h"
+#include "commit_graph.h"
+#include "revwalk.h"
+#include "fileops.h"
+
+#define GRAPH_PATH "twowaymerge.git/objects/info/commit-graph"
+
+#define FIRST_BRANCH "2224e191514cb4bd8c566d80dac22dfcb1e9bb83"
+#define MASTER "1c30b88f5f3ee66d78df6520a7de9e89b890818b"
+#define SECOND_BRANCH "9b219343610c88a1187c996d0dc58330b55cee28"
+#define ROOT "1f4c0311a24b63f6fc209a59a1e404942d4a5006"
+#define N_COMMIT "c37a783c20d92ac92362a78a32860f7eebf938ef"
+
+static git_repository *_repo;
+
+void test_revwalk_commitgraph__initialize(void)
+{
+	cl_fixture_sandbox("twowaymerge.git");
+	cl_git_pass(git_repository_open(&_repo, "twowaymerge.git"));
+}
+
+void test_revwalk_commitgraph__cleanup(void)
+{
+	git_repository_free(_repo);
+	_repo = NULL;
+
+	cl_fixture_cleanup("twowaymerge.git");
+}
+
+static void write_graph(const char *tip)
+{
+	git_commit_graph_writer *w;
+	git_revwalk *walk;
+	git_oid id;
+
+	cl_git_pass(git_commit_graph_writer_new(&w, _repo));
+
+	if (tip) {
+		cl_git_pass(git_oid_fromstr(&id, tip));
+		cl_git_pass(git_commit_graph_writer_add(w, &id));
+	} else {
+		cl_git_pass(git_revwalk_new(&walk, _repo));
+		cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+		cl_git_pass(git_commit_graph_writer_add_revwalk(w, walk));
+		git_revwalk_free(walk);
+	}
+
+	cl_git_pass(git_commit_graph_writer_commit(w));
+	git_commit_graph_writer_free(w);
+}
+
+/* every branch, walked with each sorting, as one string */
+static void walk_branches(git_buf *out)
+{
+	static const unsigned int sortings[] = {
+		GIT_SORT_NONE, GIT_SORT_TIME, GIT_SORT_TOPOLOGICAL,
+		GIT_SORT_TIME | GIT_SORT_TOPOLOGICAL, GIT_SORT_TIME | GIT_SORT_REVERSE
+	};
+	git_revwalk *walk;
+	git_oid id;
+	size_t i;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+
+	for (i = 0; i < ARRAY_SIZE(sortings); ++i) {
+		git_revwalk_sorting(walk, sortings[i]);
+		cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+
+		while (git_revwalk_next(&id, walk) == 0) {
+			char hex[GIT_OID_HEXSZ + 1];
+			git_oid_tostr(hex, sizeof(hex), &id);
+			git_buf_printf(out, "%s\n", hex);
+		}
+		git_buf_puts(out, "--\n");
+	}
+
+	git_revwalk_free(walk);
+	cl_assert(!git_buf_oom(out));
+}
+
+static void merge_bases(git_buf *out)
+{
+	static const char *tips[] = { FIRST_BRANCH, MASTER, SECOND_BRANCH, N_COMMIT };
+	size_t i, j, ahead, behind;
+	git_oid one, two, base;
+
+	for (i = 0; i < ARRAY_SIZE(tips); ++i) {
+		for (j = 0; j < ARRAY_SIZE(tips); ++j) {
+			char hex[GIT_OID_HEXSZ + 1];
+
+			cl_git_pass(git_oid_fromstr(&one, tips[i]));
+			cl_git_pass(git_oid_fromstr(&two, tips[j]));
+
+			cl_git_pass(git_merge_base(&base, _repo, &one, &two));
+			cl_git_pass(git_graph_ahead_behind(&ahead, &behind, _repo, &one, &two));
+
+			git_oid_tostr(hex, sizeof(hex), &base);
+			git_buf_printf(out, "%s %d %d\n", hex, (int)ahead, (int)behind);
+		}
+	}
+
+	cl_assert(!git_buf_oom(out));
+}
+
+void test_revwalk_commitgraph__writes_what_git_writes(void)
+{
+	git_commit_graph_file *file;
+	char checksum[GIT_OID_HEXSZ + 1];
+
+	write_graph(NULL);
+
+	cl_git_pass(git_commit_graph_open(&file, GRAPH_PATH));
+	cl_assert_equal_i(16, file->num_commits);
+
+	/* the trailer of `git commit-graph write` for the same commits */
+	git_oid_tostr(checksum, sizeof(checksum), &file->checksum);
+	cl_assert_equal_s("9d6170a84dc3b63fcb3eeda962f8e6c04a151c0f", checksum);
+
+	git_commit_graph_free(file);
+}
+
+void test_revwalk_commitgraph__entries_describe_the_commits(void)
+{
+	git_commit_graph_file *file;
+	git_commit_graph_entry e;
+	git_commit *commit;
+	uint32_t pos, parent;
+	git_oid id;
+	unsigned int i;
+
+	write_graph(NULL);
+	cl_git_pass(git_commit_graph_open(&file, GRAPH_PATH));
+
+	cl_git_pass(git_oid_fromstr(&id, ROOT));
+	cl_git_pass(git_commit_graph_find(&pos, file, &id));
+	cl_git_pass(git_commit_graph_entry_get(&e, file, pos));
+	cl_assert_equal_i(0, e.parent_count);
+	cl_assert_equal_i(1, e.generation);
+
+	cl_git_pass(git_oid_fromstr(&id, SECOND_BRANCH));
+	cl_git_pass(git_commit_graph_find(&pos, file, &id));
+	cl_git_pass(git_commit_graph_entry_get(&e, file, pos));
+	cl_assert_equal_i(8, e.generation);
+
+	cl_git_pass(git_commit_lookup(&commit, _repo, &id));
+	cl_assert(git_oid_cmp(git_commit_tree_id(commit), &e.tree_oid) == 0);
+	cl_assert(git_commit_time(commit) == e.commit_time);
+	cl_assert_equal_i(git_commit_parentcount(commit), e.parent_count);
+
+	for (i = 0; i < e.parent_count; ++i) {
+		cl_git_pass(git_commit_graph_entry_parent(&parent, file, &e, i));
+		cl_assert(git_oid_cmp(git_commit_parent_id(commit, i), &file->oid_lookup[parent]) == 0);
+	}
+	cl_git_fail(git_commit_graph_entry_parent(&parent, file, &e, e.parent_count));
+
+	git_commit_free(commit);
+
+	cl_git_pass(git_oid_fromstr(&id, "1c30b88f5f3ee66d78df6520a7de9e89b890818c"));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_commit_graph_find(&pos, file, &id));
+
+	git_commit_graph_free(file);
+}
+
+void test_revwalk_commitgraph__walks_agree_with_the_odb(void)
+{
+	git_buf before = GIT_BUF_INIT, after = GIT_BUF_INIT;
+
+	walk_branches(&before);
+	merge_bases(&before);
+
+	write_graph(NULL);
+
+	walk_branches(&after);
+	merge_bases(&after);
+
+	cl_assert_equal_s(before.ptr, after.ptr);
+
+	git_buf_free(&before);
+	git_buf_free(&after);
+}
+
+void test_revwalk_commitgraph__a_partial_graph_is_completed_from_the_odb(void)
+{
+	git_buf before = GIT_BUF_INIT, after = GIT_BUF_INIT;
+	git_commit_graph_file *file;
+
+	walk_branches(&before);
+	merge_bases(&before);
+
+	write_graph(FIRST_BRANCH);
+
+	cl_git_pass(git_commit_graph_open(&file, GRAPH_PATH));
+	cl_assert(file->num_commits > 0 && file->num_commits < 16);
+	git_commit_graph_free(file);
+
+	walk_branches(&after);
+	merge_bases(&after);
+
+	cl_assert_equal_s(before.ptr, after.ptr);
+
+	git_buf_free(&before);
+	git_buf_free(&after);
+}
+
+void test_revwalk_commitgraph__octopus_merges_use_the_edge_list(void)
+{
+	static const char *tips[] = { N_COMMIT, FIRST_BRANCH, MASTER };
+	const git_commit *parents[3];
+	git_buf before = GIT_BUF_INIT, after = GIT_BUF_INIT;
+	git_commit_graph_file *file;
+	git_commit_graph_entry e;
+	git_signature *sig;
+	git_tree *tree;
+	git_oid id;
+	uint32_t pos, parent;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(tips); ++i) {
+		cl_git_pass(git_oid_fromstr(&id, tips[i]));
+		cl_git_pass(git_commit_lookup((git_commit **)&parents[i], _repo, &id));
+	}
+
+	cl_git_pass(git_commit_tree(&tree, (git_commit *)parents[0]));
+	cl_git_pass(git_signature_new(&sig, "Octo Cat", "octo@example.com", 1354100000, 0));
+	cl_git_pass(git_commit_create(&id, _repo, "refs/heads/octopus",
+		sig, sig, NULL, "octopus\n", tree, 3, parents));
+
+	walk_branches(&before);
+	write_graph(NULL);
+	walk_branches(&after);
+	cl_assert_equal_s(before.ptr, after.ptr);
+
+	cl_git_pass(git_commit_graph_open(&file, GRAPH_PATH));
+	cl_assert_equal_i(1, file->num_extra_edge_list > 0);
+	cl_git_pass(git_commit_graph_find(&pos, file, &id));
+	cl_git_pass(git_commit_graph_entry_get(&e, file, pos));
+	cl_assert_equal_i(3, e.parent_count);
+
+	for (i = 0; i < ARRAY_SIZE(tips); ++i) {
+		cl_git_pass(git_commit_graph_entry_parent(&parent, file, &e, i));
+		cl_assert(git_oid_cmp(git_commit_id(parents[i]), &file->oid_lookup[parent]) == 0);
+		git_commit_free((git_commit *)parents[i]);
+	}
+
+	git_commit_graph_free(file);
+	git_signature_free(sig);
+	git_tree_free(tree);
+	git_buf_free(&before);
+	git_buf_free(&after);
+}
+
+void test_revwalk_commitgraph__a_corrupt_graph_is_ignored(void)
+{
+	git_buf before = GIT_BUF_INIT, after = GIT_BUF_INIT;
+
+	walk_branches(&before);
+
+	cl_must_pass(git_futils_mkpath2file(GRAPH_PATH, 0777));
+	cl_git_mkfile(GRAPH_PATH, "CGPH but not really");
+
+	walk_branches(&after);
+	cl_assert_equal_s(before.ptr, after.ptr);
+
+	git_buf_free(&before);
+	git_buf_free(&after);
+}
+
+static uint32_t generation_of(const char *sha)
+{
+	git_revwalk *walk;
+	git_commit_idx commit;
+	git_oid id;
+	uint32_t generation;
+
+	cl_git_pass(git_oid_fromstr(&id, sha));
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk__commit_lookup(&commit, walk, &id));
+	cl_git_pass(git_commit_list_generation(walk, commit));
+	generation = walk->commits.generations[commit];
+	git_revwalk_free(walk);
+
+	return generation;
+}
+
+void test_revwalk_commitgraph__generations_outside_the_graph_are_computed(void)
+{
+	static const char *tips[] = { FIRST_BRANCH, MASTER, SECOND_BRANCH, N_COMMIT, ROOT };
+	uint32_t expected[ARRAY_SIZE(tips)];
+	size_t i;
+
+	cl_assert_equal_i(GIT_COMMIT_LIST_GENERATION_INFINITY, generation_of(MASTER));
+
+	write_graph(NULL);
+	for (i = 0; i < ARRAY_SIZE(tips); ++i)
+		expected[i] = generation_of(tips[i]);
+
+	cl_assert_equal_i(1, expected[4]);
+	cl_assert_equal_i(8, expected[2]);
+
+	write_graph(FIRST_BRANCH);
+	for (i = 0; i < ARRAY_SIZE(tips); ++i)
+		cl_assert_equal_i(expected[i], generation_of(tips[i]));
+}
+
+static void commit_at(git_oid *out, git_time_t time,
+	const git_oid *parent1, const git_oid *parent2)
+{
+	const git_commit *parents[2];
+	git_signature *sig;
+	git_commit *root;
+	git_tree *tree;
+	git_oid id;
+	int n = 0;
+
+	cl_git_pass(git_oid_fromstr(&id, ROOT));
+	cl_git_pass(git_commit_lookup(&root, _repo, &id));
+	cl_git_pass(git_commit_tree(&tree, root));
+
+	if (parent1)
+		cl_git_pass(git_commit_lookup((git_commit **)&parents[n++], _repo, parent1));
+	if (parent2)
+		cl_git_pass(git_commit_lookup((git_commit **)&parents[n++], _repo, parent2));
+
+	cl_git_pass(git_signature_new(&sig, "Skewed Clock", "skew@example.com", time, 0));
+	cl_git_pass(git_commit_create(out, _repo, NULL, sig, sig, NULL, "skewed\n", tree, n, parents));
+
+	while (n > 0)
+		git_commit_free((git_commit *)parents[--n]);
+	git_signature_free(sig);
+	git_tree_free(tree);
+	git_commit_free(root);
+}
+
+/*
+ *   a --- b --- x --- y      x was made on a machine whose clock was
+ *    \     \                 off by decades, so by date it looks
+ *     w --- m                older than everything else
+ */
+void test_revwalk_commitgraph__generations_beat_skewed_clocks(void)
+{
+	git_oid a, b, x, y, w, m, base, id;
+	git_reference *ref;
+	git_revwalk *walk;
+	size_t ahead, behind, i;
+	git_oid *walked[] = { &y, &x };
+
+	commit_at(&a, 1354000000, NULL, NULL);
+	commit_at(&b, 1354001000, &a, NULL);
+	commit_at(&x, 100000000, &b, NULL);
+	commit_at(&y, 1354003000, &x, NULL);
+	commit_at(&w, 1354002000, &a, NULL);
+	commit_at(&m, 1354002500, &b, &w);
+
+	cl_git_pass(git_reference_create(&ref, _repo, "refs/heads/skewed-one", &y, 0));
+	git_reference_free(ref);
+	cl_git_pass(git_reference_create(&ref, _repo, "refs/heads/skewed-two", &m, 0));
+	git_reference_free(ref);
+
+	write_graph(NULL);
+
+	cl_git_pass(git_merge_base(&base, _repo, &y, &m));
+	cl_assert(git_oid_cmp(&base, &b) == 0);
+
+	cl_git_pass(git_graph_ahead_behind(&ahead, &behind, _repo, &y, &m));
+	cl_assert_equal_i(2, ahead);
+	cl_assert_equal_i(2, behind);
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	git_revwalk_sorting(walk, GIT_SORT_TIME);
+	cl_git_pass(git_revwalk_push(walk, &y));
+	cl_git_pass(git_revwalk_hide(walk, &m));
+
+	for (i = 0; i < ARRAY_SIZE(walked); ++i) {
+		cl_git_pass(git_revwalk_next(&id, walk));
+		cl_assert(git_oid_cmp(&id, walked[i]) == 0);
+	}
+	cl_assert_equal_i(GIT_ITEROVER, git_revwalk_next(&id, walk));
+
+	git_revwalk_free(walk);
+}
+
+/* how many commits a topological walk of `tip` has come across when it gives the first */
+static size_t commits_read_for_first(const char *tip)
+{
+	git_revwalk *walk;
+	git_oid id, first;
+	size_t read;
+
+	cl_git_pass(git_oid_fromstr(&first, tip));
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL);
+	cl_git_pass(git_revwalk_push(walk, &first));
+
+	cl_git_pass(git_revwalk_next(&id, walk));
+	cl_assert(git_oid_cmp(&id, &first) == 0);
+	read = walk->commits.length;
+
+	git_revwalk_free(walk);
+	return read;
+}
+
+void test_revwalk_commitgraph__topological_walks_only_read_what_they_show(void)
+{
+	/* without generations, all of its history has to be read first */
+	cl_assert_equal_i(8, commits_read_for_first(MASTER));
+
+	/* with them only it and d are explored; queueing the merge reads its parents */
+	write_graph(NULL);
+	cl_assert_equal_i(5, commits_read_for_first(MASTER));
+}
@@ -0,0 +1,78 @@
+#include "clar_libgit2.h"
+#include "commit_list.h"
+
+static git_commit_table table;
+
+void test_revwalk_committable__initialize(void)
+{
+	cl_git_pass(git_commit_table_init(&table));
+}
+
+void test_revwalk_committable__cleanup(void)
+{
+	git_commit_table_free(&table);
+}
+
+static void make_oid(git_oid *out, size_t n)
+{
+	memset(out, 0, sizeof(*out));
+	/* the same first bytes for all of them, so they all collide */
+	out->id[GIT_OID_RAWSZ - 1] = (unsigned char)n;
+	out->id[GIT_OID_RAWSZ - 2] = (unsigned char)(n >> 8);
+}
+
+void test_revwalk_committable__lookup_finds_what_was_added(void)
+{
+	git_commit_idx idx;
+	git_oid id;
+	size_t i;
+
+	for (i = 0; i < 1000; ++i) {
+		make_oid(&id, i);
+		cl_git_pass(git_commit_table_lookup(&idx, &table, &id));
+		cl_assert_equal_i(i, idx);
+	}
+
+	cl_assert_equal_i(1000, table.length);
+
+	/* after the table has grown a few times */
+	for (i = 0; i < 1000; ++i) {
+		make_oid(&id, i);
+		cl_git_pass(git_commit_table_lookup(&idx, &table, &id));
+		cl_assert_equal_i(i, idx);
+		cl_assert(git_oid_equal(&table.oids[idx], &id));
+	}
+
+	cl_assert_equal_i(1000, table.length);
+}
+
+void test_revwalk_committable__queue_pops_newest_first(void)
+{
+	static const int64_t times[] = { 5, 3, 9, 1, 9, 7, 2 };
+	git_commit_queue queue;
+	git_commit_idx idx;
+	int64_t last = INT64_MAX;
+	git_oid id;
+	size_t i;
+
+	cl_git_pass(git_commit_queue_init(&queue, &table, git_commit_list_time_cmp));
+
+	for (i = 0; i < ARRAY_SIZE(times); ++i) {
+		make_oid(&id, i);
+		cl_git_pass(git_commit_table_lookup(&idx, &table, &id));
+		table.times[idx] = times[i];
+		cl_git_pass(git_commit_queue_insert(&queue, idx));
+	}
+
+	cl_assert_equal_i(ARRAY_SIZE(times), git_commit_queue_length(&queue));
+
+	while ((idx = git_commit_queue_pop(&queue)) != GIT_COMMIT_IDX_NONE) {
+		cl_assert(table.times[idx] <= last);
+		last = table.times[idx];
+	}
+
+	cl_assert_equal_i(1, last);
+	cl_assert_equal_i(0, git_commit_queue_length(&queue));
+
+	git_commit_queue_free(&queue);
+}
@@ -0,0 +1,123 @@
+#include "clar_libgit2.h"
+#include <stdarg.h>
+
+static git_repository *_repo;
+static git_revwalk *_walk;
+
+void test_revwalk_paths__initialize(void)
+{
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+	cl_git_pass(git_revwalk_new(&_walk, _repo));
+}
+
+void test_revwalk_paths__cleanup(void)
+{
+	git_revwalk_free(_walk);
+	_walk = NULL;
+	git_repository_free(_repo);
+	_repo = NULL;
+}
+
+static void set_paths(const char *path, ...)
+{
+	char *strings[8];
+	git_strarray paths;
+	va_list ap;
+
+	paths.strings = strings;
+	paths.count = 0;
+
+	va_start(ap, path);
+	for (; path && paths.count < ARRAY_SIZE(strings); path = va_arg(ap, const char *))
+		strings[paths.count++] = (char *)path;
+	va_end(ap);
+
+	cl_git_pass(git_revwalk_set_paths(_walk, &paths));
+}
+
+/* the expected commits, as `git log --format=%H <ref> -- <paths>` gives them */
+static void assert_walk(const char *ref, const char **expected, size_t count)
+{
+	git_oid id;
+	size_t i = 0;
+	int error;
+
+	cl_git_pass(git_revwalk_push_ref(_walk, ref));
+
+	while ((error = git_revwalk_next(&id, _walk)) == 0) {
+		cl_assert(i < count);
+		cl_assert(git_oid_streq(&id, expected[i++]) == 0);
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert_equal_i(count, i);
+}
+
+void test_revwalk_paths__follows_the_parent_a_merge_took_the_path_from(void)
+{
+	static const char *expected[] = {
+		"4a202b346bb0fb0db7eff3cffeb3c70babbd2045",
+		"8496071c1b46c854b31185ea97743be6a8774479",
+	};
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+	set_paths("README", NULL);
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_paths__any_of_several_paths(void)
+{
+	static const char *expected[] = {
+		"9fd738e8f7967c078dceed8190330fc8648ee56a",
+		"4a202b346bb0fb0db7eff3cffeb3c70babbd2045",
+		"5b5b025afb0b4c913b4c338a42934a3863bf3644",
+		"8496071c1b46c854b31185ea97743be6a8774479",
+	};
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+	set_paths("README", "new.txt", NULL);
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_paths__can_be_reversed(void)
+{
+	static const char *expected[] = {
+		"c47800c7266a2be04c571c04d5a6614691ea99bd",
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+	};
+
+	git_revwalk_sorting(_walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+	set_paths("branch_file.txt", NULL);
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_paths__directories_in_subtrees(void)
+{
+	static const char *expected[] = {
+		"763d71aadf09a7951596c9746c024e7eece7c7af",
+	};
+
+	set_paths("ab/de/", NULL);
+	assert_walk("refs/heads/subtrees", expected, ARRAY_SIZE(expected));
+
+	set_paths("ab/de/fgh/1.txt", NULL);
+	assert_walk("refs/heads/subtrees", expected, ARRAY_SIZE(expected));
+
+	set_paths("ab/nope", "ab/de/fgh/1.txt/nope", NULL);
+	assert_walk("refs/heads/subtrees", NULL, 0);
+}
+
+void test_revwalk_paths__empty_list_walks_everything(void)
+{
+	git_oid id;
+	int count = 0;
+
+	set_paths("README", NULL);
+	set_paths(NULL);
+
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	while (git_revwalk_next(&id, _walk) == 0)
+		count++;
+
+	cl_assert_equal_i(7, count);
+}
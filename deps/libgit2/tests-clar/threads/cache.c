@@ -0,0 +1,194 @@
+#include "clar_libgit2.h"
+
+#include "cache.h"
+#include "posix.h"
+
+#ifndef GIT_WIN32
+#include <sys/time.h>
+#endif
+
+/*
+ * Hammer a small cache from several threads at once: readers go through
+ * the lock-free path while a constant stream of misses forces stores and
+ * evictions. Objects are poisoned when freed, so a reader that gets hold
+ * of an evicted and released object trips an assertion.
+ *
+ * Set GITTEST_CACHE_SCALING to print read throughput per thread count.
+ */
+
+#define OBJ_LIVE 0x0b1ec7ed
+#define OBJ_DEAD 0xdeadbeef
+#define NUM_IDS 512
+#define OPS_PER_THREAD 200000
+#define MAX_THREADS 8
+
+typedef struct {
+	git_cached_obj cached;
+	volatile unsigned int magic;
+} test_obj;
+
+static git_cache g_cache;
+static git_atomic g_allocs, g_frees, g_bad;
+static size_t g_old_budget;
+
+static void free_obj(void *_obj)
+{
+	test_obj *obj = _obj;
+
+	if (obj->magic != OBJ_LIVE)
+		git_atomic_inc(&g_bad);
+
+	obj->magic = OBJ_DEAD;
+	git_atomic_inc(&g_frees);
+	git__free(obj);
+}
+
+#ifdef GIT_THREADS
+
+static void make_id(git_oid *oid, unsigned int n)
+{
+	memset(oid, 0x0, sizeof(git_oid));
+	memcpy(oid->id, &n, sizeof(n));
+	oid->id[19] = (unsigned char)n;
+}
+
+static void touch(unsigned int n)
+{
+	git_oid oid;
+	test_obj *obj;
+
+	make_id(&oid, n);
+
+	if ((obj = git_cache_get(&g_cache, &oid)) == NULL) {
+		obj = git__calloc(1, sizeof(test_obj));
+		git_oid_cpy(&obj->cached.oid, &oid);
+		obj->cached.type = GIT_OBJ_COMMIT;
+		obj->cached.size = 64;
+		obj->magic = OBJ_LIVE;
+		git_atomic_inc(&g_allocs);
+
+		obj = git_cache_try_store(&g_cache, obj);
+	}
+
+	if (obj->magic != OBJ_LIVE || git_oid_cmp(&obj->cached.oid, &oid) != 0)
+		git_atomic_inc(&g_bad);
+
+	git_cached_obj_decref(obj, free_obj);
+}
+
+static void *churn(void *arg)
+{
+	unsigned int seed = (unsigned int)(size_t)arg, i;
+
+	for (i = 0; i < OPS_PER_THREAD; ++i) {
+		seed = seed * 1103515245 + 12345;
+		touch((seed >> 8) % NUM_IDS);
+	}
+
+	return NULL;
+}
+
+static void *read_hot(void *arg)
+{
+	unsigned int i;
+	GIT_UNUSED(arg);
+
+	for (i = 0; i < OPS_PER_THREAD; ++i)
+		touch(i % 64);
+
+	return NULL;
+}
+
+static double run_threads(void *(*fn)(void *), size_t nthreads)
+{
+	git_thread threads[MAX_THREADS];
+	struct timeval start, end;
+	size_t i;
+
+	p_gettimeofday(&start, NULL);
+
+	for (i = 0; i < nthreads; ++i)
+		cl_assert(git_thread_create(&threads[i], NULL, fn, (void *)(i + 1)) == 0);
+	for (i = 0; i < nthreads; ++i)
+		git_thread_join(threads[i], NULL);
+
+	p_gettimeofday(&end, NULL);
+
+	return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+#endif
+
+void test_threads_cache__initialize(void)
+{
+	git_atomic_set(&g_allocs, 0);
+	git_atomic_set(&g_frees, 0);
+	git_atomic_set(&g_bad, 0);
+
+	g_old_budget = git_cache__budget[GIT_OBJ_COMMIT];
+
+	/* 16 sets of 8: far fewer slots than ids, so most stores evict */
+	cl_git_pass(git_cache_init(&g_cache, GIT_CACHE_SHARDS * GIT_CACHE_WAYS, free_obj));
+}
+
+void test_threads_cache__cleanup(void)
+{
+	git_cache_free(&g_cache);
+	git_cache__budget[GIT_OBJ_COMMIT] = g_old_budget;
+}
+
+void test_threads_cache__concurrent_reads_and_evictions(void)
+{
+#ifdef GIT_THREADS
+	git_cache_stats stats;
+
+	/* four objects to a shard: evicted ones that readers may still be
+	 * looking at are parked, but never make more than twice that */
+	git_cache__budget[GIT_OBJ_COMMIT] = GIT_CACHE_SHARDS * 4 * 64;
+
+	run_threads(churn, MAX_THREADS);
+
+	git_cache_read_stats(&stats, &g_cache);
+	cl_assert(stats.evictions > 0);
+	cl_assert(stats.bytes <= 2 * git_cache__budget[GIT_OBJ_COMMIT]);
+	cl_assert_equal_i(MAX_THREADS * OPS_PER_THREAD, stats.hits + stats.misses);
+
+	git_cache_free(&g_cache);
+	cl_git_pass(git_cache_init(&g_cache, 0, free_obj));
+
+	cl_assert_equal_i(0, g_bad.val);
+	cl_assert_equal_i(g_allocs.val, g_frees.val);
+#endif
+}
+
+void test_threads_cache__read_scaling(void)
+{
+#ifdef GIT_THREADS
+	git_cache_stats before, after;
+	size_t n;
+	char *verbose = cl_getenv("GITTEST_CACHE_SCALING");
+
+	/* warm the cache, so every lookup below is a hit */
+	read_hot(NULL);
+
+	for (n = 1; n <= MAX_THREADS; n *= 2) {
+		double secs;
+
+		git_cache_read_stats(&before, &g_cache);
+		secs = run_threads(read_hot, n);
+		git_cache_read_stats(&after, &g_cache);
+
+		/* every lookup is counted, on whichever stripe, and nothing
+		 * was evicted by the readers alone */
+		cl_assert_equal_i(n * OPS_PER_THREAD, after.hits - before.hits);
+		cl_assert_equal_i(before.misses, after.misses);
+		cl_assert_equal_i(before.evictions, after.evictions);
+
+		if (verbose)
+			fprintf(stderr, "cache reads, %d thread(s): %.0f lookups/s\n",
+				(int)n, (n * OPS_PER_THREAD) / secs);
+	}
+
+	cl_assert_equal_i(0, g_bad.val);
+#endif
+}
@@ -0,0 +1,89 @@
+#include "clar_libgit2.h"
+
+#include "odb.h"
+
+/*
+ * Read every object of a pack from several threads, each with its own
+ * odb, with windows so small and a mapped limit so low that nearly every
+ * read maps a new window and closes one of another thread's.
+ */
+
+#define NUM_THREADS 4
+#define ROUNDS 20
+
+static size_t g_old_window_size, g_old_mapped_limit;
+static git_atomic g_bad;
+
+void test_threads_pack__initialize(void)
+{
+	git_libgit2_opts(GIT_OPT_GET_MWINDOW_SIZE, &g_old_window_size);
+	git_libgit2_opts(GIT_OPT_GET_MWINDOW_MAPPED_LIMIT, &g_old_mapped_limit);
+
+	git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, (size_t)8192);
+	git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, (size_t)32768);
+
+	git_atomic_set(&g_bad, 0);
+}
+
+void test_threads_pack__cleanup(void)
+{
+	git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, g_old_window_size);
+	git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, g_old_mapped_limit);
+}
+
+static int verify_cb(const git_oid *oid, void *data)
+{
+	git_odb *odb = data;
+	git_odb_object *obj;
+	git_oid actual;
+
+	if (git_odb_read(&obj, odb, oid) < 0) {
+		git_atomic_inc(&g_bad);
+		return 0;
+	}
+
+	if (git_odb_hash(&actual, git_odb_object_data(obj),
+			git_odb_object_size(obj), git_odb_object_type(obj)) < 0 ||
+		git_oid_cmp(oid, &actual) != 0)
+		git_atomic_inc(&g_bad);
+
+	git_odb_object_free(obj);
+	return 0;
+}
+
+static void *read_all(void *path)
+{
+	int i;
+
+	for (i = 0; i < ROUNDS; ++i) {
+		git_odb *odb;
+
+		if (git_odb_open(&odb, path) < 0) {
+			git_atomic_inc(&g_bad);
+			continue;
+		}
+
+		if (git_odb_foreach(odb, verify_cb, odb) < 0)
+			git_atomic_inc(&g_bad);
+
+		git_odb_free(odb);
+	}
+
+	return NULL;
+}
+
+void test_threads_pack__concurrent_reads_share_the_mapped_limit(void)
+{
+#ifdef GIT_THREADS
+	git_thread threads[NUM_THREADS];
+	const char *path = cl_fixture("testrepo.git/objects");
+	size_t i;
+
+	for (i = 0; i < NUM_THREADS; ++i)
+		cl_assert(git_thread_create(&threads[i], NULL, read_all, (void *)path) == 0);
+	for (i = 0; i < NUM_THREADS; ++i)
+		git_thread_join(threads[i], NULL);
+
+	cl_assert_equal_i(0, g_bad.val);
+#endif
+}
@@ -9,5 +9,82 @@ try {
 }
 module.exports = mod;
 
+var stream = require('stream');
+var util = require('util');
+
+// A Readable over an object in the database. Each _read asks the
+// native side for one chunk, and the next one isn't asked for until
+// it's consumed, so only about a highWaterMark of it is in memory.
+function OdbReadStream(repo, oid, options) {
+  stream.Readable.call(this, options);
+  this.repo = repo;
+  this.oid = oid;
+  this.handle = null;
+  this.size = null;
+  this.type = null;
+  this.chunkSize = (options && options.chunkSize) || 0;
+}
+util.inherits(OdbReadStream, stream.Readable);
+
+OdbReadStream.prototype._read = function (n) {
+  var self = this;
+  if (!this.handle) {
+    mod.Odb.openReadStream(this.repo, this.oid, function (err, handle) {
+      if (err) return self.emit('error', err);
+      self.handle = handle;
+      self.size = handle.size;
+      self.type = handle.type;
+      self.emit('open', handle.size, handle.type);
+      self._read(n);
+    });
+    return;
+  }
+  this.handle.read(this.chunkSize || n, function (err, chunk) {
+    if (err) return self.emit('error', err);
+    if (chunk) return self.push(chunk);
+    self.destroy();
+    self.push(null);
+  });
+};
+
+// Releases the native stream early; it's also freed on garbage collection
+OdbReadStream.prototype.destroy = function () {
+  var handle = this.handle;
+  if (!handle || this.destroyed) return;
+  this.destroyed = true;
+  handle.close(function () {});
+};
+
+mod.Odb.ReadStream = OdbReadStream;
+mod.Odb.createReadStream = function (repo, oid, options) {
+  return new OdbReadStream(repo, oid, options);
+};
+
+// A Readable of the commits a RevWalk gives, as Buffers of packed
+// 20-byte oids (wrap one in an OidArray to use it). Each _read asks
+// for one batch of about the size asked for, so the walk only runs
+// about a highWaterMark ahead of whoever reads it. `batchSize` sets a
+// fixed number of oids per batch instead (for objectMode, say).
+function RevWalkStream(walker, options) {
+  stream.Readable.call(this, options);
+  this.walker = walker;
+  this.batchSize = (options && options.batchSize) || 0;
+}
+util.inherits(RevWalkStream, stream.Readable);
+
+RevWalkStream.prototype._read = function (n) {
+  var self = this;
+  var count = this.batchSize || Math.max(1, Math.floor(n / 20));
+  this.walker.nextBatch(count, function (err, oids) {
+    if (err) return self.emit('error', err);
+    self.push(oids);
+  });
+};
+
+mod.RevWalk.Stream = RevWalkStream;
+mod.RevWalk.prototype.createReadStream = function (options) {
+  return new RevWalkStream(this, options);
+};
+
 // TODO: do the work here
 
@@ -28,12 +28,17 @@
 #include "v8u.hpp"
 #include "version.hpp"
 
+#include "cache.h"
 #include "error.h"
 #include "oid.h"
+#include "oid_array.h"
 #include "object.h"
+#include "odb.h"
 #include "reference.h"
 #include "message.h"
+#include "pool.h"
 #include "repository.h"
+#include "revwalk.h"
 
 #define GITTEH_VERSION 0,1,0
 #define SENCILLO_VERSION 0,1,1
@@ -54,6 +59,9 @@ inline Local<v8::Object> libgit2Version() {
 }
 
 NODE_DEF_MAIN() {
+  // libgit2 is built threadsafe, and jobs run on the worker pool
+  git_threads_init();
+
   // Version class & hash
   Version::init(target);
   Local<v8::Object> versions = v8u::Obj();
@@ -74,11 +82,32 @@ NODE_DEF_MAIN() {
   // Message utilities
   target->Set(Symbol("prettify"), Func(Prettify)->GetFunction());
 
+  // Worker pool knobs & counters
+  Local<v8::Object> pool = v8u::Obj();
+  pool->Set(Symbol("configure"), Func(PoolConfigure)->GetFunction());
+  pool->Set(Symbol("stats"), Func(PoolStats)->GetFunction());
+  target->Set(Symbol("pool"), pool);
+
+  // Delta base cache knobs & counters
+  Local<v8::Object> deltaBases = v8u::Obj();
+  deltaBases->Set(Symbol("configure"), Func(DeltaBaseCacheConfigure)->GetFunction());
+  deltaBases->Set(Symbol("stats"), Func(DeltaBaseCacheStats)->GetFunction());
+  target->Set(Symbol("deltaBaseCache"), deltaBases);
+
+  // Object database queries
+  Local<v8::Object> odb = v8u::Obj();
+  odb->Set(Symbol("existsMany"), Func(OdbExistsMany)->GetFunction());
+  odb->Set(Symbol("openReadStream"), Func(OdbOpenReadStream)->GetFunction());
+  target->Set(Symbol("Odb"), odb);
+
   // Classes initialization
   Oid::init(target);
+  OidArray::init(target);
   GitObject::init(target);
   Repository::init(target);
   Reference::init(target);
+  OdbReadStream::init(target);
+  RevWalk::init(target);
 } NODE_DEF_MAIN_END(sencillo)
 
 };
@@ -0,0 +1,91 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "cache.h"
+
+#include "common.h"
+
+
+using v8u::Symbol;
+using v8u::Num;
+using v8::Local;
+
+namespace sencillo {
+
+Local<v8::Object> cacheStatsObject(const git_cache_stats& stats) {
+  Local<v8::Object> ret = v8u::Obj();
+  ret->Set(Symbol("hits"), Num(stats.hits));
+  ret->Set(Symbol("misses"), Num(stats.misses));
+  ret->Set(Symbol("stores"), Num(stats.stores));
+  ret->Set(Symbol("evictions"), Num(stats.evictions));
+  ret->Set(Symbol("entries"), Num(stats.entries));
+  ret->Set(Symbol("bytes"), Num(stats.bytes));
+  return ret;
+}
+
+// Read a byte count option: -1 if invalid, 0 if absent, 1 if set
+static int sizeOpt(Local<v8::Object> opts, const char* name, size_t& out) {
+  Local<v8::Value> val = opts->Get(Symbol(name));
+  if (val->IsUndefined()) return 0;
+  double n = Num(val);
+  if (!(n >= 0)) return -1;
+  out = static_cast<size_t>(n);
+  return 1;
+}
+
+V8_SCB(DeltaBaseCacheConfigure) {
+  if (!args[0]->IsObject()) V8_STHROW(v8u::TypeErr("An options Object is needed!"));
+  Local<v8::Object> opts = v8u::Obj(args[0]);
+  size_t limit, object_limit;
+
+  int has_limit = sizeOpt(opts, "limit", limit);
+  int has_object_limit = sizeOpt(opts, "objectLimit", object_limit);
+  if (has_limit < 0 || has_object_limit < 0)
+    V8_STHROW(v8u::RangeErr("Invalid cache limit."));
+
+  if (has_limit)
+    git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_LIMIT, limit);
+  if (has_object_limit)
+    git_libgit2_opts(GIT_OPT_SET_DELTA_BASE_CACHE_OBJECT_LIMIT, object_limit);
+
+  return v8::Undefined();
+}
+
+V8_SCB(DeltaBaseCacheStats) {
+  v8::HandleScope scope;
+  git_cache_stats stats;
+  size_t limit, object_limit;
+
+  git_odb_delta_base_cache_stats(&stats);
+  git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_LIMIT, &limit);
+  git_libgit2_opts(GIT_OPT_GET_DELTA_BASE_CACHE_OBJECT_LIMIT, &object_limit);
+
+  Local<v8::Object> ret = cacheStatsObject(stats);
+  ret->Set(Symbol("limit"), Num(limit));
+  ret->Set(Symbol("objectLimit"), Num(object_limit));
+  return scope.Close(ret);
+}
+
+};
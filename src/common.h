@@ -29,6 +29,8 @@
 #include "v8u.hpp"
 #include "cvv8/convert.hpp"
 
+#include "pool.h"
+
 namespace sencillo {
 
 #define SENCILLO_ERROR_THROWER(IDENTIFIER, ERR)                                  \
@@ -64,10 +66,25 @@ V8_SCB(_isAbstract);
 
 #define SENCILLO_WORK_UNWRAP(IDENTIFIER)                                         \
   IDENTIFIER##_req* r = (IDENTIFIER##_req*)req->data
+// Work goes to sencillo's own pool (see pool.h), not to the uv threadpool
+#define SENCILLO_WORK_QUEUE_PRIO(IDENTIFIER, PRIO)                               \
+  r->req.data = r;                                                             \
+  return v8::Integer::New(queueWork(&r->req, IDENTIFIER##_work,                \
+                                    IDENTIFIER##_after, PRIO))
 #define SENCILLO_WORK_QUEUE(IDENTIFIER)                                          \
+  SENCILLO_WORK_QUEUE_PRIO(IDENTIFIER, WORK_INTERACTIVE)
+#define SENCILLO_BULK_QUEUE(IDENTIFIER)                                          \
+  SENCILLO_WORK_QUEUE_PRIO(IDENTIFIER, WORK_BULK)
+
+// Serialized with the other jobs on the same Repository (see Strand).
+// The request must have a `repo_obj` handle, which keeps the repository
+// alive until the job is done; it's released by SENCILLO_REPO_CALL.
+#define SENCILLO_REPO_QUEUE(IDENTIFIER, REPO, REPO_OBJ)                          \
   r->req.data = r;                                                             \
-  return v8::Integer::New(uv_queue_work(uv_default_loop(), &r->req,            \
-                                        IDENTIFIER##_work, (uv_after_work_cb)IDENTIFIER##_after))
+  r->repo_obj = v8u::Persist<v8::Object>(REPO_OBJ);                            \
+  return v8::Integer::New(queueWork(&r->req, IDENTIFIER##_work,                \
+                                    IDENTIFIER##_after, WORK_INTERACTIVE,      \
+                                    &(REPO)->strand))
 #define SENCILLO_WORK_CALL(ARGC)                                                 \
   v8::TryCatch try_catch;                                                      \
   r->cb->Call(v8::Context::GetCurrent()->Global(), ARGC, argv);                \
@@ -75,6 +92,10 @@ V8_SCB(_isAbstract);
   delete r;                                                                    \
   if (try_catch.HasCaught()) node::FatalException(try_catch)
 
+#define SENCILLO_REPO_CALL(ARGC)                                                 \
+  r->repo_obj.Dispose();                                                       \
+  SENCILLO_WORK_CALL(ARGC)
+
 #define SENCILLO_CB_CALL(CB, ARGC)                                             \
   v8::TryCatch try_catch;                                                      \
   r->cb->Call(v8::Context::GetCurrent()->Global(), ARGC, argv);                \
@@ -24,6 +24,8 @@
  */
 
 #include <v8.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "error.h"
 
@@ -37,12 +39,18 @@ void check(int status) {
 }
 
 void collectErr(int status, error_info& info) {
-  //TODO
+  // libgit2 keeps the last error per thread, so copy it now
+  const git_error* err = giterr_last();
+  info.status = status;
+  info.error.klass = err ? err->klass : GITERR_NOMEMORY;
+  info.error.message = strdup(err ? err->message : "Unknown error");
 }
 
 v8::Local<v8::Value> composeErr(error_info& info) {
-  const git_error* err = giterr_last();
-  return v8u::Err(err->message);
+  v8::Local<v8::Value> ret = v8u::Err(info.error.message);
+  free(info.error.message);
+  info.error.message = NULL;
+  return ret;
 }
 
 };
@@ -59,7 +59,8 @@ void check(int status);
  * Use for composing the JS error object later with `composeErr`.
  *
  * This is needed because you can't call V8 functions outside JS threads,
- * (i.e. inside uv_queue_work) which is where the errors occur.
+ * (i.e. inside the worker pool) which is where the errors occur, and
+ * because libgit2 keeps the last error per-thread.
  */
 void collectErr(int status, error_info& info);
 
@@ -0,0 +1,307 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "odb.h"
+
+#include <node_buffer.h>
+
+#include "repository.h"
+#include "common.h"
+#include "error.h"
+#include "oid_array.h"
+
+
+using v8::Local;
+using v8::Persistent;
+using v8::Function;
+using v8u::Symbol;
+
+namespace sencillo {
+
+// Upper bound for one read from a stream: 16 MB
+#define SENCILLO_ODB_MAX_CHUNK (16 << 20)
+
+//// Odb.existsMany(repo, oids, callback)
+
+SENCILLO_WORK_PRE(odb_exists_many) {
+  git_oid* oids;
+  size_t count;
+  git_repository* repo;
+  unsigned char* out; bool ok;
+  error_info err;
+
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(OdbExistsMany) {
+  v8::Local<v8::Object> repo_obj;
+  if (!(args[0]->IsObject() && Repository::HasInstance(repo_obj = v8u::Obj(args[0]))))
+    V8_STHROW(v8u::TypeErr("Repository needed as first argument."));
+  if (!args[2]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  const git_oid* input; size_t count;
+  if (args[1]->IsObject() && OidArray::HasInstance(v8u::Obj(args[1]))) {
+    OidArray* oids = node::ObjectWrap::Unwrap<OidArray>(v8u::Obj(args[1]));
+    input = oids->oids;
+    count = oids->length;
+  } else if (node::Buffer::HasInstance(args[1])) {
+    Local<v8::Object> buf = v8u::Obj(args[1]);
+    if (node::Buffer::Length(buf) % GIT_OID_RAWSZ)
+      V8_STHROW(v8u::RangeErr("Buffer length must be a multiple of 20"));
+    input = (const git_oid*)node::Buffer::Data(buf);
+    count = node::Buffer::Length(buf) / GIT_OID_RAWSZ;
+  } else V8_STHROW(v8u::TypeErr("An OidArray or a Buffer of oids is needed!"));
+
+  Repository* repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
+  odb_exists_many_req* r = new odb_exists_many_req;
+  r->repo = repo->repo;
+
+  // oids are copied here, the Buffer may change while the job runs
+  r->count = count;
+  r->oids = new git_oid [count];
+  memcpy(r->oids, input, count * GIT_OID_RAWSZ);
+  r->out = new unsigned char [(count + 7) / 8];
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[2]));
+  SENCILLO_REPO_QUEUE(odb_exists_many, repo, repo_obj);
+} SENCILLO_WORK(odb_exists_many) {
+  // one sorted pass over the packs for the whole batch
+  git_odb* odb;
+  int status = git_repository_odb(&odb, r->repo);
+  if (status == GIT_OK) {
+    status = git_odb_exists_many(r->out, odb, r->oids, r->count);
+    git_odb_free(odb);
+  }
+  if (!(r->ok= status == GIT_OK)) collectErr(status, r->err);
+  delete [] r->oids;
+} SENCILLO_WORK_AFTER(odb_exists_many) {
+  v8::Handle<v8::Value> argv [2];
+  if (r->ok) {
+    size_t len = (r->count + 7) / 8;
+    node::Buffer* buf = node::Buffer::New(len);
+    memcpy(node::Buffer::Data(buf), r->out, len);
+    argv[0] = v8::Null();
+    argv[1] = buf->handle_;
+  } else {
+    argv[0] = composeErr(r->err);
+    argv[1] = v8::Null();
+  }
+  delete [] r->out;
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+
+//// Odb.openReadStream(repo, oid, callback)
+
+SENCILLO_WORK_PRE(odb_open_rstream) {
+  git_oid oid;
+  git_repository* repo;
+  git_odb_stream* out; size_t size; git_otype type;
+  int status;
+  error_info err;
+
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(OdbOpenReadStream) {
+  v8::Local<v8::Object> repo_obj;
+  if (!(args[0]->IsObject() && Repository::HasInstance(repo_obj = v8u::Obj(args[0]))))
+    V8_STHROW(v8u::TypeErr("Repository needed as first argument."));
+  if (!args[2]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  // unwrapOid throws, and there's no try block around async entry points
+  git_oid oid;
+  try {
+    unwrapOid(args[1], &oid);
+  } catch (Persistent<v8::Value>& err) {
+    Local<v8::Value> loc = Local<v8::Value>::New(err);
+    err.Dispose();
+    return v8::ThrowException(loc);
+  }
+
+  Repository* repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
+  odb_open_rstream_req* r = new odb_open_rstream_req;
+  git_oid_cpy(&r->oid, &oid);
+  r->repo = repo->repo;
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[2]));
+  SENCILLO_REPO_QUEUE(odb_open_rstream, repo, repo_obj);
+} SENCILLO_WORK(odb_open_rstream) {
+  git_odb* odb;
+  r->status = git_repository_odb(&odb, r->repo);
+  if (r->status == GIT_OK) {
+    r->status = git_odb_open_rstream_ext(&r->out, &r->size, &r->type, odb, &r->oid);
+    git_odb_free(odb);
+  }
+  if (r->status != GIT_OK) collectErr(r->status, r->err);
+} SENCILLO_WORK_AFTER(odb_open_rstream) {
+  v8::Handle<v8::Value> argv [2];
+  if (r->status == GIT_OK) {
+    argv[0] = v8::Null();
+    argv[1] = (new OdbReadStream(r->out, r->size, r->type, r->repo_obj))->Wrapped();
+  } else {
+    argv[0] = composeErr(r->err);
+    argv[1] = v8::Null();
+  }
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+
+//// OdbReadStream
+
+OdbReadStream::OdbReadStream(git_odb_stream* stream, size_t size, git_otype type,
+                             v8::Handle<v8::Object> repo_obj)
+    : stream(stream), size(size), type(type) {
+  // the stream reads from the repository's odb, keep it alive
+  this->repo_obj = v8u::Persist<v8::Object>(repo_obj);
+  repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
+}
+OdbReadStream::~OdbReadStream() {
+  // no job can be running: they hold a handle to us
+  if (stream) stream->free(stream);
+  repo_obj.Dispose();
+}
+
+V8_ESCTOR(OdbReadStream) { V8_CTOR_NO_JS }
+
+static inline int streamClosed() {
+  giterr_set_str(GITERR_INVALID, "The stream is closed");
+  return GIT_ERROR;
+}
+
+//// OdbReadStream#read(n, callback)
+
+SENCILLO_WORK_PRE(odb_stream_read) {
+  OdbReadStream* inst;
+  char* data; size_t want, got;
+  int status;
+  error_info err;
+
+  Persistent<v8::Object> self;
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(OdbReadStream::Read) {
+  OdbReadStream* inst = Unwrap(args.This());
+  if (!args[0]->IsNumber() || args[0]->IntegerValue() <= 0)
+    V8_STHROW(v8u::RangeErr("A positive length is needed"));
+  if (!args[1]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  odb_stream_read_req* r = new odb_stream_read_req;
+  r->inst = inst;
+  r->self = v8u::Persist<v8::Object>(args.This());
+  int64_t want = args[0]->IntegerValue();
+  r->want = want > SENCILLO_ODB_MAX_CHUNK ? SENCILLO_ODB_MAX_CHUNK : (size_t) want;
+  r->data = new char [r->want];
+  r->got = 0;
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[1]));
+  SENCILLO_REPO_QUEUE(odb_stream_read, inst->repo, inst->repo_obj);
+} SENCILLO_WORK(odb_stream_read) {
+  git_odb_stream* stream = r->inst->stream;
+  r->status = stream ? GIT_OK : streamClosed();
+
+  // a backend may give back less than asked for; fill the chunk unless
+  // the object is over
+  while (r->status == GIT_OK && r->got < r->want) {
+    int n = stream->read(stream, r->data + r->got, r->want - r->got);
+    if (n < 0) r->status = n;
+    else if (n == 0) break;
+    else r->got += n;
+  }
+  if (r->status != GIT_OK) collectErr(r->status, r->err);
+} SENCILLO_WORK_AFTER(odb_stream_read) {
+  v8::Handle<v8::Value> argv [2];
+  argv[0] = v8::Null();
+  argv[1] = v8::Null();
+  if (r->status != GIT_OK) {
+    argv[0] = composeErr(r->err);
+  } else if (r->got) {
+    node::Buffer* buf = node::Buffer::New(r->data, r->got);
+    argv[1] = buf->handle_;
+  }
+  delete [] r->data;
+  r->self.Dispose();
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+//// OdbReadStream#close(callback)
+
+SENCILLO_WORK_PRE(odb_stream_close) {
+  OdbReadStream* inst;
+
+  Persistent<v8::Object> self;
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(OdbReadStream::Close) {
+  OdbReadStream* inst = Unwrap(args.This());
+  if (!args[0]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  odb_stream_close_req* r = new odb_stream_close_req;
+  r->inst = inst;
+  r->self = v8u::Persist<v8::Object>(args.This());
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[0]));
+  SENCILLO_REPO_QUEUE(odb_stream_close, inst->repo, inst->repo_obj);
+} SENCILLO_WORK(odb_stream_close) {
+  // after the reads queued before, and before the ones queued after
+  if (r->inst->stream) r->inst->stream->free(r->inst->stream);
+  r->inst->stream = NULL;
+} SENCILLO_WORK_AFTER(odb_stream_close) {
+  v8::Handle<v8::Value> argv [1];
+  argv[0] = v8::Null();
+  r->self.Dispose();
+  SENCILLO_REPO_CALL(1);
+} SENCILLO_END
+
+V8_ESGET(OdbReadStream, GetSize) {
+  V8_M_UNWRAP(OdbReadStream, info.Holder());
+  return v8u::Num(inst->size);
+}
+
+V8_ESGET(OdbReadStream, GetType) {
+  V8_M_UNWRAP(OdbReadStream, info.Holder());
+  return v8u::Str(git_object_type2string(inst->type));
+}
+
+NODE_ETYPE(OdbReadStream, "OdbReadStream") {
+  V8_DEF_CB("read", Read);
+  V8_DEF_CB("close", Close);
+
+  V8_DEF_GET("size", GetSize);
+  V8_DEF_GET("type", GetType);
+} NODE_TYPE_END()
+V8_POST_TYPE(OdbReadStream)
+
+};
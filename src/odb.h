@@ -0,0 +1,73 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SENCILLO_ODB_H
+#define	SENCILLO_ODB_H
+
+#include "git2.h"
+#include "v8u.hpp"
+#include "repository.h"
+
+namespace sencillo {
+
+// Odb.existsMany(repo, oids, callback): which of the given oids (an
+// OidArray, or a Buffer of 20*N bytes) are in the repository, as a
+// bitmap Buffer of ceil(N/8) bytes (bit i is `buf[i >> 3] & (1 << (i & 7))`).
+V8_SCB(OdbExistsMany);
+
+// Odb.openReadStream(repo, oid, callback): opens the object for reading
+// in chunks, without having all of it in memory; packed blobs (deltas
+// too) are inflated as they're read. lib/ wraps it in a Readable.
+V8_SCB(OdbOpenReadStream);
+
+class OdbReadStream : public node::ObjectWrap {
+public:
+  OdbReadStream(git_odb_stream* stream, size_t size, git_otype type,
+                v8::Handle<v8::Object> repo_obj);
+  ~OdbReadStream();
+  V8_SCTOR();
+
+  // read(n, callback): up to `n` bytes as a Buffer, or null at the end
+  static V8_SCB(Read);
+  // close(callback): frees the stream; later reads get an error
+  static V8_SCB(Close);
+
+  V8_SGET(GetSize);
+  V8_SGET(GetType);
+
+  NODE_STYPE(OdbReadStream);
+
+  // only touched from jobs on the repository's strand
+  git_odb_stream* stream;
+  const size_t size;
+  const git_otype type;
+
+  Repository* repo;
+  v8::Persistent<v8::Object> repo_obj;
+};
+
+};
+
+#endif	/* SENCILLO_ODB_H */
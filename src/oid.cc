@@ -122,17 +122,24 @@ V8_CB(Oid::ParseArray) {
   int len = input->Length();
   Local<v8::Array> output = v8u::Arr(len);
 
+  // gather all hexes and parse them in bulk; a short hex is the same
+  // as one padded with zeros, which is what git_oid_fromstrn does
+  char* hex = new char [len * GIT_OID_HEXSZ];
+  memset(hex, '0', len * GIT_OID_HEXSZ);
   for (int i = 0; i < len; i++) {
     v8::String::Utf8Value str (input->Get(i));
-
-    Oid* inst = new Oid;
-    v8::Local<v8::Object> ret = inst->Wrapped();
-
-    if (*str == NULL) check(git_oid_fromstrn(&inst->oid, "", 0));
-    else check(git_oid_fromstrn(&inst->oid, *str, str.length()));
-
-    output->Set(i, ret);
+    if (*str == NULL) continue;
+    int n = str.length() < GIT_OID_HEXSZ ? str.length() : GIT_OID_HEXSZ;
+    memcpy(hex + i*GIT_OID_HEXSZ, *str, n);
   }
+  git_oid* oids = new git_oid [len];
+  int status = git_oid_fromstr_many(oids, hex, len);
+  delete [] hex;
+
+  for (int i = 0; i < len && status == GIT_OK; i++)
+    output->Set(i, (new Oid(oids[i]))->Wrapped());
+  delete [] oids;
+  check(status);
 
   V8_RET(output);
 } V8_CB_END()
@@ -59,6 +59,8 @@ public:
 
   V8_SGET(IsEmpty);
 
+  inline const git_oid& get() const { return oid; }
+
   NODE_STYPE(Oid);
 protected:
   git_oid oid;
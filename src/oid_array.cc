@@ -0,0 +1,240 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "oid_array.h"
+
+#include <algorithm>
+#include <node_buffer.h>
+
+#include "error.h"
+#include "oid.h"
+
+
+using v8::Handle;
+using v8::Local;
+using v8u::Symbol;
+using v8u::Func;
+
+namespace sencillo {
+
+OidArray::OidArray(Handle<v8::Object> buf) {
+  buffer = v8u::Persist<v8::Object>(buf);
+  oids = (git_oid*)node::Buffer::Data(buf);
+  length = node::Buffer::Length(buf) / GIT_OID_RAWSZ;
+}
+OidArray::~OidArray() {
+  buffer.Dispose();
+}
+
+OidArray* OidArray::New(size_t length) {
+  node::Buffer* buf = node::Buffer::New(length * GIT_OID_RAWSZ);
+  memset(node::Buffer::Data(buf), 0, length * GIT_OID_RAWSZ);
+  return new OidArray(buf->handle_);
+}
+
+// new OidArray(buffer) wraps the Buffer (no copy), new OidArray(n) allocates
+V8_ECTOR(OidArray) {
+  OidArray* inst;
+  if (node::Buffer::HasInstance(args[0])) {
+    Local<v8::Object> buf = v8u::Obj(args[0]);
+    if (node::Buffer::Length(buf) % GIT_OID_RAWSZ)
+      V8_THROW(v8u::RangeErr("Buffer length must be a multiple of 20"));
+    inst = new OidArray(buf);
+  } else if (args[0]->IsNumber()) {
+    inst = New(v8u::Uint(args[0]));
+  } else V8_THROW(v8u::TypeErr("A Buffer or a length is needed"));
+  V8_WRAP(inst);
+} V8_CTOR_END()
+
+void unwrapOid(Handle<v8::Value> value, git_oid* out) {
+  if (value->IsString()) {
+    // a prefix, or anything after the 40th digit, would name another oid
+    Local<v8::String> str = value->ToString();
+    if (str->Length() != GIT_OID_HEXSZ)
+      V8_THROW(v8u::RangeErr("A hex String of 40 digits is needed"));
+    char hex [GIT_OID_HEXSZ];
+    str->WriteAscii(hex, 0, GIT_OID_HEXSZ, v8::String::NO_NULL_TERMINATION);
+    check(git_oid_fromstrn(out, hex, GIT_OID_HEXSZ));
+  } else if (node::Buffer::HasInstance(value)) {
+    Local<v8::Object> buf = value->ToObject();
+    if (node::Buffer::Length(buf) < GIT_OID_RAWSZ)
+      V8_THROW(v8u::RangeErr("Need more data"));
+    git_oid_fromraw(out, (const unsigned char*)node::Buffer::Data(buf));
+  } else if (value->IsObject() && Oid::HasInstance(v8u::Obj(value))) {
+    git_oid_cpy(out, &Oid::Unwrap(v8u::Obj(value))->get());
+  } else V8_THROW(v8u::TypeErr("An Oid, hex String or Buffer is needed"));
+}
+
+static inline size_t unwrapIndex(OidArray* inst, Handle<v8::Value> value) {
+  if (!value->IsNumber()) V8_THROW(v8u::TypeErr("An index is needed"));
+  int64_t i = value->IntegerValue();
+  if (i < 0 || (uint64_t)i >= inst->length) V8_THROW(v8u::RangeErr("Index out of range"));
+  return i;
+}
+
+struct oid_less {
+  inline bool operator()(const git_oid& a, const git_oid& b) const {
+    return memcmp(a.id, b.id, GIT_OID_RAWSZ) < 0;
+  }
+};
+
+// ACCESSORS
+
+V8_CB(OidArray::Get) {
+  OidArray* inst = Unwrap(args.This());
+  V8_RET((new Oid(inst->oids[unwrapIndex(inst, args[0])]))->Wrapped());
+} V8_CB_END()
+
+V8_CB(OidArray::Hex) {
+  OidArray* inst = Unwrap(args.This());
+  char hex [GIT_OID_HEXSZ];
+  git_oid_fmt(hex, &inst->oids[unwrapIndex(inst, args[0])]);
+  V8_RET(v8u::Str(hex, GIT_OID_HEXSZ));
+} V8_CB_END()
+
+V8_CB(OidArray::ToJSON) {
+  OidArray* inst = Unwrap(args.This());
+  Local<v8::Array> output = v8u::Arr(inst->length);
+  char* hex = new char [inst->length * GIT_OID_HEXSZ];
+  git_oid_fmt_many(hex, inst->oids, inst->length);
+  for (size_t i = 0; i < inst->length; i++)
+    output->Set(i, v8u::Str(hex + i*GIT_OID_HEXSZ, GIT_OID_HEXSZ));
+  delete [] hex;
+  V8_RET(output);
+} V8_CB_END()
+
+// COMPARING & SEARCHING
+
+V8_CB(OidArray::Compare) {
+  OidArray* inst = Unwrap(args.This());
+  const git_oid* a = &inst->oids[unwrapIndex(inst, args[0])];
+  const git_oid* b = &inst->oids[unwrapIndex(inst, args[1])];
+  V8_RET(v8u::Int(git_oid_cmp(a, b)));
+} V8_CB_END()
+
+V8_CB(OidArray::Sort) {
+  OidArray* inst = Unwrap(args.This());
+  std::sort(inst->oids, inst->oids + inst->length, oid_less());
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(OidArray::IndexOf) {
+  OidArray* inst = Unwrap(args.This());
+  git_oid oid;
+  unwrapOid(args[0], &oid);
+  for (size_t i = 0; i < inst->length; i++)
+    if (git_oid_equal(&inst->oids[i], &oid)) V8_RET(v8u::Int(i));
+  V8_RET(v8u::Int(-1));
+} V8_CB_END()
+
+// Only meaningful on a sorted array
+V8_CB(OidArray::BinarySearch) {
+  OidArray* inst = Unwrap(args.This());
+  git_oid oid;
+  unwrapOid(args[0], &oid);
+  git_oid* end = inst->oids + inst->length;
+  git_oid* pos = std::lower_bound(inst->oids, end, oid, oid_less());
+  if (pos == end || !git_oid_equal(pos, &oid)) V8_RET(v8u::Int(-1));
+  V8_RET(v8u::Int(pos - inst->oids));
+} V8_CB_END()
+
+V8_CB(OidArray::Inspect) {
+  OidArray* inst = Unwrap(args.This());
+  char str [GITTEH_OID_ARRAY_REPR_LEN];
+  V8_RET(v8u::Str(str, sprintf(str, GITTEH_OID_ARRAY_REPR, (unsigned long)inst->length)));
+} V8_CB_END()
+
+// OidArray.parse(hexes): hexes is an Array of hex Strings,
+// or a single String with all of them concatenated
+V8_CB(OidArray::Parse) {
+  if (args[0]->IsString()) {
+    Local<v8::String> str = args[0]->ToString();
+    int len = str->Length();
+    if (len % GIT_OID_HEXSZ) V8_THROW(v8u::RangeErr("String length must be a multiple of 40"));
+
+    char* hex = new char [len];
+    str->WriteAscii(hex, 0, len, v8::String::NO_NULL_TERMINATION);
+    OidArray* inst = New(len / GIT_OID_HEXSZ);
+    Local<v8::Object> ret = inst->Wrapped();
+    int status = git_oid_fromstr_many(inst->oids, hex, inst->length);
+    delete [] hex;
+    check(status);
+    V8_RET(ret);
+  }
+
+  if (!args[0]->IsArray()) V8_THROW(v8u::TypeErr("An Array or a String is needed"));
+  Local<v8::Array> input = v8u::Arr(args[0]);
+  OidArray* inst = New(input->Length());
+  Local<v8::Object> ret = inst->Wrapped();
+
+  // gather all hexes and parse them in bulk; as in unwrapOid, a prefix
+  // or anything after the 40th digit would name another oid
+  char* hex = new char [inst->length * GIT_OID_HEXSZ];
+  for (size_t i = 0; i < inst->length; i++) {
+    Local<v8::Value> item = input->Get(i);
+    if (!item->IsString() || item->ToString()->Length() != GIT_OID_HEXSZ) {
+      delete [] hex;
+      V8_THROW(v8u::TypeErr("Only hex Strings of 40 digits can be parsed"));
+    }
+    item->ToString()->WriteAscii(hex + i*GIT_OID_HEXSZ, 0, GIT_OID_HEXSZ,
+                                 v8::String::NO_NULL_TERMINATION);
+  }
+  int status = git_oid_fromstr_many(inst->oids, hex, inst->length);
+  delete [] hex;
+  check(status);
+  V8_RET(ret);
+} V8_CB_END()
+
+V8_ESGET(OidArray, GetLength) {
+  V8_M_UNWRAP(OidArray, info.Holder());
+  return v8u::Num(inst->length);
+}
+
+V8_ESGET(OidArray, GetBuffer) {
+  V8_M_UNWRAP(OidArray, info.Holder());
+  return inst->buffer;
+}
+
+NODE_ETYPE(OidArray, "OidArray") {
+  V8_DEF_CB("get", Get);
+  V8_DEF_CB("hex", Hex);
+  V8_DEF_CB("toJSON", ToJSON);
+
+  V8_DEF_CB("compare", Compare);
+  V8_DEF_CB("sort", Sort);
+  V8_DEF_CB("indexOf", IndexOf);
+  V8_DEF_CB("binarySearch", BinarySearch);
+
+  V8_DEF_CB("inspect", Inspect);
+
+  V8_DEF_GET("length", GetLength);
+  V8_DEF_GET("buffer", GetBuffer);
+
+  Local<v8::Function> func = templ->GetFunction();
+  func->Set(Symbol("parse"), Func(Parse)->GetFunction());
+} NODE_TYPE_END()
+V8_POST_TYPE(OidArray)
+
+};
@@ -0,0 +1,85 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SENCILLO_OID_ARRAY_H
+#define	SENCILLO_OID_ARRAY_H
+
+#include "git2.h"
+
+#include "v8u.hpp"
+
+namespace sencillo {
+
+#define GITTEH_OID_ARRAY_REPR "<OidArray %lu>"
+#define GITTEH_OID_ARRAY_REPR_LEN 32
+
+/*
+ * A packed array of oids: one contiguous Buffer of 20*N bytes, with
+ * the parse / format / compare / sort / search operations done natively
+ * over it, so moving lots of oids through JS doesn't create a wrapped
+ * Oid (and a weak handle) per element.
+ */
+class OidArray : public node::ObjectWrap {
+public:
+  OidArray(v8::Handle<v8::Object> buffer);
+  ~OidArray();
+  V8_SCTOR();
+
+  // Allocates a zeroed array for `length` oids
+  static OidArray* New(size_t length);
+
+  static V8_SCB(Get);
+  static V8_SCB(Hex);
+  static V8_SCB(ToJSON);
+
+  static V8_SCB(Compare);
+  static V8_SCB(Sort);
+  static V8_SCB(IndexOf);
+  static V8_SCB(BinarySearch);
+
+  static V8_SCB(Inspect);
+
+  static V8_SCB(Parse);
+
+  V8_SGET(GetLength);
+  V8_SGET(GetBuffer);
+
+  NODE_STYPE(OidArray);
+
+  git_oid* oids;
+  size_t length;
+protected:
+  v8::Persistent<v8::Object> buffer;
+};
+
+/*
+ * Reads an oid given as an Oid, a 40-char hex String or a 20-byte Buffer.
+ * Throws if it's neither.
+ */
+void unwrapOid(v8::Handle<v8::Value> value, git_oid* out);
+
+};
+
+#endif	/* SENCILLO_OID_ARRAY_H */
@@ -0,0 +1,302 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "common.h"
+
+
+using v8u::Symbol;
+using v8u::Int;
+using v8u::Num;
+using v8::Local;
+
+namespace sencillo {
+
+#define SENCILLO_POOL_DEFAULT_SIZE 4
+#define SENCILLO_POOL_MAX_SIZE 128
+
+struct pool_job {
+  uv_work_t* req;
+  work_cb work;
+  after_work_cb after;
+  work_priority prio;
+  Strand* strand;
+  uint64_t queued_at;
+  pool_job* next;
+};
+
+struct job_queue {
+  pool_job* head;
+  pool_job* tail;
+  unsigned int length;
+};
+
+struct prio_stats {
+  double completed;
+  uint64_t wait_total; // nanoseconds
+  uint64_t wait_max;
+};
+
+static struct {
+  bool started;
+  int size;
+  int bulk_limit; // max threads running bulk jobs, < size when possible
+
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  job_queue pending [WORK_PRIORITIES];
+  job_queue done;
+  int active [WORK_PRIORITIES];
+  unsigned int outstanding; // queued + running + waiting for `after`
+  prio_stats stats [WORK_PRIORITIES];
+
+  uv_async_t async;
+  uv_thread_t* threads;
+} pool;
+
+void strandNext(Strand* strand);
+
+static inline void jobPush(job_queue& q, pool_job* job) {
+  job->next = NULL;
+  if (q.tail) q.tail->next = job;
+  else q.head = job;
+  q.tail = job;
+  q.length++;
+}
+
+static inline pool_job* jobShift(job_queue& q) {
+  pool_job* job = q.head;
+  if (!job) return NULL;
+  if (!(q.head = job->next)) q.tail = NULL;
+  q.length--;
+  return job;
+}
+
+// Size given to configure(), or else $SENCILLO_POOL_SIZE, or else the default
+static int poolSize() {
+  if (pool.size) return pool.size;
+  const char* env = getenv("SENCILLO_POOL_SIZE");
+  int size = env ? atoi(env) : 0;
+  if (size <= 0) return SENCILLO_POOL_DEFAULT_SIZE;
+  if (size > SENCILLO_POOL_MAX_SIZE) return SENCILLO_POOL_MAX_SIZE;
+  return size;
+}
+
+static inline int defaultBulkLimit(int size) {
+  return size > 1 ? size - 1 : 1;
+}
+
+// Called with the lock held.
+static pool_job* nextJob() {
+  if (pool.pending[WORK_INTERACTIVE].head)
+    return jobShift(pool.pending[WORK_INTERACTIVE]);
+  if (pool.active[WORK_BULK] < pool.bulk_limit)
+    return jobShift(pool.pending[WORK_BULK]);
+  return NULL;
+}
+
+static void poolWorker(void* arg) {
+  uv_mutex_lock(&pool.lock);
+  for (;;) {
+    pool_job* job;
+    while (!(job = nextJob())) uv_cond_wait(&pool.cond, &pool.lock);
+
+    uint64_t wait = uv_hrtime() - job->queued_at;
+    prio_stats& st = pool.stats[job->prio];
+    st.wait_total += wait;
+    if (wait > st.wait_max) st.wait_max = wait;
+    pool.active[job->prio]++;
+    uv_mutex_unlock(&pool.lock);
+
+    job->work(job->req);
+
+    uv_mutex_lock(&pool.lock);
+    pool.active[job->prio]--;
+    st.completed++;
+    if (job->strand) strandNext(job->strand);
+    jobPush(pool.done, job);
+    // a finished bulk job may let another thread pick the next one
+    if (job->prio == WORK_BULK) uv_cond_signal(&pool.cond);
+    uv_async_send(&pool.async);
+  }
+}
+
+static void poolDone(uv_async_t* handle, int status) {
+  uv_mutex_lock(&pool.lock);
+  pool_job* job = pool.done.head;
+  pool.done.head = pool.done.tail = NULL;
+  pool.done.length = 0;
+  uv_mutex_unlock(&pool.lock);
+
+  while (job) {
+    pool_job* next = job->next;
+    job->after(job->req);
+    delete job;
+    if (--pool.outstanding == 0) uv_unref((uv_handle_t*)&pool.async);
+    job = next;
+  }
+}
+
+static void poolStart() {
+  if (pool.started) return;
+  pool.started = true;
+
+  pool.size = poolSize();
+  if (!pool.bulk_limit) pool.bulk_limit = defaultBulkLimit(pool.size);
+
+  if (uv_mutex_init(&pool.lock) || uv_cond_init(&pool.cond)) abort();
+  uv_async_init(uv_default_loop(), &pool.async, poolDone);
+  uv_unref((uv_handle_t*)&pool.async);
+
+  pool.threads = new uv_thread_t [pool.size];
+  for (int i = 0; i < pool.size; i++)
+    if (uv_thread_create(&pool.threads[i], poolWorker, NULL)) abort();
+}
+
+int queueWork(uv_work_t* req, work_cb work, after_work_cb after,
+              work_priority prio, Strand* strand) {
+  poolStart();
+
+  pool_job* job = new pool_job;
+  job->req = req;
+  job->work = work;
+  job->after = after;
+  job->prio = prio;
+  job->strand = strand;
+  job->queued_at = uv_hrtime();
+
+  if (pool.outstanding++ == 0) uv_ref((uv_handle_t*)&pool.async);
+
+  uv_mutex_lock(&pool.lock);
+  if (strand && strand->busy) {
+    // will be moved to the pool once its predecessors are done
+    job->next = NULL;
+    if (strand->tail) strand->tail->next = job;
+    else strand->head = job;
+    strand->tail = job;
+  } else {
+    if (strand) strand->busy = true;
+    jobPush(pool.pending[prio], job);
+    uv_cond_signal(&pool.cond);
+  }
+  uv_mutex_unlock(&pool.lock);
+  return 0;
+}
+
+
+// STRANDS
+
+Strand::Strand(): head(NULL), tail(NULL), busy(false) {}
+
+// Jobs keep their repository (and so its strand) alive until they're done
+Strand::~Strand() {
+  assert(!busy && !head);
+}
+
+// Called with the lock held, after a job of the strand has finished.
+void strandNext(Strand* strand) {
+  pool_job* job = strand->head;
+  if (!job) {
+    strand->busy = false;
+    return;
+  }
+  if (!(strand->head = job->next)) strand->tail = NULL;
+  jobPush(pool.pending[job->prio], job);
+  uv_cond_signal(&pool.cond);
+}
+
+
+// JS SIDE
+
+V8_SCB(PoolConfigure) {
+  if (!args[0]->IsObject()) V8_STHROW(v8u::TypeErr("An options Object is needed!"));
+  Local<v8::Object> opts = v8u::Obj(args[0]);
+  Local<v8::Value> size = opts->Get(Symbol("size"));
+  Local<v8::Value> bulk = opts->Get(Symbol("bulkLimit"));
+
+  int newSize = poolSize(), newBulk = pool.bulk_limit;
+
+  if (!size->IsUndefined()) {
+    if (pool.started) V8_STHROW(v8u::Err("The pool is already running, its size can't change."));
+    newSize = Int(size);
+    if (newSize < 1 || newSize > SENCILLO_POOL_MAX_SIZE) V8_STHROW(v8u::RangeErr("Invalid pool size."));
+  }
+
+  if (!bulk->IsUndefined()) {
+    newBulk = Int(bulk);
+    if (newBulk < 1) V8_STHROW(v8u::RangeErr("Invalid bulk limit."));
+  }
+
+  // bulk jobs must leave a thread to interactive ones, unless there's just one
+  if (newBulk && newSize > 1 && newBulk >= newSize)
+    V8_STHROW(v8u::RangeErr("The bulk limit must be smaller than the pool size."));
+
+  if (!size->IsUndefined()) pool.size = newSize;
+
+  if (!bulk->IsUndefined()) {
+    if (pool.started) {
+      uv_mutex_lock(&pool.lock);
+      pool.bulk_limit = newBulk;
+      uv_cond_broadcast(&pool.cond);
+      uv_mutex_unlock(&pool.lock);
+    } else pool.bulk_limit = newBulk;
+  }
+
+  return v8::Undefined();
+}
+
+static Local<v8::Object> prioStats(int prio) {
+  const prio_stats& st = pool.stats[prio];
+  Local<v8::Object> o = v8u::Obj();
+  o->Set(Symbol("queued"), Int(pool.pending[prio].length));
+  o->Set(Symbol("active"), Int(pool.active[prio]));
+  o->Set(Symbol("completed"), Num(st.completed));
+  // wait times are reported in milliseconds
+  o->Set(Symbol("waitTotal"), Num(st.wait_total / 1e6));
+  o->Set(Symbol("waitMax"), Num(st.wait_max / 1e6));
+  return o;
+}
+
+V8_SCB(PoolStats) {
+  v8::HandleScope scope;
+  Local<v8::Object> ret = v8u::Obj();
+  int size = poolSize();
+
+  if (pool.started) uv_mutex_lock(&pool.lock);
+  ret->Set(Symbol("started"), v8u::Bool(pool.started));
+  ret->Set(Symbol("size"), Int(size));
+  ret->Set(Symbol("bulkLimit"), Int(pool.bulk_limit ? pool.bulk_limit : defaultBulkLimit(size)));
+  ret->Set(Symbol("interactive"), prioStats(WORK_INTERACTIVE));
+  ret->Set(Symbol("bulk"), prioStats(WORK_BULK));
+  if (pool.started) uv_mutex_unlock(&pool.lock);
+
+  return scope.Close(ret);
+}
+
+};
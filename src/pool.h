@@ -0,0 +1,92 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SENCILLO_POOL_H
+#define	SENCILLO_POOL_H
+
+#include <uv.h>
+
+#include "v8u.hpp"
+
+namespace sencillo {
+
+/*
+ * Priority classes for jobs on the worker pool.
+ *
+ * Interactive jobs (lookups, resolves, opens) are always dequeued before
+ * bulk ones (clone, fetch), and bulk jobs never get to occupy every thread
+ * of the pool, so a slow clone can't starve a lookup.
+ */
+enum work_priority {
+  WORK_INTERACTIVE = 0,
+  WORK_BULK = 1,
+  WORK_PRIORITIES
+};
+
+typedef void (*work_cb)(uv_work_t* req);
+typedef void (*after_work_cb)(uv_work_t* req);
+
+struct pool_job;
+
+/*
+ * Jobs queued on a strand run one at a time, in order, on the worker pool.
+ *
+ * Every Repository owns one: a git_repository (its caches, refdb, pack
+ * windows) may only be used by a thread at a time, while jobs touching
+ * different repositories still run fully in parallel.
+ */
+class Strand {
+public:
+  Strand();
+  ~Strand();
+private:
+  friend int queueWork(uv_work_t*, work_cb, after_work_cb, work_priority, Strand*);
+  friend void strandNext(Strand*);
+  pool_job* head;
+  pool_job* tail;
+  bool busy;
+};
+
+/*
+ * Sencillo's own worker pool, so that libgit2 jobs don't compete with
+ * fs / dns / crypto for the (shared, and small) libuv threadpool.
+ *
+ * Works like uv_queue_work: `work` is called in one of the pool threads,
+ * then `after` is called on the default loop. Threads are started lazily
+ * on the first job; the size defaults to $SENCILLO_POOL_SIZE, or 4.
+ *
+ * If a strand is given, the job won't start until every job queued
+ * before it on that strand has finished.
+ */
+int queueWork(uv_work_t* req, work_cb work, after_work_cb after,
+              work_priority prio, Strand* strand = NULL);
+
+// JS side: sencillo.pool.configure({size, bulkLimit}) and .stats()
+V8_SCB(PoolConfigure);
+V8_SCB(PoolStats);
+
+};
+
+#endif	/* SENCILLO_POOL_H */
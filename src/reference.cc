@@ -29,6 +29,7 @@
 #include "common.h"
 #include "error.h"
 #include "oid.h"
+#include "oid_array.h"
 
 
 using v8u::Int;
@@ -61,6 +62,7 @@ SENCILLO_WORK_PRE(ref_lookup) {
   git_reference* out;
   error_info err;
 
+  Persistent<v8::Object> repo_obj;
   Persistent<Function> cb;
   uv_work_t req;
 };
@@ -71,12 +73,13 @@ V8_SCB(Reference::Lookup) {
     V8_STHROW(v8u::TypeErr("Repository needed as first argument."));
   if (!args[2]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
 
+  Repository* repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
   ref_lookup_req* r = new ref_lookup_req;
-  r->repo = node::ObjectWrap::Unwrap<Repository>(repo_obj)->repo;
+  r->repo = repo->repo;
   r->name = new v8::String::Utf8Value(args[1]);
 
   r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[2]));
-  SENCILLO_WORK_QUEUE(ref_lookup);
+  SENCILLO_REPO_QUEUE(ref_lookup, repo, repo_obj);
 } SENCILLO_WORK(ref_lookup) {
   SENCILLO_ASYNC_CSTR(r->name, cname);
 
@@ -94,7 +97,7 @@ V8_SCB(Reference::Lookup) {
     argv[0] = composeErr(r->err);
     argv[1] = v8::Null();
   }
-  SENCILLO_WORK_CALL(2);
+  SENCILLO_REPO_CALL(2);
 } SENCILLO_END
 
 
@@ -106,6 +109,7 @@ SENCILLO_WORK_PRE(ref_sresolve) {
   git_oid out; bool ok;
   error_info err;
 
+  Persistent<v8::Object> repo_obj;
   Persistent<Function> cb;
   uv_work_t req;
 };
@@ -116,12 +120,13 @@ V8_SCB(Reference::StaticResolve) {
     V8_STHROW(v8u::TypeErr("Repository needed as first argument."));
   if (!args[2]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
 
+  Repository* repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
   ref_sresolve_req* r = new ref_sresolve_req;
-  r->repo = node::ObjectWrap::Unwrap<Repository>(repo_obj)->repo;
+  r->repo = repo->repo;
   r->name = new v8::String::Utf8Value(args[1]);
 
   r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[2]));
-  SENCILLO_WORK_QUEUE(ref_sresolve);
+  SENCILLO_REPO_QUEUE(ref_sresolve, repo, repo_obj);
 } SENCILLO_WORK(ref_sresolve) {
   SENCILLO_ASYNC_CSTR(r->name, cname);
 
@@ -138,9 +143,87 @@ V8_SCB(Reference::StaticResolve) {
     argv[0] = composeErr(r->err);
     argv[1] = v8::Null();
   }
-  SENCILLO_WORK_CALL(2);
+  SENCILLO_REPO_CALL(2);
 } SENCILLO_END
 
+//// Reference.resolveMany(repo, names, [raw], callback)
+
+SENCILLO_WORK_PRE(ref_sresolve_many) {
+  char** names;
+  size_t count;
+  git_repository* repo;
+  git_oid* out; int* errors; bool ok;
+  bool raw;
+  error_info err;
+
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(Reference::StaticResolveMany) {
+  int len = args.Length()-1; // don't count the callback
+  if (len < 2) V8_STHROW(v8u::RangeErr("Not enough arguments!"));
+  if (len > 3) len = 3;
+  v8::Local<v8::Object> repo_obj;
+  if (!(args[0]->IsObject() && Repository::HasInstance(repo_obj = v8u::Obj(args[0]))))
+    V8_STHROW(v8u::TypeErr("Repository needed as first argument."));
+  if (!args[1]->IsArray()) V8_STHROW(v8u::TypeErr("An Array of names is needed!"));
+  if (!args[len]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  Repository* repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
+  Local<v8::Array> input = v8u::Arr(args[1]);
+  ref_sresolve_many_req* r = new ref_sresolve_many_req;
+  r->repo = repo->repo;
+  r->raw = len > 2 ? v8u::Bool(args[2]) : false;
+
+  // names are copied here, V8 can't be touched from the pool
+  r->count = input->Length();
+  r->names = new char* [r->count];
+  for (size_t i = 0; i < r->count; i++) {
+    v8::String::Utf8Value name (input->Get(i));
+    SENCILLO_SYNC_CSTR(name, cname);
+    r->names[i] = cname;
+  }
+  r->out = new git_oid [r->count];
+  r->errors = new int [r->count];
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[len]));
+  SENCILLO_REPO_QUEUE(ref_sresolve_many, repo, repo_obj);
+} SENCILLO_WORK(ref_sresolve_many) {
+  // the whole batch runs in a single job, loading packed-refs once
+  int status = git_reference_name_to_id_many(r->out, r->errors, r->repo,
+                                             (const char**)r->names, r->count);
+  if (!(r->ok= status == GIT_OK)) collectErr(status, r->err);
+  for (size_t i = 0; i < r->count; i++) delete [] r->names[i];
+  delete [] r->names;
+} SENCILLO_WORK_AFTER(ref_sresolve_many) {
+  v8::Handle<v8::Value> argv [2];
+  if (!r->ok) {
+    argv[0] = composeErr(r->err);
+    argv[1] = v8::Null();
+  } else if (r->raw) {
+    // 20 bytes per name, all zeros for the ones that didn't resolve
+    OidArray* oids = OidArray::New(r->count);
+    memcpy(oids->oids, r->out, r->count * GIT_OID_RAWSZ);
+    argv[0] = v8::Null();
+    argv[1] = oids->Wrapped();
+  } else {
+    Local<v8::Array> output = v8u::Arr(r->count);
+    for (size_t i = 0; i < r->count; i++) {
+      if (r->errors[i] == GIT_OK) output->Set(i, (new Oid(r->out[i]))->Wrapped());
+      else output->Set(i, v8::Null());
+    }
+    argv[0] = v8::Null();
+    argv[1] = output;
+  }
+  delete [] r->out;
+  delete [] r->errors;
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+// Runs on the JS thread, outside the repository's strand: it must not be
+// called while any job queued on the same Repository is pending.
 V8_SCB(Reference::StaticResolveSync) {
   v8::Local<v8::Object> repo_obj;
   if (!(args[0]->IsObject() && Repository::HasInstance(repo_obj = v8u::Obj(args[0]))))
@@ -172,6 +255,7 @@ NODE_ETYPE(Reference, "Reference") {
 
   func->Set(Symbol("resolve"), Func(StaticResolve)->GetFunction());
   func->Set(Symbol("resolveSync"), Func(StaticResolveSync)->GetFunction());
+  func->Set(Symbol("resolveMany"), Func(StaticResolveMany)->GetFunction());
 } NODE_TYPE_END()
 
 V8_POST_TYPE(Reference)
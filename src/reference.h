@@ -40,6 +40,7 @@ public:
 
   static V8_SCB(Lookup); //static V8_SCB(LookupSync);
   static V8_SCB(StaticResolve); static V8_SCB(StaticResolveSync);
+  static V8_SCB(StaticResolveMany);
 
   NODE_STYPE(Reference);
 protected:
@@ -27,6 +27,8 @@
 
 #include "common.h"
 #include "error.h"
+#include "cache.h"
+#include "revwalk.h"
 
 
 using v8u::Int;
@@ -86,6 +88,61 @@ V8_ESGET(Repository, IsBare) {
   return v8u::Bool(git_repository_is_bare(inst->repo));
 }
 
+//// Repository#cacheStats(callback)
+
+SENCILLO_WORK_PRE(repo_cache_stats) {
+  git_repository* repo;
+  git_cache_stats objects, odb;
+  int status;
+  error_info err;
+
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+// Queued like any other job: the caches belong to whichever thread
+// the repository's strand is running on
+V8_SCB(Repository::CacheStats) {
+  Repository* inst = Unwrap(args.This());
+  if (!args[0]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  repo_cache_stats_req* r = new repo_cache_stats_req;
+  r->repo = inst->repo;
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[0]));
+  SENCILLO_REPO_QUEUE(repo_cache_stats, inst, args.This());
+} SENCILLO_WORK(repo_cache_stats) {
+  git_odb* odb;
+
+  git_repository_cache_stats(&r->objects, r->repo);
+
+  r->status = git_repository_odb(&odb, r->repo);
+  if (r->status == GIT_OK) {
+    git_odb_cache_stats(&r->odb, odb);
+    git_odb_free(odb);
+  } else collectErr(r->status, r->err);
+} SENCILLO_WORK_AFTER(repo_cache_stats) {
+  v8::Handle<v8::Value> argv [2];
+  if (r->status == GIT_OK) {
+    Local<v8::Object> ret = v8u::Obj();
+    ret->Set(Symbol("objects"), cacheStatsObject(r->objects));
+    ret->Set(Symbol("odb"), cacheStatsObject(r->odb));
+    argv[0] = v8::Null();
+    argv[1] = ret;
+  } else {
+    argv[0] = composeErr(r->err);
+    argv[1] = v8::Null();
+  }
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+// The walk is set up lazily, on the strand, by its first job
+V8_CB(Repository::CreateWalker) {
+  Unwrap(args.This());
+  V8_RET((new RevWalk(args.This()))->Wrapped());
+} V8_CB_END()
+
 // SYMBOLS
 
 static Persistent<v8::String> stats_bytes_symbol;
@@ -418,7 +475,7 @@ V8_SCB(Repository::Clone) {
     } else printf("NO progress func\n");
   }
 
-  SENCILLO_WORK_QUEUE(repo_clone);
+  SENCILLO_BULK_QUEUE(repo_clone);
 } SENCILLO_WORK(repo_clone) {
   SENCILLO_ASYNC_CSTR(r->path, cpath);
   SENCILLO_ASYNC_CSTR(r->url, curl);
@@ -516,6 +573,9 @@ NODE_ETYPE(Repository, "Repository") {
   V8_DEF_GET("path", GetPath);
   V8_DEF_GET("bare", IsBare);
 
+  V8_DEF_CB("cacheStats", CacheStats);
+  V8_DEF_CB("createWalker", CreateWalker);
+
   stats_bytes_symbol = NODE_PSYMBOL("bytes");
   stats_received_symbol = NODE_PSYMBOL("received");
   stats_indexed_symbol = NODE_PSYMBOL("indexed");
@@ -28,6 +28,7 @@
 
 #include "git2.h"
 #include "v8u.hpp"
+#include "pool.h"
 
 namespace sencillo {
 
@@ -41,6 +42,9 @@ public:
   V8_SGET(GetPath);
   V8_SGET(IsBare);
 
+  static V8_SCB(CacheStats);
+  static V8_SCB(CreateWalker);
+
   // NOTE: Due to the allocation technique, this will
   // only succeed if absolute paths are given.
   static V8_SCB(Discover); static V8_SCB(DiscoverSync);
@@ -51,6 +55,10 @@ public:
   NODE_STYPE(Repository);
 //protected:
   git_repository* const repo;
+
+  // Async work touching `repo` must be queued here, so it never
+  // runs on two threads at once (see SENCILLO_REPO_QUEUE).
+  Strand strand;
 };
 
 };
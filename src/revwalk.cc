@@ -0,0 +1,281 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "revwalk.h"
+
+#include <node_buffer.h>
+
+#include "repository.h"
+#include "common.h"
+#include "error.h"
+#include "oid_array.h"
+
+
+using v8::Local;
+using v8::Persistent;
+using v8::Function;
+using v8u::Symbol;
+using v8u::Int;
+
+namespace sencillo {
+
+// Upper bound for one batch: 20 MB of oids
+#define SENCILLO_REVWALK_MAX_BATCH (1 << 20)
+
+RevWalk::RevWalk(v8::Handle<v8::Object> repo_obj) : walk(NULL) {
+  this->repo_obj = v8u::Persist<v8::Object>(repo_obj);
+  repo = node::ObjectWrap::Unwrap<Repository>(repo_obj);
+}
+RevWalk::~RevWalk() {
+  // no job can be running: they hold a handle to us
+  if (walk) git_revwalk_free(walk);
+  repo_obj.Dispose();
+}
+
+V8_ESCTOR(RevWalk) { V8_CTOR_NO_JS }
+
+static inline void addOp(RevWalk* inst, revwalk_op::Kind kind) {
+  revwalk_op op;
+  op.kind = kind;
+  inst->pending.push_back(op);
+}
+
+static inline void addOidOp(RevWalk* inst, revwalk_op::Kind kind, v8::Handle<v8::Value> oid) {
+  revwalk_op op;
+  op.kind = kind;
+  unwrapOid(oid, &op.oid);
+  inst->pending.push_back(op);
+}
+
+static inline void addNameOp(RevWalk* inst, revwalk_op::Kind kind, v8::Handle<v8::Value> name) {
+  if (!name->IsString()) V8_THROW(v8u::TypeErr("A String is needed!"));
+  revwalk_op op;
+  op.kind = kind;
+  op.name = *v8::String::Utf8Value(name);
+  inst->pending.push_back(op);
+}
+
+V8_CB(RevWalk::Push) {
+  addOidOp(Unwrap(args.This()), revwalk_op::PUSH, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::Hide) {
+  addOidOp(Unwrap(args.This()), revwalk_op::HIDE, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::PushGlob) {
+  addNameOp(Unwrap(args.This()), revwalk_op::PUSH_GLOB, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::HideGlob) {
+  addNameOp(Unwrap(args.This()), revwalk_op::HIDE_GLOB, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::PushRef) {
+  addNameOp(Unwrap(args.This()), revwalk_op::PUSH_REF, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::HideRef) {
+  addNameOp(Unwrap(args.This()), revwalk_op::HIDE_REF, args[0]);
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::PushHead) {
+  addNameOp(Unwrap(args.This()), revwalk_op::PUSH_REF, v8u::Str("HEAD"));
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::HideHead) {
+  addNameOp(Unwrap(args.This()), revwalk_op::HIDE_REF, v8u::Str("HEAD"));
+  V8_RET(args.This());
+} V8_CB_END()
+
+V8_CB(RevWalk::Sorting) {
+  RevWalk* inst = Unwrap(args.This());
+  if (!args[0]->IsNumber()) V8_THROW(v8u::TypeErr("A sorting mode is needed!"));
+  revwalk_op op;
+  op.kind = revwalk_op::SORTING;
+  op.sorting = v8u::Uint(args[0]);
+  inst->pending.push_back(op);
+  V8_RET(args.This());
+} V8_CB_END()
+
+// An Array of paths, or just one; an empty Array walks everything again
+V8_CB(RevWalk::Paths) {
+  RevWalk* inst = Unwrap(args.This());
+  revwalk_op op;
+  op.kind = revwalk_op::PATHS;
+  if (args[0]->IsString()) {
+    op.paths.push_back(*v8::String::Utf8Value(args[0]));
+  } else if (args[0]->IsArray()) {
+    Local<v8::Array> arr = v8u::Arr(args[0]);
+    for (uint32_t i = 0; i < arr->Length(); i++) {
+      Local<v8::Value> path = arr->Get(i);
+      if (!path->IsString()) V8_THROW(v8u::TypeErr("Paths must be Strings!"));
+      op.paths.push_back(*v8::String::Utf8Value(path));
+    }
+  } else {
+    V8_THROW(v8u::TypeErr("A String or an Array of them is needed!"));
+  }
+  inst->pending.push_back(op);
+  V8_RET(args.This());
+} V8_CB_END()
+
+// Forgets what was pushed and hidden, pending pushes and hides included;
+// like git_revwalk_reset, it keeps the sorting and the paths
+V8_CB(RevWalk::Reset) {
+  RevWalk* inst = Unwrap(args.This());
+  std::vector<revwalk_op> kept;
+  for (size_t i = 0; i < inst->pending.size(); i++) {
+    revwalk_op::Kind kind = inst->pending[i].kind;
+    if (kind == revwalk_op::SORTING || kind == revwalk_op::PATHS)
+      kept.push_back(inst->pending[i]);
+  }
+  inst->pending.swap(kept);
+  addOp(inst, revwalk_op::RESET);
+  V8_RET(args.This());
+} V8_CB_END()
+
+static int applyPaths(git_revwalk* walk, const std::vector<std::string>& paths) {
+  std::vector<char*> strings;
+  for (size_t i = 0; i < paths.size(); i++)
+    strings.push_back(const_cast<char*>(paths[i].c_str()));
+  git_strarray arr;
+  arr.strings = strings.empty() ? NULL : &strings[0];
+  arr.count = strings.size();
+  return git_revwalk_set_paths(walk, &arr);
+}
+
+static int applyOp(git_revwalk* walk, const revwalk_op& op) {
+  switch (op.kind) {
+    case revwalk_op::PUSH: return git_revwalk_push(walk, &op.oid);
+    case revwalk_op::HIDE: return git_revwalk_hide(walk, &op.oid);
+    case revwalk_op::PUSH_GLOB: return git_revwalk_push_glob(walk, op.name.c_str());
+    case revwalk_op::HIDE_GLOB: return git_revwalk_hide_glob(walk, op.name.c_str());
+    case revwalk_op::PUSH_REF: return git_revwalk_push_ref(walk, op.name.c_str());
+    case revwalk_op::HIDE_REF: return git_revwalk_hide_ref(walk, op.name.c_str());
+    case revwalk_op::SORTING: git_revwalk_sorting(walk, op.sorting); return GIT_OK;
+    case revwalk_op::PATHS: return applyPaths(walk, op.paths);
+    case revwalk_op::RESET: git_revwalk_reset(walk); return GIT_OK;
+  }
+  return GIT_OK;
+}
+
+//// RevWalk#nextBatch(n, callback)
+
+SENCILLO_WORK_PRE(revwalk_next_batch) {
+  RevWalk* inst;
+  std::vector<revwalk_op> ops;
+  git_oid* out; size_t want, got;
+  int status;
+  error_info err;
+
+  Persistent<v8::Object> self;
+  Persistent<v8::Object> repo_obj;
+  Persistent<Function> cb;
+  uv_work_t req;
+};
+
+V8_SCB(RevWalk::NextBatch) {
+  V8_M_UNWRAP(RevWalk, args.This());
+  if (!args[0]->IsNumber() || args[0]->IntegerValue() <= 0)
+    V8_STHROW(v8u::RangeErr("A positive count is needed"));
+  if (!args[1]->IsFunction()) V8_STHROW(v8u::TypeErr("A Function is needed as callback!"));
+
+  revwalk_next_batch_req* r = new revwalk_next_batch_req;
+  r->inst = inst;
+  r->self = v8u::Persist<v8::Object>(args.This());
+  r->ops.swap(inst->pending);
+  int64_t want = args[0]->IntegerValue();
+  r->want = want > SENCILLO_REVWALK_MAX_BATCH ? SENCILLO_REVWALK_MAX_BATCH : (size_t) want;
+  r->out = new git_oid [r->want];
+  r->got = 0;
+
+  r->cb = v8u::Persist<Function>(v8u::Cast<Function>(args[1]));
+  SENCILLO_REPO_QUEUE(revwalk_next_batch, inst->repo, inst->repo_obj);
+} SENCILLO_WORK(revwalk_next_batch) {
+  RevWalk* inst = r->inst;
+  r->status = GIT_OK;
+  if (!inst->walk) r->status = git_revwalk_new(&inst->walk, inst->repo->repo);
+
+  // the ones after a failed one are dropped with it
+  for (size_t i = 0; r->status == GIT_OK && i < r->ops.size(); i++)
+    r->status = applyOp(inst->walk, r->ops[i]);
+
+  while (r->status == GIT_OK && r->got < r->want) {
+    int status = git_revwalk_next(&r->out[r->got], inst->walk);
+    if (status == GIT_ITEROVER) break;
+    if (status == GIT_OK) r->got++;
+    else r->status = status;
+  }
+  if (r->status != GIT_OK) collectErr(r->status, r->err);
+} SENCILLO_WORK_AFTER(revwalk_next_batch) {
+  v8::Handle<v8::Value> argv [2];
+  argv[0] = v8::Null();
+  argv[1] = v8::Null();
+  if (r->status != GIT_OK) {
+    argv[0] = composeErr(r->err);
+  } else if (r->got) {
+    node::Buffer* buf = node::Buffer::New((char*)r->out, r->got * GIT_OID_RAWSZ);
+    argv[1] = buf->handle_;
+  }
+  delete [] r->out;
+  r->self.Dispose();
+  SENCILLO_REPO_CALL(2);
+} SENCILLO_END
+
+NODE_ETYPE(RevWalk, "RevWalk") {
+  V8_DEF_CB("push", Push);
+  V8_DEF_CB("hide", Hide);
+  V8_DEF_CB("pushGlob", PushGlob);
+  V8_DEF_CB("hideGlob", HideGlob);
+  V8_DEF_CB("pushRef", PushRef);
+  V8_DEF_CB("hideRef", HideRef);
+  V8_DEF_CB("pushHead", PushHead);
+  V8_DEF_CB("hideHead", HideHead);
+  V8_DEF_CB("sorting", Sorting);
+  V8_DEF_CB("paths", Paths);
+  V8_DEF_CB("reset", Reset);
+
+  V8_DEF_CB("nextBatch", NextBatch);
+
+  Local<Function> func = templ->GetFunction();
+
+  //FLAG: sorting modes -- SORT
+  Local<v8::Object> sortHash = v8u::Obj();
+  sortHash->Set(Symbol("NONE"), Int(GIT_SORT_NONE));
+  sortHash->Set(Symbol("TOPOLOGICAL"), Int(GIT_SORT_TOPOLOGICAL));
+  sortHash->Set(Symbol("TIME"), Int(GIT_SORT_TIME));
+  sortHash->Set(Symbol("REVERSE"), Int(GIT_SORT_REVERSE));
+  func->Set(Symbol("Sort"), sortHash);
+} NODE_TYPE_END()
+V8_POST_TYPE(RevWalk)
+
+};
@@ -0,0 +1,91 @@
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2010 Sam Day
+ * Copyright (c) 2012 Xavier Mendez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SENCILLO_REVWALK_H
+#define	SENCILLO_REVWALK_H
+
+#include <string>
+#include <vector>
+
+#include "git2.h"
+#include "v8u.hpp"
+#include "repository.h"
+
+namespace sencillo {
+
+// A push, hide, sorting or paths change, kept until the next job applies it
+struct revwalk_op {
+  enum Kind {
+    PUSH, HIDE, PUSH_GLOB, HIDE_GLOB, PUSH_REF, HIDE_REF, SORTING, PATHS, RESET
+  } kind;
+  git_oid oid;
+  std::string name;
+  std::vector<std::string> paths;
+  unsigned int sorting;
+};
+
+/*
+ * A revision walker over a Repository. The walk itself only runs on
+ * the repository's strand: push(), hide(), sorting() and friends just
+ * note what to do, and are applied, in order, by the next nextBatch()
+ * job (which also reports their errors). nextBatch(n, callback) gives
+ * up to `n` commit oids packed in one Buffer, or null once the walk is
+ * over; lib/ wraps it in a Readable. paths() limits the walk to the
+ * commits changing any of the given paths, as `git log -- <paths>`.
+ */
+class RevWalk : public node::ObjectWrap {
+public:
+  RevWalk(v8::Handle<v8::Object> repo_obj);
+  ~RevWalk();
+  V8_SCTOR();
+
+  static V8_SCB(Push);
+  static V8_SCB(Hide);
+  static V8_SCB(PushGlob);
+  static V8_SCB(HideGlob);
+  static V8_SCB(PushRef);
+  static V8_SCB(HideRef);
+  static V8_SCB(PushHead);
+  static V8_SCB(HideHead);
+  static V8_SCB(Sorting);
+  static V8_SCB(Paths);
+  static V8_SCB(Reset);
+
+  static V8_SCB(NextBatch);
+
+  NODE_STYPE(RevWalk);
+
+  // only touched from jobs on the repository's strand; created by the first
+  git_revwalk* walk;
+  // only touched on the main thread; handed over to the next job
+  std::vector<revwalk_op> pending;
+
+  Repository* repo;
+  v8::Persistent<v8::Object> repo_obj;
+};
+
+};
+
+#endif	/* SENCILLO_REVWALK_H */